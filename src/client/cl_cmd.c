@@ -92,7 +92,7 @@ void Cl_SendCmd(void) {
 
 	if (cls.state == CL_CONNECTED) {
 		// send any reliable messages and / or don't timeout
-		if (cls.net_chan.message.size || quetoo.time - cls.net_chan.last_sent > 1000)
+		if (Netchan_Pending(&cls.net_chan) || quetoo.time - cls.net_chan.last_sent > 1000)
 			Netchan_Transmit(&cls.net_chan, NULL, 0);
 		return;
 	}
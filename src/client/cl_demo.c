@@ -35,7 +35,7 @@ static void Cl_WriteDemoHeader(void) {
 
 	// write the server data
 	Net_WriteByte(&msg, SV_CMD_SERVER_DATA);
-	Net_WriteShort(&msg, PROTOCOL_MAJOR);
+	Net_WriteShort(&msg, cl.protocol);
 	Net_WriteShort(&msg, cls.cgame->protocol);
 	Net_WriteLong(&msg, cl.server_count);
 	Net_WriteLong(&msg, cl.server_hz);
@@ -195,3 +195,161 @@ void Cl_FastForward_f(void) {
 void Cl_SlowMotion_f(void) {
 	Cl_AdjustDemoPlayback(-DEMO_PLAYBACK_STEP);
 }
+
+/*
+ * @brief Accumulated sizes of packet entities re-encoded during demo playback,
+ * while the measurement is active. See Cl_DemoBandwidth_f.
+ */
+static struct {
+	_Bool active;
+	uint32_t frames;
+	size_t legacy; // bytes with PROTOCOL_MAJOR_LEGACY
+	size_t packed; // bytes with PROTOCOL_MAJOR
+} cl_demo_bandwidth;
+
+/*
+ * @brief Encodes the packet entities of the frame, relative to the delta frame,
+ * just as the server would for a client speaking the given protocol.
+ *
+ * @return The encoded size in bytes.
+ */
+static size_t Cl_EncodeDemoEntities(const uint16_t protocol, const cl_frame_t *from,
+		const cl_frame_t *to) {
+
+	mem_buf_t msg;
+	byte buffer[MAX_MSG_SIZE];
+
+	Mem_InitBuffer(&msg, buffer, sizeof(buffer));
+	msg.allow_overflow = true;
+
+	mem_bits_t bits;
+	uint16_t last_num = 0;
+
+	const _Bool packed = protocol == PROTOCOL_MAJOR;
+
+	if (packed)
+		Mem_BeginBits(&bits, &msg);
+
+	const uint16_t from_num_entities = from ? from->num_entities : 0;
+	uint32_t old_index = 0, new_index = 0;
+
+	while (new_index < to->num_entities || old_index < from_num_entities) {
+		const entity_state_t *old_state = NULL, *new_state = NULL;
+		uint16_t old_num = UINT16_MAX, new_num = UINT16_MAX;
+
+		if (new_index < to->num_entities) {
+			new_state = &cl.entity_states[(to->entity_state + new_index) & ENTITY_STATE_MASK];
+			new_num = new_state->number;
+		}
+
+		if (old_index < from_num_entities) {
+			old_state = &cl.entity_states[(from->entity_state + old_index) & ENTITY_STATE_MASK];
+			old_num = old_state->number;
+		}
+
+		if (new_num == old_num) {
+			if (packed) {
+				if (Net_WriteDeltaEntityBits(&bits, last_num, old_state, new_state, false))
+					last_num = new_num;
+			} else {
+				Net_WriteDeltaEntity(&msg, old_state, new_state, false);
+			}
+			old_index++;
+			new_index++;
+		} else if (new_num < old_num) {
+			const entity_state_t *baseline = &cl.entities[new_num].baseline;
+			if (packed) {
+				Net_WriteDeltaEntityBits(&bits, last_num, baseline, new_state, true);
+				last_num = new_num;
+			} else {
+				Net_WriteDeltaEntity(&msg, baseline, new_state, true);
+			}
+			new_index++;
+		} else {
+			if (packed) {
+				Net_WriteRemoveEntityBits(&bits, last_num, old_num);
+				last_num = old_num;
+			} else {
+				Net_WriteShort(&msg, old_num);
+				Net_WriteShort(&msg, U_REMOVE);
+			}
+			old_index++;
+		}
+	}
+
+	if (packed) {
+		Net_WriteEntityNumberBits(&bits, last_num, 0);
+		Mem_EndWriteBits(&bits);
+	} else {
+		Net_WriteShort(&msg, 0);
+	}
+
+	if (msg.overflowed) {
+		Com_Warn("Packet entities overflowed\n");
+	}
+
+	return msg.size;
+}
+
+/*
+ * @brief Re-encodes the packet entities of the frame just parsed from a demo
+ * with both the legacy and the bit packed encoders, for comparison.
+ */
+void Cl_DemoBandwidth(const cl_frame_t *delta_frame, const cl_frame_t *frame) {
+
+	if (!cl_demo_bandwidth.active || !cl.demo_server)
+		return;
+
+	cl_demo_bandwidth.frames++;
+	cl_demo_bandwidth.legacy += Cl_EncodeDemoEntities(PROTOCOL_MAJOR_LEGACY, delta_frame, frame);
+	cl_demo_bandwidth.packed += Cl_EncodeDemoEntities(PROTOCOL_MAJOR, delta_frame, frame);
+}
+
+/*
+ * @brief demo_bandwidth [start|stop|clear]
+ *
+ * Starts or stops re-encoding the packet entities of the demo frames played,
+ * or prints their size as encoded by the legacy and the bit packed protocols.
+ * Frames are only re-encoded between start and stop, so that the measurement
+ * costs nothing otherwise.
+ */
+void Cl_DemoBandwidth_f(void) {
+
+	if (Cmd_Argc() == 2) {
+		const char *arg = Cmd_Argv(1);
+
+		if (!g_strcmp0(arg, "start")) {
+			cl_demo_bandwidth.active = true;
+			Com_Print("Demo bandwidth started\n");
+		} else if (!g_strcmp0(arg, "stop")) {
+			cl_demo_bandwidth.active = false;
+			Com_Print("Demo bandwidth stopped\n");
+		} else if (!g_strcmp0(arg, "clear")) {
+			const _Bool active = cl_demo_bandwidth.active;
+			memset(&cl_demo_bandwidth, 0, sizeof(cl_demo_bandwidth));
+			cl_demo_bandwidth.active = active;
+			Com_Print("Demo bandwidth cleared\n");
+		} else {
+			Com_Print("Usage: %s [start|stop|clear]\n", Cmd_Argv(0));
+		}
+		return;
+	}
+
+	if (!cl_demo_bandwidth.frames) {
+		Com_Print("No demo frames measured, try `demo_bandwidth start; time_demo 1; demo <demo name>`\n");
+		return;
+	}
+
+	const uint32_t frames = cl_demo_bandwidth.frames;
+	const size_t legacy = cl_demo_bandwidth.legacy, packed = cl_demo_bandwidth.packed;
+
+	Com_Print("Demo packet entities over %u frames:\n", frames);
+	Com_Print("  protocol %d: %8u bytes, %6.1f bytes/frame\n", PROTOCOL_MAJOR_LEGACY,
+			(uint32_t) legacy, legacy / (vec_t) frames);
+	Com_Print("  protocol %d: %8u bytes, %6.1f bytes/frame\n", PROTOCOL_MAJOR,
+			(uint32_t) packed, packed / (vec_t) frames);
+
+	if (legacy) {
+		Com_Print("  %.1f%% of legacy\n", 100.0 * packed / legacy);
+	}
+}
@@ -30,6 +30,8 @@ void Cl_Record_f(void);
 void Cl_Stop_f(void);
 void Cl_FastForward_f(void);
 void Cl_SlowMotion_f(void);
+void Cl_DemoBandwidth(const cl_frame_t *delta_frame, const cl_frame_t *frame);
+void Cl_DemoBandwidth_f(void);
 #endif /* __CL_LOCAL_H__ */
 
 #endif /* __CL_DEMO_H__ */
@@ -56,9 +56,10 @@ static _Bool Cl_ValidDeltaEntity(const entity_state_t *from, const entity_state_
 
 /*
  * @brief Reads deltas from the given base and adds the resulting entity to the
- * current frame.
+ * current frame. If the packet entities are bit packed, the stream is given.
  */
-static void Cl_ReadDeltaEntity(cl_frame_t *frame, entity_state_t *from, uint16_t number, uint16_t bits) {
+static void Cl_ReadDeltaEntity(cl_frame_t *frame, entity_state_t *from, uint16_t number,
+		uint16_t bits, mem_bits_t *packed) {
 
 	cl_entity_t *ent = &cl.entities[number];
 
@@ -67,7 +68,10 @@ static void Cl_ReadDeltaEntity(cl_frame_t *frame, entity_state_t *from, uint16_t
 
 	frame->num_entities++;
 
-	Net_ReadDeltaEntity(&net_message, from, to, number, bits);
+	if (packed)
+		Net_ReadDeltaEntityBits(packed, from, to, number, bits);
+	else
+		Net_ReadDeltaEntity(&net_message, from, to, number, bits);
 
 	// check to see if the delta was successful and valid
 	if (ent->frame_num != cl.frame.frame_num - 1 || !Cl_ValidDeltaEntity(from, to)) {
@@ -103,125 +107,114 @@ static void Cl_ReadDeltaEntity(cl_frame_t *frame, entity_state_t *from, uint16_t
 }
 
 /*
- * @brief An svc_packetentities has just been parsed, deal with the rest of the data stream.
+ * @brief The delta frame's entities, walked alongside the packet entities.
  */
-static void Cl_ParseEntities(const cl_frame_t *delta_frame, cl_frame_t *frame) {
+typedef struct {
+	const cl_frame_t *delta_frame;
+	cl_frame_t *frame;
+	entity_state_t *state;
+	uint32_t index;
+	uint16_t delta_number;
+} cl_parse_entities_t;
 
-	frame->entity_state = cl.entity_state;
-	frame->num_entities = 0;
+/*
+ * @brief Advances to the next entity of the delta frame.
+ */
+static void Cl_NextDeltaEntity(cl_parse_entities_t *p) {
 
-	entity_state_t *state = NULL;
-	uint16_t delta_number;
+	p->index++;
 
-	if (delta_frame == NULL || delta_frame->num_entities == 0) {
-		delta_number = UINT16_MAX;
+	if (p->delta_frame == NULL || p->index >= p->delta_frame->num_entities) {
+		p->delta_number = UINT16_MAX;
 	} else {
-		state = &cl.entity_states[delta_frame->entity_state & ENTITY_STATE_MASK];
-		delta_number = state->number;
+		p->state = &cl.entity_states[(p->delta_frame->entity_state + p->index) & ENTITY_STATE_MASK];
+		p->delta_number = p->state->number;
 	}
+}
 
-	uint32_t index = 0;
-
-	while (true) {
-		const uint16_t number = Net_ReadShort(&net_message);
-
-		if (number >= MAX_ENTITIES)
-			Com_Error(ERR_DROP, "Bad number: %i\n", number);
-
-		if (net_message.read > net_message.size)
-			Com_Error(ERR_DROP, "End of message\n");
-
-		if (!number) // done
-			break;
+/*
+ * @brief Copies the delta frame's entities preceding number, which are unchanged,
+ * into the frame.
+ */
+static void Cl_CopyDeltaEntities(cl_parse_entities_t *p, uint16_t number) {
 
-		// before dealing with the new entity, copy unchanged entities into the frame
-		while (delta_number < number) {
+	while (p->delta_number < number) {
 
-			if (cl_show_net_messages->integer == 3)
-				Com_Print("   unchanged: %i\n", delta_number);
+		if (cl_show_net_messages->integer == 3)
+			Com_Print("   unchanged: %i\n", p->delta_number);
 
-			Cl_ReadDeltaEntity(frame, state, delta_number, 0);
+		Cl_ReadDeltaEntity(p->frame, p->state, p->delta_number, 0, NULL);
 
-			index++;
+		Cl_NextDeltaEntity(p);
+	}
+}
 
-			if (index >= delta_frame->num_entities) {
-				delta_number = UINT16_MAX;
-			} else {
-				state = &cl.entity_states[(delta_frame->entity_state + index) & ENTITY_STATE_MASK];
-				delta_number = state->number;
-			}
-		}
+/*
+ * @brief Net_PacketEntityFunc for Cl_ParseEntities.
+ */
+static void Cl_ParseEntity(mem_buf_t *msg, mem_bits_t *packed, uint16_t number, uint16_t flags,
+		void *data) {
 
-		// now deal with the new entity
-		const uint16_t bits = Net_ReadShort(&net_message);
+	cl_parse_entities_t *p = (cl_parse_entities_t *) data;
 
-		if (bits & U_REMOVE) { // remove it, no delta
+	// before dealing with the new entity, copy unchanged entities into the frame
+	Cl_CopyDeltaEntities(p, number);
 
-			if (cl_show_net_messages->integer == 3)
-				Com_Print("   remove: %i\n", number);
+	if (flags & U_REMOVE) { // remove it, no delta
 
-			if (delta_number != number)
-				Com_Warn("U_REMOVE: %u != %u\n", delta_number, number);
+		if (cl_show_net_messages->integer == 3)
+			Com_Print("   remove: %i\n", number);
 
-			index++;
+		if (p->delta_number != number)
+			Com_Warn("U_REMOVE: %u != %u\n", p->delta_number, number);
 
-			if (index >= delta_frame->num_entities) {
-				delta_number = UINT16_MAX;
-			} else {
-				state = &cl.entity_states[(delta_frame->entity_state + index) & ENTITY_STATE_MASK];
-				delta_number = state->number;
-			}
+		Cl_NextDeltaEntity(p);
+		return;
+	}
 
-			continue;
-		}
+	if (p->delta_number == number) { // delta from previous state
 
-		if (delta_number == number) { // delta from previous state
+		if (cl_show_net_messages->integer == 3)
+			Com_Print("   delta: %i\n", number);
 
-			if (cl_show_net_messages->integer == 3)
-				Com_Print("   delta: %i\n", number);
+		Cl_ReadDeltaEntity(p->frame, p->state, number, flags, packed);
 
-			Cl_ReadDeltaEntity(frame, state, number, bits);
+		Cl_NextDeltaEntity(p);
+		return;
+	}
 
-			index++;
+	// delta from baseline
+	if (cl_show_net_messages->integer == 3)
+		Com_Print("   baseline: %i\n", number);
 
-			if (index >= delta_frame->num_entities) {
-				delta_number = UINT16_MAX;
-			} else {
-				state = &cl.entity_states[(delta_frame->entity_state + index) & ENTITY_STATE_MASK];
-				delta_number = state->number;
-			}
+	Cl_ReadDeltaEntity(p->frame, &cl.entities[number].baseline, number, flags, packed);
+}
 
-			continue;
-		}
+/*
+ * @brief An svc_packetentities has just been parsed, deal with the rest of the data stream.
+ */
+static void Cl_ParseEntities(const cl_frame_t *delta_frame, cl_frame_t *frame) {
 
-		if (delta_number > number) { // delta from baseline
+	frame->entity_state = cl.entity_state;
+	frame->num_entities = 0;
 
-			if (cl_show_net_messages->integer == 3)
-				Com_Print("   baseline: %i\n", number);
+	cl_parse_entities_t p = {
+		.delta_frame = delta_frame,
+		.frame = frame,
+		.delta_number = UINT16_MAX
+	};
 
-			Cl_ReadDeltaEntity(frame, &cl.entities[number].baseline, number, bits);
+	if (delta_frame && delta_frame->num_entities) {
+		p.state = &cl.entity_states[delta_frame->entity_state & ENTITY_STATE_MASK];
+		p.delta_number = p.state->number;
+	}
 
-			continue;
-		}
+	if (!Net_ReadPacketEntities(&net_message, cl.protocol == PROTOCOL_MAJOR, Cl_ParseEntity, &p)) {
+		Com_Error(ERR_DROP, "Bad packet entities\n");
 	}
 
 	// any remaining entities in the old frame are copied over
-	while (delta_number != UINT16_MAX) { // one or more entities from the old packet are unchanged
-
-		if (cl_show_net_messages->integer == 3)
-			Com_Print("   unchanged: %i\n", delta_number);
-
-		Cl_ReadDeltaEntity(frame, state, delta_number, 0);
-
-		index++;
-
-		if (index >= delta_frame->num_entities) {
-			delta_number = UINT16_MAX;
-		} else {
-			state = &cl.entity_states[(delta_frame->entity_state + index) & ENTITY_STATE_MASK];
-			delta_number = state->number;
-		}
-	}
+	Cl_CopyDeltaEntities(&p, UINT16_MAX);
 }
 
 /*
@@ -229,13 +222,18 @@ static void Cl_ParseEntities(const cl_frame_t *delta_frame, cl_frame_t *frame) {
  */
 void Cl_ParseFrame(void) {
 
+	net_frame_t header;
+
 	memset(&cl.frame, 0, sizeof(cl.frame));
 
-	cl.frame.frame_num = Net_ReadLong(&net_message);
+	if (!Net_ReadFrame(&net_message, &header))
+		Com_Error(ERR_DROP, "Bad frame\n");
+
+	cl.frame.frame_num = header.frame_num;
 
-	cl.frame.delta_frame_num = Net_ReadLong(&net_message);
+	cl.frame.delta_frame_num = header.delta_frame_num;
 
-	cl.surpress_count = Net_ReadByte(&net_message);
+	cl.surpress_count = header.surpress_count;
 
 	if (cl_show_net_messages->integer == 3)
 		Com_Print("   frame:%i  delta:%i\n", cl.frame.frame_num, cl.frame.delta_frame_num);
@@ -258,13 +256,14 @@ void Cl_ParseFrame(void) {
 		cl.frame.valid = true;
 	}
 
-	const size_t len = Net_ReadByte(&net_message); // read area_bits
-	Net_ReadData(&net_message, &cl.frame.area_bits, len);
+	memcpy(cl.frame.area_bits, header.area_bits, sizeof(cl.frame.area_bits));
 
 	Cl_ParsePlayerState(cl.delta_frame, &cl.frame);
 
 	Cl_ParseEntities(cl.delta_frame, &cl.frame);
 
+	Cl_DemoBandwidth(cl.delta_frame, &cl.frame);
+
 	// set the simulation time for the frame
 	cl.frame.time = cl.frame.frame_num * (1000 / cl.server_hz);
 
@@ -73,8 +73,10 @@ static void Cl_SendConnect(void) {
 	if (addr.port == 0) // use default port
 		addr.port = htons(PORT_SERVER);
 
-	Netchan_OutOfBandPrint(NS_UDP_CLIENT, &addr, "connect %i %i %u \"%s\"\n", PROTOCOL_MAJOR,
-			qport->integer, cls.challenge, Cvar_UserInfo());
+	Netchan_OutOfBandPrint(NS_UDP_CLIENT, &addr, "connect %i %i %u \"%s\" %i %u\n", PROTOCOL_MAJOR,
+			qport->integer, cls.challenge, Cvar_UserInfo(),
+			(net_compress->integer ? NET_CHAN_COMPRESS : 0) | NET_CHAN_WINDOW,
+			Netchan_SeedChecksum());
 
 	cvar_user_info_modified = false;
 }
@@ -257,6 +259,8 @@ void Cl_SendDisconnect(void) {
 
 	Netchan_Transmit(&cls.net_chan, final, strlen((char *) final));
 
+	Netchan_Close(&cls.net_chan);
+
 	Cl_ClearState();
 
 	cls.broadcast_time = 0;
@@ -377,8 +381,14 @@ static void Cl_ConnectionlessPacket(void) {
 		cls.state = CL_CONNECTED;
 
 		memset(cls.download_url, 0, sizeof(cls.download_url));
-		if (Cmd_Argc() == 2) { // http download url
-			g_strlcpy(cls.download_url, Cmd_Argv(1), sizeof(cls.download_url));
+		for (int32_t i = 1; i < Cmd_Argc(); i++) {
+			if (!g_strcmp0(Cmd_Argv(i), "compress")) { // server accepted compression
+				cls.net_chan.compress = true;
+			} else if (!g_strcmp0(Cmd_Argv(i), "window")) { // server accepted reliable window
+				Netchan_OpenWindow(&cls.net_chan);
+			} else { // http download url
+				g_strlcpy(cls.download_url, Cmd_Argv(i), sizeof(cls.download_url));
+			}
 		}
 		return;
 	}
@@ -530,11 +540,14 @@ static void Cl_InitLocal(void) {
 	Cmd_Add("servers_list", Cl_Servers_List_f, CMD_CLIENT, NULL);
 	Cmd_Add("slow_motion", Cl_SlowMotion_f, CMD_CLIENT, NULL);
 	Cmd_Add("stop", Cl_Stop_f, CMD_CLIENT, NULL);
+	Cmd_Add("demo_bandwidth", Cl_DemoBandwidth_f, CMD_CLIENT,
+			"Compare packet entity encodings over the demo frames played after demo_bandwidth start");
 	Cmd_Add("connect", Cl_Connect_f, CMD_CLIENT, NULL);
 	Cmd_Add("reconnect", Cl_Reconnect_f, CMD_CLIENT, NULL);
 	Cmd_Add("disconnect", Cl_Disconnect_f, CMD_CLIENT, NULL);
 	Cmd_Add("rcon", Cl_Rcon_f, CMD_CLIENT, NULL);
 	Cmd_Add("precache", Cl_Precache_f, CMD_CLIENT, NULL);
+	Cmd_Add("baselines", Cl_Baselines_f, CMD_CLIENT, NULL);
 	Cmd_Add("download", Cl_Download_f, CMD_CLIENT, NULL);
 
 	// forward anything we don't handle locally to the server
@@ -660,6 +673,9 @@ void Cl_Frame(const uint32_t msec) {
 		if (cls.state < CL_LOADING && !Com_WasInit(QUETOO_SERVER)) {
 			usleep(16000);
 		}
+
+		// release the frame's temporary allocations
+		Mem_ResetFrame(MEM_TAG_CLIENT);
 	}
 }
 
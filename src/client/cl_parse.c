@@ -61,6 +61,9 @@ _Bool Cl_CheckOrDownloadFile(const char *filename) {
 
 	strncpy(cls.download.name, filename, sizeof(cls.download.name));
 
+	cls.download.stream = false;
+	cls.download.offset = 0;
+
 	// UDP downloads to a temp name, and only renames when done
 	StripExtension(cls.download.name, cls.download.tempname);
 	g_strlcat(cls.download.tempname, ".tmp", sizeof(cls.download.tempname));
@@ -81,7 +84,9 @@ _Bool Cl_CheckOrDownloadFile(const char *filename) {
 				// give the server the offset to start the download
 				Com_Debug("Resuming %s...\n", cls.download.name);
 
-				g_snprintf(cmd, sizeof(cmd), "download %s %u", cls.download.name, (uint32_t) len);
+				g_snprintf(cmd, sizeof(cmd), "download %s %u stream", cls.download.name, (uint32_t) len);
+				cls.download.offset = (int32_t) len;
+
 				Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
 				Net_WriteString(&cls.net_chan.message, cmd);
 
@@ -93,7 +98,7 @@ _Bool Cl_CheckOrDownloadFile(const char *filename) {
 	// or start if from the beginning
 	Com_Debug("Downloading %s...\n", cls.download.name);
 
-	g_snprintf(cmd, sizeof(cmd), "download %s", cls.download.name);
+	g_snprintf(cmd, sizeof(cmd), "download %s 0 stream", cls.download.name);
 	Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
 	Net_WriteString(&cls.net_chan.message, cmd);
 
@@ -113,6 +118,34 @@ void Cl_Download_f(void) {
 	Cl_CheckOrDownloadFile(Cmd_Argv(1));
 }
 
+/*
+ * @brief The server sends this command once we hold all of the config strings,
+ * and again for each packet of baselines. The first request offers the server
+ * a compression dictionary primed with the config strings, so that the
+ * baselines, and everything after them, may be compressed against it.
+ */
+void Cl_Baselines_f(void) {
+
+	if (cls.state <= CL_DISCONNECTED) {
+		Com_Print("%s: Not connected\n", Cmd_Argv(0));
+		return;
+	}
+
+	if (Cmd_Argc() != 3) {
+		Com_Print("Usage: %s <spawn_count> <start>\n", Cmd_Argv(0));
+		return;
+	}
+
+	if (cls.net_chan.compress && strtoul(Cmd_Argv(2), NULL, 0) == 0) {
+		Netchan_BuildDictionary(&cls.dictionary, cl.config_strings, MAX_CONFIG_STRINGS);
+		cls.net_chan.dictionary = &cls.dictionary;
+	}
+
+	Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
+	Net_WriteString(&cls.net_chan.message, va("baselines %s %s %u", Cmd_Argv(1), Cmd_Argv(2),
+			cls.dictionary.checksum));
+}
+
 /*
  * @brief The server sends this command just after server_data. Hang onto the spawn
  * count and check for the media we'll need to enter the game.
@@ -201,16 +234,169 @@ void Cl_ParseConfigString(void) {
 	cls.cgame->UpdateConfigString(i);
 }
 
+/*
+ * @brief Closes the completed download, and moves on to the next.
+ */
+static void Cl_FinishDownload(void) {
+
+	Fs_Close(cls.download.file);
+	cls.download.file = NULL;
+	cls.download.stream = false;
+
+	// add new archives to the search path
+	if (Fs_Rename(cls.download.tempname, cls.download.name)) {
+		if (strstr(cls.download.name, ".pk3")) {
+			Fs_AddToSearchPath(cls.download.name);
+		}
+	} else {
+		Com_Error(ERR_DROP, "Failed to rename %s\n", cls.download.name);
+	}
+
+	// get another file if needed
+	Cl_RequestNextDownload();
+}
+
+/*
+ * @brief Streamed download acknowledgements are batched, and sent once a
+ * quarter of the window has been written, or after an interval well within
+ * the server's minimum retransmit time.
+ */
+#define DOWNLOAD_ACK_CHUNKS (DOWNLOAD_WINDOW / 4)
+#define DOWNLOAD_ACK_MSEC 50
+
+/*
+ * @brief Acknowledges the chunks of a streamed download which have arrived
+ * since our last acknowledgement, if a batch is due or force is set. This is
+ * called once per server message.
+ */
+static void Cl_AckDownload(_Bool force) {
+
+	if (!cls.download.ack)
+		return;
+
+	if (!force) {
+		const int32_t written = cls.download.offset - cls.download.acked;
+
+		if (written < DOWNLOAD_ACK_CHUNKS * DOWNLOAD_CHUNK_SIZE &&
+				quetoo.time - cls.download.ack_time < DOWNLOAD_ACK_MSEC)
+			return;
+	}
+
+	cls.download.ack = false;
+	cls.download.acked = cls.download.offset;
+	cls.download.ack_time = quetoo.time;
+
+	Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
+	Net_WriteString(&cls.net_chan.message, va("download_ack %d %" PRIu64, cls.download.offset,
+			cls.download.held));
+}
+
+/*
+ * @brief The server has agreed to stream the download, and sent its length.
+ */
+static void Cl_ParseDownloadStream(const net_download_t *download) {
+
+	const int32_t size = download->length;
+
+	if (!cls.download.file) {
+		if (!(cls.download.file = Fs_OpenWrite(cls.download.tempname))) {
+			Com_Warn("Failed to open %s\n", cls.download.tempname);
+
+			// acknowledge the entire file, so that the server stops sending it
+			Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
+			Net_WriteString(&cls.net_chan.message, va("download_ack %d 0", size));
+
+			Cl_RequestNextDownload();
+			return;
+		}
+	}
+
+	cls.download.stream = true;
+	cls.download.start = cls.download.acked = cls.download.offset;
+	cls.download.ack_time = quetoo.time;
+	cls.download.size = size;
+	cls.download.held = 0;
+
+	if (cls.download.offset >= cls.download.size) {
+		Cl_FinishDownload();
+	}
+}
+
+/*
+ * @brief A chunk of a streamed download has arrived. Chunks which arrive in
+ * order are written immediately, while those which arrive ahead of a missing
+ * chunk are held until it is resent.
+ */
+static void Cl_ParseDownloadChunk(const net_download_t *download) {
+
+	const int32_t offset = download->offset;
+	const int32_t len = download->len;
+	const byte *data = download->data;
+
+	if (!cls.download.stream || !cls.download.file)
+		return;
+
+	cls.download.ack = true;
+
+	if (offset < cls.download.offset || offset + len > cls.download.size)
+		return;
+
+	const int32_t i = (offset - cls.download.offset) / DOWNLOAD_CHUNK_SIZE;
+	if (i >= DOWNLOAD_WINDOW || (offset - cls.download.start) % DOWNLOAD_CHUNK_SIZE)
+		return;
+
+	if (i > 0) { // hold it until the chunks before it arrive
+		const int32_t chunk = (offset - cls.download.start) / DOWNLOAD_CHUNK_SIZE;
+		memcpy(cls.download.chunks[chunk % DOWNLOAD_WINDOW], data, len);
+
+		cls.download.held |= 1ull << i;
+		return;
+	}
+
+	Fs_Write(cls.download.file, data, 1, len);
+
+	cls.download.offset += len;
+	cls.download.held >>= 1;
+
+	// and write any held chunks which are now contiguous
+	while (cls.download.held & 1) {
+		const int32_t chunk = (cls.download.offset - cls.download.start) / DOWNLOAD_CHUNK_SIZE;
+		const int32_t l = MIN(cls.download.size - cls.download.offset, DOWNLOAD_CHUNK_SIZE);
+
+		Fs_Write(cls.download.file, cls.download.chunks[chunk % DOWNLOAD_WINDOW], 1, l);
+
+		cls.download.offset += l;
+		cls.download.held >>= 1;
+	}
+
+	if (cls.download.offset == cls.download.size) {
+		Cl_AckDownload(true);
+		Cl_FinishDownload();
+	}
+}
+
 /*
  * @brief A download message has been received from the server.
  */
 static void Cl_ParseDownload(void) {
-	int32_t size, percent;
+	net_download_t download;
 
 	// read the data
-	size = Net_ReadShort(&net_message);
-	percent = Net_ReadByte(&net_message);
-	if (size < 0) {
+	if (!Net_ReadDownload(&net_message, &download)) {
+		Com_Error(ERR_DROP, "Bad download\n");
+	}
+
+	if (download.size == DOWNLOAD_STREAM) {
+		Cl_ParseDownloadStream(&download);
+		return;
+	}
+
+	if (download.size == DOWNLOAD_STREAM_CHUNK) {
+		Cl_ParseDownloadChunk(&download);
+		return;
+	}
+
+	if (download.size < 0) {
 		Com_Debug("Server does not have this file\n");
 		if (cls.download.file) {
 			// if here, we tried to resume a file but the server said no
@@ -225,35 +411,19 @@ static void Cl_ParseDownload(void) {
 	if (!cls.download.file) {
 
 		if (!(cls.download.file = Fs_OpenWrite(cls.download.tempname))) {
-			net_message.read += size;
 			Com_Warn("Failed to open %s\n", cls.download.tempname);
 			Cl_RequestNextDownload();
 			return;
 		}
 	}
 
-	Fs_Write(cls.download.file, net_message.data + net_message.read, 1, size);
-
-	net_message.read += size;
+	Fs_Write(cls.download.file, download.data, 1, download.len);
 
-	if (percent != 100) {
+	if (download.percent != 100) {
 		Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
 		Net_WriteString(&cls.net_chan.message, "next_download");
 	} else {
-		Fs_Close(cls.download.file);
-		cls.download.file = NULL;
-
-		// add new archives to the search path
-		if (Fs_Rename(cls.download.tempname, cls.download.name)) {
-			if (strstr(cls.download.name, ".pk3")) {
-				Fs_AddToSearchPath(cls.download.name);
-			}
-		} else {
-			Com_Error(ERR_DROP, "Failed to rename %s\n", cls.download.name);
-		}
-
-		// get another file if needed
-		Cl_RequestNextDownload();
+		Cl_FinishDownload();
 	}
 }
 
@@ -265,48 +435,52 @@ static void Cl_ParseServerData(void) {
 	// wipe the cl_client_t struct
 	Cl_ClearState();
 
+	// the config strings, and so the compression dictionary, are changing
+	cls.net_chan.dictionary = NULL;
+
 	cls.state = CL_CONNECTED;
 
 	Cl_SetKeyDest(KEY_CONSOLE);
 
-	// parse protocol version number
-	const uint16_t major = Net_ReadShort(&net_message);
-	const uint16_t minor = Net_ReadShort(&net_message);
+	net_server_data_t data;
+	if (!Net_ReadServerData(&net_message, &data)) {
+		Com_Error(ERR_DROP, "Bad server data\n");
+	}
 
-	// ensure protocol major matches
-	if (major != PROTOCOL_MAJOR) {
-		Com_Error(ERR_DROP, "Server is using protocol major %d\n", major);
+	// ensure protocol major is one we speak
+	if (data.major != PROTOCOL_MAJOR && data.major != PROTOCOL_MAJOR_LEGACY) {
+		Com_Error(ERR_DROP, "Server is using protocol major %d\n", data.major);
 	}
 
+	cl.protocol = data.major;
+
 	// retrieve spawn count and packet rate
-	cl.server_count = Net_ReadLong(&net_message);
-	cl.server_hz = Net_ReadLong(&net_message);
+	cl.server_count = data.server_count;
+	cl.server_hz = data.server_hz;
 
 	// determine if we're viewing a demo
-	cl.demo_server = Net_ReadByte(&net_message);
+	cl.demo_server = data.demo_server;
 
 	// game directory
-	char *str = Net_ReadString(&net_message);
-	if (g_strcmp0(Cvar_GetString("game"), str)) {
+	if (g_strcmp0(Cvar_GetString("game"), data.game)) {
 
-		Fs_SetGame(str);
+		Fs_SetGame(data.game);
 
 		// reload the client game
 		Cl_InitCgame();
 	}
 
 	// ensure protocol minor matches
-	if (minor != cls.cgame->protocol) {
-		Com_Error(ERR_DROP, "Server is using protocol minor %d\n", minor);
+	if (data.minor != cls.cgame->protocol) {
+		Com_Error(ERR_DROP, "Server is using protocol minor %d\n", data.minor);
 	}
 
 	// parse client slot number, which is our entity number + 1
-	cl.client_num = Net_ReadShort(&net_message);
+	cl.client_num = data.client_num;
 
 	// get the full level name
-	str = Net_ReadString(&net_message);
 	Com_Print("\n");
-	Com_Print("%c%s\n", 2, str);
+	Com_Print("%c%s\n", 2, data.level_name);
 }
 
 /**
@@ -358,43 +532,18 @@ static void Cl_ParsePrint(void) {
  * @brief
  */
 static void Cl_ParseSound(void) {
-	vec3_t origin;
-	vec_t *org;
-	uint16_t index;
-	uint16_t ent_num;
-	int32_t atten;
-
-	const byte flags = Net_ReadByte(&net_message);
-
-	if ((index = Net_ReadByte(&net_message)) > MAX_SOUNDS)
-		Com_Error(ERR_DROP, "Bad index (%d)\n", index);
+	net_sound_t sound;
 
-	if (flags & S_ATTEN)
-		atten = Net_ReadByte(&net_message);
-	else
-		atten = ATTEN_DEFAULT;
+	if (!Net_ReadSound(&net_message, &sound))
+		Com_Error(ERR_DROP, "Bad sound\n");
 
-	if (flags & S_ENTITY) { // entity relative
-		ent_num = Net_ReadShort(&net_message);
+	// positioned in space, or relative to the entity
+	const vec_t *org = (sound.flags & S_ORIGIN) ? sound.origin : NULL;
 
-		if (ent_num > MAX_ENTITIES)
-			Com_Error(ERR_DROP, "Bad entity number (%d)\n", ent_num);
-	} else {
-		ent_num = 0;
-	}
-
-	if (flags & S_ORIGIN) { // positioned in space
-		Net_ReadPosition(&net_message, origin);
-
-		org = origin;
-	} else
-		// use ent_num
-		org = NULL;
-
-	if (!cl.sound_precache[index])
+	if (!cl.sound_precache[sound.index])
 		return;
 
-	S_PlaySample(org, ent_num, cl.sound_precache[index], atten);
+	S_PlaySample(org, sound.entity, cl.sound_precache[sound.index], sound.atten);
 }
 
 /*
@@ -499,6 +648,8 @@ void Cl_ParseServerMessage(void) {
 		}
 	}
 
+	Cl_AckDownload(false);
+
 	Cl_AddNetGraph();
 
 	Cl_WriteDemoMessage();
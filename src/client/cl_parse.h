@@ -30,6 +30,7 @@ void Cl_ParseConfigString(void);
 void Cl_ParseServerMessage(void);
 void Cl_Download_f(void);
 void Cl_Precache_f(void);
+void Cl_Baselines_f(void);
 #endif /* __CL_LOCAL_H__ */
 
 #endif /* __CL_PARSE_H__ */
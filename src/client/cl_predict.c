@@ -206,15 +206,25 @@ void Cl_PredictMovement(void) {
 			return;
 		}
 
-		GList *cmds = NULL;
+		// the command list is frame scratch, so build it in the frame arena
+		GList *cmds = NULL, *last = NULL;
 
 		while (++ack <= current) {
-			cmds = g_list_append(cmds, &cl.cmds[ack & CMD_MASK]);
+			GList *cmd = Mem_FrameAlloc(sizeof(*cmd), MEM_TAG_CLIENT);
+
+			cmd->data = &cl.cmds[ack & CMD_MASK];
+			cmd->prev = last;
+
+			if (last) {
+				last->next = cmd;
+			} else {
+				cmds = cmd;
+			}
+
+			last = cmd;
 		}
 
 		cls.cgame->PredictMovement(cmds);
-
-		g_list_free(cmds);
 	}
 }
 
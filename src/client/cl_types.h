@@ -168,6 +168,7 @@ typedef struct {
 	// tracked view angles to account for spawn and teleport direction changes
 	vec3_t angles;
 
+	uint16_t protocol; // protocol major of the server, or of the demo being played
 	uint32_t server_count; // server identification for precache
 	uint16_t server_hz; // server frame rate (packets per second)
 
@@ -255,6 +256,16 @@ typedef struct {
 	file_t *file;
 	char tempname[MAX_OS_PATH];
 	char name[MAX_OS_PATH];
+
+	_Bool stream; // chunks arrive unreliably, see DOWNLOAD_STREAM
+	_Bool ack; // chunks have arrived since our last acknowledgement
+	int32_t acked; // the offset of our last acknowledgement
+	uint32_t ack_time; // the time of our last acknowledgement
+	int32_t start; // the offset at which the download began
+	int32_t offset; // the contiguous length written to file
+	int32_t size; // the file length
+	uint64_t held; // chunks beyond offset which arrived out of order
+	byte chunks[DOWNLOAD_WINDOW][DOWNLOAD_CHUNK_SIZE];
 } cl_download_t;
 
 // server information, for finding network games
@@ -304,6 +315,7 @@ typedef struct {
 	uint32_t connect_time; // for connection retransmits
 
 	net_chan_t net_chan; // network channel
+	net_dictionary_t dictionary; // compression dictionary, built before baselines
 
 	uint32_t challenge; // from the server to use for connecting
 	uint32_t spawn_count;
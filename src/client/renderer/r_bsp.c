@@ -550,13 +550,11 @@ void R_UpdateVis(void) {
 	if (clusters[1] != -1 && clusters[1] != clusters[0]) {
 		byte pvs[MAX_BSP_LEAFS >> 3], phs[MAX_BSP_LEAFS >> 3];
 
-		Cm_ClusterPVS(clusters[1], pvs);
+		const size_t len = Cm_ClusterPVS(clusters[1], pvs);
 		Cm_ClusterPHS(clusters[1], phs);
 
-		for (size_t i = 0; i < sizeof(r_locals.vis_data_pvs); i++) {
-			r_locals.vis_data_pvs[i] |= pvs[i];
-			r_locals.vis_data_phs[i] |= phs[i];
-		}
+		Cm_VisOr(r_locals.vis_data_pvs, pvs, len);
+		Cm_VisOr(r_locals.vis_data_phs, phs, len);
 	}
 
 	// recurse up the BSP from the visible leafs, marking a path via the nodes
@@ -67,7 +67,7 @@ static void R_LoadBspClusters(r_bsp_model_t *bsp, const d_bsp_lump_t *l) {
 		return;
 	}
 
-	d_bsp_vis_t *vis = (d_bsp_vis_t *) (r_bsp_base + l->file_ofs);
+	const d_bsp_vis_t *vis = (const void *) (r_bsp_base + l->file_ofs);
 
 	bsp->num_clusters = LittleLong(vis->num_clusters);
 	bsp->clusters = Mem_LinkMalloc(bsp->num_clusters * sizeof(r_bsp_cluster_t), bsp);
@@ -874,11 +874,11 @@ static void R_LoadBspSurfacesArrays(r_model_t *mod) {
 /*
  * @brief
  */
-void R_LoadBspModel(r_model_t *mod, void *buffer) {
+void R_LoadBspModel(r_model_t *mod, const void *buffer) {
 	extern void Cl_LoadingProgress(uint16_t percent, const char *file);
 
 	// byte-swap the entire header
-	d_bsp_header_t header = *(d_bsp_header_t *) buffer;
+	d_bsp_header_t header = *(const d_bsp_header_t *) buffer;
 
 	for (size_t i = 0; i < sizeof(d_bsp_header_t) / sizeof(int32_t); i++) {
 		((int32_t *) &header)[i] = LittleLong(((int32_t *) &header)[i]);
@@ -892,7 +892,7 @@ void R_LoadBspModel(r_model_t *mod, void *buffer) {
 	mod->bsp->version = header.version;
 
 	// set the base pointer for lump loading
-	r_bsp_base = (byte *) buffer;
+	r_bsp_base = buffer;
 
 	R_LoadBspVertexes(mod->bsp, &header.lumps[BSP_LUMP_VERTEXES]);
 	Cl_LoadingProgress(4, "vertices");
@@ -25,7 +25,7 @@
 #include "r_types.h"
 
 #ifdef __R_LOCAL_H__
-void R_LoadBspModel(r_model_t *mod, void *buffer);
+void R_LoadBspModel(r_model_t *mod, const void *buffer);
 #endif /* __R_LOCAL_H__ */
 
 #endif /* __R_BSP_MODEL_H__ */
@@ -211,10 +211,8 @@ static _Bool R_PositionalIllumination(const r_lighting_t *l, r_illumination_type
  * @brief Adds illuminations for static (BSP) light sources.
  */
 static void R_StaticIlluminations(r_lighting_t *l) {
-	byte pvs[MAX_BSP_LEAFS >> 3];
 
 	const r_bsp_leaf_t *leaf = R_LeafForPoint(l->origin, NULL);
-	Cm_ClusterPVS(leaf->cluster, pvs);
 
 	const r_bsp_light_t *bl = r_model_state.world->bsp->bsp_lights;
 
@@ -222,7 +220,7 @@ static void R_StaticIlluminations(r_lighting_t *l) {
 
 		const int16_t cluster = bl->leaf->cluster;
 		if (cluster != -1) {
-			if ((pvs[cluster >> 3] & (1 << (cluster & 7))) == 0) {
+			if (!Cm_ClustersVisible(leaf->cluster, cluster)) {
 				continue;
 			}
 		}
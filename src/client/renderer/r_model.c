@@ -27,12 +27,13 @@ typedef struct {
 	const char *extension;
 	r_model_type_t type;
 	void (*Load)(r_model_t *mod, void *buffer);
+	void (*LoadMapped)(r_model_t *mod, const void *buffer);
 } r_model_format_t;
 
 static const r_model_format_t r_model_formats[] = { // supported model formats
-	{ ".obj", MOD_OBJ, R_LoadObjModel },
-	{ ".md3", MOD_MD3, R_LoadMd3Model },
-	{ ".bsp", MOD_BSP, R_LoadBspModel }
+	{ ".obj", MOD_OBJ, R_LoadObjModel, NULL },
+	{ ".md3", MOD_MD3, R_LoadMd3Model, NULL },
+	{ ".bsp", MOD_BSP, NULL, R_LoadBspModel }
 };
 
 /*
@@ -152,14 +153,19 @@ r_model_t *R_LoadModel(const char *name) {
 
 	if (!(mod = (r_model_t *) R_FindMedia(key))) {
 
-		void *buf;
+		void *buf = NULL;
+		const void *map = NULL;
 		const r_model_format_t *format = r_model_formats;
 		for (i = 0; i < lengthof(r_model_formats); i++, format++) {
 
 			StripExtension(name, key);
 			strcat(key, format->extension);
 
-			if (Fs_Load(key, &buf) != -1)
+			// formats which only read their buffer are mapped rather than copied
+			if (format->LoadMapped) {
+				if (Fs_Map(key, &map) != -1)
+					break;
+			} else if (Fs_Load(key, &buf) != -1)
 				break;
 		}
 
@@ -184,11 +190,14 @@ r_model_t *R_LoadModel(const char *name) {
 		// load the materials first, so that we can resolve surfaces lists
 		R_LoadMaterials(mod);
 
-		// load it
-		format->Load(mod, buf);
-
-		// free the file
-		Fs_Free(buf);
+		// load it, and free the file
+		if (format->LoadMapped) {
+			format->LoadMapped(mod, map);
+			Fs_Unmap(map);
+		} else {
+			format->Load(mod, buf);
+			Fs_Free(buf);
+		}
 
 		// assemble vertex buffer objects from static arrays
 		R_LoadVertexBuffers(mod);
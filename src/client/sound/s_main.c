@@ -151,9 +151,12 @@ void S_LoadMedia(void) {
 		if (!cl.config_strings[CS_SOUNDS + i][0])
 			break;
 
-		cl.sound_precache[i] = S_LoadSample(cl.config_strings[CS_SOUNDS + i]);
+		cl.sound_precache[i] = S_LoadSampleAsync(cl.config_strings[CS_SOUNDS + i]);
 	}
 
+	// decode the samples as they are read
+	Fs_WaitAsync();
+
 	for (uint32_t i = 0; i < MAX_MUSICS; i++) {
 
 		if (!cl.config_strings[CS_MUSICS + i][0])
@@ -27,25 +27,68 @@ extern cl_client_t cl;
 static const char *SAMPLE_TYPES[] = { ".ogg", ".wav", NULL };
 
 /*
- * @brief
+ * @brief Resolves the path of the specified sample, without extension.
+ *
+ * @return False if the sample is a place holder.
  */
-static void S_LoadSampleChunk(s_sample_t *sample) {
-	char path[MAX_QPATH];
-	void *buf;
-	int32_t i, len;
-	SDL_RWops *rw;
+static _Bool S_SamplePath(const s_sample_t *sample, char *path, size_t len) {
 
 	if (sample->media.name[0] == '*') // place holder
-		return;
+		return false;
 
 	if (sample->media.name[0] == '#') { // global path
-		g_strlcpy(path, (sample->media.name + 1), sizeof(path));
+		g_strlcpy(path, (sample->media.name + 1), len);
 	} else { // or relative
-		g_snprintf(path, sizeof(path), "sounds/%s", sample->media.name);
+		g_snprintf(path, len, "sounds/%s", sample->media.name);
 	}
 
-	buf = NULL;
-	rw = NULL;
+	return true;
+}
+
+/*
+ * @brief Decodes the chunk for the specified sample from the given buffer.
+ */
+static _Bool S_DecodeSampleChunk(s_sample_t *sample, void *buf, int64_t len) {
+	SDL_RWops *rw;
+
+	if (!(rw = SDL_RWFromMem(buf, len)))
+		return false;
+
+	if (!(sample->chunk = Mix_LoadWAV_RW(rw, false)))
+		Com_Warn("%s\n", Mix_GetError());
+
+	SDL_FreeRW(rw);
+
+	return sample->chunk != NULL;
+}
+
+/*
+ * @brief Finalizes the specified sample once its chunk has been loaded.
+ */
+static void S_LoadedSampleChunk(s_sample_t *sample, const char *path) {
+
+	if (sample->chunk) {
+		Mix_VolumeChunk(sample->chunk, s_volume->value * MIX_MAX_VOLUME);
+		Com_Debug("Loaded %s\n", path);
+	} else {
+		if (g_str_has_prefix(sample->media.name, "#players")) {
+			Com_Debug("Failed to load player sample %s\n", sample->media.name);
+		} else {
+			Com_Warn("Failed to load %s\n", sample->media.name);
+		}
+	}
+}
+
+/*
+ * @brief
+ */
+static void S_LoadSampleChunk(s_sample_t *sample) {
+	char path[MAX_QPATH];
+	void *buf;
+	int32_t i, len;
+
+	if (!S_SamplePath(sample, path, sizeof(path)))
+		return;
 
 	i = 0;
 	while (SAMPLE_TYPES[i]) {
@@ -56,33 +99,62 @@ static void S_LoadSampleChunk(s_sample_t *sample) {
 		if ((len = Fs_Load(path, &buf)) == -1)
 			continue;
 
-		if (!(rw = SDL_RWFromMem(buf, len))) {
-			Fs_Free(buf);
-			continue;
-		}
-
-		if (!(sample->chunk = Mix_LoadWAV_RW(rw, false)))
-			Com_Warn("%s\n", Mix_GetError());
+		S_DecodeSampleChunk(sample, buf, len);
 
 		Fs_Free(buf);
 
-		SDL_FreeRW(rw);
-
 		if (sample->chunk) { // success
 			break;
 		}
 	}
 
+	S_LoadedSampleChunk(sample, path);
+}
+
+/*
+ * @brief Fs_LoadAsyncFunc for S_LoadSampleChunkAsync. Should the chunk fail to
+ * decode, the remaining sample types are tried synchronously.
+ */
+static void S_LoadSampleChunkAsync_(const char *filename, void *buffer, int64_t len, void *data) {
+	s_sample_t *sample = (s_sample_t *) data;
+
+	if (len > 0) {
+		S_DecodeSampleChunk(sample, buffer, len);
+	}
+
+	Fs_Free(buffer);
+
 	if (sample->chunk) {
-		Mix_VolumeChunk(sample->chunk, s_volume->value * MIX_MAX_VOLUME);
-		Com_Debug("Loaded %s\n", path);
+		S_LoadedSampleChunk(sample, filename);
 	} else {
-		if (g_str_has_prefix(sample->media.name, "#players")) {
-			Com_Debug("Failed to load player sample %s\n", sample->media.name);
-		} else {
-			Com_Warn("Failed to load %s\n", sample->media.name);
+		S_LoadSampleChunk(sample);
+	}
+}
+
+/*
+ * @brief Queues the chunk for the specified sample to be read asynchronously.
+ * It is decoded when the load completes, in Fs_PollAsync or Fs_WaitAsync.
+ */
+static void S_LoadSampleChunkAsync(s_sample_t *sample) {
+	char path[MAX_QPATH];
+	int32_t i;
+
+	if (!S_SamplePath(sample, path, sizeof(path)))
+		return;
+
+	i = 0;
+	while (SAMPLE_TYPES[i]) {
+
+		StripExtension(path, path);
+		g_strlcat(path, SAMPLE_TYPES[i++], sizeof(path));
+
+		if (Fs_Exists(path)) {
+			Fs_LoadAsync(path, 0, S_LoadSampleChunkAsync_, sample);
+			return;
 		}
 	}
+
+	S_LoadedSampleChunk(sample, path);
 }
 
 /*
@@ -97,9 +169,10 @@ static void S_FreeSample(s_media_t *self) {
 }
 
 /*
- * @brief
+ * @brief Resolves or allocates the named sample, loading its chunk either
+ * immediately or asynchronously.
  */
-s_sample_t *S_LoadSample(const char *name) {
+static s_sample_t *S_LoadSample_(const char *name, _Bool async) {
 	char key[MAX_QPATH];
 	s_sample_t *sample;
 
@@ -117,7 +190,11 @@ s_sample_t *S_LoadSample(const char *name) {
 
 		sample->media.Free = S_FreeSample;
 
-		S_LoadSampleChunk(sample);
+		if (async) {
+			S_LoadSampleChunkAsync(sample);
+		} else {
+			S_LoadSampleChunk(sample);
+		}
 
 		S_RegisterMedia((s_media_t *) sample);
 	}
@@ -125,6 +202,22 @@ s_sample_t *S_LoadSample(const char *name) {
 	return sample;
 }
 
+/*
+ * @brief
+ */
+s_sample_t *S_LoadSample(const char *name) {
+	return S_LoadSample_(name, false);
+}
+
+/*
+ * @brief Loads the named sample, deferring the read and decode of its chunk to
+ * the asynchronous filesystem queue. The sample must not be played until the
+ * load has been completed with Fs_WaitAsync.
+ */
+s_sample_t *S_LoadSampleAsync(const char *name) {
+	return S_LoadSample_(name, true);
+}
+
 /*
  * @brief Registers and returns a new sample, aliasing the chunk provided by
  * the specified sample.
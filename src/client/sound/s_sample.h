@@ -25,6 +25,7 @@
 s_sample_t *S_LoadSample(const char *name);
 
 #ifdef __S_LOCAL_H__
+s_sample_t *S_LoadSampleAsync(const char *name);
 s_sample_t *S_LoadModelSample(entity_state_t *ent, const char *name);
 #endif /* __S_LOCAL_H__ */
 
@@ -24,4 +24,16 @@
 
 #include "cmodel.h"
 
+/*
+ * @brief A loaded map: its BSP, the box hull appended to it, and its
+ * decompressed visibility.
+ */
+struct cm_world_s {
+	cm_bsp_t bsp;
+	cm_box_t box;
+	cm_vis_matrix_t vis_matrix;
+};
+
+extern cm_world_t *cm_world;
+
 #endif /* __CM_LOCAL_H__ */
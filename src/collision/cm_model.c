@@ -21,29 +21,69 @@
 
 #include "cm_local.h"
 
-cm_bsp_t cm_bsp;
-cm_vis_t *cm_vis;
+/*
+ * @brief The world loaded by Cm_LoadBspModel, if any.
+ */
+static cm_world_t *cm_loaded_world;
+
+/*
+ * @brief The world being loaded by Cm_LoadWorld, if any. A map which is
+ * rejected midway is left here, with its file still mapped, and is freed by
+ * the next call to Cm_LoadWorld or Cm_LoadBspModel.
+ */
+static cm_world_t *cm_loading_world;
+
+/*
+ * @brief The empty world, current until a map is loaded. Its world model and
+ * entity string are empty.
+ */
+static char cm_empty_entity_string[1];
+static cm_bsp_model_t cm_empty_models[1];
+static cm_vis_t cm_empty_vis;
+
+static cm_world_t cm_empty_world = {
+	.bsp.entity_string = cm_empty_entity_string,
+	.bsp.models = cm_empty_models,
+	.bsp.vis = &cm_empty_vis
+};
+
+/*
+ * @brief The current world, used by the functions which do not take one.
+ */
+cm_world_t *cm_world = &cm_empty_world;
+
+/*
+ * @brief Allocates an array of count elements of the given size, plus extra
+ * elements for the box hull, for the world being loaded. The array is linked
+ * to the world, so that it is freed with it, even if the map is rejected.
+ */
+static void *Cm_LoadArray(int32_t count, int32_t extra, size_t size) {
+	return Mem_LinkMalloc((count + extra) * size, cm_loading_world);
+}
 
 /*
  * @brief
  */
-static void Cm_LoadEntityString(const d_bsp_lump_t *l) {
+static void Cm_LoadEntityString(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	cm_bsp.entity_string_len = l->file_len;
+	bsp->entity_string_len = l->file_len;
 
 	if (l->file_len > MAX_BSP_ENT_STRING) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_ENT_STRING\n", l->file_len);
 	}
 
-	memcpy(cm_bsp.entity_string, cm_bsp.base + l->file_ofs, l->file_len);
+	// the string is terminated by the extra byte
+	bsp->entity_string = Cm_LoadArray(l->file_len, 1, sizeof(char));
+
+	memcpy(bsp->entity_string, bsp->base + l->file_ofs, l->file_len);
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspPlanes(const d_bsp_lump_t *l) {
+static void Cm_LoadBspPlanes(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_plane_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_plane_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -58,8 +98,8 @@ static void Cm_LoadBspPlanes(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_PLANES\n", count);
 	}
 
-	cm_bsp_plane_t *out = cm_bsp.planes;
-	cm_bsp.num_planes = count;
+	cm_bsp_plane_t *out = bsp->planes = Cm_LoadArray(count, 12, sizeof(cm_bsp_plane_t));
+	bsp->num_planes = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 
@@ -77,9 +117,9 @@ static void Cm_LoadBspPlanes(const d_bsp_lump_t *l) {
 /*
  * @brief
  */
-static void Cm_LoadBspNodes(const d_bsp_lump_t *l) {
+static void Cm_LoadBspNodes(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_node_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_node_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -94,12 +134,16 @@ static void Cm_LoadBspNodes(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_NODES\n", count);
 	}
 
-	cm_bsp_node_t *out = cm_bsp.nodes;
-	cm_bsp.num_nodes = count;
+	cm_bsp_node_t *out = bsp->nodes = Cm_LoadArray(count, 6, sizeof(cm_bsp_node_t));
+	bsp->num_nodes = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 
-		out->plane = cm_bsp.planes + LittleLong(in->plane_num);
+		const int32_t p = LittleLong(in->plane_num);
+		if (p < 0 || p >= bsp->num_planes) {
+			Com_Error(ERR_DROP, "Node %d has invalid plane %d\n", i, p);
+		}
+		out->plane = bsp->planes[p];
 
 		for (int32_t j = 0; j < 2; j++) {
 			const int32_t child = LittleLong(in->children[j]);
@@ -111,9 +155,9 @@ static void Cm_LoadBspNodes(const d_bsp_lump_t *l) {
 /*
  * @brief
  */
-static void Cm_LoadBspSurfaces(const d_bsp_lump_t *l) {
+static void Cm_LoadBspSurfaces(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_texinfo_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_texinfo_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -128,8 +172,8 @@ static void Cm_LoadBspSurfaces(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_TEXINFO\n", count);
 	}
 
-	cm_bsp_surface_t *out = cm_bsp.surfaces;
-	cm_bsp.num_surfaces = count;
+	cm_bsp_surface_t *out = bsp->surfaces = Cm_LoadArray(count, 0, sizeof(cm_bsp_surface_t));
+	bsp->num_surfaces = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 		g_strlcpy(out->name, in->texture, sizeof(out->name));
@@ -141,9 +185,9 @@ static void Cm_LoadBspSurfaces(const d_bsp_lump_t *l) {
 /*
  * @brief
  */
-static void Cm_LoadBspLeafs(const d_bsp_lump_t *l) {
+static void Cm_LoadBspLeafs(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_leaf_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_leaf_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -158,8 +202,8 @@ static void Cm_LoadBspLeafs(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_LEAFS\n", count);
 	}
 
-	cm_bsp_leaf_t *out = cm_bsp.leafs;
-	cm_bsp.num_leafs = count;
+	cm_bsp_leaf_t *out = bsp->leafs = Cm_LoadArray(count, 1, sizeof(cm_bsp_leaf_t));
+	bsp->num_leafs = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 		out->contents = LittleLong(in->contents);
@@ -169,30 +213,40 @@ static void Cm_LoadBspLeafs(const d_bsp_lump_t *l) {
 		out->num_leaf_brushes = LittleShort(in->num_leaf_brushes);
 	}
 
-	if (cm_bsp.leafs[0].contents != CONTENTS_SOLID) {
+	if (bsp->leafs[0].contents != CONTENTS_SOLID) {
 		Com_Error(ERR_DROP, "Map leaf 0 is not CONTENTS_SOLID\n");
 	}
 
-	cm_bsp.solid_leaf = 0;
-	cm_bsp.empty_leaf = -1;
+	bsp->solid_leaf = 0;
+	bsp->empty_leaf = -1;
 
-	for (int32_t i = 1; i < cm_bsp.num_leafs; i++) {
-		if (!cm_bsp.leafs[i].contents) {
-			cm_bsp.empty_leaf = i;
+	for (int32_t i = 1; i < bsp->num_leafs; i++) {
+		if (!bsp->leafs[i].contents) {
+			bsp->empty_leaf = i;
 			break;
 		}
 	}
 
-	if (cm_bsp.empty_leaf == -1)
+	if (bsp->empty_leaf == -1)
 		Com_Error(ERR_DROP, "Map does not have an empty leaf\n");
+
+	for (int32_t i = 0; i < bsp->num_nodes; i++) {
+		for (int32_t j = 0; j < 2; j++) {
+			const int32_t child = bsp->nodes[i].children[j];
+
+			if (child < 0 && -1 - child >= count) {
+				Com_Error(ERR_DROP, "Node %d has invalid leaf %d\n", i, -1 - child);
+			}
+		}
+	}
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspLeafBrushes(const d_bsp_lump_t *l) {
+static void Cm_LoadBspLeafBrushes(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const uint16_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const uint16_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -207,20 +261,28 @@ static void Cm_LoadBspLeafBrushes(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_LEAF_BRUSHES\n", count);
 	}
 
-	uint16_t *out = cm_bsp.leaf_brushes;
-	cm_bsp.num_leaf_brushes = count;
+	uint16_t *out = bsp->leaf_brushes = Cm_LoadArray(count, 1, sizeof(uint16_t));
+	bsp->num_leaf_brushes = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 		*out = LittleShort(*in);
 	}
+
+	const cm_bsp_leaf_t *leaf = bsp->leafs;
+	for (int32_t i = 0; i < bsp->num_leafs; i++, leaf++) {
+
+		if (leaf->first_leaf_brush + leaf->num_leaf_brushes > count) {
+			Com_Error(ERR_DROP, "Leaf %d has invalid brushes\n", i);
+		}
+	}
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspInlineModels(const d_bsp_lump_t *l) {
+static void Cm_LoadBspInlineModels(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_model_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_model_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -235,8 +297,8 @@ static void Cm_LoadBspInlineModels(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_MODELS\n", count);
 	}
 
-	cm_bsp_model_t *out = cm_bsp.models;
-	cm_bsp.num_models = count;
+	cm_bsp_model_t *out = bsp->models = Cm_LoadArray(count, 0, sizeof(cm_bsp_model_t));
+	bsp->num_models = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 
@@ -253,9 +315,9 @@ static void Cm_LoadBspInlineModels(const d_bsp_lump_t *l) {
 /*
  * @brief
  */
-static void Cm_LoadBspBrushes(const d_bsp_lump_t *l) {
+static void Cm_LoadBspBrushes(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_brush_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_brush_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -270,22 +332,109 @@ static void Cm_LoadBspBrushes(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_BRUSHES\n", count);
 	}
 
-	cm_bsp_brush_t *out = cm_bsp.brushes;
-	cm_bsp.num_brushes = count;
+	cm_bsp_brush_t *out = bsp->brushes = Cm_LoadArray(count, 1, sizeof(cm_bsp_brush_t));
+	bsp->num_brushes = count;
 
 	for (int32_t i = 0; i < count; i++, out++, in++) {
 		out->first_brush_side = LittleLong(in->first_side);
 		out->num_sides = LittleLong(in->num_sides);
 		out->contents = LittleLong(in->contents);
 	}
+
+	for (int32_t i = 0; i < bsp->num_leaf_brushes; i++) {
+
+		if (bsp->leaf_brushes[i] >= count) {
+			Com_Error(ERR_DROP, "Leaf brush %d has invalid brush %d\n", i, bsp->leaf_brushes[i]);
+		}
+	}
+}
+
+/*
+ * @brief Renumbers the nodes of the world and each inline model depth-first,
+ * so that a trace descending the tree tends to stay within nearby cache lines.
+ * The world's head node remains 0.
+ */
+static void Cm_PackBspNodes(cm_bsp_t *bsp) {
+
+	const int32_t count = bsp->num_nodes;
+
+	// linked to the world being loaded, so that they are freed with it on error
+	cm_bsp_node_t *nodes = Mem_LinkMalloc(count * sizeof(cm_bsp_node_t), cm_loading_world);
+	memcpy(nodes, bsp->nodes, count * sizeof(cm_bsp_node_t));
+
+	int32_t *remap = Mem_LinkMalloc(count * sizeof(int32_t), cm_loading_world);
+	memset(remap, 0xff, count * sizeof(int32_t));
+
+	int32_t *stack = Mem_LinkMalloc((count + 1) * sizeof(int32_t), cm_loading_world);
+	int32_t num_nodes = 0;
+
+	for (int32_t i = 0; i < bsp->num_models; i++) {
+		const int32_t head_node = bsp->models[i].head_node;
+
+		if (head_node < 0 || head_node >= count) {
+			Com_Error(ERR_DROP, "Model %d has invalid head node %d\n", i, head_node);
+		}
+
+		int32_t depth = 0;
+		stack[depth++] = head_node;
+
+		while (depth) {
+			const int32_t num = stack[--depth];
+
+			if (remap[num] != -1)
+				continue;
+
+			remap[num] = num_nodes++;
+
+			// visit the front child immediately after its parent
+			for (int32_t j = 1; j >= 0; j--) {
+				const int32_t child = nodes[num].children[j];
+
+				if (child >= count) {
+					Com_Error(ERR_DROP, "Node %d has invalid child %d\n", num, child);
+				}
+
+				if (child >= 0 && remap[child] == -1) {
+					stack[depth++] = child;
+				}
+			}
+		}
+	}
+
+	// nodes unreachable from any model keep their relative order at the end
+	for (int32_t i = 0; i < count; i++) {
+		if (remap[i] == -1) {
+			remap[i] = num_nodes++;
+		}
+	}
+
+	for (int32_t i = 0; i < count; i++) {
+		cm_bsp_node_t *out = &bsp->nodes[remap[i]];
+
+		*out = nodes[i];
+
+		for (int32_t j = 0; j < 2; j++) {
+			if (out->children[j] >= 0) {
+				out->children[j] = remap[out->children[j]];
+			}
+		}
+	}
+
+	for (int32_t i = 0; i < bsp->num_models; i++) {
+		bsp->models[i].head_node = remap[bsp->models[i].head_node];
+	}
+
+	Mem_Free(stack);
+	Mem_Free(remap);
+	Mem_Free(nodes);
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspBrushSides(const d_bsp_lump_t *l) {
+static void Cm_LoadBspBrushSides(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_brush_side_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_brush_side_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -300,79 +449,147 @@ static void Cm_LoadBspBrushSides(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_BRUSH_SIDES\n", count);
 	}
 
-	cm_bsp_brush_side_t *out = cm_bsp.brush_sides;
-	cm_bsp.num_brush_sides = count;
+	// packed into an array with room for the box hull by Cm_PackBspBrushSides
+	cm_bsp_brush_side_t *out = bsp->brush_sides = Cm_LoadArray(count, 0, sizeof(cm_bsp_brush_side_t));
+	bsp->num_brush_sides = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 
 		const int32_t p = LittleShort(in->plane_num);
-		if (p >= cm_bsp.num_planes) {
+		if (p < 0 || p >= bsp->num_planes) {
 			Com_Error(ERR_DROP, "Brush side %d has invalid plane %d\n", i, p);
 		}
-		out->plane = &cm_bsp.planes[p];
+		out->plane = bsp->planes[p];
 
 		const int32_t s = LittleShort(in->surf_num);
-		if (s >= cm_bsp.num_surfaces) {
+		if (s < 0 || s >= bsp->num_surfaces) {
 			Com_Error(ERR_DROP, "Brush side %d has invalid surface %d\n", i, s);
 		}
-		out->surface = &cm_bsp.surfaces[s];
+		out->surface = &bsp->surfaces[s];
+	}
+}
+
+/*
+ * @brief Copies the brush sides into brush order, so that the sides of each
+ * brush, and of consecutive brushes, are contiguous.
+ */
+static void Cm_PackBspBrushSides(cm_bsp_t *bsp) {
+
+	const int32_t count = bsp->num_brush_sides;
+	cm_bsp_brush_side_t *sides = bsp->brush_sides;
+
+	int32_t num_brush_sides = 0;
+
+	const cm_bsp_brush_t *b = bsp->brushes;
+	for (int32_t i = 0; i < bsp->num_brushes; i++, b++) {
+
+		if (b->num_sides < 0 || b->first_brush_side < 0 || b->first_brush_side + b->num_sides > count) {
+			Com_Error(ERR_DROP, "Brush %d has invalid sides\n", i);
+		}
+
+		if (num_brush_sides + b->num_sides > MAX_BSP_BRUSH_SIDES) {
+			Com_Error(ERR_DROP, "MAX_BSP_BRUSH_SIDES\n");
+		}
+
+		num_brush_sides += b->num_sides;
+	}
+
+	// brushes may share sides, so the packed sides may outnumber the lump's
+	bsp->brush_sides = Cm_LoadArray(num_brush_sides, 6, sizeof(cm_bsp_brush_side_t));
+	bsp->num_brush_sides = 0;
+
+	cm_bsp_brush_t *brush = bsp->brushes;
+	for (int32_t i = 0; i < bsp->num_brushes; i++, brush++) {
+
+		memcpy(&bsp->brush_sides[bsp->num_brush_sides], &sides[brush->first_brush_side],
+				brush->num_sides * sizeof(cm_bsp_brush_side_t));
+
+		brush->first_brush_side = bsp->num_brush_sides;
+		bsp->num_brush_sides += brush->num_sides;
 	}
+
+	Mem_Free(sides);
 }
 
 /*
  * @brief Sets brush bounds for fast trace tests.
  */
-static void Cm_SetupBspBrushes(void) {
-	cm_bsp_brush_t *b = cm_bsp.brushes;
+static void Cm_SetupBspBrushes(cm_bsp_t *bsp) {
+	cm_bsp_brush_t *b = bsp->brushes;
 
-	for (int32_t i = 0; i < cm_bsp.num_brushes; i++, b++) {
-		const cm_bsp_brush_side_t *bs = cm_bsp.brush_sides + b->first_brush_side;
+	for (int32_t i = 0; i < bsp->num_brushes; i++, b++) {
+		const cm_bsp_brush_side_t *bs = bsp->brush_sides + b->first_brush_side;
 
-		b->mins[0] = -bs[0].plane->dist;
-		b->mins[1] = -bs[2].plane->dist;
-		b->mins[2] = -bs[4].plane->dist;
+		b->mins[0] = -bs[0].plane.dist;
+		b->mins[1] = -bs[2].plane.dist;
+		b->mins[2] = -bs[4].plane.dist;
 
-		b->maxs[0] = bs[1].plane->dist;
-		b->maxs[1] = bs[3].plane->dist;
-		b->maxs[2] = bs[5].plane->dist;
+		b->maxs[0] = bs[1].plane.dist;
+		b->maxs[1] = bs[3].plane.dist;
+		b->maxs[2] = bs[5].plane.dist;
 	}
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspVisibility(const d_bsp_lump_t *l) {
+static void Cm_LoadBspVisibility(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	cm_bsp.num_visibility = l->file_len;
+	bsp->num_visibility = l->file_len;
 
 	if (l->file_len > MAX_BSP_VISIBILITY) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_VISIBILITY\n", l->file_len);
 	}
 
-	memcpy(cm_bsp.visibility, cm_bsp.base + l->file_ofs, l->file_len);
+	// maps without visibility still have a header
+	bsp->visibility = Cm_LoadArray(MAX(l->file_len, (int32_t) sizeof(cm_vis_t)), 0, sizeof(byte));
+
+	memcpy(bsp->visibility, bsp->base + l->file_ofs, l->file_len);
+
+	bsp->vis = (cm_vis_t *) bsp->visibility;
+	bsp->vis->num_clusters = LittleLong(bsp->vis->num_clusters);
+
+	if (bsp->num_visibility) {
+
+		if (l->file_len < (int32_t) sizeof(int32_t)) {
+			Com_Error(ERR_DROP, "Funny lump size\n");
+		}
+
+		// the offsets of each cluster follow the count
+		const int32_t max_clusters = (l->file_len - (int32_t) sizeof(int32_t)) /
+				(int32_t) sizeof(bsp->vis->bit_offsets[0]);
+
+		if (bsp->vis->num_clusters < 0 || bsp->vis->num_clusters > max_clusters) {
+			Com_Error(ERR_DROP, "Invalid cluster count: %d\n", bsp->vis->num_clusters);
+		}
+	}
+
+	for (int32_t i = 0; i < bsp->vis->num_clusters; i++) {
+		for (int32_t j = 0; j < 2; j++) {
+			const int32_t ofs = LittleLong(bsp->vis->bit_offsets[i][j]);
 
-	cm_vis = (d_bsp_vis_t *) cm_bsp.visibility;
-	cm_vis->num_clusters = LittleLong(cm_vis->num_clusters);
+			if (ofs < 0 || ofs >= bsp->num_visibility) {
+				Com_Error(ERR_DROP, "Cluster %d has invalid offset %d\n", i, ofs);
+			}
 
-	for (int32_t i = 0; i < cm_vis->num_clusters; i++) {
-		cm_vis->bit_offsets[i][0] = LittleLong(cm_vis->bit_offsets[i][0]);
-		cm_vis->bit_offsets[i][1] = LittleLong(cm_vis->bit_offsets[i][1]);
+			bsp->vis->bit_offsets[i][j] = ofs;
+		}
 	}
 
 	// If we have no visibility data, pad the clusters so that Cm_DecompressVis
 	// produces correctly-sized rows. If we don't do this, non-VIS'ed maps will
 	// not produce any visible entities.
-	if (cm_bsp.num_visibility == 0) {
-		cm_vis->num_clusters = cm_bsp.num_leafs;
+	if (bsp->num_visibility == 0) {
+		bsp->vis->num_clusters = bsp->num_leafs;
 	}
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspAreas(const d_bsp_lump_t *l) {
+static void Cm_LoadBspAreas(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_area_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_area_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -380,15 +597,15 @@ static void Cm_LoadBspAreas(const d_bsp_lump_t *l) {
 
 	const int32_t count = l->file_len / sizeof(*in);
 
-	if (count < 0) {
+	if (count < 1) {
 		Com_Error(ERR_DROP, "Invalid area count: %d\n", count);
 	}
 	if (count > MAX_BSP_AREAS) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_AREAS\n", count);
 	}
 
-	cm_bsp_area_t *out = cm_bsp.areas;
-	cm_bsp.num_areas = count;
+	cm_bsp_area_t *out = bsp->areas = Cm_LoadArray(count, 0, sizeof(cm_bsp_area_t));
+	bsp->num_areas = count;
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 		out->num_area_portals = LittleLong(in->num_area_portals);
@@ -396,14 +613,21 @@ static void Cm_LoadBspAreas(const d_bsp_lump_t *l) {
 		out->flood_valid = 0;
 		out->flood_num = 0;
 	}
+
+	for (int32_t i = 0; i < bsp->num_leafs; i++) {
+
+		if (bsp->leafs[i].area < 0 || bsp->leafs[i].area >= count) {
+			Com_Error(ERR_DROP, "Leaf %d has invalid area %d\n", i, bsp->leafs[i].area);
+		}
+	}
 }
 
 /*
  * @brief
  */
-static void Cm_LoadBspAreaPortals(const d_bsp_lump_t *l) {
+static void Cm_LoadBspAreaPortals(cm_bsp_t *bsp, const d_bsp_lump_t *l) {
 
-	const d_bsp_area_portal_t *in = (const void *) (cm_bsp.base + l->file_ofs);
+	const d_bsp_area_portal_t *in = (const void *) (bsp->base + l->file_ofs);
 
 	if (l->file_len % sizeof(*in)) {
 		Com_Error(ERR_DROP, "Funny lump size\n");
@@ -418,36 +642,60 @@ static void Cm_LoadBspAreaPortals(const d_bsp_lump_t *l) {
 		Com_Error(ERR_DROP, "%d > MAX_BSP_AREA_PORTALS\n", count);
 	}
 
-	d_bsp_area_portal_t *out = cm_bsp.area_portals;
-	cm_bsp.num_area_portals = count;
+	d_bsp_area_portal_t *out = bsp->area_portals = Cm_LoadArray(count, 0, sizeof(d_bsp_area_portal_t));
+	bsp->num_area_portals = count;
+
+	bsp->portal_open = Cm_LoadArray(count, 0, sizeof(_Bool));
 
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 		out->portal_num = LittleLong(in->portal_num);
 		out->other_area = LittleLong(in->other_area);
+
+		if (out->portal_num < 0 || out->portal_num >= count ||
+				out->other_area < 0 || out->other_area >= bsp->num_areas) {
+			Com_Error(ERR_DROP, "Area portal %d is invalid\n", i);
+		}
+	}
+
+	const cm_bsp_area_t *area = bsp->areas;
+	for (int32_t i = 0; i < bsp->num_areas; i++, area++) {
+
+		if (area->num_area_portals < 0 || area->first_area_portal < 0 ||
+				area->first_area_portal + area->num_area_portals > count) {
+			Com_Error(ERR_DROP, "Area %d has invalid portals\n", i);
+		}
 	}
 }
 
 /*
- * @brief Loads in the BSP and all sub-models for collision detection. This
- * function can also be used to initialize or clean up the collision model by
- * invoking with NULL.
+ * @brief Frees the world left by a map which Cm_LoadWorld rejected, if any.
  */
-cm_bsp_model_t *Cm_LoadBspModel(const char *name, int64_t *size) {
-	void *buf;
+static void Cm_FreeLoadingWorld(void) {
 
-	memset(&cm_bsp, 0, sizeof(cm_bsp));
-	cm_vis = (d_bsp_vis_t *) cm_bsp.visibility;
+	cm_world_t *world = cm_loading_world;
 
-	// clean up and return
-	if (!name) {
-		if (size) {
-			*size = 0;
+	if (world) {
+		if (world->bsp.base) {
+			Fs_Unmap(world->bsp.base);
 		}
-		return &cm_bsp.models[0];
+
+		cm_loading_world = NULL;
+		Mem_Free(world);
 	}
+}
 
-	// load the file
-	const int64_t s = Fs_Load(name, &buf);
+/*
+ * @brief Loads the specified map into a new collision world, which remains
+ * valid until it is freed with Cm_FreeWorld. Loading a world does not make it
+ * current, so the next map may be loaded while the current one is in use.
+ */
+cm_world_t *Cm_LoadWorld(const char *name, int64_t *size) {
+	const void *buf;
+
+	Cm_FreeLoadingWorld();
+
+	// map the file, as the lumps are only read from
+	const int64_t s = Fs_Map(name, &buf);
 	if (s == -1) {
 		Com_Error(ERR_DROP, "Couldn't load %s\n", name);
 	}
@@ -456,49 +704,149 @@ cm_bsp_model_t *Cm_LoadBspModel(const char *name, int64_t *size) {
 		*size = s;
 	}
 
+	if (s < (int64_t) sizeof(d_bsp_header_t)) {
+		Fs_Unmap(buf);
+		Com_Error(ERR_DROP, "%s is truncated\n", name);
+	}
+
 	// byte-swap the entire header
-	d_bsp_header_t header = *(d_bsp_header_t *) buf;
+	d_bsp_header_t header = *(const d_bsp_header_t *) buf;
 	for (size_t i = 0; i < sizeof(d_bsp_header_t) / sizeof(int32_t); i++) {
 		((int32_t *) &header)[i] = LittleLong(((int32_t *) &header)[i]);
 	}
 
 	if (header.version != BSP_VERSION && header.version != BSP_VERSION_QUETOO) {
+		Fs_Unmap(buf);
 		Com_Error(ERR_DROP, "%s has unsupported version: %d\n", name, header.version);
 	}
 
-	g_strlcpy(cm_bsp.name, name, sizeof(cm_bsp.name));
+	cm_world_t *world = cm_loading_world = Mem_Malloc(sizeof(cm_world_t));
+	cm_bsp_t *bsp = &world->bsp;
+
+	g_strlcpy(bsp->name, name, sizeof(bsp->name));
 
-	cm_bsp.base = (byte *) buf;
+	bsp->base = (const byte *) buf;
 
 	// load into heap
-	Cm_LoadEntityString(&header.lumps[BSP_LUMP_ENTITIES]);
-	Cm_LoadBspPlanes(&header.lumps[BSP_LUMP_PLANES]);
-	Cm_LoadBspNodes(&header.lumps[BSP_LUMP_NODES]);
-	Cm_LoadBspSurfaces(&header.lumps[BSP_LUMP_TEXINFO]);
-	Cm_LoadBspLeafs(&header.lumps[BSP_LUMP_LEAFS]);
-	Cm_LoadBspLeafBrushes(&header.lumps[BSP_LUMP_LEAF_BRUSHES]);
-	Cm_LoadBspInlineModels(&header.lumps[BSP_LUMP_MODELS]);
-	Cm_LoadBspBrushes(&header.lumps[BSP_LUMP_BRUSHES]);
-	Cm_LoadBspBrushSides(&header.lumps[BSP_LUMP_BRUSH_SIDES]);
-	Cm_LoadBspVisibility(&header.lumps[BSP_LUMP_VISIBILITY]);
-	Cm_LoadBspAreas(&header.lumps[BSP_LUMP_AREAS]);
-	Cm_LoadBspAreaPortals(&header.lumps[BSP_LUMP_AREA_PORTALS]);
+	Cm_LoadEntityString(bsp, &header.lumps[BSP_LUMP_ENTITIES]);
+	Cm_LoadBspPlanes(bsp, &header.lumps[BSP_LUMP_PLANES]);
+	Cm_LoadBspNodes(bsp, &header.lumps[BSP_LUMP_NODES]);
+	Cm_LoadBspSurfaces(bsp, &header.lumps[BSP_LUMP_TEXINFO]);
+	Cm_LoadBspLeafs(bsp, &header.lumps[BSP_LUMP_LEAFS]);
+	Cm_LoadBspLeafBrushes(bsp, &header.lumps[BSP_LUMP_LEAF_BRUSHES]);
+	Cm_LoadBspInlineModels(bsp, &header.lumps[BSP_LUMP_MODELS]);
+	Cm_LoadBspBrushes(bsp, &header.lumps[BSP_LUMP_BRUSHES]);
+	Cm_LoadBspBrushSides(bsp, &header.lumps[BSP_LUMP_BRUSH_SIDES]);
+	Cm_LoadBspVisibility(bsp, &header.lumps[BSP_LUMP_VISIBILITY]);
+	Cm_LoadBspAreas(bsp, &header.lumps[BSP_LUMP_AREAS]);
+	Cm_LoadBspAreaPortals(bsp, &header.lumps[BSP_LUMP_AREA_PORTALS]);
+
+	Fs_Unmap(buf);
+	bsp->base = NULL;
+
+	Cm_PackBspNodes(bsp);
+
+	Cm_PackBspBrushSides(bsp);
+
+	Cm_SetupBspBrushes(bsp);
+
+	Cm_InitBoxHull(world);
+
+	Cm_FloodAreas(world);
+
+	Cm_InitVisMatrix(world);
+
+	cm_loading_world = NULL;
+
+	return world;
+}
+
+/*
+ * @brief Frees the specified world, which must not be current.
+ */
+void Cm_FreeWorld(cm_world_t *world) {
+
+	if (!world || world == &cm_empty_world) {
+		return;
+	}
+
+	if (world == cm_world) {
+		Com_Error(ERR_DROP, "%s is the current world\n", world->bsp.name);
+	}
+
+	Cm_ShutdownVisMatrix(world);
+
+	if (world == cm_loaded_world) {
+		cm_loaded_world = NULL;
+	}
+
+	Mem_Free(world);
+}
+
+/*
+ * @brief Sets the world used by the functions which do not take one. If NULL,
+ * the empty world is used.
+ */
+void Cm_SetWorld(cm_world_t *world) {
+	cm_world = world ? world : &cm_empty_world;
+}
+
+/*
+ * @return The current world.
+ */
+cm_world_t *Cm_World(void) {
+	return cm_world;
+}
+
+/*
+ * @brief Loads in the BSP and all sub-models for collision detection, and makes
+ * it the current world. The world previously loaded by this function is freed.
+ * This function can also be used to clean up the collision model by invoking
+ * with NULL.
+ */
+cm_bsp_model_t *Cm_LoadBspModel(const char *name, int64_t *size) {
+
+	cm_world_t *world = cm_loaded_world;
+
+	if (cm_world == world) {
+		Cm_SetWorld(NULL);
+	}
 
-	Fs_Free(buf);
+	Cm_FreeWorld(world);
 
-	Cm_SetupBspBrushes();
+	Cm_FreeLoadingWorld();
+
+	// clean up and return
+	if (!name) {
+		if (size) {
+			*size = 0;
+		}
+		return Cm_WorldModel(cm_world, 0);
+	}
 
-	Cm_InitBoxHull();
+	cm_loaded_world = Cm_LoadWorld(name, size);
 
-	Cm_FloodAreas();
+	Cm_SetWorld(cm_loaded_world);
 
-	return &cm_bsp.models[0];
+	return Cm_WorldModel(cm_world, 0);
+}
+
+/*
+ * @return The specified model of the given world, where 0 is the world model.
+ */
+cm_bsp_model_t *Cm_WorldModel(cm_world_t *world, const int32_t num) {
+
+	if (num < 0 || (num && num >= world->bsp.num_models)) {
+		Com_Error(ERR_DROP, "Bad number: %d\n", num);
+	}
+
+	return &world->bsp.models[num];
 }
 
 /*
  * @brief
  */
-cm_bsp_model_t *Cm_Model(const char *name) {
+cm_bsp_model_t *Cm_Model_(cm_world_t *world, const char *name) {
 
 	if (!name || name[0] != '*') {
 		Com_Error(ERR_DROP, "Bad name\n");
@@ -506,41 +854,69 @@ cm_bsp_model_t *Cm_Model(const char *name) {
 
 	const int32_t num = atoi(name + 1);
 
-	if (num < 1 || num >= cm_bsp.num_models) {
+	if (num < 1 || num >= world->bsp.num_models) {
 		Com_Error(ERR_DROP, "Bad number: %d\n", num);
 	}
 
-	return &cm_bsp.models[num];
+	return &world->bsp.models[num];
+}
+
+/*
+ * @brief
+ */
+cm_bsp_model_t *Cm_Model(const char *name) {
+	return Cm_Model_(cm_world, name);
+}
+
+/*
+ * @brief
+ */
+int32_t Cm_NumClusters_(const cm_world_t *world) {
+	return world->bsp.vis->num_clusters;
 }
 
 /*
  * @brief
  */
 int32_t Cm_NumClusters(void) {
-	return cm_vis->num_clusters;
+	return Cm_NumClusters_(cm_world);
+}
+
+/*
+ * @brief
+ */
+int32_t Cm_NumModels_(const cm_world_t *world) {
+	return world->bsp.num_models;
 }
 
 /*
  * @brief
  */
 int32_t Cm_NumModels(void) {
-	return cm_bsp.num_models;
+	return Cm_NumModels_(cm_world);
+}
+
+/*
+ * @brief
+ */
+const char *Cm_EntityString_(const cm_world_t *world) {
+	return world->bsp.entity_string;
 }
 
 /*
  * @brief
  */
 const char *Cm_EntityString(void) {
-	return cm_bsp.entity_string;
+	return Cm_EntityString_(cm_world);
 }
 
 /*
  * @brief Parses values from the worldspawn entity definition.
  */
-const char *Cm_WorldspawnValue(const char *key) {
+const char *Cm_WorldspawnValue_(const cm_world_t *world, const char *key) {
 	const char *c, *v;
 
-	c = strstr(Cm_EntityString(), va("\"%s\"", key));
+	c = strstr(Cm_EntityString_(world), va("\"%s\"", key));
 
 	if (c) {
 		ParseToken(&c); // parse the key itself
@@ -552,38 +928,66 @@ const char *Cm_WorldspawnValue(const char *key) {
 	return v;
 }
 
+/*
+ * @brief Parses values from the worldspawn entity definition.
+ */
+const char *Cm_WorldspawnValue(const char *key) {
+	return Cm_WorldspawnValue_(cm_world, key);
+}
+
 /*
  * @brief
  */
-int32_t Cm_LeafContents(const int32_t leaf_num) {
+int32_t Cm_LeafContents_(const cm_world_t *world, const int32_t leaf_num) {
 
-	if (leaf_num < 0 || leaf_num >= cm_bsp.num_leafs) {
+	if (leaf_num < 0 || leaf_num >= world->bsp.num_leafs) {
 		Com_Error(ERR_DROP, "Bad number: %d\n", leaf_num);
 	}
 
-	return cm_bsp.leafs[leaf_num].contents;
+	return world->bsp.leafs[leaf_num].contents;
 }
 
 /*
  * @brief
  */
-int32_t Cm_LeafCluster(const int32_t leaf_num) {
+int32_t Cm_LeafContents(const int32_t leaf_num) {
+	return Cm_LeafContents_(cm_world, leaf_num);
+}
+
+/*
+ * @brief
+ */
+int32_t Cm_LeafCluster_(const cm_world_t *world, const int32_t leaf_num) {
 
-	if (leaf_num < 0 || leaf_num >= cm_bsp.num_leafs) {
+	if (leaf_num < 0 || leaf_num >= world->bsp.num_leafs) {
 		Com_Error(ERR_DROP, "Bad number: %d\n", leaf_num);
 	}
 
-	return cm_bsp.leafs[leaf_num].cluster;
+	return world->bsp.leafs[leaf_num].cluster;
 }
 
 /*
  * @brief
  */
-int32_t Cm_LeafArea(const int32_t leaf_num) {
+int32_t Cm_LeafCluster(const int32_t leaf_num) {
+	return Cm_LeafCluster_(cm_world, leaf_num);
+}
+
+/*
+ * @brief
+ */
+int32_t Cm_LeafArea_(const cm_world_t *world, const int32_t leaf_num) {
 
-	if (leaf_num < 0 || leaf_num >= cm_bsp.num_leafs) {
+	if (leaf_num < 0 || leaf_num >= world->bsp.num_leafs) {
 		Com_Error(ERR_DROP, "Bad number: %d\n", leaf_num);
 	}
 
-	return cm_bsp.leafs[leaf_num].area;
+	return world->bsp.leafs[leaf_num].area;
+}
+
+/*
+ * @brief
+ */
+int32_t Cm_LeafArea(const int32_t leaf_num) {
+	return Cm_LeafArea_(cm_world, leaf_num);
 }
@@ -24,6 +24,20 @@
 
 #include "cm_types.h"
 
+cm_world_t *Cm_LoadWorld(const char *name, int64_t *size);
+void Cm_FreeWorld(cm_world_t *world);
+void Cm_SetWorld(cm_world_t *world);
+cm_world_t *Cm_World(void);
+cm_bsp_model_t *Cm_WorldModel(cm_world_t *world, const int32_t num);
+cm_bsp_model_t *Cm_Model_(cm_world_t *world, const char *name);
+int32_t Cm_NumClusters_(const cm_world_t *world);
+int32_t Cm_NumModels_(const cm_world_t *world);
+const char *Cm_EntityString_(const cm_world_t *world);
+const char *Cm_WorldspawnValue_(const cm_world_t *world, const char *key);
+int32_t Cm_LeafContents_(const cm_world_t *world, const int32_t leaf_num);
+int32_t Cm_LeafCluster_(const cm_world_t *world, const int32_t leaf_num);
+int32_t Cm_LeafArea_(const cm_world_t *world, const int32_t leaf_num);
+
 cm_bsp_model_t *Cm_LoadBspModel(const char *name, int64_t *size);
 cm_bsp_model_t *Cm_Model(const char *name); // *1, *2, etc
 
@@ -41,56 +55,58 @@ int32_t Cm_LeafArea(const int32_t leaf_num);
 
 #include "files.h"
 
+typedef d_bsp_vis_t cm_vis_t;
+
+/*
+ * @brief The collision BSP of a world. Its arrays are sized to the lumps of
+ * the map, and are linked to the world, so that they are freed with it.
+ */
 typedef struct {
 	char name[MAX_QPATH];
-	byte *base;
+	const byte *base; // the mapped file, valid only while loading
 
 	int32_t entity_string_len;
-	char entity_string[MAX_BSP_ENT_STRING];
+	char *entity_string;
 
 	int32_t num_planes;
-	cm_bsp_plane_t planes[MAX_BSP_PLANES + 12]; // extra for box hull
+	cm_bsp_plane_t *planes; // 12 extra for box hull
 
 	int32_t num_nodes;
-	cm_bsp_node_t nodes[MAX_BSP_NODES + 6]; // extra for box hull
+	cm_bsp_node_t *nodes; // 6 extra for box hull
 
 	int32_t num_surfaces;
-	cm_bsp_surface_t surfaces[MAX_BSP_TEXINFO];
+	cm_bsp_surface_t *surfaces;
 
 	int32_t num_leafs;
-	cm_bsp_leaf_t leafs[MAX_BSP_LEAFS + 1]; // extra for box hull
+	cm_bsp_leaf_t *leafs; // 1 extra for box hull
 	int32_t empty_leaf, solid_leaf;
 
 	int32_t num_leaf_brushes;
-	uint16_t leaf_brushes[MAX_BSP_LEAF_BRUSHES + 1]; // extra for box hull
+	uint16_t *leaf_brushes; // 1 extra for box hull
 
 	int32_t num_models;
-	cm_bsp_model_t models[MAX_BSP_MODELS];
+	cm_bsp_model_t *models;
 
 	int32_t num_brushes;
-	cm_bsp_brush_t brushes[MAX_BSP_BRUSHES + 1]; // extra for box hull
+	cm_bsp_brush_t *brushes; // 1 extra for box hull
 
 	int32_t num_brush_sides;
-	cm_bsp_brush_side_t brush_sides[MAX_BSP_BRUSH_SIDES + 6]; // extra for box hull
+	cm_bsp_brush_side_t *brush_sides; // 6 extra for box hull
 
 	int32_t num_visibility;
-	byte visibility[MAX_BSP_VISIBILITY];
+	byte *visibility;
+	cm_vis_t *vis; // the header of the visibility lump
 
 	int32_t num_areas;
-	cm_bsp_area_t areas[MAX_BSP_AREAS];
+	cm_bsp_area_t *areas;
 
 	int32_t num_area_portals;
-	d_bsp_area_portal_t area_portals[MAX_BSP_AREA_PORTALS];
+	d_bsp_area_portal_t *area_portals;
 
-	_Bool portal_open[MAX_BSP_AREA_PORTALS];
+	_Bool *portal_open;
 	int32_t flood_valid;
 } cm_bsp_t;
 
-typedef d_bsp_vis_t cm_vis_t;
-
-extern cm_bsp_t cm_bsp;
-extern cm_vis_t *cm_vis;
-
 #endif /* __CM_LOCAL_H__ */
 
 #endif /* __CM_MODEL_H__ */
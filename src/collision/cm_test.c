@@ -101,97 +101,75 @@ int32_t Cm_BoxOnPlaneSide(const vec3_t mins, const vec3_t maxs, const cm_bsp_pla
 	return sides;
 }
 
-/*
- * @brief Bounding box to BSP tree structure for box positional testing.
- */
-typedef struct {
-	int32_t head_node;
-	cm_bsp_plane_t *planes;
-	cm_bsp_brush_t *brush;
-	cm_bsp_leaf_t *leaf;
-} cm_box_t;
-
-static cm_box_t cm_box;
-
 /*
  * @brief Appends a brush (6 nodes, 12 planes) opaquely to the primary BSP
  * structure to represent the bounding box used for Cm_BoxLeafnums. This brush
  * is never tested by the rest of the collision detection code, as it resides
- * just beyond the parsed size of the map.
+ * just beyond the parsed size of the map, in the room which the loaders
+ * reserve for it.
  */
-void Cm_InitBoxHull(void) {
+void Cm_InitBoxHull(cm_world_t *world) {
 	static cm_bsp_surface_t null_surface;
 
-	if (cm_bsp.num_planes + 12 > MAX_BSP_PLANES)
-		Com_Error(ERR_DROP, "MAX_BSP_PLANES\n");
-
-	if (cm_bsp.num_nodes + 6 > MAX_BSP_NODES)
-		Com_Error(ERR_DROP, "MAX_BSP_NODES\n");
-
-	if (cm_bsp.num_leafs + 1 > MAX_BSP_LEAFS)
-		Com_Error(ERR_DROP, "MAX_BSP_LEAFS\n");
-
-	if (cm_bsp.num_leaf_brushes + 1 > MAX_BSP_LEAF_BRUSHES)
-		Com_Error(ERR_DROP, "MAX_BSP_LEAF_BRUSHES\n");
-
-	if (cm_bsp.num_brushes + 1 > MAX_BSP_BRUSHES)
-		Com_Error(ERR_DROP, "MAX_BSP_BRUSHES\n");
-
-	if (cm_bsp.num_brush_sides + 6 > MAX_BSP_BRUSH_SIDES)
-		Com_Error(ERR_DROP, "MAX_BSP_BRUSH_SIDES\n");
+	cm_bsp_t *bsp = &world->bsp;
+	cm_box_t *box = &world->box;
 
 	// head node
-	cm_box.head_node = cm_bsp.num_nodes;
+	box->head_node = bsp->num_nodes;
 
 	// planes
-	cm_box.planes = &cm_bsp.planes[cm_bsp.num_planes];
+	box->planes = &bsp->planes[bsp->num_planes];
+
+	// nodes and brush sides, which carry copies of the planes
+	box->nodes = &bsp->nodes[box->head_node];
+	box->brush_sides = &bsp->brush_sides[bsp->num_brush_sides];
 
 	// leaf
-	cm_box.leaf = &cm_bsp.leafs[cm_bsp.num_leafs];
-	cm_box.leaf->contents = CONTENTS_MONSTER;
-	cm_box.leaf->first_leaf_brush = cm_bsp.num_leaf_brushes;
-	cm_box.leaf->num_leaf_brushes = 1;
+	box->leaf = &bsp->leafs[bsp->num_leafs];
+	box->leaf->contents = CONTENTS_MONSTER;
+	box->leaf->first_leaf_brush = bsp->num_leaf_brushes;
+	box->leaf->num_leaf_brushes = 1;
 
 	// leaf brush
-	cm_bsp.leaf_brushes[cm_bsp.num_leaf_brushes] = cm_bsp.num_brushes;
+	bsp->leaf_brushes[bsp->num_leaf_brushes] = bsp->num_brushes;
 
 	// brush
-	cm_box.brush = &cm_bsp.brushes[cm_bsp.num_brushes];
-	cm_box.brush->num_sides = 6;
-	cm_box.brush->first_brush_side = cm_bsp.num_brush_sides;
-	cm_box.brush->contents = CONTENTS_MONSTER;
+	box->brush = &bsp->brushes[bsp->num_brushes];
+	box->brush->num_sides = 6;
+	box->brush->first_brush_side = bsp->num_brush_sides;
+	box->brush->contents = CONTENTS_MONSTER;
 
 	for (int32_t i = 0; i < 6; i++) {
 
 		// fill in planes, two per side
-		cm_bsp_plane_t *plane = &cm_box.planes[i * 2];
+		cm_bsp_plane_t *plane = &box->planes[i * 2];
 		plane->type = i >> 1;
 		VectorClear(plane->normal);
 		plane->normal[i >> 1] = 1.0;
 		plane->sign_bits = Cm_SignBitsForPlane(plane);
-		plane->num = cm_bsp.num_planes + i * 2;
+		plane->num = bsp->num_planes + i * 2;
 
-		plane = &cm_box.planes[i * 2 + 1];
+		plane = &box->planes[i * 2 + 1];
 		plane->type = PLANE_ANY_X + (i >> 1);
 		VectorClear(plane->normal);
 		plane->normal[i >> 1] = -1.0;
 		plane->sign_bits = Cm_SignBitsForPlane(plane);
-		plane->num = cm_bsp.num_planes + i * 2 + 1;
+		plane->num = bsp->num_planes + i * 2 + 1;
 
 		const int32_t side = i & 1;
 
 		// fill in nodes, one per side
-		cm_bsp_node_t *node = &cm_bsp.nodes[cm_box.head_node + i];
-		node->plane = cm_bsp.planes + (cm_bsp.num_planes + i * 2);
-		node->children[side] = -1 - cm_bsp.empty_leaf;
+		cm_bsp_node_t *node = &box->nodes[i];
+		node->plane = box->planes[i * 2];
+		node->children[side] = -1 - bsp->empty_leaf;
 		if (i < 5)
-			node->children[side ^ 1] = cm_box.head_node + i + 1;
+			node->children[side ^ 1] = box->head_node + i + 1;
 		else
-			node->children[side ^ 1] = -1 - cm_bsp.num_leafs;
+			node->children[side ^ 1] = -1 - bsp->num_leafs;
 
 		// fill in brush sides, one per side
-		cm_bsp_brush_side_t *bside = &cm_bsp.brush_sides[cm_bsp.num_brush_sides + i];
-		bside->plane = cm_bsp.planes + (cm_bsp.num_planes + i * 2 + side);
+		cm_bsp_brush_side_t *bside = &box->brush_sides[i];
+		bside->plane = box->planes[i * 2 + side];
 		bside->surface = &null_surface;
 	}
 }
@@ -200,34 +178,49 @@ void Cm_InitBoxHull(void) {
  * @brief Initializes the box hull for the specified bounds, returning the
  * head node for the resulting box hull tree.
  */
-int32_t Cm_SetBoxHull(const vec3_t mins, const vec3_t maxs, const int32_t contents) {
+int32_t Cm_SetBoxHull_(cm_world_t *world, const vec3_t mins, const vec3_t maxs,
+		const int32_t contents) {
+
+	cm_box_t *box = &world->box;
+
+	box->planes[0].dist = maxs[0];
+	box->planes[1].dist = -maxs[0];
+	box->planes[2].dist = mins[0];
+	box->planes[3].dist = -mins[0];
+	box->planes[4].dist = maxs[1];
+	box->planes[5].dist = -maxs[1];
+	box->planes[6].dist = mins[1];
+	box->planes[7].dist = -mins[1];
+	box->planes[8].dist = maxs[2];
+	box->planes[9].dist = -maxs[2];
+	box->planes[10].dist = mins[2];
+	box->planes[11].dist = -mins[2];
 
-	cm_box.planes[0].dist = maxs[0];
-	cm_box.planes[1].dist = -maxs[0];
-	cm_box.planes[2].dist = mins[0];
-	cm_box.planes[3].dist = -mins[0];
-	cm_box.planes[4].dist = maxs[1];
-	cm_box.planes[5].dist = -maxs[1];
-	cm_box.planes[6].dist = mins[1];
-	cm_box.planes[7].dist = -mins[1];
-	cm_box.planes[8].dist = maxs[2];
-	cm_box.planes[9].dist = -maxs[2];
-	cm_box.planes[10].dist = mins[2];
-	cm_box.planes[11].dist = -mins[2];
-
-	cm_box.leaf->contents = cm_box.brush->contents = contents;
-
-	return cm_box.head_node;
+	for (int32_t i = 0; i < 6; i++) {
+		box->nodes[i].plane.dist = box->planes[i * 2].dist;
+		box->brush_sides[i].plane.dist = box->planes[i * 2 + (i & 1)].dist;
+	}
+
+	box->leaf->contents = box->brush->contents = contents;
+
+	return box->head_node;
+}
+
+/*
+ * @brief Initializes the box hull of the current world.
+ */
+int32_t Cm_SetBoxHull(const vec3_t mins, const vec3_t maxs, const int32_t contents) {
+	return Cm_SetBoxHull_(cm_world, mins, maxs, contents);
 }
 
 /*
  * @brief
  */
-static int32_t Cm_PointLeafnum_r(const vec3_t p, int32_t num) {
+static int32_t Cm_PointLeafnum_r(const cm_bsp_t *bsp, const vec3_t p, int32_t num) {
 
 	while (num >= 0) {
-		const cm_bsp_node_t *node = cm_bsp.nodes + num;
-		cm_bsp_plane_t *plane = node->plane;
+		const cm_bsp_node_t *node = bsp->nodes + num;
+		const cm_bsp_plane_t *plane = &node->plane;
 
 		vec_t d;
 		if (AXIAL(plane))
@@ -247,30 +240,45 @@ static int32_t Cm_PointLeafnum_r(const vec3_t p, int32_t num) {
 /*
  * @return The leaf number containing the specified point.
  */
-int32_t Cm_PointLeafnum(const vec3_t p, int32_t head_node) {
+int32_t Cm_PointLeafnum_(const cm_world_t *world, const vec3_t p, int32_t head_node) {
 
-	if (!cm_bsp.num_nodes)
+	if (!world->bsp.num_nodes)
 		return 0;
 
-	return Cm_PointLeafnum_r(p, head_node);
+	return Cm_PointLeafnum_r(&world->bsp, p, head_node);
+}
+
+/*
+ * @return The leaf number of the current world containing the specified point.
+ */
+int32_t Cm_PointLeafnum(const vec3_t p, int32_t head_node) {
+	return Cm_PointLeafnum_(cm_world, p, head_node);
 }
 
 /*
  * @brief Contents check against the world model.
  *
+ * @param world The world to check.
  * @param p The point to check.
  * @param head_node The BSP head node to recurse down.
  *
  * @return The contents mask at the specified point.
  */
-int32_t Cm_PointContents(const vec3_t p, int32_t head_node) {
+int32_t Cm_PointContents_(const cm_world_t *world, const vec3_t p, int32_t head_node) {
 
-	if (!cm_bsp.num_nodes)
+	if (!world->bsp.num_nodes)
 		return 0;
 
-	const int32_t leaf_num = Cm_PointLeafnum(p, head_node);
+	const int32_t leaf_num = Cm_PointLeafnum_(world, p, head_node);
+
+	return world->bsp.leafs[leaf_num].contents;
+}
 
-	return cm_bsp.leafs[leaf_num].contents;
+/*
+ * @brief Contents check against the current world.
+ */
+int32_t Cm_PointContents(const vec3_t p, int32_t head_node) {
+	return Cm_PointContents_(cm_world, p, head_node);
 }
 
 /*
@@ -279,25 +287,35 @@ int32_t Cm_PointContents(const vec3_t p, int32_t head_node) {
  * the head node is the root of the model's subtree. For mesh models, a special
  * reserver box hull is used.
  *
+ * @param world The world to check.
  * @param p The point, in world space.
  * @param head_hode The BSP head node to recurse down.
  * @param inverse_matrix The inverse matrix of the entity to be tested.
  *
  * @return The contents mask at the specified point.
  */
-int32_t Cm_TransformedPointContents(const vec3_t p, int32_t head_node,
+int32_t Cm_TransformedPointContents_(const cm_world_t *world, const vec3_t p, int32_t head_node,
 		const matrix4x4_t *inverse_matrix) {
 	vec3_t p0;
 
 	Matrix4x4_Transform(inverse_matrix, p, p0);
 
-	return Cm_PointContents(p0, head_node);
+	return Cm_PointContents_(world, p0, head_node);
+}
+
+/*
+ * @brief Contents check for non-world models of the current world.
+ */
+int32_t Cm_TransformedPointContents(const vec3_t p, int32_t head_node,
+		const matrix4x4_t *inverse_matrix) {
+	return Cm_TransformedPointContents_(cm_world, p, head_node, inverse_matrix);
 }
 
 /*
  * @brief Data binding structure for box to leaf tests.
  */
 typedef struct {
+	const cm_bsp_t *bsp;
 	const vec_t *mins, *maxs;
 	int32_t *list;
 	size_t len, max_len;
@@ -318,8 +336,8 @@ static void Cm_BoxLeafnums_r(cm_box_leafnum_data *data, int32_t node_num) {
 			return;
 		}
 
-		const cm_bsp_node_t *node = &cm_bsp.nodes[node_num];
-		const cm_bsp_plane_t *plane = node->plane;
+		const cm_bsp_node_t *node = &data->bsp->nodes[node_num];
+		const cm_bsp_plane_t *plane = &node->plane;
 
 		const int32_t side = Cm_BoxOnPlaneSide(data->mins, data->maxs, plane);
 
@@ -341,6 +359,7 @@ static void Cm_BoxLeafnums_r(cm_box_leafnum_data *data, int32_t node_num) {
  * top_node is not NULL, it will contain the top node of the BSP tree that
  * fully contains the box.
  *
+ * @param world The world to check.
  * @param mins The box mins in world space.
  * @param maxs The box maxs in world space.
  * @param list The list of leaf numbers to populate.
@@ -350,11 +369,12 @@ static void Cm_BoxLeafnums_r(cm_box_leafnum_data *data, int32_t node_num) {
  *
  * @return The number of leafs accumulated to the list.
  */
-size_t Cm_BoxLeafnums(const vec3_t mins, const vec3_t maxs, int32_t *list, size_t len,
-		int32_t *top_node, int32_t head_node) {
+size_t Cm_BoxLeafnums_(const cm_world_t *world, const vec3_t mins, const vec3_t maxs,
+		int32_t *list, size_t len, int32_t *top_node, int32_t head_node) {
 
 	cm_box_leafnum_data data;
 
+	data.bsp = &world->bsp;
 	data.mins = mins;
 	data.maxs = maxs;
 	data.list = list;
@@ -373,3 +393,12 @@ size_t Cm_BoxLeafnums(const vec3_t mins, const vec3_t maxs, int32_t *list, size_
 
 	return data.len;
 }
+
+/*
+ * @brief Populates the list of leafs of the current world the specified
+ * bounding box touches.
+ */
+size_t Cm_BoxLeafnums(const vec3_t mins, const vec3_t maxs, int32_t *list, size_t len,
+		int32_t *top_node, int32_t head_node) {
+	return Cm_BoxLeafnums_(cm_world, mins, maxs, list, len, top_node, head_node);
+}
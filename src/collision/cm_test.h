@@ -26,6 +26,16 @@
 
 int32_t Cm_SignBitsForPlane(const cm_bsp_plane_t *plane);
 int32_t Cm_BoxOnPlaneSide(const vec3_t mins, const vec3_t maxs, const cm_bsp_plane_t *plane);
+
+int32_t Cm_SetBoxHull_(cm_world_t *world, const vec3_t mins, const vec3_t maxs,
+		const int32_t contents);
+int32_t Cm_PointLeafnum_(const cm_world_t *world, const vec3_t p, int32_t head_node);
+int32_t Cm_PointContents_(const cm_world_t *world, const vec3_t p, int32_t head_node);
+int32_t Cm_TransformedPointContents_(const cm_world_t *world, const vec3_t p, int32_t head_node,
+		const matrix4x4_t *inverse_matrix);
+size_t Cm_BoxLeafnums_(const cm_world_t *world, const vec3_t mins, const vec3_t maxs,
+		int32_t *list, size_t len, int32_t *top_node, int32_t head_node);
+
 int32_t Cm_SetBoxHull(const vec3_t mins, const vec3_t maxs, const int32_t contents);
 int32_t Cm_PointLeafnum(const vec3_t p, int32_t head_node);
 int32_t Cm_PointContents(const vec3_t p, int32_t head_node);
@@ -35,7 +45,20 @@ size_t Cm_BoxLeafnums(const vec3_t mins, const vec3_t maxs, int32_t *list, size_
 		int32_t *top_node, int32_t head_node);
 
 #ifdef __CM_LOCAL_H__
-void Cm_InitBoxHull(void);
+
+/*
+ * @brief Bounding box to BSP tree structure for box positional testing.
+ */
+typedef struct {
+	int32_t head_node;
+	cm_bsp_plane_t *planes;
+	cm_bsp_node_t *nodes;
+	cm_bsp_brush_t *brush;
+	cm_bsp_brush_side_t *brush_sides;
+	cm_bsp_leaf_t *leaf;
+} cm_box_t;
+
+void Cm_InitBoxHull(cm_world_t *world);
 #endif
 
 #endif /* __CM_TEST_H__ */
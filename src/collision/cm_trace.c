@@ -19,8 +19,20 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include <SDL2/SDL_atomic.h>
+
 #include "cm_local.h"
 
+/*
+ * @brief Brush sides are clipped four at a time with SSE, where scalar floating
+ * point also uses SSE, and may not be contracted to FMA, so that the results
+ * are identical to the scalar path.
+ */
+#if defined(__SSE_MATH__) && !defined(__FMA__)
+#define CM_TRACE_SSE
+#include <xmmintrin.h>
+#endif
+
 /*
  * @brief Plane side epsilon (1.0 / 32.0) to keep floating point happy.
  */
@@ -30,6 +42,8 @@
  * @brief Box trace data encapsulation and context management.
  */
 typedef struct {
+	const cm_world_t *world;
+
 	vec3_t start, end;
 	vec3_t mins, maxs;
 	vec3_t extents;
@@ -41,20 +55,98 @@ typedef struct {
 
 	cm_trace_t trace;
 
-	int32_t brushes[32]; // used to avoid multiple intersection tests with brushes
+	cm_trace_stats_t stats; // for this trace
 } cm_trace_data_t;
 
 /*
- * @brief
+ * @brief Each thread numbers its traces, and marks each brush with the number
+ * of the trace that last tested it, so that brushes spanning several leafs are
+ * tested only once per trace.
+ */
+typedef struct {
+	uint32_t trace_num;
+	uint32_t brushes[MAX_BSP_BRUSHES + 1]; // extra for box hull
+} cm_trace_checks_t;
+
+static __thread cm_trace_checks_t cm_trace_checks;
+
+/*
+ * @brief Collision statistics, accumulated from all threads while enabled.
+ */
+static struct {
+	SDL_atomic_t enabled;
+	SDL_atomic_t traces;
+	SDL_atomic_t nodes;
+	SDL_atomic_t leafs;
+	SDL_atomic_t brushes;
+	SDL_atomic_t brushes_skipped;
+} cm_trace_stats;
+
+/*
+ * @return True if the brush has already been tested by the current trace,
+ * marking it as tested otherwise.
  */
 static _Bool Cm_BrushAlreadyTested(cm_trace_data_t *data, const int32_t brush_num) {
 
-	const int32_t hash = brush_num & 31;
-	const _Bool skip = (data->brushes[hash] == brush_num);
+	if (cm_trace_checks.brushes[brush_num] == cm_trace_checks.trace_num) {
+		data->stats.brushes_skipped++;
+		return true;
+	}
+
+	cm_trace_checks.brushes[brush_num] = cm_trace_checks.trace_num;
+	data->stats.brushes++;
+
+	return false;
+}
+
+/*
+ * @brief Resolves the distances of the trace's start and end points to four
+ * consecutive brush sides, with each plane shifted to account for the box size.
+ */
+static void Cm_BrushSideDistances(const cm_trace_data_t *data, const cm_bsp_brush_side_t *side,
+		const int32_t count, vec_t *d1, vec_t *d2) {
+
+#if defined(CM_TRACE_SSE)
+	if (count == 4) {
+		const cm_bsp_plane_t *p0 = &side[0].plane, *p1 = &side[1].plane;
+		const cm_bsp_plane_t *p2 = &side[2].plane, *p3 = &side[3].plane;
+
+		const vec_t *o0 = data->offsets[p0->sign_bits], *o1 = data->offsets[p1->sign_bits];
+		const vec_t *o2 = data->offsets[p2->sign_bits], *o3 = data->offsets[p3->sign_bits];
+
+		const __m128 nx = _mm_setr_ps(p0->normal[0], p1->normal[0], p2->normal[0], p3->normal[0]);
+		const __m128 ny = _mm_setr_ps(p0->normal[1], p1->normal[1], p2->normal[1], p3->normal[1]);
+		const __m128 nz = _mm_setr_ps(p0->normal[2], p1->normal[2], p2->normal[2], p3->normal[2]);
 
-	data->brushes[hash] = brush_num;
+		const __m128 ox = _mm_setr_ps(o0[0], o1[0], o2[0], o3[0]);
+		const __m128 oy = _mm_setr_ps(o0[1], o1[1], o2[1], o3[1]);
+		const __m128 oz = _mm_setr_ps(o0[2], o1[2], o2[2], o3[2]);
 
-	return skip;
+		const __m128 offset = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, nx), _mm_mul_ps(oy, ny)),
+				_mm_mul_ps(oz, nz));
+
+		const __m128 dist = _mm_sub_ps(_mm_setr_ps(p0->dist, p1->dist, p2->dist, p3->dist), offset);
+
+		const __m128 start = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(data->start[0]), nx),
+				_mm_mul_ps(_mm_set1_ps(data->start[1]), ny)), _mm_mul_ps(_mm_set1_ps(data->start[2]), nz));
+
+		const __m128 end = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(data->end[0]), nx),
+				_mm_mul_ps(_mm_set1_ps(data->end[1]), ny)), _mm_mul_ps(_mm_set1_ps(data->end[2]), nz));
+
+		_mm_storeu_ps(d1, _mm_sub_ps(start, dist));
+		_mm_storeu_ps(d2, _mm_sub_ps(end, dist));
+		return;
+	}
+#endif
+
+	for (int32_t i = 0; i < count; i++, side++) {
+		const cm_bsp_plane_t *plane = &side->plane;
+
+		const vec_t dist = plane->dist - DotProduct(data->offsets[plane->sign_bits], plane->normal);
+
+		d1[i] = DotProduct(data->start, plane->normal) - dist;
+		d2[i] = DotProduct(data->end, plane->normal) - dist;
+	}
 }
 
 /*
@@ -76,43 +168,49 @@ static void Cm_TraceToBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush)
 
 	_Bool end_outside = false, start_outside = false;
 
-	const cm_bsp_brush_side_t *side = &cm_bsp.brush_sides[brush->first_brush_side];
+	const cm_bsp_brush_side_t *side = &data->world->bsp.brush_sides[brush->first_brush_side];
 
-	for (int32_t i = 0; i < brush->num_sides; i++, side++) {
-		const cm_bsp_plane_t *plane = side->plane;
+	for (int32_t i = 0; i < brush->num_sides; i += 4) {
+		vec_t d1s[4], d2s[4];
 
-		const vec_t dist = plane->dist - DotProduct(data->offsets[plane->sign_bits], plane->normal);
+		const int32_t count = MIN(brush->num_sides - i, 4);
 
-		const vec_t d1 = DotProduct(data->start, plane->normal) - dist;
-		const vec_t d2 = DotProduct(data->end, plane->normal) - dist;
+		Cm_BrushSideDistances(data, side, count, d1s, d2s);
 
-		if (d2 > 0.0)
-			end_outside = true; // end point is not in solid
-		if (d1 > 0.0)
-			start_outside = true;
+		for (int32_t j = 0; j < count; j++, side++) {
+			const cm_bsp_plane_t *plane = &side->plane;
 
-		// if completely in front of face, no intersection with entire brush
-		if (d1 > 0.0 && d2 >= d1)
-			return;
+			const vec_t d1 = d1s[j];
+			const vec_t d2 = d2s[j];
 
-		// if completely behind plane, no intersection
-		if (d1 <= 0.0 && d2 <= 0.0)
-			continue;
+			if (d2 > 0.0)
+				end_outside = true; // end point is not in solid
+			if (d1 > 0.0)
+				start_outside = true;
 
-		// crosses face
-		if (d1 > d2) { // enter
-			const vec_t f = (d1 - DIST_EPSILON) / (d1 - d2);
+			// if completely in front of face, no intersection with entire brush
+			if (d1 > 0.0 && d2 >= d1)
+				return;
 
-			if (f > enter_fraction) {
-				enter_fraction = f;
-				clip_plane = plane;
-				clip_side = side;
-			}
-		} else { // leave
-			const vec_t f = (d1 + DIST_EPSILON) / (d1 - d2);
+			// if completely behind plane, no intersection
+			if (d1 <= 0.0 && d2 <= 0.0)
+				continue;
+
+			// crosses face
+			if (d1 > d2) { // enter
+				const vec_t f = (d1 - DIST_EPSILON) / (d1 - d2);
 
-			if (f < leave_fraction)
-				leave_fraction = f;
+				if (f > enter_fraction) {
+					enter_fraction = f;
+					clip_plane = plane;
+					clip_side = side;
+				}
+			} else { // leave
+				const vec_t f = (d1 + DIST_EPSILON) / (d1 - d2);
+
+				if (f < leave_fraction)
+					leave_fraction = f;
+			}
 		}
 	}
 
@@ -146,10 +244,10 @@ static void Cm_TestBoxInBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush
 	if (!BoxIntersect(data->box_mins, data->box_maxs, brush->mins, brush->maxs))
 		return;
 
-	const cm_bsp_brush_side_t *side = &cm_bsp.brush_sides[brush->first_brush_side];
+	const cm_bsp_brush_side_t *side = &data->world->bsp.brush_sides[brush->first_brush_side];
 
 	for (int32_t i = 0; i < brush->num_sides; i++, side++) {
-		const cm_bsp_plane_t *plane = side->plane;
+		const cm_bsp_plane_t *plane = &side->plane;
 
 		const vec_t dist = plane->dist - DotProduct(data->offsets[plane->sign_bits], plane->normal);
 
@@ -171,22 +269,21 @@ static void Cm_TestBoxInBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush
  */
 static void Cm_TraceToLeaf(cm_trace_data_t *data, int32_t leaf_num) {
 
-	const cm_bsp_leaf_t *leaf = &cm_bsp.leafs[leaf_num];
+	const cm_bsp_leaf_t *leaf = &data->world->bsp.leafs[leaf_num];
 
 	if (!(leaf->contents & data->contents))
 		return;
 
-	// reset the brushes cache for this leaf
-	memset(data->brushes, 0xff, sizeof(data->brushes));
+	data->stats.leafs++;
 
 	// trace line against all brushes in the leaf
 	for (int32_t i = 0; i < leaf->num_leaf_brushes; i++) {
-		const int32_t brush_num = cm_bsp.leaf_brushes[leaf->first_leaf_brush + i];
+		const int32_t brush_num = data->world->bsp.leaf_brushes[leaf->first_leaf_brush + i];
 
 		if (Cm_BrushAlreadyTested(data, brush_num))
 			continue; // already checked this brush in another leaf
 
-		const cm_bsp_brush_t *b = &cm_bsp.brushes[brush_num];
+		const cm_bsp_brush_t *b = &data->world->bsp.brushes[brush_num];
 
 		if (!(b->contents & data->contents))
 			continue;
@@ -203,19 +300,21 @@ static void Cm_TraceToLeaf(cm_trace_data_t *data, int32_t leaf_num) {
  */
 static void Cm_TestInLeaf(cm_trace_data_t *data, int32_t leaf_num) {
 
-	const cm_bsp_leaf_t *leaf = &cm_bsp.leafs[leaf_num];
+	const cm_bsp_leaf_t *leaf = &data->world->bsp.leafs[leaf_num];
 
 	if (!(leaf->contents & data->contents))
 		return;
 
+	data->stats.leafs++;
+
 	// trace line against all brushes in the leaf
 	for (int32_t i = 0; i < leaf->num_leaf_brushes; i++) {
-		const int32_t brush_num = cm_bsp.leaf_brushes[leaf->first_leaf_brush + i];
+		const int32_t brush_num = data->world->bsp.leaf_brushes[leaf->first_leaf_brush + i];
 
 		if (Cm_BrushAlreadyTested(data, brush_num))
 			continue; // already checked this brush in another leaf
 
-		const cm_bsp_brush_t *b = &cm_bsp.brushes[brush_num];
+		const cm_bsp_brush_t *b = &data->world->bsp.brushes[brush_num];
 
 		if (!(b->contents & data->contents))
 			continue;
@@ -242,10 +341,12 @@ static void Cm_TraceToNode(cm_trace_data_t *data, int32_t num, vec_t p1f, vec_t
 		return;
 	}
 
+	data->stats.nodes++;
+
 	// find the point distances to the separating plane
 	// and the offset for the size of the box
-	const cm_bsp_node_t *node = cm_bsp.nodes + num;
-	const cm_bsp_plane_t *plane = node->plane;
+	const cm_bsp_node_t *node = data->world->bsp.nodes + num;
+	const cm_bsp_plane_t *plane = &node->plane;
 
 	vec_t d1, d2, offset;
 	if (AXIAL(plane)) {
@@ -315,91 +416,72 @@ static void Cm_TraceToNode(cm_trace_data_t *data, int32_t num, vec_t p1f, vec_t
 }
 
 /*
- * @brief Primary collision detection entry point. This function recurses down
- * the BSP tree from the specified head node, clipping the desired movement to
- * brushes that match the specified contents mask.
- *
- * @param start The starting point.
- * @param end The desired end point.
- * @param mins The bounding box mins, in model space.
- * @param maxs The bounding box maxs, in model space.
- * @param head_node The BSP head node to recurse down.
- * @param contents The contents mask to clip to.
- *
- * @return The trace.
+ * @brief Prepares the trace data for the given box and contents mask, which
+ * may then be used to trace any number of rays.
  */
-cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
-		const int32_t head_node, const int32_t contents) {
+static void Cm_InitTraceData(cm_trace_data_t *data, const cm_world_t *world, const vec3_t mins,
+		const vec3_t maxs, const int32_t contents) {
 
-	static __thread cm_trace_data_t data;
-	memset(&data, 0, sizeof(data));
+	memset(data, 0, sizeof(*data));
 
-	data.trace.fraction = 1.0;
+	data->world = world;
 
-	if (!cm_bsp.num_nodes) { // map not loaded
-		return data.trace;
-	}
-
-	VectorCopy(start, data.start);
-	VectorCopy(end, data.end);
+	VectorCopy(mins, data->mins);
+	VectorCopy(maxs, data->maxs);
 
-	VectorCopy(mins, data.mins);
-	VectorCopy(maxs, data.maxs);
-
-	data.contents = contents;
+	data->contents = contents;
 
 	// check for point special case
 	if (VectorCompare(mins, vec3_origin) && VectorCompare(maxs, vec3_origin)) {
-		data.is_point = true;
+		data->is_point = true;
 	} else {
-		data.is_point = false;
+		data->is_point = false;
 
 		// extents allow planes to be shifted to account for the box size
-		data.extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		data.extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		data.extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		data->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		data->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		data->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 
 		// offsets provide sign bit lookups for fast plane tests
-		data.offsets[0][0] = mins[0];
-		data.offsets[0][1] = mins[1];
-		data.offsets[0][2] = mins[2];
-
-		data.offsets[1][0] = maxs[0];
-		data.offsets[1][1] = mins[1];
-		data.offsets[1][2] = mins[2];
-
-		data.offsets[2][0] = mins[0];
-		data.offsets[2][1] = maxs[1];
-		data.offsets[2][2] = mins[2];
+		for (int32_t i = 0; i < 8; i++) {
+			data->offsets[i][0] = (i & 1) ? maxs[0] : mins[0];
+			data->offsets[i][1] = (i & 2) ? maxs[1] : mins[1];
+			data->offsets[i][2] = (i & 4) ? maxs[2] : mins[2];
+		}
+	}
+}
 
-		data.offsets[3][0] = maxs[0];
-		data.offsets[3][1] = maxs[1];
-		data.offsets[3][2] = mins[2];
+/*
+ * @brief Traces the box prepared by Cm_InitTraceData from start to end,
+ * leaving the result in data->trace.
+ */
+static void Cm_Trace(cm_trace_data_t *data, const vec3_t start, const vec3_t end,
+		const int32_t head_node) {
 
-		data.offsets[4][0] = mins[0];
-		data.offsets[4][1] = mins[1];
-		data.offsets[4][2] = maxs[2];
+	memset(&data->trace, 0, sizeof(data->trace));
+	memset(&data->stats, 0, sizeof(data->stats));
 
-		data.offsets[5][0] = maxs[0];
-		data.offsets[5][1] = mins[1];
-		data.offsets[5][2] = maxs[2];
+	data->trace.fraction = 1.0;
 
-		data.offsets[6][0] = mins[0];
-		data.offsets[6][1] = maxs[1];
-		data.offsets[6][2] = maxs[2];
+	if (!data->world->bsp.num_nodes) { // map not loaded
+		return;
+	}
 
-		data.offsets[7][0] = maxs[0];
-		data.offsets[7][1] = maxs[1];
-		data.offsets[7][2] = maxs[2];
+	if (++cm_trace_checks.trace_num == 0) { // wrapped, so forget all brushes
+		memset(cm_trace_checks.brushes, 0, sizeof(cm_trace_checks.brushes));
+		cm_trace_checks.trace_num = 1;
 	}
 
+	VectorCopy(start, data->start);
+	VectorCopy(end, data->end);
+
 	for (int32_t i = 0; i < 3; i++) {
 		if (start[i] < end[i]) {
-			data.box_mins[i] = start[i] + mins[i] - 1.0;
-			data.box_maxs[i] = end[i] + maxs[i] + 1.0;
+			data->box_mins[i] = start[i] + data->mins[i] - 1.0;
+			data->box_maxs[i] = end[i] + data->maxs[i] + 1.0;
 		} else {
-			data.box_mins[i] = end[i] + mins[i] - 1.0;
-			data.box_maxs[i] = start[i] + maxs[i] + 1.0;
+			data->box_mins[i] = end[i] + data->mins[i] - 1.0;
+			data->box_maxs[i] = start[i] + data->maxs[i] + 1.0;
 		}
 	}
 
@@ -407,33 +489,121 @@ cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
 	if (VectorCompare(start, end)) {
 		int32_t leafs[1024];
 
-		const size_t len = Cm_BoxLeafnums(data.box_mins, data.box_maxs, leafs, lengthof(leafs),
+		const size_t len = Cm_BoxLeafnums_(data->world, data->box_mins, data->box_maxs, leafs, lengthof(leafs),
 				NULL, head_node);
 
 		for (size_t i = 0; i < len; i++) {
-			Cm_TestInLeaf(&data, leafs[i]);
+			Cm_TestInLeaf(data, leafs[i]);
 
-			if (data.trace.all_solid)
+			if (data->trace.all_solid)
 				break;
 		}
 
-		VectorCopy(start, data.trace.end);
-		return data.trace;
+		VectorCopy(start, data->trace.end);
+		return;
 	}
 
-	Cm_TraceToNode(&data, head_node, 0.0, 1.0, start, end);
+	Cm_TraceToNode(data, head_node, 0.0, 1.0, start, end);
 
-	if (data.trace.fraction == 0.0) {
-		VectorCopy(start, data.trace.end);
-	} else if (data.trace.fraction == 1.0) {
-		VectorCopy(end, data.trace.end);
+	if (data->trace.fraction == 0.0) {
+		VectorCopy(start, data->trace.end);
+	} else if (data->trace.fraction == 1.0) {
+		VectorCopy(end, data->trace.end);
 	} else {
-		VectorLerp(start, end, data.trace.fraction, data.trace.end);
+		VectorLerp(start, end, data->trace.fraction, data->trace.end);
+	}
+}
+
+/*
+ * @brief Traces the box, accumulating statistics if they are enabled.
+ */
+static void Cm_TraceWithStats(cm_trace_data_t *data, const vec3_t start, const vec3_t end,
+		const int32_t head_node) {
+
+	Cm_Trace(data, start, end, head_node);
+
+	if (SDL_AtomicGet(&cm_trace_stats.enabled)) {
+		SDL_AtomicIncRef(&cm_trace_stats.traces);
+		SDL_AtomicAdd(&cm_trace_stats.nodes, data->stats.nodes);
+		SDL_AtomicAdd(&cm_trace_stats.leafs, data->stats.leafs);
+		SDL_AtomicAdd(&cm_trace_stats.brushes, data->stats.brushes);
+		SDL_AtomicAdd(&cm_trace_stats.brushes_skipped, data->stats.brushes_skipped);
 	}
+}
+
+/*
+ * @brief Primary collision detection entry point. This function recurses down
+ * the BSP tree from the specified head node, clipping the desired movement to
+ * brushes that match the specified contents mask.
+ *
+ * @param world The world to trace through.
+ * @param start The starting point.
+ * @param end The desired end point.
+ * @param mins The bounding box mins, in model space.
+ * @param maxs The bounding box maxs, in model space.
+ * @param head_node The BSP head node to recurse down.
+ * @param contents The contents mask to clip to.
+ *
+ * @return The trace.
+ */
+cm_trace_t Cm_BoxTrace_(const cm_world_t *world, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, const int32_t head_node, const int32_t contents) {
+
+	static __thread cm_trace_data_t data;
+
+	Cm_InitTraceData(&data, world, mins, maxs, contents);
+
+	Cm_TraceWithStats(&data, start, end, head_node);
 
 	return data.trace;
 }
 
+/*
+ * @brief Collision detection against the current world.
+ */
+cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+		const int32_t head_node, const int32_t contents) {
+	return Cm_BoxTrace_(cm_world, start, end, mins, maxs, head_node, contents);
+}
+
+/*
+ * @brief Batched collision detection, for fans of traces sharing a box, head
+ * node and contents mask (e.g. shotgun pellets, or lighting). The results are
+ * identical to those of calling Cm_BoxTrace for each ray, but the trace setup
+ * is performed only once.
+ *
+ * @param world The world to trace through.
+ * @param starts The starting points.
+ * @param ends The desired end points.
+ * @param count The number of rays.
+ * @param mins The bounding box mins, in model space.
+ * @param maxs The bounding box maxs, in model space.
+ * @param head_node The BSP head node to recurse down.
+ * @param contents The contents mask to clip to.
+ * @param traces The traces, one per ray.
+ */
+void Cm_BoxTraces_(const cm_world_t *world, const vec3_t *starts, const vec3_t *ends,
+		const size_t count, const vec3_t mins, const vec3_t maxs, const int32_t head_node,
+		const int32_t contents, cm_trace_t *traces) {
+
+	static __thread cm_trace_data_t data;
+
+	Cm_InitTraceData(&data, world, mins, maxs, contents);
+
+	for (size_t i = 0; i < count; i++) {
+		Cm_TraceWithStats(&data, starts[i], ends[i], head_node);
+		traces[i] = data.trace;
+	}
+}
+
+/*
+ * @brief Batched collision detection against the current world.
+ */
+void Cm_BoxTraces(const vec3_t *starts, const vec3_t *ends, const size_t count, const vec3_t mins,
+		const vec3_t maxs, const int32_t head_node, const int32_t contents, cm_trace_t *traces) {
+	Cm_BoxTraces_(cm_world, starts, ends, count, mins, maxs, head_node, contents, traces);
+}
+
 /*
  * @brief Collision detection for non-world models. Rotates the specified end
  * points into the model's space, and traces down the relevant subset of the
@@ -441,6 +611,7 @@ cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
  * subtree. For mesh models, a special reserved box hull and head node are
  * used.
  *
+ * @param world The world to trace through.
  * @param start The trace start point, in world space.
  * @param end The trace end point, in world space.
  * @param mins The trace bounding box mins.
@@ -452,8 +623,8 @@ cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
  *
  * @return The trace.
  */
-cm_trace_t Cm_TransformedBoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
-		const vec3_t maxs, const int32_t head_node, const int32_t contents,
+cm_trace_t Cm_TransformedBoxTrace_(const cm_world_t *world, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, const int32_t head_node, const int32_t contents,
 		const matrix4x4_t *matrix, const matrix4x4_t *inverse_matrix) {
 
 	vec3_t start0, end0;
@@ -462,7 +633,7 @@ cm_trace_t Cm_TransformedBoxTrace(const vec3_t start, const vec3_t end, const ve
 	Matrix4x4_Transform(inverse_matrix, end, end0);
 
 	// sweep the box through the model
-	cm_trace_t trace = Cm_BoxTrace(start0, end0, mins, maxs, head_node, contents);
+	cm_trace_t trace = Cm_BoxTrace_(world, start0, end0, mins, maxs, head_node, contents);
 
 	if (trace.fraction < 1.0) { // transform the impacted plane
 		vec4_t plane;
@@ -481,3 +652,44 @@ cm_trace_t Cm_TransformedBoxTrace(const vec3_t start, const vec3_t end, const ve
 
 	return trace;
 }
+
+/*
+ * @brief Collision detection for non-world models of the current world.
+ */
+cm_trace_t Cm_TransformedBoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
+		const vec3_t maxs, const int32_t head_node, const int32_t contents,
+		const matrix4x4_t *matrix, const matrix4x4_t *inverse_matrix) {
+	return Cm_TransformedBoxTrace_(cm_world, start, end, mins, maxs, head_node, contents, matrix,
+			inverse_matrix);
+}
+
+/*
+ * @brief Enables or disables the collection of collision statistics.
+ */
+void Cm_EnableTraceStats(_Bool enable) {
+	SDL_AtomicSet(&cm_trace_stats.enabled, enable);
+}
+
+/*
+ * @brief Copies the collision statistics to the specified structure.
+ */
+void Cm_TraceStats(cm_trace_stats_t *stats) {
+
+	stats->traces = SDL_AtomicGet(&cm_trace_stats.traces);
+	stats->nodes = SDL_AtomicGet(&cm_trace_stats.nodes);
+	stats->leafs = SDL_AtomicGet(&cm_trace_stats.leafs);
+	stats->brushes = SDL_AtomicGet(&cm_trace_stats.brushes);
+	stats->brushes_skipped = SDL_AtomicGet(&cm_trace_stats.brushes_skipped);
+}
+
+/*
+ * @brief Resets the collision statistics.
+ */
+void Cm_ClearTraceStats(void) {
+
+	SDL_AtomicSet(&cm_trace_stats.traces, 0);
+	SDL_AtomicSet(&cm_trace_stats.nodes, 0);
+	SDL_AtomicSet(&cm_trace_stats.leafs, 0);
+	SDL_AtomicSet(&cm_trace_stats.brushes, 0);
+	SDL_AtomicSet(&cm_trace_stats.brushes_skipped, 0);
+}
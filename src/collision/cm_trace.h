@@ -24,11 +24,29 @@
 
 #include "cm_types.h"
 
+cm_trace_t Cm_BoxTrace_(const cm_world_t *world, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, const int32_t head_node, const int32_t contents);
+
+void Cm_BoxTraces_(const cm_world_t *world, const vec3_t *starts, const vec3_t *ends,
+		const size_t count, const vec3_t mins, const vec3_t maxs, const int32_t head_node,
+		const int32_t contents, cm_trace_t *traces);
+
+cm_trace_t Cm_TransformedBoxTrace_(const cm_world_t *world, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, const int32_t head_node, const int32_t contents,
+		const matrix4x4_t *matrix, const matrix4x4_t *inverse_matrix);
+
 cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
 		const int32_t head_node, const int32_t contents);
 
+void Cm_BoxTraces(const vec3_t *starts, const vec3_t *ends, const size_t count, const vec3_t mins,
+		const vec3_t maxs, const int32_t head_node, const int32_t contents, cm_trace_t *traces);
+
 cm_trace_t Cm_TransformedBoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
 		const vec3_t maxs, const int32_t head_node, const int32_t contents,
 		const matrix4x4_t *matrix, const matrix4x4_t *inverse_matrix);
 
+void Cm_EnableTraceStats(_Bool enable);
+void Cm_TraceStats(cm_trace_stats_t *stats);
+void Cm_ClearTraceStats(void);
+
 #endif /* __CM_TRACE_H__ */
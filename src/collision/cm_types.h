@@ -37,6 +37,12 @@
 #define	SIDE_BOTH				3
 #define	SIDE_FACING				4
 
+/*
+ * @brief A collision world is a loaded map. Several worlds may be loaded at
+ * once, and most functions operate on the current world.
+ */
+typedef struct cm_world_s cm_world_t;
+
 /*
  * @brief Plane type constants for axial plane optimizations.
  */
@@ -135,15 +141,34 @@ typedef struct {
 	struct g_entity_s *ent; // not set by Cm_*() functions
 } cm_trace_t;
 
+/*
+ * @brief Collision statistics, collected while enabled by Cm_EnableTraceStats.
+ */
+typedef struct {
+	uint32_t traces;
+	uint32_t nodes; // nodes visited
+	uint32_t leafs; // leafs visited
+	uint32_t brushes; // brushes tested
+	uint32_t brushes_skipped; // brushes already tested in another leaf
+} cm_trace_stats_t;
+
 #ifdef __CM_LOCAL_H__
 
+/*
+ * @brief Nodes carry a copy of their plane, so that each node visited by a
+ * trace touches a single cache line. Nodes are ordered depth-first at load.
+ */
 typedef struct {
-	cm_bsp_plane_t *plane;
+	cm_bsp_plane_t plane;
 	int32_t children[2]; // negative numbers are leafs
 } cm_bsp_node_t;
 
+/*
+ * @brief Brush sides also carry a copy of their plane, and are ordered by
+ * brush at load, so that clipping to a brush reads its sides sequentially.
+ */
 typedef struct {
-	cm_bsp_plane_t *plane;
+	cm_bsp_plane_t plane;
 	cm_bsp_surface_t *surface;
 } cm_bsp_brush_side_t;
 
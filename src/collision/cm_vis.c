@@ -19,6 +19,8 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include <SDL2/SDL_timer.h>
+
 #include "cm_local.h"
 
 /*
@@ -26,15 +28,32 @@
  */
 _Bool cm_no_areas = false;
 
+/*
+ * @brief Maps whose decompressed visibility would exceed this many bytes
+ * decompress their rows on every request instead.
+ */
+#define CM_VIS_MATRIX_MAX (64 << 20)
+
+/*
+ * @brief Rows of the matrix are decompressed on first use, possibly by
+ * several threads at once. Each is claimed before it is written, and other
+ * threads wait for it to become ready.
+ */
+typedef enum {
+	CM_VIS_EMPTY,
+	CM_VIS_PENDING,
+	CM_VIS_READY
+} cm_vis_state_t;
+
 /*
  * @brief
  */
-static void Cm_DecompressVis(const byte *in, byte *out) {
+static void Cm_DecompressVis(const cm_bsp_t *bsp, const byte *in, byte *out) {
 
-	const int32_t row = (cm_vis->num_clusters + 7) >> 3;
+	const int32_t row = (bsp->vis->num_clusters + 7) >> 3;
 	byte *out_p = out;
 
-	if (!in || !cm_bsp.num_visibility) { // no vis info, so make all visible
+	if (!in || !bsp->num_visibility) { // no vis info, so make all visible
 		for (int32_t i = 0; i < row; i++) {
 			*out_p++ = 0xff;
 		}
@@ -60,43 +79,364 @@ static void Cm_DecompressVis(const byte *in, byte *out) {
 }
 
 /*
- * @brief
+ * @return True if the specified bit is set in the compressed row, which is
+ * walked only as far as the byte containing it.
+ */
+static _Bool Cm_CompressedVisBit(const cm_bsp_t *bsp, const byte *in, const int32_t bit) {
+
+	if (!in || !bsp->num_visibility) { // no vis info, so all are visible
+		return true;
+	}
+
+	const int32_t index = bit >> 3;
+
+	for (int32_t i = 0; i <= index;) {
+		if (*in) {
+			if (i == index) {
+				return *in & (1 << (bit & 7));
+			}
+			i++;
+			in++;
+			continue;
+		}
+
+		i += in[1];
+		in += 2;
+	}
+
+	return false;
+}
+
+/*
+ * @brief Resolves the decompressed row for the specified cluster, decompressing
+ * it on first use.
  *
- * @remark `pvs` must be at least `MAX_BSP_LEAFS >> 3` in length.
+ * @return The row, or NULL if the matrix is not available for this world.
  */
-size_t Cm_ClusterPVS(const int32_t cluster, byte *pvs) {
+static const byte *Cm_ClusterVisRow(const cm_world_t *world, const int32_t cluster,
+		const int32_t vis) {
+
+	const cm_vis_matrix_t *matrix = &world->vis_matrix;
+
+	if (!matrix->rows[vis]) {
+		return NULL;
+	}
+
+	if (cluster < 0 || cluster >= matrix->num_clusters) {
+		return matrix->empty;
+	}
+
+	byte *row = matrix->rows[vis] + cluster * matrix->row_size;
+	SDL_atomic_t *state = &matrix->state[vis][cluster];
+
+	if (SDL_AtomicGet(state) != CM_VIS_READY) {
+		if (SDL_AtomicCAS(state, CM_VIS_EMPTY, CM_VIS_PENDING)) {
+			const cm_bsp_t *bsp = &world->bsp;
+
+			Cm_DecompressVis(bsp, bsp->visibility + bsp->vis->bit_offsets[cluster][vis], row);
+			SDL_AtomicSet(state, CM_VIS_READY);
+		} else {
+			while (SDL_AtomicGet(state) != CM_VIS_READY) {
+				SDL_Delay(0); // another thread is writing this row
+			}
+		}
+	}
+
+	return row;
+}
+
+/*
+ * @brief Decompresses every row of the matrix, unless cancelled because the
+ * world is being freed.
+ */
+static void Cm_BuildVisMatrix(void *data) {
+
+	cm_world_t *world = data;
+	cm_vis_matrix_t *matrix = &world->vis_matrix;
+
+	const uint32_t start = SDL_GetTicks();
+
+	for (int32_t i = 0; i < matrix->num_clusters; i++) {
+
+		if (SDL_AtomicGet(&matrix->cancel)) {
+			return;
+		}
+
+		Cm_ClusterVisRow(world, i, DVIS_PVS);
+		Cm_ClusterVisRow(world, i, DVIS_PHS);
+	}
+
+	Com_Debug("%s: %d clusters in %ums\n", world->bsp.name, matrix->num_clusters,
+			SDL_GetTicks() - start);
+}
+
+/*
+ * @brief Allocates the decompressed visibility matrix for the specified world,
+ * and starts a job to populate it.
+ */
+void Cm_InitVisMatrix(cm_world_t *world) {
+
+	cm_vis_matrix_t *matrix = &world->vis_matrix;
+
+	const int32_t num_clusters = world->bsp.vis->num_clusters;
+
+	if (num_clusters <= 0) {
+		return;
+	}
+
+	const size_t row_size = ((num_clusters + 63) >> 6) * sizeof(uint64_t);
+
+	if (num_clusters * row_size * 2 > CM_VIS_MATRIX_MAX) {
+		Com_Debug("%s: %d clusters exceeds CM_VIS_MATRIX_MAX\n", world->bsp.name, num_clusters);
+		return;
+	}
+
+	matrix->num_clusters = num_clusters;
+	matrix->row_size = row_size;
+
+	for (int32_t i = 0; i < 2; i++) {
+		matrix->rows[i] = Mem_Malloc(num_clusters * row_size);
+		matrix->state[i] = Mem_Malloc(num_clusters * sizeof(SDL_atomic_t));
+	}
+
+	matrix->empty = Mem_Malloc(row_size);
+
+	matrix->thread = Thread_Create(Cm_BuildVisMatrix, world);
+}
+
+/*
+ * @brief Stops populating and frees the decompressed visibility matrix.
+ */
+void Cm_ShutdownVisMatrix(cm_world_t *world) {
+
+	cm_vis_matrix_t *matrix = &world->vis_matrix;
+
+	SDL_AtomicSet(&matrix->cancel, 1);
+	Thread_Wait(matrix->thread);
+
+	if (matrix->empty) {
+		for (int32_t i = 0; i < 2; i++) {
+			Mem_Free(matrix->rows[i]);
+			Mem_Free(matrix->state[i]);
+		}
+
+		Mem_Free(matrix->empty);
+	}
+
+	memset(matrix, 0, sizeof(*matrix));
+}
+
+/*
+ * @brief Writes the row of the specified visibility set for the given cluster.
+ */
+static size_t Cm_ClusterVis(const cm_world_t *world, const int32_t cluster, const int32_t vis,
+		byte *out) {
+
+	const cm_bsp_t *bsp = &world->bsp;
 
-	const size_t len = (cm_vis->num_clusters + 7) >> 3;
+	const size_t len = (bsp->vis->num_clusters + 7) >> 3;
+	const byte *row = Cm_ClusterVisRow(world, cluster, vis);
 
-	if (cluster == -1)
-		memset(pvs, 0, len);
+	if (row)
+		memcpy(out, row, len);
+	else if (cluster == -1)
+		memset(out, 0, len);
 	else
-		Cm_DecompressVis(cm_bsp.visibility + cm_vis->bit_offsets[cluster][DVIS_PVS], pvs);
+		Cm_DecompressVis(bsp, bsp->visibility + bsp->vis->bit_offsets[cluster][vis], out);
 
 	return len;
 }
 
 /*
- * @brief
+ * @brief Writes the PVS row for the specified cluster.
+ *
+ * @remark `pvs` must be at least `MAX_BSP_LEAFS >> 3` in length.
+ *
+ * @return The length of the row in bytes.
+ */
+size_t Cm_ClusterPVS_(const cm_world_t *world, const int32_t cluster, byte *pvs) {
+	return Cm_ClusterVis(world, cluster, DVIS_PVS, pvs);
+}
+
+/*
+ * @brief Writes the PVS row for the specified cluster of the current world.
+ */
+size_t Cm_ClusterPVS(const int32_t cluster, byte *pvs) {
+	return Cm_ClusterPVS_(cm_world, cluster, pvs);
+}
+
+/*
+ * @brief Writes the PHS row for the specified cluster.
+ *
+ * @return The length of the row in bytes.
+ */
+size_t Cm_ClusterPHS_(const cm_world_t *world, const int32_t cluster, byte *phs) {
+	return Cm_ClusterVis(world, cluster, DVIS_PHS, phs);
+}
+
+/*
+ * @brief Writes the PHS row for the specified cluster of the current world.
  */
 size_t Cm_ClusterPHS(const int32_t cluster, byte *phs) {
+	return Cm_ClusterPHS_(cm_world, cluster, phs);
+}
 
-	const size_t len = (cm_vis->num_clusters + 7) >> 3;
+/*
+ * @return The decompressed PVS row for the specified cluster, which remains
+ * valid until the world is freed. Invalid clusters see nothing. NULL is
+ * returned if the map is too large for the decompressed matrix, in which case
+ * callers should fall back to Cm_ClusterPVS.
+ */
+const byte *Cm_ClusterPVSRow_(const cm_world_t *world, const int32_t cluster) {
+	return Cm_ClusterVisRow(world, cluster, DVIS_PVS);
+}
 
-	if (cluster == -1)
-		memset(phs, 0, len);
-	else
-		Cm_DecompressVis(cm_bsp.visibility + cm_vis->bit_offsets[cluster][DVIS_PHS], phs);
+/*
+ * @return The decompressed PVS row for the specified cluster of the current
+ * world, or NULL.
+ */
+const byte *Cm_ClusterPVSRow(const int32_t cluster) {
+	return Cm_ClusterPVSRow_(cm_world, cluster);
+}
 
-	return len;
+/*
+ * @return The decompressed PHS row for the specified cluster, or NULL.
+ * @see Cm_ClusterPVSRow_
+ */
+const byte *Cm_ClusterPHSRow_(const cm_world_t *world, const int32_t cluster) {
+	return Cm_ClusterVisRow(world, cluster, DVIS_PHS);
+}
+
+/*
+ * @return The decompressed PHS row for the specified cluster of the current
+ * world, or NULL.
+ */
+const byte *Cm_ClusterPHSRow(const int32_t cluster) {
+	return Cm_ClusterPHSRow_(cm_world, cluster);
+}
+
+/*
+ * @return True if the specified bit of the given cluster's row is set.
+ */
+static _Bool Cm_ClustersVis(const cm_world_t *world, const int32_t cluster1,
+		const int32_t cluster2, const int32_t vis) {
+
+	const cm_bsp_t *bsp = &world->bsp;
+
+	if (cluster1 < 0 || cluster1 >= bsp->vis->num_clusters) {
+		return false;
+	}
+
+	if (cluster2 < 0 || cluster2 >= bsp->vis->num_clusters) {
+		return false;
+	}
+
+	const byte *row = Cm_ClusterVisRow(world, cluster1, vis);
+
+	if (row) {
+		return row[cluster2 >> 3] & (1 << (cluster2 & 7));
+	}
+
+	return Cm_CompressedVisBit(bsp, bsp->visibility + bsp->vis->bit_offsets[cluster1][vis], cluster2);
+}
+
+/*
+ * @return True if cluster2 is in the PVS of cluster1, without decompressing
+ * a row into the caller's memory.
+ */
+_Bool Cm_ClustersVisible_(const cm_world_t *world, const int32_t cluster1, const int32_t cluster2) {
+	return Cm_ClustersVis(world, cluster1, cluster2, DVIS_PVS);
+}
+
+/*
+ * @return True if cluster2 is in the PVS of cluster1 in the current world.
+ */
+_Bool Cm_ClustersVisible(const int32_t cluster1, const int32_t cluster2) {
+	return Cm_ClustersVisible_(cm_world, cluster1, cluster2);
+}
+
+/*
+ * @return True if cluster2 is in the PHS of cluster1.
+ */
+_Bool Cm_ClustersHearable_(const cm_world_t *world, const int32_t cluster1, const int32_t cluster2) {
+	return Cm_ClustersVis(world, cluster1, cluster2, DVIS_PHS);
+}
+
+/*
+ * @return True if cluster2 is in the PHS of cluster1 in the current world.
+ */
+_Bool Cm_ClustersHearable(const int32_t cluster1, const int32_t cluster2) {
+	return Cm_ClustersHearable_(cm_world, cluster1, cluster2);
+}
+
+/*
+ * @brief Merges `len` bytes of the `in` vector into `out`, a word at a time.
+ */
+void Cm_VisOr(byte *out, const byte *in, const size_t len) {
+	size_t i;
+
+	for (i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+		memcpy(&a, out + i, sizeof(a));
+		memcpy(&b, in + i, sizeof(b));
+		a |= b;
+		memcpy(out + i, &a, sizeof(a));
+	}
+
+	for (; i < len; i++) {
+		out[i] |= in[i];
+	}
+}
+
+/*
+ * @brief Intersects `len` bytes of the `out` vector with `in`, a word at a time.
+ */
+void Cm_VisAnd(byte *out, const byte *in, const size_t len) {
+	size_t i;
+
+	for (i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+		memcpy(&a, out + i, sizeof(a));
+		memcpy(&b, in + i, sizeof(b));
+		a &= b;
+		memcpy(out + i, &a, sizeof(a));
+	}
+
+	for (; i < len; i++) {
+		out[i] &= in[i];
+	}
+}
+
+/*
+ * @return True if the vectors have any bit in common within `len` bytes.
+ */
+_Bool Cm_VisIntersects(const byte *a, const byte *b, const size_t len) {
+	size_t i;
+
+	for (i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t x, y;
+		memcpy(&x, a + i, sizeof(x));
+		memcpy(&y, b + i, sizeof(y));
+		if (x & y) {
+			return true;
+		}
+	}
+
+	for (; i < len; i++) {
+		if (a[i] & b[i]) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 /*
  * @brief Recurse over the area portals, marking adjacent ones as flooded.
  */
-static void Cm_FloodArea(cm_bsp_area_t *area, int32_t flood_num) {
+static void Cm_FloodArea(cm_bsp_t *bsp, cm_bsp_area_t *area, int32_t flood_num) {
 
-	if (area->flood_valid == cm_bsp.flood_valid) {
+	if (area->flood_valid == bsp->flood_valid) {
 		if (area->flood_num == flood_num)
 			return;
 
@@ -104,13 +444,13 @@ static void Cm_FloodArea(cm_bsp_area_t *area, int32_t flood_num) {
 	}
 
 	area->flood_num = flood_num;
-	area->flood_valid = cm_bsp.flood_valid;
+	area->flood_valid = bsp->flood_valid;
 
-	const d_bsp_area_portal_t *p = &cm_bsp.area_portals[area->first_area_portal];
+	const d_bsp_area_portal_t *p = &bsp->area_portals[area->first_area_portal];
 
 	for (int32_t i = 0; i < area->num_area_portals; i++, p++) {
-		if (cm_bsp.portal_open[p->portal_num]) {
-			Cm_FloodArea(&cm_bsp.areas[p->other_area], flood_num);
+		if (bsp->portal_open[p->portal_num]) {
+			Cm_FloodArea(bsp, &bsp->areas[p->other_area], flood_num);
 		}
 	}
 }
@@ -118,20 +458,21 @@ static void Cm_FloodArea(cm_bsp_area_t *area, int32_t flood_num) {
 /*
  * @brief
  */
-void Cm_FloodAreas(void) {
+void Cm_FloodAreas(cm_world_t *world) {
+	cm_bsp_t *bsp = &world->bsp;
 	int32_t flood_num;
 
 	// all current floods are now invalid
-	cm_bsp.flood_valid++;
+	bsp->flood_valid++;
 
 	// area 0 is not used
-	for (int32_t i = flood_num = 1; i < cm_bsp.num_areas; i++) {
-		cm_bsp_area_t *area = &cm_bsp.areas[i];
+	for (int32_t i = flood_num = 1; i < bsp->num_areas; i++) {
+		cm_bsp_area_t *area = &bsp->areas[i];
 
-		if (area->flood_valid == cm_bsp.flood_valid)
+		if (area->flood_valid == bsp->flood_valid)
 			continue; // already flooded into
 
-		Cm_FloodArea(area, flood_num++);
+		Cm_FloodArea(bsp, area, flood_num++);
 	}
 }
 
@@ -140,52 +481,70 @@ void Cm_FloodAreas(void) {
  * connections, updating their flood counts such that Cm_WriteAreaBits
  * will return the correct information.
  */
-void Cm_SetAreaPortalState(const int32_t portal_num, const _Bool open) {
+void Cm_SetAreaPortalState_(cm_world_t *world, const int32_t portal_num, const _Bool open) {
 
-	if (portal_num > cm_bsp.num_area_portals) {
-		Com_Error(ERR_DROP, "Portal %d > num_area_portals", portal_num);
+	if (portal_num < 0 || portal_num >= world->bsp.num_area_portals) {
+		Com_Error(ERR_DROP, "Portal %d >= num_area_portals", portal_num);
 	}
 
-	cm_bsp.portal_open[portal_num] = open;
-	Cm_FloodAreas();
+	world->bsp.portal_open[portal_num] = open;
+	Cm_FloodAreas(world);
+}
+
+/*
+ * @brief Sets the state of the specified area portal of the current world.
+ */
+void Cm_SetAreaPortalState(const int32_t portal_num, const _Bool open) {
+	Cm_SetAreaPortalState_(cm_world, portal_num, open);
 }
 
 /*
  * @brief Returns true if the specified areas are connected.
  */
-_Bool Cm_AreasConnected(int32_t area1, int32_t area2) {
+_Bool Cm_AreasConnected_(const cm_world_t *world, int32_t area1, int32_t area2) {
 
 	if (cm_no_areas)
 		return true;
 
-	if (area1 > cm_bsp.num_areas || area2 > cm_bsp.num_areas) {
-		Com_Error(ERR_DROP, "Area %d > cm.num_areas\n", area1 > area2 ? area1 : area2);
+	const cm_bsp_t *bsp = &world->bsp;
+
+	if (area1 < 0 || area1 >= bsp->num_areas || area2 < 0 || area2 >= bsp->num_areas) {
+		Com_Error(ERR_DROP, "Area %d >= cm.num_areas\n", area1 > area2 ? area1 : area2);
 	}
 
-	if (cm_bsp.areas[area1].flood_num == cm_bsp.areas[area2].flood_num)
+	if (bsp->areas[area1].flood_num == bsp->areas[area2].flood_num)
 		return true;
 
 	return false;
 }
 
+/*
+ * @brief Returns true if the specified areas of the current world are connected.
+ */
+_Bool Cm_AreasConnected(int32_t area1, int32_t area2) {
+	return Cm_AreasConnected_(cm_world, area1, area2);
+}
+
 /*
  * @brief Writes a bit vector of all the areas that are in the same flood as the
  * specified area. Returns the length of the bit vector in bytes.
  *
  * This is used by the client view to cull visibility.
  */
-int32_t Cm_WriteAreaBits(const int32_t area, byte *out) {
+int32_t Cm_WriteAreaBits_(const cm_world_t *world, const int32_t area, byte *out) {
 
-	const int32_t bytes = (cm_bsp.num_areas + 7) >> 3;
+	const cm_bsp_t *bsp = &world->bsp;
+
+	const int32_t bytes = (bsp->num_areas + 7) >> 3;
 
 	if (cm_no_areas) { // for debugging, send everything
 		memset(out, 0xff, bytes);
 	} else {
-		const int32_t flood_num = cm_bsp.areas[area].flood_num;
+		const int32_t flood_num = bsp->areas[area].flood_num;
 		memset(out, 0, bytes);
 
-		for (int32_t i = 0; i < cm_bsp.num_areas; i++) {
-			if (cm_bsp.areas[i].flood_num == flood_num || !area) {
+		for (int32_t i = 0; i < bsp->num_areas; i++) {
+			if (bsp->areas[i].flood_num == flood_num || !area) {
 				out[i >> 3] |= 1 << (i & 7);
 			}
 		}
@@ -194,16 +553,24 @@ int32_t Cm_WriteAreaBits(const int32_t area, byte *out) {
 	return bytes;
 }
 
+/*
+ * @brief Writes a bit vector of the areas of the current world in the same
+ * flood as the specified area.
+ */
+int32_t Cm_WriteAreaBits(const int32_t area, byte *out) {
+	return Cm_WriteAreaBits_(cm_world, area, out);
+}
+
 /*
  * @brief Returns true if any leaf under head_node has a cluster that
  * is potentially visible.
  */
-_Bool Cm_HeadnodeVisible(const int32_t node_num, const byte *vis) {
+_Bool Cm_HeadnodeVisible_(const cm_world_t *world, const int32_t node_num, const byte *vis) {
 	const cm_bsp_node_t *node;
 
 	if (node_num < 0) { // at a leaf, check it
 		const int32_t leaf_num = -1 - node_num;
-		const int32_t cluster = cm_bsp.leafs[leaf_num].cluster;
+		const int32_t cluster = world->bsp.leafs[leaf_num].cluster;
 
 		if (cluster == -1)
 			return false;
@@ -214,10 +581,18 @@ _Bool Cm_HeadnodeVisible(const int32_t node_num, const byte *vis) {
 		return false;
 	}
 
-	node = &cm_bsp.nodes[node_num];
+	node = &world->bsp.nodes[node_num];
 
-	if (Cm_HeadnodeVisible(node->children[0], vis))
+	if (Cm_HeadnodeVisible_(world, node->children[0], vis))
 		return true;
 
-	return Cm_HeadnodeVisible(node->children[1], vis);
+	return Cm_HeadnodeVisible_(world, node->children[1], vis);
+}
+
+/*
+ * @brief Returns true if any leaf of the current world under head_node has a
+ * cluster that is potentially visible.
+ */
+_Bool Cm_HeadnodeVisible(const int32_t node_num, const byte *vis) {
+	return Cm_HeadnodeVisible_(cm_world, node_num, vis);
 }
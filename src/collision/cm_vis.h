@@ -24,8 +24,29 @@
 
 #include "cm_types.h"
 
+size_t Cm_ClusterPVS_(const cm_world_t *world, const int32_t cluster, byte *pvs);
+size_t Cm_ClusterPHS_(const cm_world_t *world, const int32_t cluster, byte *phs);
+const byte *Cm_ClusterPVSRow_(const cm_world_t *world, const int32_t cluster);
+const byte *Cm_ClusterPHSRow_(const cm_world_t *world, const int32_t cluster);
+_Bool Cm_ClustersVisible_(const cm_world_t *world, const int32_t cluster1, const int32_t cluster2);
+_Bool Cm_ClustersHearable_(const cm_world_t *world, const int32_t cluster1, const int32_t cluster2);
+
+void Cm_SetAreaPortalState_(cm_world_t *world, const int32_t portal_num, const _Bool open);
+_Bool Cm_AreasConnected_(const cm_world_t *world, const int32_t area1, const int32_t area2);
+
+int32_t Cm_WriteAreaBits_(const cm_world_t *world, const int32_t area, byte *out);
+_Bool Cm_HeadnodeVisible_(const cm_world_t *world, const int32_t head_node, const byte *vis);
+
 size_t Cm_ClusterPVS(const int32_t cluster, byte *pvs);
 size_t Cm_ClusterPHS(const int32_t cluster, byte *phs);
+const byte *Cm_ClusterPVSRow(const int32_t cluster);
+const byte *Cm_ClusterPHSRow(const int32_t cluster);
+_Bool Cm_ClustersVisible(const int32_t cluster1, const int32_t cluster2);
+_Bool Cm_ClustersHearable(const int32_t cluster1, const int32_t cluster2);
+
+void Cm_VisOr(byte *out, const byte *in, const size_t len);
+void Cm_VisAnd(byte *out, const byte *in, const size_t len);
+_Bool Cm_VisIntersects(const byte *a, const byte *b, const size_t len);
 
 void Cm_SetAreaPortalState(const int32_t portal_num, const _Bool open);
 _Bool Cm_AreasConnected(const int32_t area1, const int32_t area2);
@@ -34,7 +55,30 @@ int32_t Cm_WriteAreaBits(const int32_t area, byte *out);
 _Bool Cm_HeadnodeVisible(const int32_t head_node, const byte *vis);
 
 #ifdef __CM_LOCAL_H__
-void Cm_FloodAreas(void);
+
+#include "thread.h"
+
+/*
+ * @brief The decompressed visibility matrix holds a PVS and a PHS row for each
+ * cluster, padded to whole words for Cm_VisOr and friends. A job started at
+ * load time decompresses every row, so that hot callers rarely need to.
+ */
+typedef struct {
+	int32_t num_clusters;
+	size_t row_size;
+
+	byte *rows[2]; // DVIS_PVS and DVIS_PHS, num_clusters rows of row_size bytes
+	SDL_atomic_t *state[2]; // cm_vis_state_t for each row
+
+	byte *empty; // for the invalid cluster
+
+	SDL_atomic_t cancel;
+	thread_t *thread;
+} cm_vis_matrix_t;
+
+void Cm_FloodAreas(cm_world_t *world);
+void Cm_InitVisMatrix(cm_world_t *world);
+void Cm_ShutdownVisMatrix(cm_world_t *world);
 #endif /* __CM_LOCAL_H__ */
 
 #endif /* __CM_VIS_H__ */
@@ -140,7 +140,7 @@ void Com_Print(const char *fmt, ...) {
  * @brief Prints a warning message.
  */
 void Com_Warn_(const char *func, const char *fmt, ...) {
-	static char msg[MAX_PRINT_MSG];
+	char msg[MAX_PRINT_MSG];
 
 	if (fmt[0] != '!') {
 		g_snprintf(msg, sizeof(msg), "%s: ", func);
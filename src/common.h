@@ -41,7 +41,14 @@
  * of core net messages or serialized data types change. The game and client
  * game maintain PROTOCOL_MINOR as well.
  */
-#define PROTOCOL_MAJOR		1013
+#define PROTOCOL_MAJOR		1014
+
+/*
+ * @brief The previous protocol major, which differs only in that packet entities
+ * are byte aligned rather than bit packed. Servers and clients continue to
+ * accept it, so that older clients may connect and older demos may be played.
+ */
+#define PROTOCOL_MAJOR_LEGACY	1013
 
 /*
  * @brief The IP address of the master server, where the authoritative list of
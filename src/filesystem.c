@@ -21,11 +21,89 @@
 
 #include <sys/stat.h>
 #include <physfs.h>
+#include <SDL2/SDL_mutex.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "filesystem.h"
+#include "thread.h"
 
 #define FS_FILE_BUFFER (1024 * 1024 * 2)
 
+/*
+ * @brief Stored archive entries are only referenced in place when their data
+ * is suitably aligned. On x86, unaligned access is permitted.
+ */
+#if defined(__i386__) || defined(__x86_64__)
+#define FS_MAP_ALIGN 1
+#else
+#define FS_MAP_ALIGN 8
+#endif
+
+/*
+ * @brief An entry within a memory-mapped archive.
+ */
+typedef struct {
+	char name[MAX_QPATH];
+	size_t offset; // offset of the entry's data within the archive
+	size_t size;
+	_Bool stored; // the entry is uncompressed, and may be referenced in place
+} fs_archive_entry_t;
+
+/*
+ * @brief A memory-mapped archive, used to serve stored (uncompressed) entries
+ * to Fs_Map without copying them, and to enumerate its entries for the index.
+ */
+typedef struct {
+	char path[MAX_OS_PATH];
+	byte *base;
+	size_t size;
+	GHashTable *entries; // fs_archive_entry_t, keyed by name
+	uint32_t refs; // outstanding Fs_Map buffers referencing this archive
+} fs_archive_t;
+
+typedef enum {
+	FS_MAP_FILE, // a loose file, mapped in its entirety
+	FS_MAP_ARCHIVE, // a stored entry, referenced in place within an archive
+	FS_MAP_LOAD // a buffer read with Fs_Load
+} fs_map_type_t;
+
+/*
+ * @brief The maximum number of asynchronous loads which may be read
+ * concurrently. Remaining requests wait in the queue, by priority.
+ */
+#define FS_ASYNC_MAX_IN_FLIGHT 4
+
+/*
+ * @brief An asynchronous load request.
+ */
+typedef struct {
+	char filename[MAX_QPATH];
+	int32_t priority;
+	Fs_LoadAsyncFunc callback;
+	void *data;
+	void *buffer;
+	int64_t len;
+	_Bool failed; // the file exists, but could not be read
+} fs_async_t;
+
+/*
+ * @brief A buffer returned by Fs_Map.
+ */
+typedef struct {
+	fs_map_type_t type;
+	void *base;
+	size_t size;
+	fs_archive_t *archive;
+	uint32_t refs;
+	char filename[MAX_QPATH];
+} fs_mapping_t;
+
 typedef struct fs_state_s {
 
 	/*
@@ -54,10 +132,287 @@ typedef struct fs_state_s {
 	 * they are freed (Fs_Free) in all code paths.
 	 */
 	GHashTable *loaded_files;
+
+	/*
+	 * @brief Archives mapped on behalf of Fs_Map, keyed by their real path.
+	 * Archives which can not be mapped are retained with a NULL base.
+	 */
+	GHashTable *archives;
+
+	/*
+	 * @brief All buffers returned by Fs_Map, resolving to their fs_mapping_t.
+	 */
+	GHashTable *mapped_files;
+
+	/*
+	 * @brief The file index, resolving every file on the search path to its
+	 * real directory. It is rebuilt lazily when the search path changes.
+	 */
+	struct {
+		GHashTable *files; // real directories, keyed by file name
+		GHashTable *misses; // the negative cache, names known not to exist
+		GStringChunk *strings; // interned keys of the above, cleared on rebuild
+		GStringChunk *dirs; // interned real directories, which are never released
+		_Bool dirty;
+	} index;
+
+	/*
+	 * @brief Guards the above tables, as files may be loaded from any thread.
+	 */
+	SDL_mutex *lock;
+
+	/*
+	 * @brief The asynchronous load queue. Requests are read by jobs on the
+	 * thread pool, and are completed on the calling thread by Fs_PollAsync.
+	 */
+	struct {
+		SDL_mutex *lock;
+		GQueue pending; // fs_async_t awaiting a read, by descending priority
+		GQueue completed; // fs_async_t awaiting their callback
+		uint32_t in_flight; // jobs currently reading
+		thread_counter_t counter;
+	} async;
 } fs_state_t;
 
 static fs_state_t fs_state;
 
+#define FS_INDEX_MAX_DEPTH 32
+
+static fs_archive_t *Fs_LoadArchive(const char *path);
+
+/*
+ * @brief Adds the specified file to the index, unless a search path of higher
+ * precedence has already provided it.
+ */
+static void Fs_IndexFile(const char *filename, const char *real_dir) {
+
+	if (g_hash_table_lookup(fs_state.index.files, filename) == NULL) {
+		g_hash_table_insert(fs_state.index.files,
+				g_string_chunk_insert(fs_state.index.strings, filename), (gpointer) real_dir);
+	}
+}
+
+/*
+ * @brief Recursively adds the files within the specified directory of a
+ * search path directory to the index.
+ */
+static void Fs_IndexDirectory(const char *real_dir, const char *dir, uint32_t depth) {
+	char path[MAX_OS_PATH];
+
+	if (depth == FS_INDEX_MAX_DEPTH) {
+		Com_Warn("%s: Maximum depth exceeded\n", dir);
+		return;
+	}
+
+	g_snprintf(path, sizeof(path), "%s"G_DIR_SEPARATOR_S"%s", real_dir, dir);
+
+	GDir *d = g_dir_open(path, 0, NULL);
+	if (d == NULL) {
+		return;
+	}
+
+	const char *name;
+	while ((name = g_dir_read_name(d))) {
+		char filename[MAX_OS_PATH];
+
+		if (depth) {
+			g_snprintf(filename, sizeof(filename), "%s/%s", dir, name);
+		} else {
+			g_strlcpy(filename, name, sizeof(filename));
+		}
+
+		g_snprintf(path, sizeof(path), "%s"G_DIR_SEPARATOR_S"%s", real_dir, filename);
+
+		if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+			Fs_IndexDirectory(real_dir, filename, depth + 1);
+		} else {
+			Fs_IndexFile(filename, real_dir);
+		}
+	}
+
+	g_dir_close(d);
+}
+
+/*
+ * @brief Adds the entries of the specified search path archive to the index.
+ *
+ * @return True if the archive was enumerated, false if it is not supported.
+ */
+static _Bool Fs_IndexArchive(const char *real_dir) {
+
+	fs_archive_t *archive = Fs_LoadArchive(real_dir);
+	if (archive == NULL) {
+		return false;
+	}
+
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init(&iter, archive->entries);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		Fs_IndexFile((const char *) key, real_dir);
+	}
+
+	return true;
+}
+
+/*
+ * @brief Recursively adds the files within the specified directory to the
+ * index, resolving each through PhysFS. This is only used when an archive
+ * on the search path can not be enumerated directly.
+ */
+static void Fs_BuildIndex_(const char *dir, uint32_t depth) {
+
+	if (depth == FS_INDEX_MAX_DEPTH) {
+		Com_Warn("%s: Maximum depth exceeded\n", dir);
+		return;
+	}
+
+	char **files = PHYSFS_enumerateFiles(dir);
+	for (char **f = files; *f; f++) {
+		char path[MAX_OS_PATH];
+
+		if (depth) {
+			g_snprintf(path, sizeof(path), "%s/%s", dir, *f);
+		} else {
+			g_strlcpy(path, *f, sizeof(path));
+		}
+
+		if (PHYSFS_isDirectory(path)) {
+			Fs_BuildIndex_(path, depth + 1);
+			continue;
+		}
+
+		const char *real_dir = PHYSFS_getRealDir(path);
+		if (real_dir) {
+			Fs_IndexFile(path, g_string_chunk_insert_const(fs_state.index.dirs, real_dir));
+		}
+	}
+
+	PHYSFS_freeList(files);
+}
+
+/*
+ * @brief Rebuilds the file index and clears the negative cache. Each search
+ * path is enumerated in order of precedence, so that every file resolves to
+ * the first search path which provides it. The caller must hold fs_state.lock.
+ */
+static void Fs_BuildIndex(void) {
+
+	g_hash_table_remove_all(fs_state.index.files);
+	g_hash_table_remove_all(fs_state.index.misses);
+
+	g_string_chunk_clear(fs_state.index.strings);
+
+	_Bool enumerated = true;
+
+	char **paths = PHYSFS_getSearchPath();
+	for (char **path = paths; *path && enumerated; path++) {
+		const char *real_dir = g_string_chunk_insert_const(fs_state.index.dirs, *path);
+
+		if (g_file_test(real_dir, G_FILE_TEST_IS_DIR)) {
+			Fs_IndexDirectory(real_dir, "", 0);
+		} else {
+			enumerated = Fs_IndexArchive(real_dir);
+		}
+	}
+
+	PHYSFS_freeList(paths);
+
+	if (!enumerated) {
+		Com_Debug("Indexing the search path through PhysFS\n");
+
+		g_hash_table_remove_all(fs_state.index.files);
+		Fs_BuildIndex_("/", 0);
+	}
+
+	Com_Debug("Indexed %u files\n", g_hash_table_size(fs_state.index.files));
+
+	fs_state.index.dirty = false;
+}
+
+/*
+ * @brief Resolves the real directory of the specified file through the index.
+ * Files absent from the index (e.g. directories) are resolved by PhysFS once,
+ * and the result is cached, so that repeated probes for missing files are
+ * answered without walking the search path. The returned directory remains
+ * valid even after the index is rebuilt.
+ *
+ * @return The real directory of the file, or NULL if it does not exist.
+ */
+static const char *Fs_Lookup(const char *filename) {
+
+	while (*filename == '/') {
+		filename++;
+	}
+
+	SDL_LockMutex(fs_state.lock);
+
+	if (fs_state.index.dirty) {
+		Fs_BuildIndex();
+	}
+
+	const char *real_dir = g_hash_table_lookup(fs_state.index.files, filename);
+	if (real_dir == NULL && !g_hash_table_lookup(fs_state.index.misses, filename)) {
+
+		const char *key = g_string_chunk_insert(fs_state.index.strings, filename);
+
+		if ((real_dir = PHYSFS_getRealDir(filename))) {
+			real_dir = g_string_chunk_insert_const(fs_state.index.dirs, real_dir);
+			g_hash_table_insert(fs_state.index.files, (gpointer) key, (gpointer) real_dir);
+		} else {
+			g_hash_table_insert(fs_state.index.misses, (gpointer) key, (gpointer) key);
+		}
+	}
+
+	SDL_UnlockMutex(fs_state.lock);
+
+	return real_dir;
+}
+
+/*
+ * @brief Evicts the specified file, and each of its parent directories, from
+ * the index after it has been created, written, renamed or removed. They will
+ * be resolved by PhysFS on their next lookup.
+ */
+static void Fs_Invalidate(const char *filename) {
+	char path[MAX_OS_PATH];
+
+	while (*filename == '/') {
+		filename++;
+	}
+
+	g_strlcpy(path, filename, sizeof(path));
+
+	SDL_LockMutex(fs_state.lock);
+
+	while (*path) {
+		g_hash_table_remove(fs_state.index.files, path);
+		g_hash_table_remove(fs_state.index.misses, path);
+
+		char *c = strrchr(path, '/');
+		if (c == NULL) {
+			break;
+		}
+
+		*c = '\0';
+	}
+
+	SDL_UnlockMutex(fs_state.lock);
+}
+
+/*
+ * @brief Marks the index for rebuild, after the search path has changed.
+ */
+static void Fs_InvalidateIndex(void) {
+
+	SDL_LockMutex(fs_state.lock);
+
+	fs_state.index.dirty = true;
+
+	SDL_UnlockMutex(fs_state.lock);
+}
+
 /*
  * @brief Closes the file.
  *
@@ -78,7 +433,7 @@ _Bool Fs_Eof(file_t *file) {
  * @return True if the specified filename exists on the search path.
  */
 _Bool Fs_Exists(const char *filename) {
-	return PHYSFS_exists(filename) ? true : false;
+	return Fs_Lookup(filename) != NULL;
 }
 
 /*
@@ -99,6 +454,9 @@ const char *Fs_LastError(void) {
  * @brief Creates the specified directory (and any ancestors) in Fs_WriteDir.
  */
 _Bool Fs_Mkdir(const char *dir) {
+
+	Fs_Invalidate(dir);
+
 	return PHYSFS_mkdir(dir) ? true : false;
 }
 
@@ -112,6 +470,8 @@ file_t *Fs_OpenAppend(const char *filename) {
 	Dirname(filename, dir);
 	Fs_Mkdir(dir);
 
+	Fs_Invalidate(filename);
+
 	if ((file = PHYSFS_openAppend(filename))) {
 		if (!PHYSFS_setBuffer(file, FS_FILE_BUFFER)) {
 			Com_Warn("%s: %s\n", filename, Fs_LastError());
@@ -127,6 +487,10 @@ file_t *Fs_OpenAppend(const char *filename) {
 file_t *Fs_OpenRead(const char *filename) {
 	PHYSFS_File *file;
 
+	if (!Fs_Exists(filename)) {
+		return NULL;
+	}
+
 	if ((file = PHYSFS_openRead(filename))) {
 		if (!PHYSFS_setBuffer(file, FS_FILE_BUFFER)) {
 			Com_Warn("%s: %s\n", filename, Fs_LastError());
@@ -146,6 +510,8 @@ file_t *Fs_OpenWrite(const char *filename) {
 	Dirname(filename, dir);
 	Fs_Mkdir(dir);
 
+	Fs_Invalidate(filename);
+
 	if ((file = PHYSFS_openWrite(filename))) {
 		if (!PHYSFS_setBuffer(file, FS_FILE_BUFFER)) {
 			Com_Warn("%s: %s\n", filename, Fs_LastError());
@@ -220,6 +586,13 @@ int64_t Fs_Tell(file_t *file) {
 	return PHYSFS_tell((PHYSFS_File *) file);
 }
 
+/*
+ * @return The length of the open file, or -1 if it can not be determined.
+ */
+int64_t Fs_Length(file_t *file) {
+	return PHYSFS_fileLength((PHYSFS_File *) file);
+}
+
 /*
  * @brief Writes to the specified file.
  *
@@ -230,13 +603,13 @@ int64_t Fs_Write(file_t *file, const void *buffer, size_t size, size_t count) {
 }
 
 /*
- * @brief Loads the specified file into the given buffer, which is automatically
- * allocated if non-NULL. Returns the file length, or -1 if it is unable to be
- * read. Be sure to free the buffer when finished with Fs_Free.
+ * @brief Loads the specified file into the given buffer, without raising an
+ * error. This is safe to call from any thread. If the file exists but can not
+ * be read, the buffer is released and `failed` is set.
  *
  * @return The file length, or -1 on error.
  */
-int64_t Fs_Load(const char *filename, void **buffer) {
+static int64_t Fs_Load_(const char *filename, void **buffer, _Bool *failed) {
 	int64_t len;
 
 	typedef struct {
@@ -244,8 +617,39 @@ int64_t Fs_Load(const char *filename, void **buffer) {
 		int64_t len;
 	} fs_block_t;
 
+	*failed = false;
+
+	if (buffer) {
+		*buffer = NULL;
+	}
+
 	file_t *file;
 	if ((file = Fs_OpenRead(filename))) {
+		len = PHYSFS_fileLength((PHYSFS_File *) file);
+
+		// when the length is known, read the file in one shot into a buffer of exact size
+		if (len >= 0) {
+			if (buffer && len > 0) {
+				*buffer = Mem_Malloc(len + 1);
+
+				if (Fs_Read(file, *buffer, 1, len) != len) {
+					Mem_Free(*buffer);
+					*buffer = NULL;
+
+					*failed = true;
+					len = -1;
+				} else {
+					SDL_LockMutex(fs_state.lock);
+					g_hash_table_insert(fs_state.loaded_files, *buffer,
+							(gpointer) Mem_CopyString(filename));
+					SDL_UnlockMutex(fs_state.lock);
+				}
+			}
+
+			Fs_Close(file);
+			return len;
+		}
+
 		GList *list = NULL;
 		len = 0;
 
@@ -259,43 +663,60 @@ int64_t Fs_Load(const char *filename, void **buffer) {
 			b->data = Mem_LinkMalloc(FS_FILE_BUFFER, b);
 			b->len = Fs_Read(file, b->data, 1, FS_FILE_BUFFER);
 
+			list = g_list_append(list, b);
+
 			if (b->len == -1) {
-				Com_Error(ERR_DROP, "%s: %s\n", filename, Fs_LastError());
+				*failed = true;
+				break;
 			}
 
-			list = g_list_append(list, b);
 			len += b->len;
 		}
 
-		if (buffer) {
-			if (len > 0) {
-				byte *buf = *buffer = Mem_Malloc(len + 1);
+		if (*failed) {
+			len = -1;
+		} else if (buffer && len > 0) {
+			byte *buf = *buffer = Mem_Malloc(len + 1);
 
-				GList *e = list;
-				while (e) {
-					fs_block_t *b = (fs_block_t *) e->data;
+			GList *e = list;
+			while (e) {
+				fs_block_t *b = (fs_block_t *) e->data;
 
-					memcpy(buf, b->data, b->len);
-					buf += (ptrdiff_t) b->len;
+				memcpy(buf, b->data, b->len);
+				buf += (ptrdiff_t) b->len;
 
-					e = e->next;
-				}
-
-				g_hash_table_insert(fs_state.loaded_files, *buffer,
-						(gpointer) Mem_CopyString(filename));
-			} else {
-				*buffer = NULL;
+				e = e->next;
 			}
+
+			SDL_LockMutex(fs_state.lock);
+			g_hash_table_insert(fs_state.loaded_files, *buffer,
+					(gpointer) Mem_CopyString(filename));
+			SDL_UnlockMutex(fs_state.lock);
 		}
 
 		g_list_free_full(list, Mem_Free);
 		Fs_Close(file);
 	} else {
 		len = -1;
+	}
 
-		if (buffer) {
-			*buffer = NULL;
-		}
+	return len;
+}
+
+/*
+ * @brief Loads the specified file into the given buffer, which is automatically
+ * allocated if non-NULL. Returns the file length, or -1 if it is unable to be
+ * read. Be sure to free the buffer when finished with Fs_Free.
+ *
+ * @return The file length, or -1 on error.
+ */
+int64_t Fs_Load(const char *filename, void **buffer) {
+	_Bool failed;
+
+	const int64_t len = Fs_Load_(filename, buffer, &failed);
+
+	if (failed) {
+		Com_Error(ERR_DROP, "%s: %s\n", filename, Fs_LastError());
 	}
 
 	return len;
@@ -307,13 +728,541 @@ int64_t Fs_Load(const char *filename, void **buffer) {
 void Fs_Free(void *buffer) {
 
 	if (buffer) {
+		SDL_LockMutex(fs_state.lock);
+
 		if (!g_hash_table_remove(fs_state.loaded_files, buffer)) {
 			Com_Warn("Invalid buffer\n");
 		}
+
+		SDL_UnlockMutex(fs_state.lock);
+
 		Mem_Free(buffer);
 	}
 }
 
+/*
+ * @brief Maps the file at the specified system path into memory, read-only.
+ *
+ * @return The mapped region, or NULL if the file could not be mapped.
+ */
+static void *Fs_MapRegion(const char *path, size_t *size) {
+	void *base = NULL;
+
+#if !defined(_WIN32)
+	const int32_t fd = open(path, O_RDONLY);
+	if (fd != -1) {
+		struct stat s;
+
+		if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode) && s.st_size > 0) {
+			base = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (base == MAP_FAILED) {
+				Com_Debug("%s: %s\n", path, strerror(errno));
+				base = NULL;
+			} else {
+				*size = s.st_size;
+			}
+		}
+
+		close(fd);
+	}
+#endif
+
+	return base;
+}
+
+/*
+ * @brief Releases a region mapped with Fs_MapRegion.
+ */
+static void Fs_UnmapRegion(void *base, size_t size) {
+
+#if !defined(_WIN32)
+	if (base) {
+		munmap(base, size);
+	}
+#endif
+}
+
+/*
+ * @return The little-endian 16 bit integer at the specified (unaligned) address.
+ */
+static uint32_t Fs_ArchiveShort(const byte *b) {
+	return b[0] | (b[1] << 8);
+}
+
+/*
+ * @return The little-endian 32 bit integer at the specified (unaligned) address.
+ */
+static uint32_t Fs_ArchiveLong(const byte *b) {
+	return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+}
+
+/*
+ * @brief Adds the named entry to the archive index. Entries which are not
+ * stored are indexed by name only.
+ */
+static void Fs_AddArchiveEntry(fs_archive_t *archive, const byte *name, size_t name_len,
+		size_t offset, size_t size, _Bool stored) {
+
+	if (name_len == 0 || name_len >= MAX_QPATH || name[name_len - 1] == '/') {
+		return;
+	}
+
+	if (stored && (offset > archive->size || size > archive->size - offset)) {
+		stored = false;
+	}
+
+	fs_archive_entry_t *entry = Mem_Malloc(sizeof(*entry));
+
+	memcpy(entry->name, name, name_len);
+
+	if (stored) {
+		entry->offset = offset;
+		entry->size = size;
+		entry->stored = true;
+	}
+
+	g_hash_table_replace(archive->entries, entry->name, entry);
+}
+
+#define ZIP_END_SIGNATURE 0x06054b50
+#define ZIP_END_SIZE 22
+#define ZIP_CENTRAL_SIGNATURE 0x02014b50
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIGNATURE 0x04034b50
+#define ZIP_LOCAL_SIZE 30
+
+/*
+ * @brief Indexes the entries of a .pk3 archive by walking its central
+ * directory. Only stored (uncompressed, unencrypted) entries may be referenced
+ * in place, so compressed entries are indexed by name only.
+ */
+static _Bool Fs_IndexPk3(fs_archive_t *archive) {
+	const byte *end = NULL;
+
+	if (archive->size < ZIP_END_SIZE) {
+		return false;
+	}
+
+	// the end of central directory record is followed by a comment of up to 64k
+	size_t ofs = archive->size - ZIP_END_SIZE;
+	const size_t min = ofs > 0xffff ? ofs - 0xffff : 0;
+
+	while (true) {
+		if (Fs_ArchiveLong(archive->base + ofs) == ZIP_END_SIGNATURE) {
+			end = archive->base + ofs;
+			break;
+		}
+		if (ofs == min) {
+			return false;
+		}
+		ofs--;
+	}
+
+	const uint32_t count = Fs_ArchiveShort(end + 10);
+	ofs = Fs_ArchiveLong(end + 16);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		if (ofs > archive->size - ZIP_CENTRAL_SIZE) {
+			return false;
+		}
+
+		const byte *central = archive->base + ofs;
+		if (Fs_ArchiveLong(central) != ZIP_CENTRAL_SIGNATURE) {
+			return false;
+		}
+
+		const uint32_t flags = Fs_ArchiveShort(central + 8);
+		const uint32_t method = Fs_ArchiveShort(central + 10);
+		const uint32_t compressed_size = Fs_ArchiveLong(central + 20);
+		const uint32_t size = Fs_ArchiveLong(central + 24);
+		const uint32_t name_len = Fs_ArchiveShort(central + 28);
+		const uint32_t extra_len = Fs_ArchiveShort(central + 30);
+		const uint32_t comment_len = Fs_ArchiveShort(central + 32);
+		const size_t local = Fs_ArchiveLong(central + 42);
+
+		if (ofs + ZIP_CENTRAL_SIZE + name_len > archive->size) {
+			return false;
+		}
+
+		ofs += ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len;
+
+		const byte *name = central + ZIP_CENTRAL_SIZE;
+
+		if (method != 0 || (flags & 1) || compressed_size != size) {
+			Fs_AddArchiveEntry(archive, name, name_len, 0, 0, false);
+			continue;
+		}
+
+		if (local > archive->size - ZIP_LOCAL_SIZE) {
+			Fs_AddArchiveEntry(archive, name, name_len, 0, 0, false);
+			continue;
+		}
+
+		// the local header's name and extra field lengths may differ from the central directory
+		const byte *header = archive->base + local;
+		if (Fs_ArchiveLong(header) != ZIP_LOCAL_SIGNATURE) {
+			Fs_AddArchiveEntry(archive, name, name_len, 0, 0, false);
+			continue;
+		}
+
+		const size_t data = local + ZIP_LOCAL_SIZE + Fs_ArchiveShort(header + 26)
+				+ Fs_ArchiveShort(header + 28);
+
+		Fs_AddArchiveEntry(archive, name, name_len, data, size, true);
+	}
+
+	return true;
+}
+
+#define PAK_HEADER_SIZE 12
+#define PAK_ENTRY_SIZE 64
+#define PAK_NAME_SIZE 56
+
+/*
+ * @brief Indexes the entries of a .pak archive, all of which are stored.
+ */
+static _Bool Fs_IndexPak(fs_archive_t *archive) {
+
+	if (archive->size < PAK_HEADER_SIZE || memcmp(archive->base, "PACK", 4)) {
+		return false;
+	}
+
+	const size_t ofs = Fs_ArchiveLong(archive->base + 4);
+	const size_t len = Fs_ArchiveLong(archive->base + 8);
+
+	if (ofs > archive->size || len > archive->size - ofs) {
+		return false;
+	}
+
+	for (size_t i = 0; i < len / PAK_ENTRY_SIZE; i++) {
+		const byte *entry = archive->base + ofs + i * PAK_ENTRY_SIZE;
+
+		const size_t name_len = strnlen((const char *) entry, PAK_NAME_SIZE);
+
+		Fs_AddArchiveEntry(archive, entry, name_len, Fs_ArchiveLong(entry + PAK_NAME_SIZE),
+				Fs_ArchiveLong(entry + PAK_NAME_SIZE + 4), true);
+	}
+
+	return true;
+}
+
+/*
+ * @brief GDestroyNotify for fs_state.archives.
+ */
+static void Fs_FreeArchive(gpointer data) {
+	fs_archive_t *archive = (fs_archive_t *) data;
+
+	if (archive->refs) {
+		Com_Warn("%s: %u mapped entries\n", archive->path, archive->refs);
+	}
+
+	Fs_UnmapRegion(archive->base, archive->size);
+	g_hash_table_destroy(archive->entries);
+
+	Mem_Free(archive);
+}
+
+/*
+ * @brief Resolves the archive at the specified system path, mapping and
+ * indexing it on first use.
+ *
+ * @return The archive, or NULL if it could not be mapped or is not supported.
+ */
+static fs_archive_t *Fs_LoadArchive(const char *path) {
+
+	fs_archive_t *archive = g_hash_table_lookup(fs_state.archives, path);
+	if (archive == NULL) {
+		archive = Mem_Malloc(sizeof(*archive));
+
+		g_strlcpy(archive->path, path, sizeof(archive->path));
+		archive->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, Mem_Free);
+
+		g_hash_table_insert(fs_state.archives, archive->path, archive);
+
+		if ((archive->base = Fs_MapRegion(path, &archive->size))) {
+			_Bool indexed = false;
+
+			if (g_str_has_suffix(path, ".pk3")) {
+				indexed = Fs_IndexPk3(archive);
+			} else if (g_str_has_suffix(path, ".pak")) {
+				indexed = Fs_IndexPak(archive);
+			}
+
+			if (!indexed) {
+				Com_Debug("Failed to index %s\n", path);
+
+				g_hash_table_remove_all(archive->entries);
+				Fs_UnmapRegion(archive->base, archive->size);
+
+				archive->base = NULL;
+				archive->size = 0;
+			} else {
+				Com_Debug("Mapped %s: %u entries\n", path,
+						g_hash_table_size(archive->entries));
+			}
+		}
+	}
+
+	return archive->base ? archive : NULL;
+}
+
+/*
+ * @brief Maps the specified file into memory for read-only access, avoiding
+ * copies wherever possible. Loose files are memory-mapped, and stored
+ * (uncompressed) archive entries are referenced in place. All other files are
+ * read into a buffer of exact size. The returned buffer is not NULL-terminated,
+ * and must be released with Fs_Unmap.
+ *
+ * @return The file length, or -1 on error.
+ */
+int64_t Fs_Map(const char *filename, const void **buffer) {
+
+	*buffer = NULL;
+
+	const char *dir = Fs_RealDir(filename);
+	if (dir == NULL) {
+		return -1;
+	}
+
+	fs_mapping_t *mapping = NULL;
+	struct stat s;
+
+	if (stat(dir, &s) == 0) {
+		if (S_ISDIR(s.st_mode)) {
+			char path[MAX_OS_PATH];
+			size_t size;
+
+			g_snprintf(path, sizeof(path), "%s"G_DIR_SEPARATOR_S"%s", dir, filename);
+
+			void *base = Fs_MapRegion(path, &size);
+			if (base) {
+				mapping = Mem_Malloc(sizeof(*mapping));
+
+				mapping->type = FS_MAP_FILE;
+				mapping->base = base;
+				mapping->size = size;
+			}
+		} else {
+			SDL_LockMutex(fs_state.lock);
+
+			fs_archive_t *archive = Fs_LoadArchive(dir);
+			if (archive) {
+				const char *name = filename;
+				while (*name == '/') {
+					name++;
+				}
+
+				const fs_archive_entry_t *entry = g_hash_table_lookup(archive->entries, name);
+				if (entry && entry->stored && entry->size && (entry->offset % FS_MAP_ALIGN) == 0) {
+					void *base = archive->base + entry->offset;
+
+					// repeated requests for the same entry resolve to the same address
+					if ((mapping = g_hash_table_lookup(fs_state.mapped_files, base))) {
+						mapping->refs++;
+						SDL_UnlockMutex(fs_state.lock);
+
+						*buffer = base;
+						return mapping->size;
+					}
+
+					mapping = Mem_Malloc(sizeof(*mapping));
+
+					mapping->type = FS_MAP_ARCHIVE;
+					mapping->base = base;
+					mapping->size = entry->size;
+					mapping->archive = archive;
+
+					archive->refs++;
+				}
+			}
+
+			SDL_UnlockMutex(fs_state.lock);
+		}
+	}
+
+	if (mapping == NULL) {
+		void *buf;
+
+		const int64_t len = Fs_Load(filename, &buf);
+		if (len <= 0) {
+			return len;
+		}
+
+		mapping = Mem_Malloc(sizeof(*mapping));
+
+		mapping->type = FS_MAP_LOAD;
+		mapping->base = buf;
+		mapping->size = len;
+	}
+
+	mapping->refs = 1;
+	g_strlcpy(mapping->filename, filename, sizeof(mapping->filename));
+
+	SDL_LockMutex(fs_state.lock);
+	g_hash_table_insert(fs_state.mapped_files, mapping->base, mapping);
+	SDL_UnlockMutex(fs_state.lock);
+
+	*buffer = mapping->base;
+	return mapping->size;
+}
+
+/*
+ * @brief Releases the specified buffer returned by Fs_Map.
+ */
+void Fs_Unmap(const void *buffer) {
+
+	if (buffer) {
+		SDL_LockMutex(fs_state.lock);
+
+		fs_mapping_t *mapping = g_hash_table_lookup(fs_state.mapped_files, buffer);
+		if (mapping == NULL) {
+			Com_Warn("Invalid buffer\n");
+			SDL_UnlockMutex(fs_state.lock);
+			return;
+		}
+
+		if (--mapping->refs) {
+			SDL_UnlockMutex(fs_state.lock);
+			return;
+		}
+
+		switch (mapping->type) {
+			case FS_MAP_FILE:
+				Fs_UnmapRegion(mapping->base, mapping->size);
+				break;
+			case FS_MAP_ARCHIVE:
+				mapping->archive->refs--;
+				break;
+			case FS_MAP_LOAD:
+				Fs_Free(mapping->base);
+				break;
+		}
+
+		g_hash_table_remove(fs_state.mapped_files, buffer);
+
+		SDL_UnlockMutex(fs_state.lock);
+	}
+}
+
+/*
+ * @brief GCompareDataFunc for the asynchronous queue, ordering requests by
+ * descending priority. Requests of equal priority are serviced in order.
+ */
+static gint Fs_LoadAsync_compare(gconstpointer queued, gconstpointer req,
+		gpointer data __attribute__((unused))) {
+	return ((const fs_async_t *) req)->priority > ((const fs_async_t *) queued)->priority ? 1 : -1;
+}
+
+/*
+ * @brief ThreadRunFunc for asynchronous loads. Each job reads pending requests,
+ * highest priority first, until the queue is drained.
+ */
+static void Fs_LoadAsync_(void *data __attribute__((unused))) {
+
+	while (true) {
+		SDL_LockMutex(fs_state.async.lock);
+
+		fs_async_t *req = g_queue_pop_head(&fs_state.async.pending);
+		if (req == NULL) {
+			fs_state.async.in_flight--;
+			SDL_UnlockMutex(fs_state.async.lock);
+			break;
+		}
+
+		SDL_UnlockMutex(fs_state.async.lock);
+
+		// Com_Error must not be raised from a worker, so failures are reported by Fs_PollAsync
+		req->len = Fs_Load_(req->filename, &req->buffer, &req->failed);
+
+		SDL_LockMutex(fs_state.async.lock);
+		g_queue_push_tail(&fs_state.async.completed, req);
+		SDL_UnlockMutex(fs_state.async.lock);
+	}
+}
+
+/*
+ * @brief Queues the specified file to be loaded on the thread pool. Requests of
+ * higher priority are read first, and no more than FS_ASYNC_MAX_IN_FLIGHT are
+ * read at once. The callback is invoked from Fs_PollAsync or Fs_WaitAsync on
+ * the polling thread, and owns the buffer, which must be freed with Fs_Free.
+ * This allows callers to issue all of their loads up front, and decode each
+ * file while the remaining ones are read.
+ */
+void Fs_LoadAsync(const char *filename, int32_t priority, Fs_LoadAsyncFunc callback, void *data) {
+
+	fs_async_t *req = Mem_Malloc(sizeof(*req));
+
+	g_strlcpy(req->filename, filename, sizeof(req->filename));
+	req->priority = priority;
+	req->callback = callback;
+	req->data = data;
+
+	SDL_LockMutex(fs_state.async.lock);
+
+	g_queue_insert_sorted(&fs_state.async.pending, req, Fs_LoadAsync_compare, NULL);
+
+	const _Bool dispatch = fs_state.async.in_flight < FS_ASYNC_MAX_IN_FLIGHT;
+	if (dispatch) {
+		fs_state.async.in_flight++;
+	}
+
+	SDL_UnlockMutex(fs_state.async.lock);
+
+	// without workers, the job runs immediately, and so must not hold the lock
+	if (dispatch) {
+		Thread_Submit(Fs_LoadAsync_, NULL, &fs_state.async.counter);
+	}
+}
+
+/*
+ * @brief Invokes the callbacks of all completed asynchronous loads on the
+ * calling thread.
+ *
+ * @return The number of asynchronous loads still outstanding.
+ */
+uint32_t Fs_PollAsync(void) {
+
+	SDL_LockMutex(fs_state.async.lock);
+
+	GQueue completed = fs_state.async.completed;
+	g_queue_init(&fs_state.async.completed);
+
+	SDL_UnlockMutex(fs_state.async.lock);
+
+	fs_async_t *req;
+	while ((req = g_queue_pop_head(&completed))) {
+
+		if (req->failed) {
+			Com_Warn("Failed to read %s\n", req->filename);
+		}
+
+		req->callback(req->filename, req->buffer, req->len, req->data);
+		Mem_Free(req);
+	}
+
+	SDL_LockMutex(fs_state.async.lock);
+
+	const uint32_t outstanding = fs_state.async.in_flight
+			+ g_queue_get_length(&fs_state.async.pending)
+			+ g_queue_get_length(&fs_state.async.completed);
+
+	SDL_UnlockMutex(fs_state.async.lock);
+
+	return outstanding;
+}
+
+/*
+ * @brief Completes all asynchronous loads, including those issued by callbacks.
+ * The calling thread assists with reads while it waits.
+ */
+void Fs_WaitAsync(void) {
+
+	while (Fs_PollAsync()) {
+		Thread_WaitAll(&fs_state.async.counter);
+	}
+}
+
 /*
  * @brief Renames the specified source to the given destination.
  */
@@ -323,7 +1272,12 @@ _Bool Fs_Rename(const char *source, const char *dest) {
 	const char *src = va("%s"G_DIR_SEPARATOR_S"%s", dir, source);
 	const char *dst = va("%s"G_DIR_SEPARATOR_S"%s", dir, dest);
 
-	return rename(src, dst) == 0;
+	const _Bool renamed = rename(src, dst) == 0;
+
+	Fs_Invalidate(source);
+	Fs_Invalidate(dest);
+
+	return renamed;
 }
 
 /*
@@ -332,7 +1286,11 @@ _Bool Fs_Rename(const char *source, const char *dest) {
 _Bool Fs_Unlink(const char *filename) {
 
 	if (!g_strcmp0(Fs_WriteDir(), Fs_RealDir(filename))) {
-		return unlink(filename) == 0;
+		const _Bool unlinked = unlink(filename) == 0;
+
+		Fs_Invalidate(filename);
+
+		return unlinked;
 	}
 
 	return false;
@@ -425,6 +1383,8 @@ void Fs_AddToSearchPath(const char *dir) {
 			return;
 		}
 
+		Fs_InvalidateIndex();
+
 		if (fs_state.auto_load_archives && is_dir) {
 			Fs_Enumerate("*.pak", Fs_AddToSearchPath_enumerate, (void *) dir);
 			Fs_Enumerate("*.pk3", Fs_AddToSearchPath_enumerate, (void *) dir);
@@ -441,7 +1401,8 @@ void Fs_AddToSearchPath(const char *dir) {
 static void Fs_AddToSearchPath_enumerate(const char *path, void *data) {
 	const char *dir = (const char *) data;
 
-	if (!g_strcmp0(Fs_RealDir(path), dir)) {
+	// consult PhysFS directly, as the index is invalidated by each new archive
+	if (!g_strcmp0(PHYSFS_getRealDir(path), dir)) {
 		Fs_AddToSearchPath(va("%s%s", dir, path));
 	}
 }
@@ -465,6 +1426,14 @@ static void Fs_AddUserSearchPath(const char *dir) {
 	Fs_SetWriteDir(path);
 }
 
+/*
+ * @brief GHRFunc for Fs_SetGame, releasing unreferenced archives.
+ */
+static gboolean Fs_SetGame_archives(gpointer key __attribute__((unused)), gpointer value,
+		gpointer data __attribute__((unused))) {
+	return ((fs_archive_t *) value)->refs == 0;
+}
+
 /*
  * @brief Sets the game path to a relative directory.
  */
@@ -502,6 +1471,13 @@ void Fs_SetGame(const char *dir) {
 
 	PHYSFS_freeList(paths);
 
+	Fs_InvalidateIndex();
+
+	// and release any mapped archives which are no longer referenced
+	SDL_LockMutex(fs_state.lock);
+	g_hash_table_foreach_remove(fs_state.archives, Fs_SetGame_archives, NULL);
+	SDL_UnlockMutex(fs_state.lock);
+
 	// now add new entries for the new game
 	Fs_AddToSearchPath(va(PKGLIBDIR G_DIR_SEPARATOR_S "%s", dir));
 	Fs_AddToSearchPath(va(PKGDATADIR G_DIR_SEPARATOR_S "%s", dir));
@@ -543,7 +1519,7 @@ const char *Fs_WriteDir(void) {
  * @brief Returns the real directory name of the specified file.
  */
 const char *Fs_RealDir(const char *filename) {
-	return PHYSFS_getRealDir(filename);
+	return Fs_Lookup(filename);
 }
 
 /*
@@ -578,6 +1554,14 @@ void Fs_Init(_Bool auto_load_archives) {
 
 	memset(&fs_state, 0, sizeof(fs_state_t));
 
+	fs_state.lock = SDL_CreateMutex();
+
+	fs_state.index.files = g_hash_table_new(g_str_hash, g_str_equal);
+	fs_state.index.misses = g_hash_table_new(g_str_hash, g_str_equal);
+	fs_state.index.strings = g_string_chunk_new(0x10000);
+	fs_state.index.dirs = g_string_chunk_new(0x1000);
+	fs_state.index.dirty = true;
+
 	if (PHYSFS_init(Com_Argv(0)) == 0) {
 		Com_Error(ERR_FATAL, "%s\n", PHYSFS_getLastError());
 	}
@@ -659,6 +1643,13 @@ void Fs_Init(_Bool auto_load_archives) {
 	fs_state.base_search_paths = PHYSFS_getSearchPath();
 
 	fs_state.loaded_files = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, Mem_Free);
+
+	fs_state.archives = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, Fs_FreeArchive);
+	fs_state.mapped_files = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, Mem_Free);
+
+	fs_state.async.lock = SDL_CreateMutex();
+	g_queue_init(&fs_state.async.pending);
+	g_queue_init(&fs_state.async.completed);
 }
 
 /*
@@ -668,14 +1659,44 @@ static void Fs_LoadedFiles_(gpointer key, gpointer value, gpointer data __attrib
 	Com_Print("Fs_PrintLoadedFiles: %s @ %p\n", (char *) value, key);
 }
 
+/*
+ * @brief Prints the names of mapped (i.e. yet-to-be-unmapped) files.
+ */
+static void Fs_MappedFiles_(gpointer key, gpointer value, gpointer data __attribute__((unused))) {
+	Com_Print("Fs_PrintMappedFiles: %s @ %p\n", ((fs_mapping_t *) value)->filename, key);
+}
+
 /*
  * @brief Shuts down the filesystem.
  */
 void Fs_Shutdown(void) {
 
+	// outstanding loads are completed, but their callbacks are not invoked
+	Thread_WaitAll(&fs_state.async.counter);
+
+	fs_async_t *req;
+	while ((req = g_queue_pop_head(&fs_state.async.completed))) {
+		Fs_Free(req->buffer);
+		Mem_Free(req);
+	}
+
+	SDL_DestroyMutex(fs_state.async.lock);
+
+	g_hash_table_foreach(fs_state.mapped_files, Fs_MappedFiles_, NULL);
+	g_hash_table_destroy(fs_state.mapped_files);
+
 	g_hash_table_foreach(fs_state.loaded_files, Fs_LoadedFiles_, NULL);
 	g_hash_table_destroy(fs_state.loaded_files);
 
+	g_hash_table_destroy(fs_state.archives);
+
+	g_hash_table_destroy(fs_state.index.files);
+	g_hash_table_destroy(fs_state.index.misses);
+	g_string_chunk_free(fs_state.index.strings);
+	g_string_chunk_free(fs_state.index.dirs);
+
+	SDL_DestroyMutex(fs_state.lock);
+
 	PHYSFS_freeList(fs_state.base_search_paths);
 
 	PHYSFS_deinit();
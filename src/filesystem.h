@@ -32,6 +32,12 @@ typedef struct {
 
 typedef void (*Fs_EnumerateFunc)(const char *path, void *data);
 
+/*
+ * @brief Invoked when an asynchronous load completes. The length is -1 if the
+ * file could not be read. The buffer, if any, must be freed with Fs_Free.
+ */
+typedef void (*Fs_LoadAsyncFunc)(const char *filename, void *buffer, int64_t len, void *data);
+
 _Bool Fs_Close(file_t *file);
 _Bool Fs_Eof(file_t *file);
 _Bool Fs_Exists(const char *filename);
@@ -46,9 +52,15 @@ int64_t Fs_Read(file_t *file, void *buffer, size_t size, size_t count);
 _Bool Fs_ReadLine(file_t *file, char *buffer, size_t len);
 _Bool Fs_Seek(file_t *file, size_t offset);
 int64_t Fs_Tell(file_t *file);
+int64_t Fs_Length(file_t *file);
 int64_t Fs_Write(file_t *file, const void *buffer, size_t size, size_t count);
 int64_t Fs_Load(const char *filename, void **buffer);
 void Fs_Free(void *buffer);
+int64_t Fs_Map(const char *filename, const void **buffer);
+void Fs_Unmap(const void *buffer);
+void Fs_LoadAsync(const char *filename, int32_t priority, Fs_LoadAsyncFunc callback, void *data);
+uint32_t Fs_PollAsync(void);
+void Fs_WaitAsync(void);
 _Bool Fs_Rename(const char *source, const char *dest);
 _Bool Fs_Unlink(const char *filename);
 void Fs_Enumerate(const char *pattern, Fs_EnumerateFunc, void *data);
@@ -118,6 +118,32 @@ static void Quit_f(void) {
 	Com_Shutdown("Server quit\n");
 }
 
+/*
+ * @brief Prints managed memory statistics, by tag.
+ */
+static void Mem_Stats_f(void) {
+	static const char *tags[MEM_TAG_TOTAL] = {
+		"default", "server", "ai", "game", "game_level", "client",
+		"renderer", "sound", "ui", "cgame", "cgame_level"
+	};
+	mem_stats_t stats;
+	mem_tag_t t;
+
+	Mem_Stats(&stats);
+
+	Com_Print("%-12s %8s %10s %10s %10s\n", "tag", "blocks", "kb", "peak kb", "allocs");
+
+	for (t = 0; t < MEM_TAG_TOTAL; t++) {
+		const mem_tag_stats_t *s = &stats.tags[t];
+
+		Com_Print("%-12s %8u %10u %10u %10u\n", tags[t], s->count, (uint32_t) (s->size >> 10),
+				(uint32_t) (s->peak >> 10), s->allocations);
+	}
+
+	Com_Print("%u kb total, %u kb reserved for small blocks\n", (uint32_t) (Mem_Size() >> 10),
+			(uint32_t) (stats.arena_size >> 10));
+}
+
 /*
  * @brief
  */
@@ -138,10 +164,6 @@ static void Init(void) {
 		Cvar_ForceSet("dedicated", "1");
 	}
 
-	if (dedicated->value) {
-		Cvar_ForceSet("threads", "0");
-	}
-
 	game = Cvar_Get("game", DEFAULT_GAME, CVAR_LATCH | CVAR_SERVER_INFO, "The game module name");
 	game->modified = g_strcmp0(game->string, DEFAULT_GAME);
 
@@ -159,6 +181,7 @@ static void Init(void) {
 	Con_Init();
 
 	Cmd_Add("quit", Quit_f, CMD_SYSTEM, "Quit Quetoo");
+	Cmd_Add("mem_stats", Mem_Stats_f, CMD_SYSTEM, "Print managed memory statistics");
 
 	Netchan_Init();
 
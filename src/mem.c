@@ -20,6 +20,7 @@
  */
 
 #include <signal.h>
+#include <SDL2/SDL_atomic.h>
 #include <SDL2/SDL_thread.h>
 
 #include "mem.h"
@@ -27,22 +28,125 @@
 #define MEM_MAGIC 0x69
 typedef byte mem_magic_t;
 
+/*
+ * @brief Managed blocks are kept on intrusive, doubly-linked lists: top-level
+ * blocks on their tag's bucket, and linked blocks on their parent's children.
+ * This allows any block to be unlinked in constant time. The header is padded
+ * so that the memory following it is aligned as malloc's would be.
+ */
 typedef struct mem_block_s {
 	mem_magic_t magic;
 	mem_tag_t tag; // for group free
 	struct mem_block_s *parent;
-	GList *children;
+	struct mem_block_s *children;
+	struct mem_block_s *prev, *next;
 	size_t size;
-} mem_block_t;
+	int32_t size_class; // -1 for blocks allocated from the heap
+} __attribute__((aligned(16))) mem_block_t;
+
+/*
+ * @brief Small blocks are carved from slabs by size class. Sizes include the
+ * block header.
+ */
+static const size_t mem_class_sizes[] = {
+	64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+#define MEM_CLASSES lengthof(mem_class_sizes)
+
+/*
+ * @brief Slabs are bump-allocated from chunks of this size.
+ */
+#define MEM_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * @brief Thread caches refill from, and flush to, the shared free lists in
+ * batches of this many blocks.
+ */
+#define MEM_CACHE_BATCH 32
+#define MEM_CACHE_MAX (MEM_CACHE_BATCH * 8)
+
+/*
+ * @brief Children lists are guarded by a striped set of locks, hashed by the
+ * parent's address.
+ */
+#define MEM_LINK_LOCKS 64
+
+/*
+ * @brief Frame arenas grow in chunks of at least this size.
+ */
+#define MEM_FRAME_CHUNK_SIZE (64 * 1024)
 
+typedef struct mem_chunk_s {
+	struct mem_chunk_s *next;
+	size_t used;
+} mem_chunk_t;
+
+typedef struct mem_frame_chunk_s {
+	struct mem_frame_chunk_s *next;
+	size_t size, used;
+} __attribute__((aligned(16))) mem_frame_chunk_t;
+
+/*
+ * @brief A linear arena for per-frame temporaries. The arena is reset when its
+ * tag's frame number advances.
+ */
 typedef struct {
-	GHashTable *blocks;
-	size_t size;
-	SDL_mutex *lock;
+	uint32_t frame;
+	mem_frame_chunk_t *chunks;
+} mem_frame_t;
+
+/*
+ * @brief Each thread caches free blocks of each size class, so that most small
+ * allocations require no synchronization at all. Each thread also owns one
+ * frame arena per tag.
+ */
+typedef struct {
+	uint32_t generation;
+	mem_block_t *blocks[MEM_CLASSES];
+	uint32_t count[MEM_CLASSES];
+	mem_frame_t frames[MEM_TAG_TOTAL];
+} mem_cache_t;
+
+typedef struct {
+	SDL_SpinLock lock;
+	mem_block_t *blocks;
+} mem_class_t;
+
+typedef struct {
+	SDL_SpinLock lock;
+	mem_block_t *blocks;
+	mem_tag_stats_t stats;
+} mem_bucket_t;
+
+typedef struct {
+	mem_bucket_t tags[MEM_TAG_TOTAL];
+	SDL_SpinLock links[MEM_LINK_LOCKS];
+
+	mem_class_t classes[MEM_CLASSES];
+
+	SDL_SpinLock arena_lock;
+	mem_chunk_t *chunks;
+	size_t arena_size;
+
+	SDL_atomic_t frames[MEM_TAG_TOTAL];
+
+	uint32_t generation;
 } mem_state_t;
 
 static mem_state_t mem_state;
 
+/*
+ * @brief Incremented on each Mem_Init so that thread caches populated before a
+ * shutdown are discarded rather than reused.
+ */
+static uint32_t mem_generation;
+
+/*
+ * @brief Thread-local storage for mem_cache_t.
+ */
+static SDL_TLSID mem_cache;
+
 /*
  * @brief Throws a fatal error if the specified memory block is non-NULL but
  * not owned by the memory subsystem.
@@ -63,19 +167,352 @@ static mem_block_t *Mem_CheckMagic(void *p) {
 }
 
 /*
- * @brief Recursively frees linked managed memory.
+ * @return The bucket for the specified tag.
+ */
+static mem_bucket_t *Mem_Bucket(mem_tag_t tag) {
+
+	if (tag < 0 || tag >= MEM_TAG_TOTAL) {
+		fprintf(stderr, "Invalid tag (%d)\n", tag);
+		raise(SIGABRT);
+	}
+
+	return &mem_state.tags[tag];
+}
+
+/*
+ * @return The lock guarding the children of the specified parent.
+ */
+static SDL_SpinLock *Mem_LinkLock(const mem_block_t *parent) {
+	return &mem_state.links[(((uintptr_t) parent) >> 6) % MEM_LINK_LOCKS];
+}
+
+/*
+ * @brief Inserts the block at the head of the specified list.
+ */
+static void Mem_InsertBlock(mem_block_t **list, mem_block_t *b) {
+
+	b->prev = NULL;
+	b->next = *list;
+
+	if (*list) {
+		(*list)->prev = b;
+	}
+
+	*list = b;
+}
+
+/*
+ * @brief Removes the block from the specified list.
+ */
+static void Mem_RemoveBlock(mem_block_t **list, mem_block_t *b) {
+
+	if (b->prev) {
+		b->prev->next = b->next;
+	} else {
+		*list = b->next;
+	}
+
+	if (b->next) {
+		b->next->prev = b->prev;
+	}
+
+	b->prev = b->next = NULL;
+}
+
+/*
+ * @brief Links the block into the managed memory structures: either its
+ * parent's children, or its tag's bucket.
+ */
+static void Mem_LinkBlock(mem_block_t *b) {
+
+	if (b->parent) {
+		SDL_SpinLock *lock = Mem_LinkLock(b->parent);
+
+		SDL_AtomicLock(lock);
+		Mem_InsertBlock(&b->parent->children, b);
+		SDL_AtomicUnlock(lock);
+	} else {
+		mem_bucket_t *bucket = Mem_Bucket(b->tag);
+
+		SDL_AtomicLock(&bucket->lock);
+		Mem_InsertBlock(&bucket->blocks, b);
+		SDL_AtomicUnlock(&bucket->lock);
+	}
+}
+
+/*
+ * @brief Unlinks the block from the managed memory structures.
+ */
+static void Mem_UnlinkBlock(mem_block_t *b) {
+
+	if (b->parent) {
+		SDL_SpinLock *lock = Mem_LinkLock(b->parent);
+
+		SDL_AtomicLock(lock);
+		Mem_RemoveBlock(&b->parent->children, b);
+		SDL_AtomicUnlock(lock);
+	} else {
+		mem_bucket_t *bucket = Mem_Bucket(b->tag);
+
+		SDL_AtomicLock(&bucket->lock);
+		Mem_RemoveBlock(&bucket->blocks, b);
+		SDL_AtomicUnlock(&bucket->lock);
+	}
+}
+
+/*
+ * @brief Updates the statistics of the block's tag.
+ */
+static void Mem_Account(const mem_block_t *b, _Bool alloc) {
+	mem_bucket_t *bucket = Mem_Bucket(b->tag);
+
+	SDL_AtomicLock(&bucket->lock);
+
+	if (alloc) {
+		bucket->stats.size += b->size;
+		bucket->stats.peak = MAX(bucket->stats.peak, bucket->stats.size);
+		bucket->stats.count++;
+		bucket->stats.allocations++;
+	} else {
+		bucket->stats.size -= b->size;
+		bucket->stats.count--;
+	}
+
+	SDL_AtomicUnlock(&bucket->lock);
+}
+
+/*
+ * @brief Returns free blocks from the thread cache to the shared free list.
+ */
+static void Mem_FlushCache(mem_cache_t *cache, size_t c, uint32_t count) {
+
+	if (count == 0) {
+		return;
+	}
+
+	mem_block_t *head = cache->blocks[c], *tail = head;
+	uint32_t i;
+
+	for (i = 1; i < count; i++) {
+		tail = tail->next;
+	}
+
+	cache->blocks[c] = tail->next;
+	cache->count[c] -= count;
+
+	mem_class_t *cls = &mem_state.classes[c];
+
+	SDL_AtomicLock(&cls->lock);
+
+	tail->next = cls->blocks;
+	cls->blocks = head;
+
+	SDL_AtomicUnlock(&cls->lock);
+}
+
+/*
+ * @brief Releases the chunks backing all of the thread cache's frame arenas.
+ */
+static void Mem_FreeFrames(mem_cache_t *cache) {
+	mem_tag_t t;
+
+	for (t = 0; t < MEM_TAG_TOTAL; t++) {
+		mem_frame_chunk_t *chunk = cache->frames[t].chunks;
+
+		while (chunk) {
+			mem_frame_chunk_t *next = chunk->next;
+			free(chunk);
+			chunk = next;
+		}
+
+		cache->frames[t].chunks = NULL;
+	}
+}
+
+/*
+ * @brief TLS destructor, returning an exiting thread's cache to the shared
+ * free lists.
+ */
+static void Mem_FreeCache(void *data) {
+	mem_cache_t *cache = (mem_cache_t *) data;
+
+	if (cache->generation == mem_state.generation) {
+		size_t c;
+
+		for (c = 0; c < MEM_CLASSES; c++) {
+			Mem_FlushCache(cache, c, cache->count[c]);
+		}
+	}
+
+	Mem_FreeFrames(cache);
+
+	free(cache);
+}
+
+/*
+ * @return The calling thread's cache, discarding stale contents.
+ */
+static mem_cache_t *Mem_Cache(void) {
+
+	mem_cache_t *cache = SDL_TLSGet(mem_cache);
+	if (cache == NULL) {
+
+		if (!(cache = calloc(1, sizeof(*cache)))) {
+			fprintf(stderr, "Failed to allocate thread cache\n");
+			raise(SIGABRT);
+		}
+
+		SDL_TLSSet(mem_cache, cache, Mem_FreeCache);
+	}
+
+	if (cache->generation != mem_state.generation) {
+		Mem_FreeFrames(cache);
+
+		memset(cache, 0, sizeof(*cache));
+		cache->generation = mem_state.generation;
+	}
+
+	return cache;
+}
+
+/*
+ * @brief Refills the thread cache for the given size class, first from the
+ * shared free list, and then by carving new blocks from the slab arena.
+ */
+static void Mem_RefillCache(mem_cache_t *cache, size_t c) {
+	mem_class_t *cls = &mem_state.classes[c];
+
+	SDL_AtomicLock(&cls->lock);
+
+	while (cls->blocks && cache->count[c] < MEM_CACHE_BATCH) {
+		mem_block_t *b = cls->blocks;
+		cls->blocks = b->next;
+
+		b->next = cache->blocks[c];
+		cache->blocks[c] = b;
+		cache->count[c]++;
+	}
+
+	SDL_AtomicUnlock(&cls->lock);
+
+	if (cache->count[c]) {
+		return;
+	}
+
+	const size_t size = mem_class_sizes[c];
+
+	SDL_AtomicLock(&mem_state.arena_lock);
+
+	while (cache->count[c] < MEM_CACHE_BATCH) {
+		mem_chunk_t *chunk = mem_state.chunks;
+
+		if (chunk == NULL || chunk->used + size > MEM_CHUNK_SIZE) {
+
+			if (!(chunk = malloc(MEM_CHUNK_SIZE))) {
+				fprintf(stderr, "Failed to allocate %u bytes\n", (uint32_t) MEM_CHUNK_SIZE);
+				raise(SIGABRT);
+			}
+
+			chunk->next = mem_state.chunks;
+			chunk->used = sizeof(*chunk);
+
+			mem_state.chunks = chunk;
+			mem_state.arena_size += MEM_CHUNK_SIZE;
+		}
+
+		mem_block_t *b = (mem_block_t *) (((byte *) chunk) + chunk->used);
+		chunk->used += size;
+
+		b->next = cache->blocks[c];
+		cache->blocks[c] = b;
+		cache->count[c]++;
+	}
+
+	SDL_AtomicUnlock(&mem_state.arena_lock);
+}
+
+/*
+ * @brief Allocates a zeroed block of the given total size, from the thread
+ * cache for small blocks, or from the heap for large ones.
+ */
+static mem_block_t *Mem_AllocBlock(size_t s) {
+	mem_block_t *b;
+	size_t c;
+
+	for (c = 0; c < MEM_CLASSES; c++) {
+		if (s <= mem_class_sizes[c]) {
+			break;
+		}
+	}
+
+	if (c == MEM_CLASSES) {
+		if (!(b = calloc(s, 1))) {
+			fprintf(stderr, "Failed to allocate %u bytes\n", (uint32_t) s);
+			raise(SIGABRT);
+		}
+
+		b->size_class = -1;
+		return b;
+	}
+
+	mem_cache_t *cache = Mem_Cache();
+
+	if (cache->blocks[c] == NULL) {
+		Mem_RefillCache(cache, c);
+	}
+
+	b = cache->blocks[c];
+
+	cache->blocks[c] = b->next;
+	cache->count[c]--;
+
+	memset(b, 0, s);
+
+	b->size_class = (int32_t) c;
+	return b;
+}
+
+/*
+ * @brief Releases a block to the thread cache, or to the heap.
+ */
+static void Mem_FreeBlock(mem_block_t *b) {
+
+	b->magic = 0;
+
+	if (b->size_class == -1) {
+		free(b);
+		return;
+	}
+
+	const size_t c = (size_t) b->size_class;
+	mem_cache_t *cache = Mem_Cache();
+
+	b->next = cache->blocks[c];
+	cache->blocks[c] = b;
+	cache->count[c]++;
+
+	if (cache->count[c] > MEM_CACHE_MAX) {
+		Mem_FlushCache(cache, c, MEM_CACHE_MAX / 2);
+	}
+}
+
+/*
+ * @brief Recursively frees linked managed memory. The block must already be
+ * unlinked from its parent or bucket.
  */
 static void Mem_Free_(mem_block_t *b) {
 
 	// recurse down the tree, freeing children
-	if (b->children) {
-		g_list_free_full(b->children, (GDestroyNotify) Mem_Free_);
+	mem_block_t *c = b->children;
+	while (c) {
+		mem_block_t *next = c->next;
+		Mem_Free_(c);
+		c = next;
 	}
 
-	// decrement the pool size and free the memory
-	mem_state.size -= b->size;
+	Mem_Account(b, false);
 
-	free(b);
+	Mem_FreeBlock(b);
 }
 
 /*
@@ -85,40 +522,39 @@ static void Mem_Free_(mem_block_t *b) {
 void Mem_Free(void *p) {
 	mem_block_t *b = Mem_CheckMagic(p);
 
-	SDL_mutexP(mem_state.lock);
-
-	if (b->parent) {
-		b->parent->children = g_list_remove(b->parent->children, b);
-	} else {
-		g_hash_table_remove(mem_state.blocks, (gconstpointer) b);
-	}
+	Mem_UnlinkBlock(b);
 
 	Mem_Free_(b);
-
-	SDL_mutexV(mem_state.lock);
 }
 
 /*
  * @brief Free all managed items allocated with the specified tag.
  */
 void Mem_FreeTag(mem_tag_t tag) {
-	GHashTableIter it;
-	gpointer key, value;
+	mem_tag_t t;
+
+	for (t = 0; t < MEM_TAG_TOTAL; t++) {
+
+		if (tag != MEM_TAG_ALL && tag != t) {
+			continue;
+		}
 
-	SDL_mutexP(mem_state.lock);
+		mem_bucket_t *bucket = Mem_Bucket(t);
 
-	g_hash_table_iter_init(&it, mem_state.blocks);
+		// detach the whole bucket, so that its blocks can be freed without the lock
+		SDL_AtomicLock(&bucket->lock);
 
-	while (g_hash_table_iter_next(&it, &key, &value)) {
-		mem_block_t *b = (mem_block_t *) key;
+		mem_block_t *b = bucket->blocks;
+		bucket->blocks = NULL;
 
-		if (tag == MEM_TAG_ALL || b->tag == tag) {
-			g_hash_table_iter_remove(&it);
+		SDL_AtomicUnlock(&bucket->lock);
+
+		while (b) {
+			mem_block_t *next = b->next;
 			Mem_Free_(b);
+			b = next;
 		}
 	}
-
-	SDL_mutexV(mem_state.lock);
 }
 
 /*
@@ -136,12 +572,7 @@ static void *Mem_Malloc_(size_t size, mem_tag_t tag, void *parent) {
 	mem_block_t *b, *p = Mem_CheckMagic(parent);
 
 	// allocate the block plus the desired size
-	const size_t s = size + sizeof(mem_block_t);
-
-	if (!(b = calloc(s, 1))) {
-		fprintf(stderr, "Failed to allocate %u bytes\n", (uint32_t) s);
-		raise(SIGABRT);
-	}
+	b = Mem_AllocBlock(size + sizeof(mem_block_t));
 
 	b->magic = MEM_MAGIC;
 	b->tag = tag;
@@ -149,17 +580,9 @@ static void *Mem_Malloc_(size_t size, mem_tag_t tag, void *parent) {
 	b->size = size;
 
 	// insert it into the managed memory structures
-	SDL_mutexP(mem_state.lock);
-
-	if (b->parent) {
-		b->parent->children = g_list_prepend(b->parent->children, b);
-	} else {
-		g_hash_table_insert(mem_state.blocks, b, b);
-	}
+	Mem_LinkBlock(b);
 
-	mem_state.size += size;
-
-	SDL_mutexV(mem_state.lock);
+	Mem_Account(b, true);
 
 	// return the address in front of the block
 	return (void *) (b + 1);
@@ -215,27 +638,148 @@ void *Mem_Link(void *child, void *parent) {
 	mem_block_t *c = Mem_CheckMagic(child);
 	mem_block_t *p = Mem_CheckMagic(parent);
 
-	SDL_mutexP(mem_state.lock);
-
-	if (c->parent) {
-		c->parent->children = g_list_remove(c->parent->children, c);
-	} else {
-		g_hash_table_remove(mem_state.blocks, c);
-	}
+	Mem_UnlinkBlock(c);
 
 	c->parent = p;
-	p->children = g_list_prepend(p->children, c);
 
-	SDL_mutexV(mem_state.lock);
+	Mem_LinkBlock(c);
 
 	return child;
 }
 
+/*
+ * @brief Resets the frame arena, coalescing its chunks if it grew so that the
+ * next frame is served from a single chunk.
+ */
+static void Mem_ResetFrame_(mem_frame_t *frame, uint32_t frame_num) {
+
+	frame->frame = frame_num;
+
+	mem_frame_chunk_t *chunk = frame->chunks;
+	if (chunk == NULL) {
+		return;
+	}
+
+	if (chunk->next) {
+		size_t size = 0;
+
+		while (chunk) {
+			mem_frame_chunk_t *next = chunk->next;
+			size += chunk->size;
+			free(chunk);
+			chunk = next;
+		}
+
+		if (!(chunk = malloc(sizeof(*chunk) + size))) {
+			fprintf(stderr, "Failed to allocate %u bytes\n", (uint32_t) size);
+			raise(SIGABRT);
+		}
+
+		chunk->next = NULL;
+		chunk->size = size;
+
+		frame->chunks = chunk;
+	}
+
+	chunk->used = 0;
+}
+
+/*
+ * @brief Allocates a block of temporary memory from the calling thread's frame
+ * arena for the given tag. Frame memory may not be freed individually; it is
+ * reclaimed wholesale by Mem_ResetFrame, typically at the end of a server or
+ * client frame. Each thread has its own arenas, so no locking is required.
+ *
+ * @param size The number of bytes to allocate.
+ * @param tag The tag whose frame owns the allocation (e.g. MEM_TAG_SERVER).
+ *
+ * @return A block of memory initialized to 0x0, valid until the tag's frame
+ * is reset.
+ */
+void *Mem_FrameAlloc(size_t size, mem_tag_t tag) {
+
+	Mem_Bucket(tag);
+
+	mem_frame_t *frame = &Mem_Cache()->frames[tag];
+
+	const uint32_t frame_num = (uint32_t) SDL_AtomicGet(&mem_state.frames[tag]);
+	if (frame->frame != frame_num) {
+		Mem_ResetFrame_(frame, frame_num);
+	}
+
+	size = (size + 15) & ~((size_t) 15);
+
+	mem_frame_chunk_t *chunk = frame->chunks;
+	if (chunk == NULL || chunk->used + size > chunk->size) {
+		const size_t s = MAX(size, MEM_FRAME_CHUNK_SIZE);
+
+		if (!(chunk = malloc(sizeof(*chunk) + s))) {
+			fprintf(stderr, "Failed to allocate %u bytes\n", (uint32_t) s);
+			raise(SIGABRT);
+		}
+
+		chunk->next = frame->chunks;
+		chunk->size = s;
+		chunk->used = 0;
+
+		frame->chunks = chunk;
+	}
+
+	void *p = ((byte *) (chunk + 1)) + chunk->used;
+	chunk->used += size;
+
+	memset(p, 0, size);
+	return p;
+}
+
+/*
+ * @brief Ends the current frame for the specified tag, reclaiming all frame
+ * memory allocated with it. The calling thread's arena is reset immediately,
+ * while other threads' arenas are reset upon their next allocation.
+ */
+void Mem_ResetFrame(mem_tag_t tag) {
+
+	Mem_Bucket(tag);
+
+	const uint32_t frame_num = (uint32_t) SDL_AtomicAdd(&mem_state.frames[tag], 1) + 1;
+
+	Mem_ResetFrame_(&Mem_Cache()->frames[tag], frame_num);
+}
+
 /*
  * @return The current size (user bytes) of the zone allocation pool.
  */
 size_t Mem_Size(void) {
-	return mem_state.size;
+	size_t size = 0;
+	mem_tag_t t;
+
+	for (t = 0; t < MEM_TAG_TOTAL; t++) {
+		size += mem_state.tags[t].stats.size;
+	}
+
+	return size;
+}
+
+/*
+ * @brief Populates the specified structure with a snapshot of per-tag and slab
+ * arena statistics.
+ */
+void Mem_Stats(mem_stats_t *stats) {
+	mem_tag_t t;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (t = 0; t < MEM_TAG_TOTAL; t++) {
+		mem_bucket_t *bucket = Mem_Bucket(t);
+
+		SDL_AtomicLock(&bucket->lock);
+		stats->tags[t] = bucket->stats;
+		SDL_AtomicUnlock(&bucket->lock);
+	}
+
+	SDL_AtomicLock(&mem_state.arena_lock);
+	stats->arena_size = mem_state.arena_size;
+	SDL_AtomicUnlock(&mem_state.arena_lock);
 }
 
 /*
@@ -258,9 +802,11 @@ void Mem_Init(void) {
 
 	memset(&mem_state, 0, sizeof(mem_state));
 
-	mem_state.blocks = g_hash_table_new(g_direct_hash, g_direct_equal);
+	mem_state.generation = ++mem_generation;
 
-	mem_state.lock = SDL_CreateMutex();
+	if (mem_cache == 0) {
+		mem_cache = SDL_TLSCreate();
+	}
 }
 
 /*
@@ -271,7 +817,17 @@ void Mem_Shutdown(void) {
 
 	Mem_FreeTag(MEM_TAG_ALL);
 
-	g_hash_table_destroy(mem_state.blocks);
+	mem_cache_t *cache = SDL_TLSGet(mem_cache);
+	if (cache) {
+		Mem_FreeFrames(cache);
+	}
+
+	mem_chunk_t *chunk = mem_state.chunks;
+	while (chunk) {
+		mem_chunk_t *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
 
-	SDL_DestroyMutex(mem_state.lock);
+	memset(&mem_state, 0, sizeof(mem_state));
 }
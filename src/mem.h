@@ -24,13 +24,34 @@
 
 #include "quetoo.h"
 
+/*
+ * @brief Per-tag allocation statistics.
+ */
+typedef struct {
+	size_t size; // user bytes currently allocated
+	size_t peak; // high water mark of size
+	uint32_t count; // blocks currently allocated
+	uint32_t allocations; // blocks allocated since Mem_Init
+} mem_tag_stats_t;
+
+/*
+ * @brief Managed memory statistics, as reported by the `mem_stats` command.
+ */
+typedef struct {
+	mem_tag_stats_t tags[MEM_TAG_TOTAL];
+	size_t arena_size; // bytes reserved for small block slabs
+} mem_stats_t;
+
 void Mem_Free(void *p);
 void Mem_FreeTag(mem_tag_t tag);
 void *Mem_TagMalloc(size_t size, mem_tag_t tag);
 void *Mem_LinkMalloc(size_t size, void *parent);
 void *Mem_Malloc(size_t size);
 void *Mem_Link(void *parent, void *child);
+void *Mem_FrameAlloc(size_t size, mem_tag_t tag);
+void Mem_ResetFrame(mem_tag_t tag);
 size_t Mem_Size(void);
+void Mem_Stats(mem_stats_t *stats);
 char *Mem_CopyString(const char *in);
 void Mem_Init(void);
 void Mem_Shutdown(void);
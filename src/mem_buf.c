@@ -79,3 +79,113 @@ void *Mem_AllocBuffer(mem_buf_t *buf, size_t len) {
 void Mem_WriteBuffer(mem_buf_t *buf, const void *data, size_t len) {
 	memcpy(Mem_AllocBuffer(buf, len), data, len);
 }
+
+/*
+ * @brief Begins a bit stream, for reading or writing, at the current position
+ * of the specified buffer.
+ */
+void Mem_BeginBits(mem_bits_t *bits, mem_buf_t *buf) {
+
+	bits->buf = buf;
+	bits->bits = 0;
+	bits->count = 0;
+}
+
+/*
+ * @brief Writes the low `count` bits of `value`, where count is at most 32.
+ * Whole bytes are flushed to the buffer as they accumulate.
+ */
+void Mem_WriteBits(mem_bits_t *bits, uint32_t value, uint32_t count) {
+
+	if (count == 0)
+		return;
+
+	if (count < 32)
+		value &= (1u << count) - 1;
+
+	bits->bits |= ((uint64_t) value) << bits->count;
+	bits->count += count;
+
+	while (bits->count >= 8) {
+		const byte b = bits->bits & 0xff;
+		Mem_WriteBuffer(bits->buf, &b, 1);
+
+		bits->bits >>= 8;
+		bits->count -= 8;
+	}
+}
+
+/*
+ * @brief Appends `count` bits previously packed to `data` by another bit stream.
+ */
+void Mem_CopyBits(mem_bits_t *bits, const byte *data, uint32_t count) {
+
+	while (count >= 32) {
+		Mem_WriteBits(bits, data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24), 32);
+		data += 4;
+		count -= 32;
+	}
+
+	while (count >= 8) {
+		Mem_WriteBits(bits, *data++, 8);
+		count -= 8;
+	}
+
+	if (count)
+		Mem_WriteBits(bits, *data, count);
+}
+
+/*
+ * @brief Ends a written bit stream, flushing any pending bits padded to a byte.
+ */
+void Mem_EndWriteBits(mem_bits_t *bits) {
+
+	if (bits->count) {
+		const byte b = bits->bits & 0xff;
+		Mem_WriteBuffer(bits->buf, &b, 1);
+	}
+
+	bits->bits = 0;
+	bits->count = 0;
+}
+
+/*
+ * @brief Reads `count` bits, where count is at most 32. Bytes are consumed from
+ * the buffer only as they are needed. Reading past the end of the buffer
+ * yields zeros, and advances the read position past the size of the buffer,
+ * just as reading bytes does.
+ */
+uint32_t Mem_ReadBits(mem_bits_t *bits, uint32_t count) {
+
+	if (count == 0)
+		return 0;
+
+	while (bits->count < count) {
+		mem_buf_t *buf = bits->buf;
+
+		if (buf->read < buf->size) {
+			bits->bits |= ((uint64_t) buf->data[buf->read]) << bits->count;
+		}
+
+		buf->read++;
+		bits->count += 8;
+	}
+
+	uint32_t value = (uint32_t) bits->bits;
+	if (count < 32)
+		value &= (1u << count) - 1;
+
+	bits->bits >>= count;
+	bits->count -= count;
+
+	return value;
+}
+
+/*
+ * @brief Ends a read bit stream, discarding the padding of its final byte.
+ */
+void Mem_EndReadBits(mem_bits_t *bits) {
+
+	bits->bits = 0;
+	bits->count = 0;
+}
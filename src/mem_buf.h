@@ -36,9 +36,26 @@ typedef struct {
 	size_t read;
 } mem_buf_t;
 
+/*
+ * @brief A bit stream over a mem_buf_t. Bits are packed least significant
+ * first, and the stream is padded to a byte boundary when ended, so that bit
+ * packed sections may be freely interleaved with byte aligned messages.
+ */
+typedef struct {
+	mem_buf_t *buf;
+	uint64_t bits; // pending bits, least significant first
+	uint32_t count; // number of pending bits
+} mem_bits_t;
+
 void Mem_InitBuffer(mem_buf_t *buf, byte *data, size_t len);
 void Mem_ClearBuffer(mem_buf_t *buf);
 void *Mem_AllocBuffer(mem_buf_t *buf, size_t len);
 void Mem_WriteBuffer(mem_buf_t *buf, const void *data, size_t len);
+void Mem_BeginBits(mem_bits_t *bits, mem_buf_t *buf);
+void Mem_WriteBits(mem_bits_t *bits, uint32_t value, uint32_t count);
+void Mem_CopyBits(mem_bits_t *bits, const byte *data, uint32_t count);
+void Mem_EndWriteBits(mem_bits_t *bits);
+uint32_t Mem_ReadBits(mem_bits_t *bits, uint32_t count);
+void Mem_EndReadBits(mem_bits_t *bits);
 
 #endif /* __MEM_BUF_H__ */
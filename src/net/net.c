@@ -83,12 +83,15 @@ _Bool Net_CompareClientNetaddr(const net_addr_t *a, const net_addr_t *b) {
 }
 
 /*
- * @brief
+ * @brief Formats the address into a buffer private to the calling thread, as
+ * the server's ingress thread may warn of packets it can not process.
  */
 const char *Net_NetaddrToString(const net_addr_t *a) {
-	static char s[64];
+	static __thread char s[64];
+
+	const byte *b = (const byte *) &a->addr;
 
-	g_snprintf(s, sizeof(s), "%s:%i", inet_ntoa(*(struct in_addr *) &a->addr), ntohs(a->port));
+	g_snprintf(s, sizeof(s), "%u.%u.%u.%u:%i", b[0], b[1], b[2], b[3], ntohs(a->port));
 
 	return s;
 }
@@ -19,6 +19,9 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include <zlib.h>
+
+#include "cmd.h"
 #include "cvar.h"
 #include "net_chan.h"
 
@@ -31,6 +34,7 @@
  * 31	acknowledge sequence
  * 1	acknowledge receipt of even/odd message
  * 8	qport
+ * 8	compression flags, only if negotiated
  *
  * The remote connection never knows if it missed a reliable message, the
  * local side detects that it has been dropped by seeing a sequence acknowledge
@@ -72,15 +76,527 @@
  * such as during the connection stage while waiting for the client to load,
  * then a packet only needs to be delivered if there is something in the
  * unacknowledged reliable
+ *
+ * If both ends agree at connect, every packet carries a byte of compression
+ * flags after the header, and payloads which deflate to a smaller size are
+ * sent compressed. Loopback channels never negotiate compression. A client
+ * which holds the same seed dictionary as the server, confirmed by checksum
+ * at connect, receives server data and config strings compressed against it.
+ * Once it has received the config strings, the client confirms the checksum
+ * of a dictionary built from them when requesting baselines, after which the
+ * server compresses against that instead.
+ *
+ * If both ends agree on a reliable window, the single outstanding reliable
+ * message is replaced by a stream of fragments. Every payload then begins
+ * with the next fragment sequence we expect, a mask of the fragments we hold
+ * from it, and the fragments we are sending:
+ *
+ * 16	next expected fragment sequence
+ * 32	mask of received fragments, from the next expected
+ * 8	fragment count
+ * 16	fragment sequence     \
+ * 15	fragment size          > per fragment
+ * 1	last fragment flag    /
+ *
+ * Up to NET_RELIABLE_WINDOW fragments may be in flight, and each is resent
+ * on its own timer, derived from the round trip time, until it is selectively
+ * acknowledged. The receiver buffers fragments which arrive out of order, and
+ * delivers complete reliable messages in order ahead of the unreliable data.
+ * The even/odd reliable bits in the packet header are unused.
  */
 
 static cvar_t *net_show_packets;
 static cvar_t *net_show_drop;
 
+cvar_t *net_compress;
+
 net_addr_t net_from;
 mem_buf_t net_message;
 static byte net_message_buffer[MAX_MSG_SIZE];
 
+#define NET_PACKET_DEFLATE		0x1
+#define NET_PACKET_DICTIONARY	0x2
+#define NET_PACKET_SEED			0x4
+
+/*
+ * @brief Substrings common to config strings and user info, which prime every
+ * compression dictionary. Changing this changes the seed checksum, so that
+ * mismatched builds simply do not use it.
+ */
+static const char net_dictionary_seed_strings[] =
+		"\\name\\skin\\color\\hand\\rate\\msg\\spectator\\"
+		"models/players/sounds/world/weapons/items/misc/pics/images/textures/maps/"
+		".md3.obj.bsp.pk3.wav.ogg.tga.png.jpg.pcx.wal default ";
+
+static net_dictionary_t net_dictionary_seed;
+
+/*
+ * @brief Payloads smaller than this are never worth compressing.
+ */
+#define NET_COMPRESS_THRESHOLD 64
+
+/*
+ * @brief Bounds for the fragment retransmit timer, in milliseconds.
+ */
+#define NET_RETRANSMIT_MIN 50
+#define NET_RETRANSMIT_MAX 1000
+
+/*
+ * @brief The compression state and scratch buffers are shared by all channels.
+ * Netchan_Transmit and Netchan_Process must therefore only be called from the
+ * main thread.
+ */
+static z_stream net_deflate;
+static z_stream net_inflate;
+
+static net_compress_stats_t net_compress_stats[NS_UDP_SERVER + 1];
+
+/*
+ * @brief Accumulates compression time for the given source.
+ */
+static void Netchan_CompressTime(net_src_t source, const int64_t start) {
+	net_compress_stats_t *stats = &net_compress_stats[source];
+
+	stats->usec += g_get_monotonic_time() - start;
+
+	if (stats->last_time != quetoo.time) {
+		stats->last_time = quetoo.time;
+		stats->frames++;
+	}
+}
+
+/*
+ * @brief Deflates the payload into out, if doing so makes it smaller.
+ *
+ * @return The compressed size, or 0 if the payload should be sent as is.
+ */
+static size_t Netchan_Deflate(const net_chan_t *chan, const mem_buf_t *payload, byte *out,
+		byte *flags) {
+
+	if (payload->size < NET_COMPRESS_THRESHOLD)
+		return 0;
+
+	net_compress_stats_t *stats = &net_compress_stats[chan->source];
+	const int64_t start = g_get_monotonic_time();
+
+	deflateReset(&net_deflate);
+
+	// only the server knows that the client holds the same dictionary
+	if (chan->source == NS_UDP_SERVER) {
+		if (chan->dictionary) {
+			deflateSetDictionary(&net_deflate, chan->dictionary->data, chan->dictionary->size);
+			*flags |= NET_PACKET_DICTIONARY;
+		} else if (chan->seeded) {
+			deflateSetDictionary(&net_deflate, net_dictionary_seed.data, net_dictionary_seed.size);
+			*flags |= NET_PACKET_SEED;
+		}
+	}
+
+	net_deflate.next_in = payload->data;
+	net_deflate.avail_in = payload->size;
+	net_deflate.next_out = out;
+	net_deflate.avail_out = payload->size - 1;
+
+	size_t size = 0;
+	if (deflate(&net_deflate, Z_FINISH) == Z_STREAM_END) {
+		size = payload->size - 1 - net_deflate.avail_out;
+		*flags |= NET_PACKET_DEFLATE;
+		stats->compressed++;
+	} else {
+		*flags = 0;
+	}
+
+	stats->packets++;
+	stats->bytes_in += payload->size;
+	stats->bytes_out += size ? size : payload->size;
+
+	Netchan_CompressTime(chan->source, start);
+	return size;
+}
+
+/*
+ * @brief Inflates the remainder of msg in place.
+ *
+ * @return True on success, false if the packet should be discarded.
+ */
+static _Bool Netchan_Inflate(const net_chan_t *chan, mem_buf_t *msg, const byte flags) {
+	static byte out[MAX_MSG_SIZE];
+
+	if (msg->read >= msg->size)
+		return false;
+
+	net_compress_stats_t *stats = &net_compress_stats[chan->source];
+	const int64_t start = g_get_monotonic_time();
+
+	inflateReset(&net_inflate);
+
+	if (flags & NET_PACKET_DICTIONARY) {
+		if (!chan->dictionary) {
+			Com_Debug("%s: No dictionary\n", Net_NetaddrToString(&chan->remote_address));
+			return false;
+		}
+		inflateSetDictionary(&net_inflate, chan->dictionary->data, chan->dictionary->size);
+	} else if (flags & NET_PACKET_SEED) {
+		inflateSetDictionary(&net_inflate, net_dictionary_seed.data, net_dictionary_seed.size);
+	}
+
+	net_inflate.next_in = msg->data + msg->read;
+	net_inflate.avail_in = msg->size - msg->read;
+	net_inflate.next_out = out;
+	net_inflate.avail_out = msg->max_size - msg->read;
+
+	const _Bool ok = inflate(&net_inflate, Z_FINISH) == Z_STREAM_END;
+	if (ok) {
+		const size_t size = msg->max_size - msg->read - net_inflate.avail_out;
+
+		stats->packets++;
+		stats->compressed++;
+		stats->bytes_in += size;
+		stats->bytes_out += msg->size - msg->read;
+
+		memcpy(msg->data + msg->read, out, size);
+		msg->size = msg->read + size;
+	} else {
+		Com_Debug("%s: Corrupt packet\n", Net_NetaddrToString(&chan->remote_address));
+	}
+
+	Netchan_CompressTime(chan->source, start);
+	return ok;
+}
+
+/*
+ * @brief Reads the compression flags, if negotiated, and inflates the
+ * remainder of msg in place if it was compressed.
+ *
+ * @return True on success, false if the packet should be discarded.
+ */
+static _Bool Netchan_ReadPayload(const net_chan_t *chan, mem_buf_t *msg) {
+
+	if (chan->compress) {
+		const int32_t flags = Net_ReadByte(msg);
+
+		if (flags == -1)
+			return false;
+
+		if ((flags & NET_PACKET_DEFLATE) && !Netchan_Inflate(chan, msg, flags))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * @brief Builds the compression dictionary from the seed and the given config
+ * strings. Strings are taken from the highest index down, and laid out in index
+ * order after the seed, since deflate favors matches near the end of the
+ * dictionary. The client and server compare checksums before the dictionary
+ * is used.
+ */
+void Netchan_BuildDictionary(net_dictionary_t *dict, const char (*strings)[MAX_STRING_CHARS],
+		size_t count) {
+
+	const size_t seed = sizeof(net_dictionary_seed_strings) - 1;
+	size_t pos = sizeof(dict->data);
+
+	while (count--) {
+		const size_t len = strlen(strings[count]);
+		if (len == 0)
+			continue;
+
+		if (len + 1 > pos - seed)
+			break;
+
+		pos -= len + 1;
+		memcpy(dict->data + pos, strings[count], len + 1);
+	}
+
+	pos -= seed;
+	memcpy(dict->data + pos, net_dictionary_seed_strings, seed);
+
+	dict->size = sizeof(dict->data) - pos;
+	memmove(dict->data, dict->data + pos, dict->size);
+
+	dict->checksum = crc32(crc32(0, Z_NULL, 0), dict->data, dict->size);
+}
+
+/*
+ * @return The checksum of the seed dictionary, which clients advertise at
+ * connect.
+ */
+uint32_t Netchan_SeedChecksum(void) {
+	return net_dictionary_seed.checksum;
+}
+
+/*
+ * @return The retransmit timeout for a fragment which has been sent the given
+ * number of times, backing off from twice the smoothed round trip time.
+ */
+static uint32_t Netchan_RetransmitTime(const net_chan_t *chan, const uint16_t transmits) {
+
+	uint32_t rto = chan->fragment_rtt ? chan->fragment_rtt * 2 : NET_RETRANSMIT_MAX / 4;
+	rto = Clamp(rto, NET_RETRANSMIT_MIN, NET_RETRANSMIT_MAX);
+
+	return MIN(rto << MIN(transmits - 1, 3), NET_RETRANSMIT_MAX);
+}
+
+/*
+ * @return True if the fragment has yet to be sent, is presumed lost, or its
+ * timer has expired.
+ */
+static _Bool Netchan_FragmentDue(const net_chan_t *chan, const net_fragment_t *frag) {
+
+	if (!frag->transmits || frag->lost)
+		return true;
+
+	return quetoo.time - frag->sent >= Netchan_RetransmitTime(chan, frag->transmits);
+}
+
+/*
+ * @brief Splits the pending reliable message into fragments, if the window
+ * has room for all of them. Otherwise, it continues to accumulate.
+ */
+static void Netchan_QueueFragments(net_chan_t *chan) {
+
+	if (!chan->message.size)
+		return;
+
+	const uint16_t in_flight = chan->fragment_outgoing - chan->fragment_acknowledged;
+	const size_t count = (chan->message.size + NET_FRAGMENT_SIZE - 1) / NET_FRAGMENT_SIZE;
+
+	if (in_flight + count > NET_RELIABLE_WINDOW)
+		return;
+
+	const byte *data = chan->message.data;
+	size_t remaining = chan->message.size;
+
+	while (remaining) {
+		net_fragment_t *frag = &chan->window->out[chan->fragment_outgoing % NET_RELIABLE_WINDOW];
+
+		frag->valid = true;
+		frag->sequence = chan->fragment_outgoing++;
+		frag->size = MIN(remaining, NET_FRAGMENT_SIZE);
+		frag->last = frag->size == remaining;
+		frag->lost = false;
+		frag->transmits = 0;
+		frag->sent = 0;
+
+		memcpy(frag->data, data, frag->size);
+
+		data += frag->size;
+		remaining -= frag->size;
+	}
+
+	chan->message.size = 0;
+}
+
+/*
+ * @brief Writes our acknowledgement of the remote end's fragments, followed by
+ * those of our fragments which are due. Beyond the first fragment, room is
+ * reserved for the unreliable message.
+ *
+ * @return The number of fragments written.
+ */
+static uint32_t Netchan_WriteFragments(net_chan_t *chan, mem_buf_t *payload, size_t reserve) {
+
+	uint32_t mask = 0;
+	for (uint16_t i = 0; i < NET_RELIABLE_WINDOW; i++) {
+		if (chan->window->in[(uint16_t) (chan->fragment_incoming + i) % NET_RELIABLE_WINDOW].valid)
+			mask |= 1u << i;
+	}
+
+	Net_WriteShort(payload, chan->fragment_incoming);
+	Net_WriteLong(payload, mask);
+
+	const size_t count = payload->size;
+	Net_WriteByte(payload, 0);
+
+	uint32_t written = 0;
+	for (uint16_t s = chan->fragment_acknowledged; s != chan->fragment_outgoing; s++) {
+		net_fragment_t *frag = &chan->window->out[s % NET_RELIABLE_WINDOW];
+
+		if (!frag->valid || !Netchan_FragmentDue(chan, frag))
+			continue;
+
+		if (payload->max_size - payload->size < frag->size + 4u + (written ? reserve : 0))
+			break;
+
+		Net_WriteShort(payload, frag->sequence);
+		Net_WriteShort(payload, frag->size | (frag->last << 15));
+		Mem_WriteBuffer(payload, frag->data, frag->size);
+
+		frag->lost = false;
+		frag->transmits++;
+		frag->sent = quetoo.time;
+
+		written++;
+	}
+
+	payload->data[count] = written;
+
+	chan->fragment_ack_pending = false;
+	return written;
+}
+
+/*
+ * @brief Retires our fragments which the remote end has acknowledged, sampling
+ * the round trip time from those which were not retransmitted. Fragments sent
+ * before one which was acknowledged are presumed lost, and resent without
+ * waiting for their timers.
+ */
+static void Netchan_AcknowledgeFragments(net_chan_t *chan, const uint16_t ack, const uint32_t mask) {
+	uint32_t newest = 0;
+
+	for (uint16_t s = chan->fragment_acknowledged; s != chan->fragment_outgoing; s++) {
+		net_fragment_t *frag = &chan->window->out[s % NET_RELIABLE_WINDOW];
+
+		if (!frag->valid)
+			continue;
+
+		const uint16_t delta = s - ack;
+		if ((int16_t) delta < 0 || (delta < NET_RELIABLE_WINDOW && (mask & (1u << delta)))) {
+
+			if (frag->transmits == 1) {
+				const uint32_t rtt = MAX(quetoo.time - frag->sent, 1u);
+
+				if (chan->fragment_rtt)
+					chan->fragment_rtt = (chan->fragment_rtt * 7 + rtt) / 8;
+				else
+					chan->fragment_rtt = rtt;
+			}
+
+			newest = MAX(newest, frag->sent);
+			frag->valid = false;
+		}
+	}
+
+	for (uint16_t s = chan->fragment_acknowledged; s != chan->fragment_outgoing; s++) {
+		net_fragment_t *frag = &chan->window->out[s % NET_RELIABLE_WINDOW];
+
+		if (frag->valid && frag->transmits && frag->sent < newest)
+			frag->lost = true;
+	}
+
+	while (chan->fragment_acknowledged != chan->fragment_outgoing) {
+		if (chan->window->out[chan->fragment_acknowledged % NET_RELIABLE_WINDOW].valid)
+			break;
+		chan->fragment_acknowledged++;
+	}
+}
+
+/*
+ * @brief Reads the remote end's acknowledgement and fragments from msg, and
+ * rewrites the remainder of msg as the complete reliable messages which may
+ * now be delivered in order, followed by the unreliable message. Reliable
+ * messages which do not fit are held for the next packet, and the unreliable
+ * message is discarded if it does not fit behind them. Stale packets are only
+ * salvaged for their fragments.
+ *
+ * @return True on success, false if the packet should be discarded.
+ */
+static _Bool Netchan_ProcessFragments(net_chan_t *chan, mem_buf_t *msg, _Bool stale) {
+	static byte out[MAX_MSG_SIZE]; // main thread only, as for the compression state
+
+	const size_t start = msg->read;
+
+	const uint16_t ack = Net_ReadShort(msg);
+	const uint32_t mask = Net_ReadLong(msg);
+	const int32_t count = Net_ReadByte(msg);
+
+	if (msg->read > msg->size) {
+		Com_Debug("%s: Corrupt fragment header\n", Net_NetaddrToString(&chan->remote_address));
+		return false;
+	}
+
+	for (int32_t i = 0; i < count; i++) {
+		const uint16_t sequence = Net_ReadShort(msg);
+		const uint16_t bits = Net_ReadShort(msg);
+		const uint16_t size = bits & 0x7fff;
+
+		if (size == 0 || size > NET_FRAGMENT_SIZE || msg->read + size > msg->size) {
+			Com_Debug("%s: Corrupt fragment\n", Net_NetaddrToString(&chan->remote_address));
+			return false;
+		}
+
+		// buffer fragments within the window which we do not yet hold
+		const uint16_t delta = sequence - chan->fragment_incoming;
+		if (delta < NET_RELIABLE_WINDOW) {
+			net_fragment_t *frag = &chan->window->in[sequence % NET_RELIABLE_WINDOW];
+
+			if (!frag->valid) {
+				frag->valid = true;
+				frag->last = !!(bits & 0x8000);
+				frag->sequence = sequence;
+				frag->size = size;
+
+				memcpy(frag->data, msg->data + msg->read, size);
+			}
+		}
+
+		msg->read += size;
+	}
+
+	// even duplicates are acknowledged, in case our last acknowledgement was lost
+	if (count)
+		chan->fragment_ack_pending = true;
+
+	if (stale)
+		return false;
+
+	// acknowledgements of fragments we have not sent are ignored, not fatal
+	if ((int16_t) (chan->fragment_outgoing - ack) >= 0)
+		Netchan_AcknowledgeFragments(chan, ack, mask);
+
+	mem_buf_t deliver;
+	Mem_InitBuffer(&deliver, out, msg->max_size - start);
+
+	// deliver each reliable message for which we hold all fragments, in order
+	while (true) {
+		uint16_t s = chan->fragment_incoming;
+		size_t size = 0;
+
+		_Bool complete = false;
+		for (uint16_t i = 0; i < NET_RELIABLE_WINDOW; i++, s++) {
+			const net_fragment_t *frag = &chan->window->in[s % NET_RELIABLE_WINDOW];
+
+			if (!frag->valid)
+				break;
+
+			size += frag->size;
+
+			if (frag->last) {
+				complete = true;
+				break;
+			}
+		}
+
+		if (!complete || deliver.size + size > deliver.max_size)
+			break;
+
+		while (chan->fragment_incoming != (uint16_t) (s + 1)) {
+			net_fragment_t *frag = &chan->window->in[chan->fragment_incoming % NET_RELIABLE_WINDOW];
+
+			Mem_WriteBuffer(&deliver, frag->data, frag->size);
+			frag->valid = false;
+
+			chan->fragment_incoming++;
+		}
+	}
+
+	// followed by the unreliable message, if it fits
+	const size_t len = msg->size - msg->read;
+	if (deliver.max_size - deliver.size >= len)
+		Mem_WriteBuffer(&deliver, msg->data + msg->read, len);
+	else
+		Com_Debug("%s: Dumped unreliable\n", Net_NetaddrToString(&chan->remote_address));
+
+	memcpy(msg->data + start, deliver.data, deliver.size);
+
+	msg->read = start;
+	msg->size = start + deliver.size;
+
+	return true;
+}
+
 /*
  * @brief Sends an out-of-band datagram
  */
@@ -117,9 +633,12 @@ void Netchan_OutOfBandPrint(int32_t sock, const net_addr_t *addr, const char *fo
 /*
  * @brief Called to open a channel to a remote system. If greater than zero,
  * the specified qport will be used. Otherwise, one is determined at random.
+ * The channel must be zeroed, or have been set up previously.
  */
 void Netchan_Setup(net_src_t source, net_chan_t *chan, net_addr_t *addr, uint8_t qport) {
 
+	Netchan_Close(chan);
+
 	memset(chan, 0, sizeof(*chan));
 
 	chan->source = source;
@@ -141,6 +660,29 @@ void Netchan_Setup(net_src_t source, net_chan_t *chan, net_addr_t *addr, uint8_t
 	chan->message.allow_overflow = true;
 }
 
+/*
+ * @brief Allocates the fragment buffers, once both ends agree on a reliable
+ * window.
+ */
+void Netchan_OpenWindow(net_chan_t *chan) {
+
+	if (!chan->window) {
+		chan->window = Mem_Malloc(sizeof(net_window_t));
+	}
+}
+
+/*
+ * @brief Releases the fragment buffers, if any. The channel may be set up
+ * again, or simply discarded.
+ */
+void Netchan_Close(net_chan_t *chan) {
+
+	if (chan->window) {
+		Mem_Free(chan->window);
+		chan->window = NULL;
+	}
+}
+
 /*
  * @return True if reliable data must be transmitted this frame, false
  * otherwise.
@@ -156,6 +698,30 @@ static _Bool Netchan_CheckRetransmit(net_chan_t *chan) {
 	return false;
 }
 
+/*
+ * @return True if the channel has reliable data or acknowledgements to send,
+ * and so should transmit even if there is no unreliable message.
+ */
+_Bool Netchan_Pending(const net_chan_t *chan) {
+
+	if (chan->message.size)
+		return true;
+
+	if (chan->window) {
+		if (chan->fragment_ack_pending)
+			return true;
+
+		for (uint16_t s = chan->fragment_acknowledged; s != chan->fragment_outgoing; s++) {
+			const net_fragment_t *frag = &chan->window->out[s % NET_RELIABLE_WINDOW];
+
+			if (frag->valid && Netchan_FragmentDue(chan, frag))
+				return true;
+		}
+	}
+
+	return false;
+}
+
 /*
  * @brief Tries to send an unreliable message to a connection, and handles the
  * transmission / retransmission of the reliable messages.
@@ -171,18 +737,43 @@ void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len) {
 		Com_Error(ERR_DROP, "%s: Overflow\n", Net_NetaddrToString(&chan->remote_address));
 	}
 
-	// check for re-transmission of reliable message
-	_Bool send_reliable = Netchan_CheckRetransmit(chan);
+	_Bool send_reliable = false;
+	uint32_t fragments = 0;
+
+	// assemble the payload
+	mem_buf_t payload;
+	byte payload_buffer[MAX_MSG_SIZE];
+
+	Mem_InitBuffer(&payload, payload_buffer, sizeof(payload_buffer) - 16);
 
-	// or for transmission of a new one
-	if (!chan->reliable_size && chan->message.size) {
-		memcpy(chan->reliable_buffer, chan->message_buffer, chan->message.size);
-		chan->reliable_size = chan->message.size;
-		chan->message.size = 0;
-		chan->reliable_sequence ^= 1;
-		send_reliable = true;
+	if (chan->window) { // acknowledge and send fragments first
+		Netchan_QueueFragments(chan);
+		fragments = Netchan_WriteFragments(chan, &payload, len);
+	} else {
+		// check for re-transmission of reliable message
+		send_reliable = Netchan_CheckRetransmit(chan);
+
+		// or for transmission of a new one
+		if (!chan->reliable_size && chan->message.size) {
+			memcpy(chan->reliable_buffer, chan->message_buffer, chan->message.size);
+			chan->reliable_size = chan->message.size;
+			chan->message.size = 0;
+			chan->reliable_sequence ^= 1;
+			send_reliable = true;
+		}
+
+		// copy the reliable message to the packet first
+		if (send_reliable) {
+			Mem_WriteBuffer(&payload, chan->reliable_buffer, chan->reliable_size);
+		}
 	}
 
+	// add the unreliable part if space is available
+	if (payload.max_size - payload.size >= len)
+		Mem_WriteBuffer(&payload, data, len);
+	else
+		Com_Warn("Netchan_Transmit: dumped unreliable\n");
+
 	// write the packet header
 	Mem_InitBuffer(&send, send_buffer, sizeof(send_buffer));
 
@@ -199,23 +790,34 @@ void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len) {
 	if (chan->source == NS_UDP_CLIENT)
 		Net_WriteByte(&send, chan->qport);
 
-	// copy the reliable message to the packet first
-	if (send_reliable) {
-		Mem_WriteBuffer(&send, chan->reliable_buffer, chan->reliable_size);
+	if (send_reliable)
 		chan->reliable_outgoing = chan->outgoing_sequence;
-	}
 
-	// add the unreliable part if space is available
-	if (send.max_size - send.size >= len)
-		Mem_WriteBuffer(&send, data, len);
-	else
-		Com_Warn("Netchan_Transmit: dumped unreliable\n");
+	// and the payload, compressed if negotiated and worthwhile
+	if (chan->compress) {
+		byte compressed[MAX_MSG_SIZE], flags = 0;
+
+		const size_t size = Netchan_Deflate(chan, &payload, compressed, &flags);
+
+		Net_WriteByte(&send, flags);
+		if (size)
+			Mem_WriteBuffer(&send, compressed, size);
+		else
+			Mem_WriteBuffer(&send, payload.data, payload.size);
+	} else {
+		Mem_WriteBuffer(&send, payload.data, payload.size);
+	}
 
 	// send the datagram
 	Net_SendDatagram(chan->source, &chan->remote_address, send.data, send.size);
 
 	if (net_show_packets->value) {
-		if (send_reliable)
+		if (chan->window)
+			Com_Print("Send %u bytes: s=%i fragments=%u/%u ack=%i fack=%i\n", (uint32_t) send.size,
+					chan->outgoing_sequence - 1, fragments,
+					(uint16_t) (chan->fragment_outgoing - chan->fragment_acknowledged),
+					chan->incoming_sequence, chan->fragment_incoming);
+		else if (send_reliable)
 			Com_Print("Send %u bytes: s=%i reliable=%i ack=%i rack=%i\n", (uint32_t) send.size,
 					chan->outgoing_sequence - 1, chan->reliable_sequence, chan->incoming_sequence,
 					chan->reliable_incoming);
@@ -263,6 +865,11 @@ _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg) {
 		if (net_show_drop->value)
 			Com_Print("%s:Out of order packet %i at %i\n",
 					Net_NetaddrToString(&chan->remote_address), sequence, chan->incoming_sequence);
+
+		// but salvage any fragments which we do not yet hold
+		if (chan->window && Netchan_ReadPayload(chan, msg))
+			Netchan_ProcessFragments(chan, msg, true);
+
 		return false;
 	}
 
@@ -274,18 +881,28 @@ _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg) {
 					chan->dropped, sequence);
 	}
 
-	// if the current outgoing reliable message has been acknowledged
-	// clear the buffer to make way for the next
-	if (reliable_ack == chan->reliable_sequence)
-		chan->reliable_size = 0; // it has been received
+	if (!Netchan_ReadPayload(chan, msg))
+		return false;
+
+	if (chan->window) {
+		// acknowledge our fragments and deliver theirs
+		if (!Netchan_ProcessFragments(chan, msg, false))
+			return false;
+	} else {
+		// if the current outgoing reliable message has been acknowledged
+		// clear the buffer to make way for the next
+		if (reliable_ack == chan->reliable_sequence)
+			chan->reliable_size = 0; // it has been received
+
+		// if this message contains a reliable message, bump reliable_incoming
+		chan->reliable_acknowledged = reliable_ack;
+		if (reliable_message) {
+			chan->reliable_incoming ^= 1;
+		}
+	}
 
-	// if this message contains a reliable message, bump reliable_incoming
 	chan->incoming_sequence = sequence;
 	chan->incoming_acknowledged = sequence_ack;
-	chan->reliable_acknowledged = reliable_ack;
-	if (reliable_message) {
-		chan->reliable_incoming ^= 1;
-	}
 
 	// the message can now be read from the current message pointer
 	chan->last_received = quetoo.time;
@@ -293,6 +910,57 @@ _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg) {
 	return true;
 }
 
+/*
+ * @brief net_compress_stats [clear]
+ */
+static void Netchan_CompressStats_f(void) {
+	const char *names[] = { "client", "server" };
+
+	if (Cmd_Argc() == 2 && !g_strcmp0(Cmd_Argv(1), "clear")) {
+		memset(net_compress_stats, 0, sizeof(net_compress_stats));
+		Com_Print("Compression statistics cleared\n");
+		return;
+	}
+
+	for (size_t i = 0; i < lengthof(net_compress_stats); i++) {
+		const net_compress_stats_t *stats = &net_compress_stats[i];
+
+		if (!stats->packets)
+			continue;
+
+		Com_Print("%s: %u of %u packets compressed, %u -> %u bytes (%.1f%%)\n", names[i],
+				stats->compressed, stats->packets, (uint32_t) stats->bytes_in,
+				(uint32_t) stats->bytes_out, 100.0 * stats->bytes_out / stats->bytes_in);
+
+		Com_Print("%s: %.1fus/packet, %.1fus/frame over %u frames\n", names[i],
+				stats->usec / (vec_t) stats->packets,
+				stats->usec / (vec_t) MAX(stats->frames, 1), stats->frames);
+	}
+}
+
+/*
+ * @brief net_capture [filename]
+ */
+static void Netchan_Capture_f(void) {
+
+	if (Cmd_Argc() == 2) {
+		char filename[MAX_QPATH];
+
+		g_snprintf(filename, sizeof(filename), "captures/%s.cap", Cmd_Argv(1));
+
+		if (Net_StartCapture(filename))
+			Com_Print("Capturing packets to %s\n", filename);
+		return;
+	}
+
+	if (Net_Capturing()) {
+		Net_StopCapture();
+		Com_Print("Packet capture stopped\n");
+	} else {
+		Com_Print("Usage: %s <filename>\n", Cmd_Argv(0));
+	}
+}
+
 /*
  * @brief
  */
@@ -303,6 +971,22 @@ void Netchan_Init(void) {
 	net_show_packets = Cvar_Get("net_show_packets", "0", 0, NULL);
 	net_show_drop = Cvar_Get("net_show_drop", "0", 0, NULL);
 
+	net_compress = Cvar_Get("net_compress", "1", CVAR_ARCHIVE,
+			"Negotiate per-packet compression with remote hosts");
+
+	Cmd_Add("net_compress_stats", Netchan_CompressStats_f, CMD_SYSTEM,
+			"Print per-packet compression statistics");
+	Cmd_Add("net_capture", Netchan_Capture_f, CMD_SYSTEM,
+			"Capture every datagram to a file for replay, or stop capturing");
+
+	if (deflateInit2(&net_deflate, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		Com_Error(ERR_FATAL, "Failed to initialize deflate\n");
+
+	if (inflateInit2(&net_inflate, -MAX_WBITS) != Z_OK)
+		Com_Error(ERR_FATAL, "Failed to initialize inflate\n");
+
+	Netchan_BuildDictionary(&net_dictionary_seed, NULL, 0);
+
 	Mem_InitBuffer(&net_message, net_message_buffer, sizeof(net_message_buffer));
 }
 
@@ -314,6 +998,14 @@ void Netchan_Shutdown(void) {
 	Net_Config(NS_UDP_CLIENT, false);
 	Net_Config(NS_UDP_SERVER, false);
 
+	Net_StopCapture();
+
+	Cmd_Remove("net_compress_stats");
+	Cmd_Remove("net_capture");
+
+	deflateEnd(&net_deflate);
+	inflateEnd(&net_inflate);
+
 	Net_Shutdown();
 }
 
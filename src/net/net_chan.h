@@ -28,11 +28,37 @@
 extern net_addr_t net_from;
 extern mem_buf_t net_message;
 
+extern cvar_t *net_compress;
+
+/*
+ * @brief Channel capabilities, advertised by the client at connect.
+ */
+#define NET_CHAN_COMPRESS	0x1
+#define NET_CHAN_WINDOW		0x2
+
+/*
+ * @brief Per-packet compression accounting, for each source.
+ */
+typedef struct {
+	uint32_t frames; // distinct frames in which packets were processed
+	uint32_t packets; // packets eligible for compression
+	uint32_t compressed; // packets actually sent or received compressed
+	size_t bytes_in; // payload bytes before compression
+	size_t bytes_out; // payload bytes after compression
+	uint64_t usec; // time spent compressing and decompressing
+	uint32_t last_time; // to count frames
+} net_compress_stats_t;
+
 void Netchan_Setup(net_src_t source, net_chan_t *chan, net_addr_t *addr, uint8_t qport);
+void Netchan_OpenWindow(net_chan_t *chan);
+void Netchan_Close(net_chan_t *chan);
+_Bool Netchan_Pending(const net_chan_t *chan);
 void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len);
 void Netchan_OutOfBand(int32_t sock, const net_addr_t *addr, const void *data, size_t len);
 void Netchan_OutOfBandPrint(int32_t sock, const net_addr_t *addr, const char *format, ...) __attribute__((format(printf, 3, 4)));
 _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg);
+void Netchan_BuildDictionary(net_dictionary_t *dict, const char (*strings)[MAX_STRING_CHARS], size_t count);
+uint32_t Netchan_SeedChecksum(void);
 void Netchan_Init(void);
 void Netchan_Shutdown(void);
 
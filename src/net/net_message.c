@@ -287,11 +287,9 @@ void Net_WriteDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, const
 }
 
 /*
- * @brief Writes an entity's state changes to a net message. Can delta from
- * either a baseline or a previous packet_entity
+ * @brief Resolves the U_* flags describing the delta between two entity states.
  */
-void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const entity_state_t *to,
-		_Bool force) {
+uint16_t Net_DeltaEntityFlags(const entity_state_t *from, const entity_state_t *to) {
 
 	uint16_t bits = 0;
 
@@ -337,6 +335,19 @@ void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const enti
 	if (to->solid != from->solid)
 		bits |= U_SOLID;
 
+	return bits;
+}
+
+/*
+ * @brief Writes an entity's state changes to a net message. Can delta from
+ * either a baseline or a previous packet_entity. This byte aligned encoding is
+ * used for baselines, and for packet entities with PROTOCOL_MAJOR_LEGACY.
+ */
+void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const entity_state_t *to,
+		_Bool force) {
+
+	const uint16_t bits = Net_DeltaEntityFlags(from, to);
+
 	if (!bits && !force)
 		return; // nothing to send
 
@@ -385,6 +396,180 @@ void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const enti
 		Net_WriteShort(msg, to->solid);
 }
 
+/*
+ * @brief Quantizes a coordinate to NET_POSITION_SCALE. Both ends of the
+ * connection quantize their copy of the delta base identically, so only
+ * quantized deltas need be transmitted, and no error accumulates.
+ */
+static int32_t Net_QuantizeCoord(const vec_t v) {
+	return (int32_t) floorf(v * NET_POSITION_SCALE + 0.5f);
+}
+
+/*
+ * @brief Writes the signed value in the specified number of bits, zig-zag
+ * encoded so that small magnitudes of either sign have leading zeros.
+ */
+static void Net_WriteSignedBits(mem_bits_t *bits, const int32_t value, const uint32_t count) {
+	Mem_WriteBits(bits, (((uint32_t) value) << 1) ^ (uint32_t) (value >> 31), count);
+}
+
+/*
+ * @brief Writes the specified position as a quantized delta from the given
+ * base. Each axis is prefix coded: `0` for no change, `10` for a small delta,
+ * `110` for a medium delta and `111` for an absolute, full precision value.
+ */
+static void Net_WritePositionBits(mem_bits_t *bits, const vec3_t from, const vec3_t to) {
+
+	for (int32_t i = 0; i < 3; i++) {
+		const int32_t delta = Net_QuantizeCoord(to[i]) - Net_QuantizeCoord(from[i]);
+
+		if (delta == 0) {
+			Mem_WriteBits(bits, 0x0, 1);
+		} else if (abs(delta) < (1 << (NET_POSITION_SMALL_BITS - 1))) {
+			Mem_WriteBits(bits, 0x1, 2);
+			Net_WriteSignedBits(bits, delta, NET_POSITION_SMALL_BITS);
+		} else if (abs(delta) < (1 << (NET_POSITION_MEDIUM_BITS - 1))) {
+			Mem_WriteBits(bits, 0x3, 3);
+			Net_WriteSignedBits(bits, delta, NET_POSITION_MEDIUM_BITS);
+		} else {
+			const net_vec_t vec = {
+				.v = to[i]
+			};
+
+			Mem_WriteBits(bits, 0x7, 3);
+			Mem_WriteBits(bits, vec.i, 32);
+		}
+	}
+}
+
+/*
+ * @brief Writes the entity number as a delta from the previously written
+ * number, which is 0 at the start of the list. Entity lists are sorted, so
+ * the delta is usually small. A `1` is written for the very common delta of
+ * 1; otherwise `0` is followed by a two bit class and a value. Writing a
+ * number of 0 terminates the list.
+ */
+void Net_WriteEntityNumberBits(mem_bits_t *bits, const uint16_t last, const uint16_t number) {
+
+	if (number == 0) {
+		Mem_WriteBits(bits, 0x0, 3);
+		return;
+	}
+
+	const int32_t delta = number - last;
+
+	if (delta == 1) {
+		Mem_WriteBits(bits, 0x1, 1);
+	} else if (delta > 1 && delta < 2 + (1 << 4)) {
+		Mem_WriteBits(bits, 0x1 << 1, 3);
+		Mem_WriteBits(bits, delta - 2, 4);
+	} else if (delta > 1 && delta < 2 + (1 << 8)) {
+		Mem_WriteBits(bits, 0x2 << 1, 3);
+		Mem_WriteBits(bits, delta - 2, 8);
+	} else {
+		Mem_WriteBits(bits, 0x3 << 1, 3);
+		Mem_WriteBits(bits, number, 16);
+	}
+}
+
+/*
+ * @brief Writes the removal of the specified entity to the bit stream.
+ */
+void Net_WriteRemoveEntityBits(mem_bits_t *bits, const uint16_t last, const uint16_t number) {
+
+	Net_WriteEntityNumberBits(bits, last, number);
+	Mem_WriteBits(bits, 0x1, 1);
+}
+
+/*
+ * @brief Writes the delta from one entity_state_t to another to the bit stream,
+ * following the entity number last written. Positions are quantized and delta
+ * coded, and the remaining fields are packed to their natural widths.
+ *
+ * @return True if the entity was written, false if it was unchanged.
+ */
+_Bool Net_WriteDeltaEntityBits(mem_bits_t *bits, const uint16_t last, const entity_state_t *from,
+		const entity_state_t *to, _Bool force) {
+
+	const uint16_t flags = Net_DeltaEntityFlags(from, to);
+
+	if (!flags && !force)
+		return false; // nothing to send
+
+	Net_WriteEntityNumberBits(bits, last, to->number);
+	Net_WriteDeltaEntityFieldsBits(bits, flags, from, to);
+
+	return true;
+}
+
+/*
+ * @brief Writes the flags and fields of an entity delta to the bit stream. This
+ * is everything but the entity number, and so it does not depend on the entity
+ * written before it.
+ */
+void Net_WriteDeltaEntityFieldsBits(mem_bits_t *bits, const uint16_t flags,
+		const entity_state_t *from, const entity_state_t *to) {
+
+	Mem_WriteBits(bits, 0x0, 1); // not removed
+	Mem_WriteBits(bits, flags, NET_ENTITY_FLAG_BITS);
+
+	if (flags & U_ORIGIN)
+		Net_WritePositionBits(bits, from->origin, to->origin);
+
+	if (flags & U_TERMINATION)
+		Net_WritePositionBits(bits, from->termination, to->termination);
+
+	if (flags & U_ANGLES) {
+		for (int32_t i = 0; i < 3; i++) {
+			const uint16_t angle = PackAngle(to->angles[i]);
+
+			if (angle == PackAngle(from->angles[i])) {
+				Mem_WriteBits(bits, 0x0, 1);
+			} else {
+				Mem_WriteBits(bits, 0x1, 1);
+				Mem_WriteBits(bits, angle, 16);
+			}
+		}
+	}
+
+	if (flags & U_ANIMATIONS) {
+		Mem_WriteBits(bits, to->animation1, 8);
+		Mem_WriteBits(bits, to->animation2, 8);
+	}
+
+	if (flags & U_EVENT)
+		Mem_WriteBits(bits, to->event, 8);
+
+	if (flags & U_EFFECTS)
+		Mem_WriteBits(bits, to->effects, 16);
+
+	if (flags & U_TRAIL)
+		Mem_WriteBits(bits, to->trail, 8);
+
+	if (flags & U_MODELS) {
+		const uint8_t f[] = { from->model1, from->model2, from->model3, from->model4 };
+		const uint8_t t[] = { to->model1, to->model2, to->model3, to->model4 };
+
+		for (size_t i = 0; i < lengthof(t); i++) {
+			if (t[i] == f[i]) {
+				Mem_WriteBits(bits, 0x0, 1);
+			} else {
+				Mem_WriteBits(bits, 0x1, 1);
+				Mem_WriteBits(bits, t[i], 8);
+			}
+		}
+	}
+
+	if (flags & U_CLIENT)
+		Mem_WriteBits(bits, to->client, 8);
+
+	if (flags & U_SOUND)
+		Mem_WriteBits(bits, to->sound, 8);
+
+	if (flags & U_SOLID)
+		Mem_WriteBits(bits, to->solid, 16);
+}
+
 /*
  * @brief
  */
@@ -696,3 +881,297 @@ void Net_ReadDeltaEntity(mem_buf_t *msg, const entity_state_t *from, entity_stat
 	if (bits & U_SOLID)
 		to->solid = Net_ReadShort(msg);
 }
+
+/*
+ * @brief Reads a zig-zag encoded signed value of the specified number of bits.
+ */
+static int32_t Net_ReadSignedBits(mem_bits_t *bits, const uint32_t count) {
+
+	const uint32_t value = Mem_ReadBits(bits, count);
+
+	return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+/*
+ * @brief Reads a position written by Net_WritePositionBits.
+ */
+static void Net_ReadPositionBits(mem_bits_t *bits, const vec3_t from, vec3_t to) {
+
+	for (int32_t i = 0; i < 3; i++) {
+		int32_t delta;
+
+		if (Mem_ReadBits(bits, 1) == 0) {
+			to[i] = from[i];
+			continue;
+		}
+
+		if (Mem_ReadBits(bits, 1) == 0) {
+			delta = Net_ReadSignedBits(bits, NET_POSITION_SMALL_BITS);
+		} else if (Mem_ReadBits(bits, 1) == 0) {
+			delta = Net_ReadSignedBits(bits, NET_POSITION_MEDIUM_BITS);
+		} else {
+			const net_vec_t vec = {
+				.i = (int32_t) Mem_ReadBits(bits, 32)
+			};
+
+			to[i] = vec.v;
+			continue;
+		}
+
+		to[i] = (Net_QuantizeCoord(from[i]) + delta) / (vec_t) NET_POSITION_SCALE;
+	}
+}
+
+/*
+ * @brief Reads an entity number written by Net_WriteEntityNumberBits.
+ *
+ * @return The entity number, or 0 at the end of the list.
+ */
+uint16_t Net_ReadEntityNumberBits(mem_bits_t *bits, const uint16_t last) {
+
+	if (Mem_ReadBits(bits, 1))
+		return last + 1;
+
+	switch (Mem_ReadBits(bits, 2)) {
+		case 0:
+			return 0;
+		case 1:
+			return last + 2 + Mem_ReadBits(bits, 4);
+		case 2:
+			return last + 2 + Mem_ReadBits(bits, 8);
+		default:
+			return Mem_ReadBits(bits, 16);
+	}
+}
+
+/*
+ * @brief Reads the U_* flags for the entity number just read.
+ */
+uint16_t Net_ReadEntityFlagsBits(mem_bits_t *bits) {
+
+	if (Mem_ReadBits(bits, 1))
+		return U_REMOVE;
+
+	return Mem_ReadBits(bits, NET_ENTITY_FLAG_BITS);
+}
+
+/*
+ * @brief Reads an entity delta written by Net_WriteDeltaEntityBits.
+ */
+void Net_ReadDeltaEntityBits(mem_bits_t *bits, const entity_state_t *from, entity_state_t *to,
+		uint16_t number, uint16_t flags) {
+
+	*to = *from;
+
+	to->number = number;
+
+	if (flags & U_ORIGIN)
+		Net_ReadPositionBits(bits, from->origin, to->origin);
+
+	if (flags & U_TERMINATION)
+		Net_ReadPositionBits(bits, from->termination, to->termination);
+
+	if (flags & U_ANGLES) {
+		for (int32_t i = 0; i < 3; i++) {
+			if (Mem_ReadBits(bits, 1))
+				to->angles[i] = UnpackAngle(Mem_ReadBits(bits, 16));
+		}
+	}
+
+	if (flags & U_ANIMATIONS) {
+		to->animation1 = Mem_ReadBits(bits, 8);
+		to->animation2 = Mem_ReadBits(bits, 8);
+	}
+
+	if (flags & U_EVENT)
+		to->event = Mem_ReadBits(bits, 8);
+	else
+		to->event = 0;
+
+	if (flags & U_EFFECTS)
+		to->effects = Mem_ReadBits(bits, 16);
+
+	if (flags & U_TRAIL)
+		to->trail = Mem_ReadBits(bits, 8);
+
+	if (flags & U_MODELS) {
+		uint8_t *t[] = { &to->model1, &to->model2, &to->model3, &to->model4 };
+
+		for (size_t i = 0; i < lengthof(t); i++) {
+			if (Mem_ReadBits(bits, 1))
+				*t[i] = Mem_ReadBits(bits, 8);
+		}
+	}
+
+	if (flags & U_CLIENT)
+		to->client = Mem_ReadBits(bits, 8);
+
+	if (flags & U_SOUND)
+		to->sound = Mem_ReadBits(bits, 8);
+
+	if (flags & U_SOLID)
+		to->solid = Mem_ReadBits(bits, 16);
+}
+
+/*
+ * @brief Reads SV_CMD_SERVER_DATA.
+ *
+ * @return False if the message is truncated.
+ */
+_Bool Net_ReadServerData(mem_buf_t *msg, net_server_data_t *data) {
+
+	data->major = Net_ReadShort(msg);
+	data->minor = Net_ReadShort(msg);
+	data->server_count = Net_ReadLong(msg);
+	data->server_hz = Net_ReadLong(msg);
+	data->demo_server = Net_ReadByte(msg);
+	g_strlcpy(data->game, Net_ReadString(msg), sizeof(data->game));
+	data->client_num = Net_ReadShort(msg);
+	g_strlcpy(data->level_name, Net_ReadString(msg), sizeof(data->level_name));
+
+	return msg->read <= msg->size;
+}
+
+/*
+ * @brief Reads the fields of SV_CMD_FRAME which precede the player state.
+ *
+ * @return False if the message is truncated or malformed.
+ */
+_Bool Net_ReadFrame(mem_buf_t *msg, net_frame_t *frame) {
+
+	memset(frame, 0, sizeof(*frame));
+
+	frame->frame_num = Net_ReadLong(msg);
+	frame->delta_frame_num = Net_ReadLong(msg);
+	frame->surpress_count = Net_ReadByte(msg);
+
+	const int32_t len = Net_ReadByte(msg);
+	if (len < 0 || len > (int32_t) sizeof(frame->area_bits))
+		return false;
+
+	Net_ReadData(msg, frame->area_bits, len);
+
+	return msg->read <= msg->size;
+}
+
+/*
+ * @brief Walks the packet entities of a frame, calling func for each of them.
+ *
+ * @return False if the message is truncated or malformed.
+ */
+_Bool Net_ReadPacketEntities(mem_buf_t *msg, _Bool packed, Net_PacketEntityFunc func, void *data) {
+	mem_bits_t bits;
+
+	if (packed)
+		Mem_BeginBits(&bits, msg);
+
+	uint16_t number = 0;
+	while (true) {
+		if (packed)
+			number = Net_ReadEntityNumberBits(&bits, number);
+		else
+			number = Net_ReadShort(msg);
+
+		if (number >= MAX_ENTITIES || msg->read > msg->size)
+			return false;
+
+		if (!number)
+			break;
+
+		const uint16_t flags = packed ? Net_ReadEntityFlagsBits(&bits) : Net_ReadShort(msg);
+
+		func(msg, packed ? &bits : NULL, number, flags, data);
+	}
+
+	if (packed)
+		Mem_EndReadBits(&bits);
+
+	return msg->read <= msg->size;
+}
+
+/*
+ * @brief Reads SV_CMD_SOUND.
+ *
+ * @return False if the message is truncated or malformed.
+ */
+_Bool Net_ReadSound(mem_buf_t *msg, net_sound_t *sound) {
+
+	memset(sound, 0, sizeof(*sound));
+
+	sound->flags = Net_ReadByte(msg);
+	sound->index = Net_ReadByte(msg);
+
+	if (sound->flags & S_ATTEN)
+		sound->atten = Net_ReadByte(msg);
+	else
+		sound->atten = ATTEN_DEFAULT;
+
+	if (sound->flags & S_ENTITY) {
+		sound->entity = Net_ReadShort(msg);
+
+		if (sound->entity >= MAX_ENTITIES)
+			return false;
+	}
+
+	if (sound->flags & S_ORIGIN)
+		Net_ReadPosition(msg, sound->origin);
+
+	return msg->read <= msg->size;
+}
+
+/*
+ * @brief Reads SV_CMD_DOWNLOAD, including the data of a chunk or legacy
+ * download.
+ *
+ * @return False if the message is truncated or malformed.
+ */
+_Bool Net_ReadDownload(mem_buf_t *msg, net_download_t *download) {
+
+	memset(download, 0, sizeof(*download));
+
+	download->size = Net_ReadShort(msg);
+
+	switch (download->size) {
+		case DOWNLOAD_STREAM:
+			download->length = Net_ReadLong(msg);
+			break;
+
+		case DOWNLOAD_STREAM_CHUNK:
+			download->offset = Net_ReadLong(msg);
+			download->len = Net_ReadShort(msg);
+
+			if (download->len <= 0 || download->len > DOWNLOAD_CHUNK_SIZE)
+				return false;
+			break;
+
+		default:
+			download->percent = Net_ReadByte(msg);
+			download->len = MAX(download->size, 0);
+			break;
+	}
+
+	if (msg->read + download->len > msg->size)
+		return false;
+
+	download->data = msg->data + msg->read;
+	msg->read += download->len;
+
+	return true;
+}
+
+/*
+ * @brief Reads CL_CMD_MOVE.
+ *
+ * @return False if the message is truncated.
+ */
+_Bool Net_ReadMove(mem_buf_t *msg, net_move_t *move) {
+	static const pm_cmd_t null_cmd;
+
+	move->last_frame = Net_ReadLong(msg);
+
+	Net_ReadDeltaMoveCmd(msg, &null_cmd, &move->cmds[0]);
+	Net_ReadDeltaMoveCmd(msg, &move->cmds[0], &move->cmds[1]);
+	Net_ReadDeltaMoveCmd(msg, &move->cmds[1], &move->cmds[2]);
+
+	return msg->read <= msg->size;
+}
@@ -23,6 +23,7 @@
 #define __NET_MESSAGE_H__
 
 #include "common.h"
+#include "files.h"
 
 /*
  * @brief Delta compression flags for pm_state_t.
@@ -66,6 +67,20 @@
 #define U_SOLID					0x400 // encoded bounding box
 #define U_REMOVE				0x800 // remove this entity, don't add it
 
+/*
+ * @brief The number of U_* flags written for each entity in a bit packed entity
+ * list. U_REMOVE is written as a single leading bit instead.
+ */
+#define NET_ENTITY_FLAG_BITS	11
+
+/*
+ * @brief Bit packed entity positions are delta coded in fractions of a unit.
+ * Deltas that do not fit in the medium width are sent at full precision.
+ */
+#define NET_POSITION_SCALE			16
+#define NET_POSITION_SMALL_BITS		8 // +/- 8 units
+#define NET_POSITION_MEDIUM_BITS	14 // +/- 512 units
+
 /*
  * @brief These flags indicate which fields a given sound packet will contain.
  */
@@ -73,6 +88,72 @@
 #define S_ORIGIN				0x2
 #define S_ENTITY				0x4
 
+/*
+ * @brief The fields of SV_CMD_SERVER_DATA.
+ */
+typedef struct {
+	uint16_t major;
+	uint16_t minor;
+	uint32_t server_count;
+	uint32_t server_hz;
+	byte demo_server;
+	char game[MAX_QPATH];
+	uint16_t client_num;
+	char level_name[MAX_STRING_CHARS];
+} net_server_data_t;
+
+/*
+ * @brief The fields of SV_CMD_FRAME which precede the player state and the
+ * packet entities.
+ */
+typedef struct {
+	int32_t frame_num;
+	int32_t delta_frame_num;
+	byte surpress_count;
+	byte area_bits[MAX_BSP_AREAS >> 3];
+} net_frame_t;
+
+/*
+ * @brief The fields of SV_CMD_SOUND. Those which are absent are defaulted.
+ */
+typedef struct {
+	byte flags;
+	uint16_t index;
+	int32_t atten;
+	uint16_t entity;
+	vec3_t origin;
+} net_sound_t;
+
+/*
+ * @brief The fields of SV_CMD_DOWNLOAD. Chunks and legacy downloads refer to
+ * their data in the message.
+ */
+typedef struct {
+	int32_t size; // the chunk size, or one of the DOWNLOAD_* codes
+	int32_t percent; // legacy downloads only
+	int32_t length; // the file length, for DOWNLOAD_STREAM
+	int32_t offset; // the chunk offset, for DOWNLOAD_STREAM_CHUNK
+	const byte *data;
+	int32_t len;
+} net_download_t;
+
+/*
+ * @brief The fields of CL_CMD_MOVE: the last frame the client received, and
+ * its three most recent commands, oldest first.
+ */
+typedef struct {
+	int32_t last_frame;
+	pm_cmd_t cmds[3];
+} net_move_t;
+
+/*
+ * @brief Called for each entity in the packet entities of a frame, with the
+ * bit stream if they are packed. Unless the entity is removed, the callback
+ * must read its delta.
+ */
+typedef void (*Net_PacketEntityFunc)(mem_buf_t *msg, mem_bits_t *packed, uint16_t number,
+		uint16_t flags, void *data);
+
 /*
  * @brief Message writing and reading facilities.
  */
@@ -89,7 +170,14 @@ void Net_WriteAngles(mem_buf_t *msg, const vec3_t angles);
 void Net_WriteDir(mem_buf_t *msg, const vec3_t dir);
 void Net_WriteDeltaMoveCmd(mem_buf_t *msg, const pm_cmd_t *from, const pm_cmd_t *to);
 void Net_WriteDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, const player_state_t *to);
+uint16_t Net_DeltaEntityFlags(const entity_state_t *from, const entity_state_t *to);
 void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const entity_state_t *to, _Bool force);
+void Net_WriteEntityNumberBits(mem_bits_t *bits, const uint16_t last, const uint16_t number);
+void Net_WriteRemoveEntityBits(mem_bits_t *bits, const uint16_t last, const uint16_t number);
+_Bool Net_WriteDeltaEntityBits(mem_bits_t *bits, const uint16_t last, const entity_state_t *from,
+		const entity_state_t *to, _Bool force);
+void Net_WriteDeltaEntityFieldsBits(mem_bits_t *bits, const uint16_t flags,
+		const entity_state_t *from, const entity_state_t *to);
 
 void Net_BeginReading(mem_buf_t *msg);
 void Net_ReadData(mem_buf_t *msg, void *data, size_t len);
@@ -108,5 +196,16 @@ void Net_ReadDeltaMoveCmd(mem_buf_t *msg, const pm_cmd_t *from, pm_cmd_t *to);
 void Net_ReadDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, player_state_t *to);
 void Net_ReadDeltaEntity(mem_buf_t *msg, const entity_state_t *from, entity_state_t *to,
 		uint16_t bits, uint16_t number);
+uint16_t Net_ReadEntityNumberBits(mem_bits_t *bits, const uint16_t last);
+uint16_t Net_ReadEntityFlagsBits(mem_bits_t *bits);
+void Net_ReadDeltaEntityBits(mem_bits_t *bits, const entity_state_t *from, entity_state_t *to,
+		uint16_t number, uint16_t flags);
+
+_Bool Net_ReadServerData(mem_buf_t *msg, net_server_data_t *data);
+_Bool Net_ReadFrame(mem_buf_t *msg, net_frame_t *frame);
+_Bool Net_ReadPacketEntities(mem_buf_t *msg, _Bool packed, Net_PacketEntityFunc func, void *data);
+_Bool Net_ReadSound(mem_buf_t *msg, net_sound_t *sound);
+_Bool Net_ReadDownload(mem_buf_t *msg, net_download_t *download);
+_Bool Net_ReadMove(mem_buf_t *msg, net_move_t *move);
 
 #endif /* __NET_MESSAGE_H__ */
@@ -72,6 +72,47 @@ typedef enum {
 	NS_UDP_SERVER
 } net_src_t;
 
+/*
+ * @brief Compressed packets may reference a dictionary shared by both ends of
+ * a channel. It is primed with the level's config strings, which recur in
+ * prints and user info updates. See Netchan_BuildDictionary.
+ */
+#define NET_DICTIONARY_SIZE 4096
+
+typedef struct {
+	byte data[NET_DICTIONARY_SIZE];
+	size_t size;
+	uint32_t checksum; // exchanged to confirm that both ends agree
+} net_dictionary_t;
+
+/*
+ * @brief Channels which negotiate a reliable window split their reliable
+ * messages into fragments, several of which may be in flight at once. Each
+ * fragment is retransmitted on its own timer until it is acknowledged.
+ */
+#define NET_RELIABLE_WINDOW 32
+#define NET_FRAGMENT_SIZE 1024
+
+typedef struct {
+	_Bool valid; // queued and unacknowledged, or received and undelivered
+	_Bool last; // the final fragment of a reliable message
+	_Bool lost; // a later fragment was acknowledged first
+	uint16_t sequence;
+	uint16_t size;
+	uint16_t transmits; // number of times this fragment has been sent
+	uint32_t sent; // time of the most recent transmit
+	byte data[NET_FRAGMENT_SIZE];
+} net_fragment_t;
+
+/*
+ * @brief The fragment buffers are allocated only for channels which negotiate
+ * a reliable window.
+ */
+typedef struct {
+	net_fragment_t out[NET_RELIABLE_WINDOW];
+	net_fragment_t in[NET_RELIABLE_WINDOW];
+} net_window_t;
+
 /*
  * @brief The network channel provides a conduit for packet sequencing and
  * optional reliable message delivery. The client and server speak explicitly
@@ -89,6 +130,12 @@ typedef struct {
 
 	uint8_t qport; // to differentiate multiple clients behind NAT
 
+	_Bool compress; // negotiated at connect, packets carry a compression byte
+	_Bool seeded; // both ends hold the same seed dictionary, confirmed at connect
+	const net_dictionary_t *dictionary; // set once both ends hold the same dictionary
+
+	net_window_t *window; // negotiated at connect, reliable messages are fragmented
+
 	// sequencing variables
 	uint32_t incoming_sequence;
 	uint32_t incoming_acknowledged;
@@ -106,6 +153,44 @@ typedef struct {
 	// message is copied to this buffer when it is first transfered
 	size_t reliable_size;
 	byte reliable_buffer[MAX_MSG_SIZE - 16]; // un-acked reliable message
+
+	// or, if a reliable window was negotiated, it is split into fragments
+	uint16_t fragment_outgoing; // sequence of the next fragment to queue
+	uint16_t fragment_acknowledged; // sequence of the oldest unacknowledged fragment
+	uint16_t fragment_incoming; // sequence of the next fragment to deliver
+	_Bool fragment_ack_pending; // fragments were received since our last transmit
+	uint32_t fragment_rtt; // smoothed round trip time, for retransmits
 } net_chan_t;
 
+/*
+ * @brief Packet captures record every datagram sent or received by the
+ * process, so that sessions may be replayed through the parse paths. A
+ * capture is a net_capture_header_t followed by any number of records, each
+ * immediately followed by its datagram. Fields are in host byte order.
+ */
+#define NET_CAPTURE_MAGIC (('P' << 24) | ('A' << 16) | ('C' << 8) | 'Q')
+#define NET_CAPTURE_VERSION 1
+
+typedef struct {
+	int32_t magic;
+	int32_t version;
+} net_capture_header_t;
+
+typedef enum {
+	NET_CAPTURE_RECV,
+	NET_CAPTURE_SEND
+} net_capture_direction_t;
+
+typedef struct {
+	int64_t time; // microseconds since the capture was started
+	uint8_t source; // net_src_t
+	uint8_t direction; // net_capture_direction_t
+	uint8_t type; // net_addr_type_t of the remote address
+	uint8_t pad;
+	in_addr_t addr; // remote address
+	in_port_t port; // and port
+	uint16_t pad2;
+	uint32_t size; // datagram length
+} net_capture_record_t;
+
 #endif /* __NET_TYPES_H__ */
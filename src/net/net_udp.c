@@ -19,13 +19,32 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE // for recvmmsg and sendmmsg
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#define HAVE_MMSG 1
+#define HAVE_EPOLL 1
+#endif
+
 #include <sys/time.h>
 
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_thread.h>
+
 #include "cvar.h"
+#include "filesystem.h"
 #include "net_udp.h"
 
 #define MAX_NET_UDP_LOOPS 4
 
+/*
+ * @brief The number of datagrams received or sent with a single system call.
+ */
+#define NET_UDP_BATCH 16
+
 typedef struct {
 	byte data[MAX_MSG_SIZE];
 	size_t size;
@@ -36,9 +55,35 @@ typedef struct {
 	int32_t send, recv;
 } net_udp_loop_t;
 
+/*
+ * @brief A batch of datagrams, either drained from the socket and awaiting
+ * Net_ReceiveDatagram, or queued by Net_SendDatagram awaiting a flush.
+ */
+typedef struct {
+	byte data[NET_UDP_BATCH][MAX_MSG_SIZE];
+	mem_buf_t buffers[NET_UDP_BATCH];
+	struct sockaddr_in addrs[NET_UDP_BATCH];
+	uint32_t count, index;
+} net_udp_batch_t;
+
 typedef struct {
 	net_udp_loop_t loops[2];
 	int32_t sockets[2];
+
+	net_udp_batch_t recv[2];
+	net_udp_batch_t send[2];
+	_Bool queue[2]; // true while outgoing datagrams are being queued
+	SDL_threadID queue_thread[2]; // by this thread, others send immediately
+	SDL_SpinLock queue_lock; // guards the above, read from several threads
+
+	_Bool mmsg; // false if batched I/O is not supported
+
+	int32_t epoll; // polls the server socket and frame timer
+	int32_t timer; // fires at the server's frame deadline
+
+	file_t *capture; // records every datagram, see Net_StartCapture
+	int64_t capture_start;
+	SDL_SpinLock capture_lock; // datagrams may be captured from several threads
 } net_udp_state_t;
 
 static net_udp_state_t net_udp_state;
@@ -69,10 +114,133 @@ static _Bool Net_ReceiveDatagram_Loop(net_src_t source, net_addr_t *from, mem_bu
 }
 
 /*
- * @brief Receive a datagram on the specified socket, populating the from
- * address with the sender.
+ * @brief Drains up to NET_UDP_BATCH datagrams from the specified socket with
+ * a single system call.
+ *
+ * @return The number of datagrams received.
  */
-_Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
+static uint32_t Net_ReceiveBatch(net_src_t source) {
+	net_udp_batch_t *batch = &net_udp_state.recv[source];
+
+	batch->count = batch->index = 0;
+
+#if defined(HAVE_MMSG)
+	struct mmsghdr msgs[NET_UDP_BATCH];
+	struct iovec iovs[NET_UDP_BATCH];
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (int32_t i = 0; i < NET_UDP_BATCH; i++) {
+		iovs[i].iov_base = batch->data[i];
+		iovs[i].iov_len = sizeof(batch->data[i]);
+
+		msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	const int32_t received = recvmmsg(net_udp_state.sockets[source], msgs, NET_UDP_BATCH, 0, NULL);
+
+	if (received == -1) {
+		const int32_t err = Net_GetError();
+
+		if (err == ENOSYS) {
+			Com_Warn("Batched I/O not supported, falling back\n");
+			net_udp_state.mmsg = false;
+		} else if (err != EWOULDBLOCK && err != ECONNREFUSED) {
+			Com_Warn("%s\n", Net_GetErrorString());
+		}
+
+		return 0;
+	}
+
+	for (int32_t i = 0; i < received; i++) {
+		mem_buf_t *buf = &batch->buffers[i];
+
+		Mem_InitBuffer(buf, batch->data[i], sizeof(batch->data[i]));
+		buf->size = msgs[i].msg_len;
+
+		if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			buf->size = buf->max_size; // flag it as oversized
+		}
+	}
+
+	batch->count = received;
+#endif
+
+	return batch->count;
+}
+
+/*
+ * @brief Receive the next datagram from the batch for the specified socket,
+ * refilling the batch when it is exhausted.
+ */
+static _Bool Net_ReceiveDatagram_Batch(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
+	net_udp_batch_t *batch = &net_udp_state.recv[source];
+
+	while (true) {
+
+		if (batch->index == batch->count) {
+			if (Net_ReceiveBatch(source) == 0)
+				return false;
+		}
+
+		const uint32_t i = batch->index++;
+
+		from->addr = batch->addrs[i].sin_addr.s_addr;
+		from->port = batch->addrs[i].sin_port;
+
+		const mem_buf_t *in = &batch->buffers[i];
+
+		if (in->size == in->max_size || in->size >= buf->max_size) {
+			Com_Warn("Oversized packet from %s\n", Net_NetaddrToString(from));
+			continue;
+		}
+
+		memcpy(buf->data, in->data, in->size);
+		buf->size = in->size;
+
+		return true;
+	}
+}
+
+/*
+ * @brief Appends the given datagram to the packet capture.
+ */
+static void Net_CaptureDatagram(net_src_t source, net_capture_direction_t direction,
+		const net_addr_t *addr, const void *data, size_t len) {
+
+	const net_capture_record_t record = {
+		.time = g_get_monotonic_time() - net_udp_state.capture_start,
+		.source = source,
+		.direction = direction,
+		.type = addr->type,
+		.addr = addr->addr,
+		.port = addr->port,
+		.size = len
+	};
+
+	SDL_AtomicLock(&net_udp_state.capture_lock);
+
+	_Bool ok = true;
+	if (net_udp_state.capture) {
+		ok = Fs_Write(net_udp_state.capture, &record, sizeof(record), 1) == 1 &&
+				Fs_Write(net_udp_state.capture, data, len, 1) == 1;
+	}
+
+	SDL_AtomicUnlock(&net_udp_state.capture_lock);
+
+	if (!ok) {
+		Com_Warn("Failed to write packet capture, stopping\n");
+		Net_StopCapture();
+	}
+}
+
+/*
+ * @brief Receive a datagram from the loopback or the specified socket.
+ */
+static _Bool Net_ReceiveDatagram_(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
 
 	buf->read = buf->size = 0;
 
@@ -87,6 +255,10 @@ _Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
 	if (!sock)
 		return false;
 
+	if (net_udp_state.mmsg) {
+		return Net_ReceiveDatagram_Batch(source, from, buf);
+	}
+
 	struct sockaddr_in addr;
 	socklen_t addr_len = sizeof(addr);
 
@@ -119,6 +291,22 @@ _Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
 	return true;
 }
 
+/*
+ * @brief Receive a datagram on the specified socket, populating the from
+ * address with the sender.
+ */
+_Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
+
+	if (!Net_ReceiveDatagram_(source, from, buf))
+		return false;
+
+	if (net_udp_state.capture) {
+		Net_CaptureDatagram(source, NET_CAPTURE_RECV, from, buf->data, buf->size);
+	}
+
+	return true;
+}
+
 /*
  * @brief
  */
@@ -134,11 +322,128 @@ static _Bool Net_SendDatagram_Loop(net_src_t source, const void *data, size_t le
 	return true;
 }
 
+/*
+ * @brief Sends the datagrams queued for the specified socket with as few
+ * system calls as possible.
+ */
+static void Net_SendBatch(net_src_t source) {
+	net_udp_batch_t *batch = &net_udp_state.send[source];
+
+#if defined(HAVE_MMSG)
+	struct mmsghdr msgs[NET_UDP_BATCH];
+	struct iovec iovs[NET_UDP_BATCH];
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (uint32_t i = 0; i < batch->count; i++) {
+		iovs[i].iov_base = batch->buffers[i].data;
+		iovs[i].iov_len = batch->buffers[i].size;
+
+		msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	const int32_t sock = net_udp_state.sockets[source];
+
+	uint32_t i = 0;
+	while (sock && i < batch->count) {
+		int32_t sent;
+
+		if (net_udp_state.mmsg) {
+			sent = sendmmsg(sock, msgs + i, batch->count - i, 0);
+
+			if (sent == -1 && Net_GetError() == ENOSYS) {
+				Com_Warn("Batched I/O not supported, falling back\n");
+				net_udp_state.mmsg = false;
+				continue;
+			}
+		} else {
+			sent = sendto(sock, iovs[i].iov_base, iovs[i].iov_len, 0,
+					(const struct sockaddr *) &batch->addrs[i], sizeof(batch->addrs[i]));
+			sent = sent == -1 ? -1 : 1;
+		}
+
+		if (sent == -1) { // skip the offending datagram, and carry on
+			net_addr_t to = { .type = NA_DATAGRAM };
+
+			to.addr = batch->addrs[i].sin_addr.s_addr;
+			to.port = batch->addrs[i].sin_port;
+
+			Com_Warn("%s to %s\n", Net_GetErrorString(), Net_NetaddrToString(&to));
+			i++;
+		} else {
+			i += sent;
+		}
+	}
+#endif
+
+	batch->count = 0;
+}
+
+/*
+ * @brief Queues a datagram to be sent by Net_FlushDatagrams, flushing the
+ * queue first if it is full.
+ */
+static _Bool Net_SendDatagram_Queue(net_src_t source, const net_addr_t *to, const void *data, size_t len) {
+	net_udp_batch_t *batch = &net_udp_state.send[source];
+
+	if (batch->count == NET_UDP_BATCH) {
+		Net_SendBatch(source);
+	}
+
+	const uint32_t i = batch->count++;
+
+	memcpy(batch->data[i], data, len);
+	Mem_InitBuffer(&batch->buffers[i], batch->data[i], sizeof(batch->data[i]));
+	batch->buffers[i].size = len;
+
+	Net_NetAddrToSockaddr(to, &batch->addrs[i]);
+
+	return true;
+}
+
+/*
+ * @brief Queues datagrams sent on the specified socket by the calling thread
+ * until they are flushed with Net_FlushDatagrams, so that they are sent with
+ * as few system calls as possible. Without batched I/O, or from any other
+ * thread, datagrams are sent immediately.
+ */
+void Net_QueueDatagrams(net_src_t source) {
+
+	if (net_udp_state.mmsg) {
+		SDL_AtomicLock(&net_udp_state.queue_lock);
+
+		net_udp_state.queue_thread[source] = SDL_ThreadID();
+		net_udp_state.queue[source] = true;
+
+		SDL_AtomicUnlock(&net_udp_state.queue_lock);
+	}
+}
+
+/*
+ * @brief Sends any datagrams queued for the specified socket, and stops
+ * queueing.
+ */
+void Net_FlushDatagrams(net_src_t source) {
+
+	Net_SendBatch(source);
+
+	SDL_AtomicLock(&net_udp_state.queue_lock);
+	net_udp_state.queue[source] = false;
+	SDL_AtomicUnlock(&net_udp_state.queue_lock);
+}
+
 /*
  * @brief Send a datagram to the specified address.
  */
 _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data, size_t len) {
 
+	if (net_udp_state.capture) {
+		Net_CaptureDatagram(source, NET_CAPTURE_SEND, to, data, len);
+	}
+
 	if (to->type == NA_LOOP) {
 		return Net_SendDatagram_Loop(source, data, len);
 	}
@@ -151,6 +456,16 @@ _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data,
 		Com_Error(ERR_DROP, "Bad address type\n");
 	}
 
+	SDL_AtomicLock(&net_udp_state.queue_lock);
+
+	const _Bool queue = net_udp_state.queue[source] && net_udp_state.queue_thread[source] == SDL_ThreadID();
+
+	SDL_AtomicUnlock(&net_udp_state.queue_lock);
+
+	if (queue) {
+		return Net_SendDatagram_Queue(source, to, data, len);
+	}
+
 	struct sockaddr_in to_addr;
 	Net_NetAddrToSockaddr(to, &to_addr);
 
@@ -164,6 +479,65 @@ _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data,
 	return true;
 }
 
+/*
+ * @brief Starts capturing every datagram sent or received to the specified
+ * file, replacing any capture in progress. See net_capture_record_t.
+ *
+ * @return True if the capture was started, false otherwise.
+ */
+_Bool Net_StartCapture(const char *filename) {
+
+	Net_StopCapture();
+
+	file_t *file = Fs_OpenWrite(filename);
+	if (!file) {
+		Com_Warn("Failed to open %s\n", filename);
+		return false;
+	}
+
+	const net_capture_header_t header = {
+		.magic = NET_CAPTURE_MAGIC,
+		.version = NET_CAPTURE_VERSION
+	};
+
+	if (Fs_Write(file, &header, sizeof(header), 1) != 1) {
+		Com_Warn("Failed to write %s\n", filename);
+		Fs_Close(file);
+		return false;
+	}
+
+	SDL_AtomicLock(&net_udp_state.capture_lock);
+
+	net_udp_state.capture = file;
+	net_udp_state.capture_start = g_get_monotonic_time();
+
+	SDL_AtomicUnlock(&net_udp_state.capture_lock);
+
+	return true;
+}
+
+/*
+ * @brief Stops the packet capture in progress, if any.
+ */
+void Net_StopCapture(void) {
+
+	SDL_AtomicLock(&net_udp_state.capture_lock);
+
+	if (net_udp_state.capture) {
+		Fs_Close(net_udp_state.capture);
+		net_udp_state.capture = NULL;
+	}
+
+	SDL_AtomicUnlock(&net_udp_state.capture_lock);
+}
+
+/*
+ * @return True if a packet capture is in progress.
+ */
+_Bool Net_Capturing(void) {
+	return net_udp_state.capture != NULL;
+}
+
 /*
  * @brief Sleeps for msec or until the server socket is ready.
  */
@@ -186,6 +560,120 @@ void Net_Sleep(uint32_t msec) {
 	select(sock + 1, &fdset, NULL, NULL, &timeout);
 }
 
+/*
+ * @brief Sleeps until the server socket is readable, or until the specified
+ * deadline, in microseconds of g_get_monotonic_time, is reached. On Linux, the
+ * deadline is armed on a timerfd and waited on with epoll alongside the socket.
+ *
+ * @return True if the server socket is readable, false if the deadline was
+ * reached or the wait was interrupted.
+ */
+_Bool Net_WaitUntil(int64_t deadline) {
+
+	const int32_t sock = net_udp_state.sockets[NS_UDP_SERVER];
+
+	if (!sock)
+		return false;
+
+	const net_udp_batch_t *batch = &net_udp_state.recv[NS_UDP_SERVER];
+	if (batch->index < batch->count)
+		return true; // already drained from the socket, but not yet read
+
+#if defined(HAVE_EPOLL)
+	if (net_udp_state.epoll) {
+		const struct itimerspec spec = {
+			.it_value = {
+				.tv_sec = deadline / 1000000,
+				.tv_nsec = (deadline % 1000000) * 1000
+			}
+		};
+
+		if (timerfd_settime(net_udp_state.timer, TFD_TIMER_ABSTIME, &spec, NULL) == 0) {
+			struct epoll_event events[2];
+			_Bool readable = false;
+
+			const int32_t count = epoll_wait(net_udp_state.epoll, events, lengthof(events), -1);
+
+			for (int32_t i = 0; i < count; i++) {
+				uint64_t expirations;
+
+				if (events[i].data.fd == sock) {
+					readable = true;
+				} else if (read(net_udp_state.timer, &expirations, sizeof(expirations)) == -1) {
+					Com_Debug("%s\n", Net_GetErrorString()); // re-armed since it fired
+				}
+			}
+
+			return readable;
+		}
+	}
+#endif
+
+	const int64_t usec = deadline - g_get_monotonic_time();
+
+	if (usec <= 0)
+		return false;
+
+	struct timeval timeout;
+	fd_set fdset;
+
+	FD_ZERO(&fdset);
+	FD_SET(sock, &fdset);
+
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
+
+	return select(sock + 1, &fdset, NULL, NULL, &timeout) > 0;
+}
+
+/*
+ * @brief Creates the epoll instance and frame timer for the server socket.
+ */
+static void Net_InitWait(int32_t sock) {
+
+#if defined(HAVE_EPOLL)
+	const int32_t epoll = epoll_create1(EPOLL_CLOEXEC);
+	const int32_t timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (epoll != -1 && timer != -1) {
+		struct epoll_event event = { .events = EPOLLIN };
+
+		event.data.fd = sock;
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, sock, &event) == 0) {
+
+			event.data.fd = timer;
+			if (epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event) == 0) {
+				net_udp_state.epoll = epoll;
+				net_udp_state.timer = timer;
+				return;
+			}
+		}
+	}
+
+	Com_Warn("Failed to create frame timer, falling back to select: %s\n", Net_GetErrorString());
+
+	if (epoll != -1)
+		close(epoll);
+	if (timer != -1)
+		close(timer);
+#endif
+}
+
+/*
+ * @brief Closes the epoll instance and frame timer, if any.
+ */
+static void Net_ShutdownWait(void) {
+
+#if defined(HAVE_EPOLL)
+	if (net_udp_state.epoll) {
+		close(net_udp_state.epoll);
+		close(net_udp_state.timer);
+	}
+#endif
+
+	net_udp_state.epoll = net_udp_state.timer = 0;
+}
+
 /*
  * @brief Opens or closes the managed UDP socket for the given net_src_t. The
  * interface and port are resolved from immutable console variables, optionally
@@ -204,8 +692,27 @@ void Net_Config(net_src_t source, _Bool up) {
 			const in_port_t port = source == NS_UDP_SERVER ? net_port->integer : 0;
 
 			*sock = Net_Socket(NA_DATAGRAM, iface, port);
+
+#if defined(HAVE_MMSG)
+			net_udp_state.mmsg = true;
+#endif
+
+			if (*sock && source == NS_UDP_SERVER) {
+				Net_InitWait(*sock);
+			}
 		}
 	} else {
+		if (source == NS_UDP_SERVER) {
+			Net_ShutdownWait();
+		}
+
+		net_udp_state.recv[source].count = net_udp_state.recv[source].index = 0;
+		net_udp_state.send[source].count = 0;
+
+		SDL_AtomicLock(&net_udp_state.queue_lock);
+		net_udp_state.queue[source] = false;
+		SDL_AtomicUnlock(&net_udp_state.queue_lock);
+
 		if (*sock != 0) {
 			Net_CloseSocket(*sock);
 			*sock = 0;
@@ -26,8 +26,15 @@
 
 _Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf);
 _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data, size_t len);
+void Net_QueueDatagrams(net_src_t source);
+void Net_FlushDatagrams(net_src_t source);
+
+_Bool Net_StartCapture(const char *filename);
+void Net_StopCapture(void);
+_Bool Net_Capturing(void);
 
 void Net_Config(net_src_t source, _Bool up);
 void Net_Sleep(uint32_t msec);
+_Bool Net_WaitUntil(int64_t deadline);
 
 #endif /* __NET_UDP_H__ */
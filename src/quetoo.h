@@ -152,6 +152,7 @@ typedef enum {
 	MEM_TAG_UI,
 	MEM_TAG_CGAME,
 	MEM_TAG_CGAME_LEVEL,
+	MEM_TAG_TOTAL,
 	MEM_TAG_ALL = -1
 } mem_tag_t;
 
@@ -205,7 +206,7 @@ typedef enum {
 	SV_CMD_CBUF_TEXT, // [string] stuffed into client's console buffer, should be \n terminated
 	SV_CMD_CONFIG_STRING, // [short] [string]
 	SV_CMD_DISCONNECT,
-	SV_CMD_DOWNLOAD, // [short] size [size bytes]
+	SV_CMD_DOWNLOAD, // [short] size [byte] percent [size bytes], or see DOWNLOAD_STREAM
 	SV_CMD_FRAME,
 	SV_CMD_PRINT, // [byte] id [string] null terminated string
 	SV_CMD_RECONNECT,
@@ -214,6 +215,20 @@ typedef enum {
 	SV_CMD_CGAME, // the game may extend from here
 } sv_packet_cmd_t;
 
+/*
+ * @brief Negative SV_CMD_DOWNLOAD sizes. Clients may request that a download be
+ * streamed, in which case the server replies with DOWNLOAD_STREAM, and then
+ * sends the file as unreliable chunks. The client acknowledges the contiguous
+ * offset it has written, and the chunks it holds beyond it, with download_ack,
+ * in batches rather than for every packet.
+ */
+#define DOWNLOAD_UNAVAILABLE	-1 // [byte] 0
+#define DOWNLOAD_STREAM			-2 // [long] file length
+#define DOWNLOAD_STREAM_CHUNK	-3 // [long] offset [short] length [length bytes]
+
+#define DOWNLOAD_CHUNK_SIZE		1024
+#define DOWNLOAD_WINDOW			64 // chunks in flight, and the width of the acknowledgement
+
 /*
  * @brief Client protocol commands. The game and client game module are free
  * to implement custom commands as well (8 bits).
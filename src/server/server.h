@@ -32,13 +32,18 @@
 #include "sv_admin.h"
 #include "sv_console.h"
 #include "sv_client.h"
+#include "sv_delta.h"
 #include "sv_entity.h"
 #include "sv_game.h"
+#include "sv_grid.h"
+#include "sv_hash.h"
+#include "sv_ingress.h"
 #include "sv_init.h"
 #include "sv_main.h"
 #include "sv_master.h"
 #include "sv_send.h"
 #include "sv_types.h"
+#include "sv_vis.h"
 #include "sv_world.h"
 
 #endif /* __SERVER_H__ */
@@ -241,6 +241,135 @@ static void Sv_ListEntities_f(void) {
 	}
 }
 
+/*
+ * @brief Prints the hit rates of the cluster visibility cache, optionally
+ * clearing them.
+ */
+static void Sv_VisStats_f(void) {
+	sv_vis_stats_t stats;
+
+	if (!svs.initialized) {
+		Com_Print("No server running\n");
+		return;
+	}
+
+	Sv_VisStats(&stats);
+
+	const struct {
+		const char *name;
+		uint32_t hits, misses;
+	} rows[] = {
+		{ "pvs", stats.pvs_hits, stats.pvs_misses },
+		{ "phs", stats.phs_hits, stats.phs_misses },
+		{ "entities", stats.entities_hits, stats.entities_misses }
+	};
+
+	Com_Print("cache    hits       misses     rate\n");
+	Com_Print("-------- ---------- ---------- ------\n");
+
+	for (size_t i = 0; i < lengthof(rows); i++) {
+		const uint32_t total = rows[i].hits + rows[i].misses;
+		const vec_t rate = total ? 100.0 * rows[i].hits / total : 0.0;
+
+		Com_Print("%-8s %10u %10u %5.1f%%\n", rows[i].name, rows[i].hits, rows[i].misses, rate);
+	}
+
+	if (Cmd_Argc() > 1 && !g_strcmp0(Cmd_Argv(1), "clear")) {
+		Sv_ClearVisStats();
+	}
+}
+
+/*
+ * @brief Prints the average work done by each collision trace, optionally
+ * clearing the statistics.
+ */
+static void Sv_TraceStats_f(void) {
+	cm_trace_stats_t stats;
+
+	if (!svs.initialized) {
+		Com_Print("No server running\n");
+		return;
+	}
+
+	if (!sv_debug_traces->integer) {
+		Com_Print("Set sv_debug_traces 1 to collect collision statistics\n");
+		return;
+	}
+
+	Cm_TraceStats(&stats);
+
+	const vec_t traces = stats.traces ? stats.traces : 1.0;
+
+	Com_Print("%u traces, per trace:\n", stats.traces);
+	Com_Print("  nodes    %8.2f\n", stats.nodes / traces);
+	Com_Print("  leafs    %8.2f\n", stats.leafs / traces);
+	Com_Print("  brushes  %8.2f\n", stats.brushes / traces);
+	Com_Print("  skipped  %8.2f\n", stats.brushes_skipped / traces);
+
+	if (Cmd_Argc() > 1 && !g_strcmp0(Cmd_Argv(1), "clear")) {
+		Cm_ClearTraceStats();
+	}
+}
+
+/*
+ * @brief Compares frame timing samples for sorting.
+ */
+static int32_t Sv_FrameStats_Compare(const void *a, const void *b) {
+	const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * @brief Prints percentiles of how late recent frames began, relative to their
+ * scheduled deadlines. Only dedicated servers are paced to deadlines.
+ */
+static void Sv_FrameStats_f(void) {
+	uint32_t samples[SV_FRAME_TIMING_SAMPLES];
+
+	if (!svs.initialized) {
+		Com_Print("No server running\n");
+		return;
+	}
+
+	const uint32_t count = MIN(svs.frame_count, (uint32_t) SV_FRAME_TIMING_SAMPLES);
+
+	if (count == 0) {
+		Com_Print("No frame timing available\n");
+		return;
+	}
+
+	memcpy(samples, svs.frame_jitter, count * sizeof(uint32_t));
+	qsort(samples, count, sizeof(uint32_t), Sv_FrameStats_Compare);
+
+	Com_Print("Frame jitter over %u frames at %uHz (microseconds late):\n", count, svs.frame_rate);
+
+	const vec_t percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+	for (size_t i = 0; i < lengthof(percentiles); i++) {
+		const uint32_t index = MIN((uint32_t) (count * percentiles[i] / 100.0), count - 1);
+		Com_Print("  p%-5g %8u\n", percentiles[i], samples[index]);
+	}
+
+	Com_Print("  max    %8u\n", samples[count - 1]);
+
+	const uint32_t hits = SDL_AtomicGet(&svs.entity_delta_hits);
+	const uint32_t misses = SDL_AtomicGet(&svs.entity_delta_misses);
+
+	if (hits + misses) {
+		Com_Print("Entity deltas: %u encoded, %u shared (%.1f%%)\n", misses, hits,
+				100.0 * hits / (hits + misses));
+	}
+
+	const uint32_t answered = SDL_AtomicGet(&svs.ingress_answered);
+	const uint32_t limited = SDL_AtomicGet(&svs.ingress_limited);
+	const uint32_t overflowed = SDL_AtomicGet(&svs.ingress_overflowed);
+
+	if (answered + limited + overflowed) {
+		Com_Print("Ingress: %u queries answered, %u rate limited, %u dropped on overflow\n",
+				answered, limited, overflowed);
+	}
+}
+
 /*
  * @brief
  */
@@ -381,6 +510,11 @@ void Sv_InitAdmin(void) {
 	Cmd_Add("list_entities", Sv_ListEntities_f, CMD_SERVER, "List all entities in use");
 	Cmd_Add("server_info", Sv_ServerInfo_f, CMD_SERVER, "Print server info settings");
 	Cmd_Add("user_info", Sv_UserInfo_f, CMD_SERVER, "Print information for a given user");
+	Cmd_Add("sv_frame_stats", Sv_FrameStats_f, CMD_SERVER, "Print frame timing jitter percentiles");
+	Cmd_Add("sv_vis_stats", Sv_VisStats_f, CMD_SERVER,
+			"Print visibility cache hit rates; pass \"clear\" to reset them");
+	Cmd_Add("sv_trace_stats", Sv_TraceStats_f, CMD_SERVER,
+			"Print collision statistics per trace; pass \"clear\" to reset them");
 
 	Cmd_Add("demo", Sv_Demo_f, CMD_SERVER, "Start playback of the specified demo file");
 	Cmd_Add("map", Sv_Map_f, CMD_SERVER, "Start a server for the specified map");
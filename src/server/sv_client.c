@@ -34,6 +34,9 @@ static void Sv_New_f(void) {
 		return;
 	}
 
+	// the level's config strings are about to change, so fall back to the seed
+	sv_client->net_chan.dictionary = NULL;
+
 	// demo servers will send the demo file's server info packet
 	if (sv.state == SV_ACTIVE_DEMO) {
 		return;
@@ -41,7 +44,7 @@ static void Sv_New_f(void) {
 
 	// send the server data
 	Net_WriteByte(&sv_client->net_chan.message, SV_CMD_SERVER_DATA);
-	Net_WriteShort(&sv_client->net_chan.message, PROTOCOL_MAJOR);
+	Net_WriteShort(&sv_client->net_chan.message, sv_client->protocol);
 	Net_WriteShort(&sv_client->net_chan.message, svs.game->protocol);
 	Net_WriteLong(&sv_client->net_chan.message, svs.spawn_count);
 	Net_WriteLong(&sv_client->net_chan.message, svs.frame_rate);
@@ -132,6 +135,18 @@ static void Sv_Baselines_f(void) {
 
 	start = strtoul(Cmd_Argv(2), NULL, 0);
 
+	// compress the baselines, and all that follows, against the config strings
+	// if the client's dictionary matches ours
+	if (start == 0 && sv_client->net_chan.compress && Cmd_Argc() > 3) {
+		Netchan_BuildDictionary(&sv_client->dictionary, sv.config_strings, MAX_CONFIG_STRINGS);
+
+		if (strtoul(Cmd_Argv(3), NULL, 0) == sv_client->dictionary.checksum) {
+			sv_client->net_chan.dictionary = &sv_client->dictionary;
+		} else {
+			Com_Debug("Dictionary mismatch for %s\n", Sv_NetaddrToString(sv_client));
+		}
+	}
+
 	memset(&null_state, 0, sizeof(null_state));
 
 	// write a packet full of data
@@ -186,6 +201,40 @@ static void Sv_Begin_f(void) {
 	Cbuf_InsertFromDefer();
 }
 
+/*
+ * @brief Reads the specified chunk of the client's download into msg.
+ *
+ * @return True on success, false if the file could not be read.
+ */
+static _Bool Sv_ReadDownloadChunk(sv_client_t *cl, mem_buf_t *msg, int32_t offset, int32_t len) {
+	sv_client_download_t *download = &cl->download;
+
+	if (msg->size + len > msg->max_size)
+		return false;
+
+	// chunks are usually read in order, and seeking within archives is costly
+	if (Fs_Tell(download->file) != offset && !Fs_Seek(download->file, offset))
+		return false;
+
+	if (Fs_Read(download->file, msg->data + msg->size, 1, len) != len)
+		return false;
+
+	msg->size += len;
+	return true;
+}
+
+/*
+ * @brief Closes the client's download, if any.
+ */
+void Sv_CloseDownload(sv_client_t *cl) {
+
+	if (cl->download.file) {
+		Fs_Close(cl->download.file);
+	}
+
+	memset(&cl->download, 0, sizeof(cl->download));
+}
+
 /*
  * @brief
  */
@@ -195,12 +244,12 @@ static void Sv_NextDownload_f(void) {
 
 	sv_client_download_t *download = &sv_client->download;
 
-	if (!download->buffer)
+	if (!download->file || download->stream)
 		return;
 
 	Mem_InitBuffer(&msg, buf, sizeof(buf));
 
-	int32_t len = Clamp(download->size - download->count, 0, 1024);
+	int32_t len = Clamp(download->size - download->count, 0, DOWNLOAD_CHUNK_SIZE);
 
 	Net_WriteByte(&msg, SV_CMD_DOWNLOAD);
 	Net_WriteShort(&msg, len);
@@ -208,16 +257,131 @@ static void Sv_NextDownload_f(void) {
 	int32_t percent = download->count * 100 / (Clamp(download->size, 1, download->size));
 	Net_WriteByte(&msg, percent);
 
-	Mem_WriteBuffer(&msg, download->buffer + download->count, len);
+	if (!Sv_ReadDownloadChunk(sv_client, &msg, download->count, len)) {
+		Com_Warn("Failed to read download for %s\n", Sv_NetaddrToString(sv_client));
+		Sv_CloseDownload(sv_client);
+		return;
+	}
+
 	Mem_WriteBuffer(&sv_client->net_chan.message, msg.data, msg.size);
 
 	download->count += len;
 
 	if (download->count == download->size) {
 		Com_Debug("Finished download to %s\n", Sv_NetaddrToString(sv_client));
+		Sv_CloseDownload(sv_client);
+	}
+}
+
+/*
+ * @brief Sends the chunks of the client's streamed download which are due,
+ * limited by the window and by sv_udp_download_rate (and the client's rate).
+ * Chunks are resent if they are not acknowledged within twice the round trip
+ * time. This is called once per server frame, after the frame itself.
+ */
+void Sv_SendClientDownload(sv_client_t *cl) {
+	byte buf[MAX_MSG_SIZE - 16];
+	mem_buf_t msg;
+
+	sv_client_download_t *download = &cl->download;
+
+	if (!download->file || !download->stream)
+		return;
+
+	uint32_t rate = sv_udp_download_rate->integer;
+	if (cl->rate && cl->rate < rate)
+		rate = cl->rate;
+
+	const size_t budget = MAX(rate / svs.frame_rate, (uint32_t) DOWNLOAD_CHUNK_SIZE);
+
+	uint32_t rto = cl->net_chan.fragment_rtt ? cl->net_chan.fragment_rtt * 2 : 250;
+	rto = Clamp(rto, 100, 1000);
+
+	Mem_InitBuffer(&msg, buf, MIN(sizeof(buf), budget + 64));
+
+	for (int32_t i = 0; i < DOWNLOAD_WINDOW; i++) {
+		const int32_t offset = download->count + i * DOWNLOAD_CHUNK_SIZE;
+
+		if (offset >= download->size)
+			break;
+
+		const uint64_t bit = 1ull << i;
+
+		if (download->acked & bit)
+			continue;
+
+		if ((download->sent & bit) && quetoo.time - download->sent_time[i] < rto)
+			continue;
+
+		const int32_t len = MIN(download->size - offset, DOWNLOAD_CHUNK_SIZE);
+
+		if (msg.size + 7 + len > msg.max_size)
+			break;
+
+		Net_WriteByte(&msg, SV_CMD_DOWNLOAD);
+		Net_WriteShort(&msg, DOWNLOAD_STREAM_CHUNK);
+		Net_WriteLong(&msg, offset);
+		Net_WriteShort(&msg, len);
+
+		if (!Sv_ReadDownloadChunk(cl, &msg, offset, len)) {
+			Com_Warn("Failed to read download for %s\n", Sv_NetaddrToString(cl));
+			Sv_CloseDownload(cl);
+			return;
+		}
+
+		download->sent |= bit;
+		download->sent_time[i] = quetoo.time;
+	}
+
+	if (msg.size) {
+		Netchan_Transmit(&cl->net_chan, msg.data, msg.size);
 
-		Fs_Free(download->buffer);
-		download->buffer = NULL;
+		// count it against the client's rate, along with the frame
+		cl->frame_size[sv.frame_num % sv_hz->integer] += msg.size;
+	}
+}
+
+/*
+ * @brief The client acknowledges the contiguous offset of a streamed download
+ * which it has written, and the chunks beyond it which it holds. The window
+ * slides forward, and chunks which were not acknowledged are resent when their
+ * timers expire. See Sv_SendClientDownload.
+ */
+static void Sv_DownloadAck_f(void) {
+
+	sv_client_download_t *download = &sv_client->download;
+
+	if (!download->file || !download->stream)
+		return;
+
+	const int32_t offset = strtol(Cmd_Argv(1), NULL, 0);
+	const uint64_t acked = strtoull(Cmd_Argv(2), NULL, 0);
+
+	if (offset < download->count || offset > download->size) {
+		return; // stale
+	}
+
+	if (offset < download->size && (offset - download->count) % DOWNLOAD_CHUNK_SIZE) {
+		Com_Warn("Invalid offset (%d) from %s\n", offset, Sv_NetaddrToString(sv_client));
+		return;
+	}
+
+	const int32_t n = (offset - download->count + DOWNLOAD_CHUNK_SIZE - 1) / DOWNLOAD_CHUNK_SIZE;
+
+	if (n >= DOWNLOAD_WINDOW) {
+		download->sent = 0;
+	} else if (n) {
+		download->sent >>= n;
+		memmove(download->sent_time, download->sent_time + n,
+				(DOWNLOAD_WINDOW - n) * sizeof(download->sent_time[0]));
+	}
+
+	download->count = offset;
+	download->acked = acked;
+
+	if (download->count == download->size) {
+		Com_Debug("Finished download to %s\n", Sv_NetaddrToString(sv_client));
+		Sv_CloseDownload(sv_client);
 	}
 }
 
@@ -258,27 +422,26 @@ static void Sv_Download_f(void) {
 
 	if (!sv_udp_download->value) { // ensure server wishes to allow
 		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_DOWNLOAD);
-		Net_WriteShort(&sv_client->net_chan.message, -1);
+		Net_WriteShort(&sv_client->net_chan.message, DOWNLOAD_UNAVAILABLE);
 		Net_WriteByte(&sv_client->net_chan.message, 0);
 		return;
 	}
 
 	sv_client_download_t *download = &sv_client->download;
 
-	if (download->buffer) { // free last download
-		Fs_Free(download->buffer);
-	}
-
-	memset(download, 0, sizeof(*download));
+	Sv_CloseDownload(sv_client); // close last download
 
-	// try to load the file
-	download->size = (int32_t) Fs_Load(filename, (void *) &download->buffer);
+	// try to open the file, and take its length from the handle
+	if ((download->file = Fs_OpenRead(filename))) {
+		download->size = (int32_t) Fs_Length(download->file);
+	}
 
-	if (download->size == -1) {
+	if (!download->file || download->size < 0) {
 		Com_Warn("Couldn't download %s to %s\n", filename, Sv_NetaddrToString(sv_client));
 		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_DOWNLOAD);
-		Net_WriteShort(&sv_client->net_chan.message, -1);
+		Net_WriteShort(&sv_client->net_chan.message, DOWNLOAD_UNAVAILABLE);
 		Net_WriteByte(&sv_client->net_chan.message, 0);
+		Sv_CloseDownload(sv_client);
 		return;
 	}
 
@@ -291,8 +454,23 @@ static void Sv_Download_f(void) {
 		}
 	}
 
-	Sv_NextDownload_f();
 	Com_Debug("Downloading %s to %s\n", filename, sv_client->name);
+
+	// newer clients may ask that the file be streamed, see Sv_SendClientDownload
+	if (Cmd_Argc() > 3 && !g_strcmp0(Cmd_Argv(3), "stream")) {
+		download->stream = true;
+
+		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_DOWNLOAD);
+		Net_WriteShort(&sv_client->net_chan.message, DOWNLOAD_STREAM);
+		Net_WriteLong(&sv_client->net_chan.message, download->size);
+
+		if (download->count == download->size) {
+			Sv_CloseDownload(sv_client);
+		}
+		return;
+	}
+
+	Sv_NextDownload_f();
 }
 
 /*
@@ -340,6 +518,7 @@ sv_user_string_cmd_t sv_user_string_cmds[] = { // mapping command names to their
 	{ "info", Sv_Info_f },
 	{ "download", Sv_Download_f },
 	{ "next_download", Sv_NextDownload_f },
+	{ "download_ack", Sv_DownloadAck_f },
 	{ NULL, NULL }
 };
 
@@ -422,20 +601,22 @@ void Sv_ParseClientMessage(sv_client_t *cl) {
 					return; // someone is trying to cheat
 				}
 
-				const int32_t last_frame = Net_ReadLong(&net_message);
-				if (last_frame != cl->last_frame) {
-					cl->last_frame = last_frame;
+				net_move_t move;
+				if (!Net_ReadMove(&net_message, &move)) {
+					break; // truncated, the client is dropped above
+				}
+
+				if (move.last_frame != cl->last_frame) {
+					cl->last_frame = move.last_frame;
 					if (cl->last_frame > -1) {
 						cl->frame_latency[cl->last_frame & (SV_CLIENT_LATENCY_COUNT - 1)] =
 								quetoo.time - cl->frames[cl->last_frame & PACKET_MASK].sent_time;
 					}
 				}
 
-				static pm_cmd_t null_cmd;
-				pm_cmd_t oldest_cmd, old_cmd, new_cmd;
-				Net_ReadDeltaMoveCmd(&net_message, &null_cmd, &oldest_cmd);
-				Net_ReadDeltaMoveCmd(&net_message, &oldest_cmd, &old_cmd);
-				Net_ReadDeltaMoveCmd(&net_message, &old_cmd, &new_cmd);
+				pm_cmd_t *oldest_cmd = &move.cmds[0];
+				pm_cmd_t *old_cmd = &move.cmds[1];
+				pm_cmd_t *new_cmd = &move.cmds[2];
 
 				// don't start delta compression until the client is spawned
 				// TODO: should this be a little higher up?
@@ -451,12 +632,12 @@ void Sv_ParseClientMessage(sv_client_t *cl) {
 						net_drop--;
 					}
 					if (net_drop > 1)
-						Sv_ClientThink(cl, &oldest_cmd);
+						Sv_ClientThink(cl, oldest_cmd);
 					if (net_drop > 0)
-						Sv_ClientThink(cl, &old_cmd);
+						Sv_ClientThink(cl, old_cmd);
 				}
-				Sv_ClientThink(cl, &new_cmd);
-				cl->last_cmd = new_cmd;
+				Sv_ClientThink(cl, new_cmd);
+				cl->last_cmd = *new_cmd;
 				break;
 
 			case CL_CMD_STRING:
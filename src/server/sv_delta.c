@@ -0,0 +1,146 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sv_local.h"
+
+#define SV_DELTA_READY		0x1
+#define SV_DELTA_VALID		0x2
+#define SV_DELTA_PACKED		0x4
+
+/*
+ * @brief The key of an entity delta for the current frame. The delta age is the
+ * number of frames since the delta frame, or 0 for deltas from the baseline.
+ */
+static int32_t Sv_EntityDeltaKey(const uint32_t age, const _Bool packed) {
+	return ((sv.frame_num & 0xffff) << 16) | (age << 8) | (packed ? SV_DELTA_PACKED : 0) | SV_DELTA_VALID;
+}
+
+/*
+ * @brief Encodes the delta to the cache slot, without its entity number for the
+ * bit packed protocol, as that depends on the entity written before it.
+ */
+static void Sv_EncodeEntityDelta(sv_entity_delta_t *delta, const _Bool packed,
+		const entity_state_t *from, const entity_state_t *to, _Bool force) {
+	mem_buf_t buf;
+
+	Mem_InitBuffer(&buf, delta->data, sizeof(delta->data));
+
+	delta->from = *from;
+	delta->to = *to;
+
+	if (packed) {
+		const uint16_t flags = Net_DeltaEntityFlags(from, to);
+
+		if (flags || force) {
+			mem_bits_t bits;
+
+			Mem_BeginBits(&bits, &buf);
+			Net_WriteDeltaEntityFieldsBits(&bits, flags, from, to);
+
+			delta->count = buf.size * 8 + bits.count;
+			Mem_EndWriteBits(&bits);
+		} else {
+			delta->count = 0;
+		}
+	} else {
+		Net_WriteDeltaEntity(&buf, from, to, force);
+		delta->count = buf.size * 8;
+	}
+}
+
+/*
+ * @brief Writes the encoded delta to the message, or to the bit stream.
+ *
+ * @return True if the entity was written.
+ */
+static _Bool Sv_WriteEntityDelta(const sv_entity_delta_t *delta, mem_buf_t *msg, mem_bits_t *bits,
+		const uint16_t last) {
+
+	if (!delta->count)
+		return false;
+
+	if (bits) {
+		Net_WriteEntityNumberBits(bits, last, delta->to.number);
+		Mem_CopyBits(bits, delta->data, delta->count);
+	} else {
+		Mem_WriteBuffer(msg, delta->data, delta->count >> 3);
+	}
+
+	return true;
+}
+
+/*
+ * @brief Writes the delta from one entity_state_t to another. Clients which
+ * delta from the same frame usually share identical deltas, so these are
+ * encoded once per frame and copied for each client. Frames may be written
+ * concurrently, so cache slots are claimed atomically. If the delta is already
+ * being encoded elsewhere, or the slots are exhausted, it is simply encoded here.
+ *
+ * @return True if the entity was written.
+ */
+_Bool Sv_WriteDeltaEntity(mem_buf_t *msg, mem_bits_t *bits, const uint16_t last,
+		const uint32_t age, const entity_state_t *from, const entity_state_t *to) {
+
+	sv_entity_delta_t *slots = &svs.entity_deltas[to->number * SV_ENTITY_DELTA_SLOTS];
+	const int32_t key = Sv_EntityDeltaKey(age, bits != NULL);
+	const _Bool force = age == 0;
+
+	// look for the same delta, already encoded by another client
+	for (int32_t i = 0; i < SV_ENTITY_DELTA_SLOTS; i++) {
+		sv_entity_delta_t *delta = &slots[i];
+
+		if (SDL_AtomicGet(&delta->key) == (key | SV_DELTA_READY)) {
+			if (!memcmp(&delta->from, from, sizeof(*from)) && !memcmp(&delta->to, to, sizeof(*to))) {
+				SDL_AtomicIncRef(&svs.entity_delta_hits);
+				return Sv_WriteEntityDelta(delta, msg, bits, last);
+			}
+		}
+	}
+
+	SDL_AtomicIncRef(&svs.entity_delta_misses);
+
+	// claim a slot left over from a previous frame, and encode the delta to it
+	sv_entity_delta_t *delta = NULL;
+	for (int32_t i = 0; i < SV_ENTITY_DELTA_SLOTS; i++) {
+		const int32_t k = SDL_AtomicGet(&slots[i].key);
+
+		if ((k >> 16) == (key >> 16) && (k & SV_DELTA_VALID))
+			continue; // in use this frame
+
+		if (SDL_AtomicCAS(&slots[i].key, k, key)) {
+			delta = &slots[i];
+			break;
+		}
+	}
+
+	if (delta) {
+		Sv_EncodeEntityDelta(delta, bits != NULL, from, to, force);
+		SDL_AtomicSet(&delta->key, key | SV_DELTA_READY);
+
+		return Sv_WriteEntityDelta(delta, msg, bits, last);
+	}
+
+	if (bits)
+		return Net_WriteDeltaEntityBits(bits, last, from, to, force);
+
+	Net_WriteDeltaEntity(msg, from, to, force);
+	return true;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SV_DELTA_H__
+#define __SV_DELTA_H__
+
+#include "sv_types.h"
+
+#ifdef __SV_LOCAL_H__
+_Bool Sv_WriteDeltaEntity(mem_buf_t *msg, mem_bits_t *bits, const uint16_t last,
+		const uint32_t age, const entity_state_t *from, const entity_state_t *to);
+#endif /* __SV_LOCAL_H__ */
+
+#endif /* __SV_DELTA_H__ */
@@ -22,14 +22,26 @@
 #include "sv_local.h"
 
 /*
- * @brief Writes a delta update of an entity_state_t list to the message.
+ * @brief Writes a delta update of an entity_state_t list to the message. Clients
+ * using PROTOCOL_MAJOR receive a bit packed list, while PROTOCOL_MAJOR_LEGACY
+ * clients receive the byte aligned encoding. The age is the number of frames
+ * since the delta frame.
  */
-static void Sv_WriteEntities(sv_frame_t *from, sv_frame_t *to, mem_buf_t *msg) {
+static void Sv_WriteEntities(const uint16_t protocol, const uint32_t age, sv_frame_t *from,
+		sv_frame_t *to, mem_buf_t *msg) {
 	entity_state_t *old_state = NULL, *new_state = NULL;
 	uint32_t old_index, new_index;
 	uint16_t old_num, new_num;
 	uint16_t from_num_entities;
 
+	mem_bits_t bits;
+	uint16_t last_num = 0;
+
+	const _Bool packed = protocol == PROTOCOL_MAJOR;
+
+	if (packed)
+		Mem_BeginBits(&bits, msg);
+
 	if (!from)
 		from_num_entities = 0;
 	else
@@ -54,30 +66,42 @@ static void Sv_WriteEntities(sv_frame_t *from, sv_frame_t *to, mem_buf_t *msg) {
 		}
 
 		if (new_num == old_num) { // delta update from old position
-			Net_WriteDeltaEntity(msg, old_state, new_state, false);
+			if (Sv_WriteDeltaEntity(msg, packed ? &bits : NULL, last_num, age, old_state, new_state))
+				last_num = new_num;
 			old_index++;
 			new_index++;
 			continue;
 		}
 
 		if (new_num < old_num) { // this is a new entity, send it from the baseline
-			Net_WriteDeltaEntity(msg, &sv.baselines[new_num], new_state, true);
+			Sv_WriteDeltaEntity(msg, packed ? &bits : NULL, last_num, 0, &sv.baselines[new_num], new_state);
+			last_num = new_num;
 			new_index++;
 			continue;
 		}
 
 		if (new_num > old_num) { // the old entity isn't present in the new message
-			const int16_t bits = U_REMOVE;
-
-			Net_WriteShort(msg, old_num);
-			Net_WriteShort(msg, bits);
+			if (packed) {
+				Net_WriteRemoveEntityBits(&bits, last_num, old_num);
+				last_num = old_num;
+			} else {
+				const int16_t flags = U_REMOVE;
+
+				Net_WriteShort(msg, old_num);
+				Net_WriteShort(msg, flags);
+			}
 
 			old_index++;
 			continue;
 		}
 	}
 
-	Net_WriteShort(msg, 0); // end of entities
+	if (packed) { // end of entities
+		Net_WriteEntityNumberBits(&bits, last_num, 0);
+		Mem_EndWriteBits(&bits);
+	} else {
+		Net_WriteShort(msg, 0);
+	}
 }
 
 /*
@@ -130,25 +154,34 @@ void Sv_WriteClientFrame(sv_client_t *client, mem_buf_t *msg) {
 	Sv_WritePlayerState(delta_frame, frame, msg);
 
 	// delta encode the entities
-	Sv_WriteEntities(delta_frame, frame, msg);
+	const uint32_t age = delta_frame ? sv.frame_num - delta_frame_num : 0;
+	Sv_WriteEntities(client->protocol, age, delta_frame, frame, msg);
 }
 
 /*
- * @brief Resolve the visibility data for the bounding box around the client. The
- * bounding box provides some leniency because the client's actual view origin
- * is likely slightly different than what we think it is.
+ * @brief Resolve the entities visible from the bounding box around the client.
+ * The bounding box provides some leniency because the client's actual view
+ * origin is likely slightly different than what we think it is. The first
+ * cluster contributes its visible and audible entities, the others only their
+ * visible entities.
  */
-static void Sv_ClientVisibility(const vec3_t org, byte *pvs, byte *phs) {
+static void Sv_ClientVisibility(const vec3_t org, byte *ents) {
 	int32_t leafs[MAX_ENT_LEAFS];
 	int32_t clusters[MAX_ENT_LEAFS];
 	vec3_t mins, maxs;
 
+	memset(ents, 0, MAX_ENTITIES >> 3);
+
 	leafs[0] = Cm_PointLeafnum(org, 0);
 	clusters[0] = Cm_LeafCluster(leafs[0]);
 
 	// take the first cluster's visibility and hearability
-	Cm_ClusterPVS(clusters[0], pvs);
-	Cm_ClusterPHS(clusters[0], phs);
+	const sv_vis_entities_t *vis = Sv_ClusterEntities(clusters[0]);
+	if (vis) {
+		for (size_t i = 0; i < sizeof(vis->pvs); i++) {
+			ents[i] = vis->pvs[i] | vis->phs[i];
+		}
+	}
 
 	// spread the bounds to account for view offset
 	for (int32_t i = 0; i < 3; i++) {
@@ -156,10 +189,9 @@ static void Sv_ClientVisibility(const vec3_t org, byte *pvs, byte *phs) {
 		maxs[i] = org[i] + 16.0;
 	}
 
-	const size_t len = Cm_BoxLeafnums(mins, maxs, leafs + 1, sizeof(leafs) - 1, NULL, 0);
-	if (len == 0) {
-		Com_Error(ERR_DROP, "Bad leaf count @ %s\n", vtos(org));
-	}
+	// this may run on a worker thread, so rather than raising an error for a
+	// degenerate leaf count, simply use the first cluster's visibility
+	const size_t len = Cm_BoxLeafnums(mins, maxs, leafs + 1, lengthof(leafs) - 1, NULL, 0);
 
 	// convert leafs to clusters and combine their visibility data
 	for (size_t i = 1; i <= len; i++) {
@@ -174,18 +206,52 @@ static void Sv_ClientVisibility(const vec3_t org, byte *pvs, byte *phs) {
 		if (j < i) // already got it
 			continue;
 
-		byte cluster_pvs[MAX_BSP_LEAFS >> 3];
-		Cm_ClusterPVS(clusters[i], cluster_pvs);
+		if ((vis = Sv_ClusterEntities(clusters[i]))) {
+			for (size_t k = 0; k < sizeof(vis->pvs); k++) {
+				ents[k] |= vis->pvs[k];
+			}
+		}
+	}
+}
+
+/*
+ * @brief Prepares the entities for this frame's client snapshots. Entity numbers
+ * are validated once here, as the snapshots may be built concurrently.
+ */
+void Sv_PrepareClientFrames(void) {
+
+	for (uint16_t e = 1; e < svs.game->num_entities; e++) {
+		g_entity_t *ent = ENTITY_FOR_NUM(e);
 
-		for (size_t i = 0; i < sizeof(pvs); i++) {
-			pvs[i] |= cluster_pvs[i];
+		if (ent->s.number != e) {
+			Com_Warn("Fixing entity number: %d -> %d\n", ent->s.number, e);
+			ent->s.number = e;
 		}
 	}
 }
 
+/*
+ * @brief Reserves a span of MAX_PACKET_ENTITIES in the entity_state_t ring for
+ * the client's current frame. Each client then writes only to its own span, so
+ * that frames may be built concurrently. The ring holds PACKET_BACKUP frames
+ * for every client, so reserved spans are never reused while still referenced
+ * for delta compression.
+ */
+void Sv_ReserveClientFrame(sv_client_t *client) {
+
+	sv_frame_t *frame = &client->frames[sv.frame_num & PACKET_MASK];
+
+	frame->entity_state = svs.next_entity_state;
+	frame->num_entities = 0;
+
+	svs.next_entity_state += MAX_PACKET_ENTITIES;
+}
+
 /*
  * @brief Decides which entities are going to be visible to the client, and
- * copies off the player state and area_bits.
+ * copies off the player state and area_bits. The frame must have been reserved
+ * with Sv_ReserveClientFrame. Only the client's own state is written, so
+ * frames for different clients may be built concurrently.
  */
 void Sv_BuildClientFrame(sv_client_t *client) {
 	vec3_t org, off;
@@ -212,15 +278,27 @@ void Sv_BuildClientFrame(sv_client_t *client) {
 	// calculate the visible areas
 	frame->area_bytes = Cm_WriteAreaBits(area, frame->area_bits);
 
-	// resolve the visibility data
-	byte pvs[MAX_BSP_LEAFS >> 3], phs[MAX_BSP_LEAFS >> 3];
-	Sv_ClientVisibility(org, pvs, phs);
+	// resolve the potentially visible entities, including our own
+	byte ents[MAX_ENTITIES >> 3];
+	Sv_ClientVisibility(org, ents);
+
+	const uint16_t num = NUM_FOR_ENTITY(cent);
+	ents[num >> 3] |= 1 << (num & 7);
 
 	// build up the list of relevant entities
 	frame->num_entities = 0;
-	frame->entity_state = svs.next_entity_state;
 
 	for (uint16_t e = 1; e < svs.game->num_entities; e++) {
+
+		// skip over empty bytes of the vector
+		if (!ents[e >> 3]) {
+			e |= 7;
+			continue;
+		}
+
+		if (!(ents[e >> 3] & (1 << (e & 7))))
+			continue;
+
 		g_entity_t *ent = ENTITY_FOR_NUM(e);
 
 		// ignore entities that are local to the server
@@ -231,46 +309,30 @@ void Sv_BuildClientFrame(sv_client_t *client) {
 		if (!ent->s.event && !ent->s.effects && !ent->s.trail && !ent->s.model1 && !ent->s.sound)
 			continue;
 
-		// ignore entities not in PVS / PHS
+		// ignore entities in areas the client can not see
 		if (ent != cent) {
 			const sv_entity_t *sent = &sv.entities[e];
 
-			// by first checking area
 			if (!Cm_AreasConnected(area, sent->areas[0])) {
 				if (!sent->areas[1] || !Cm_AreasConnected(area, sent->areas[1]))
 					continue;
 			}
+		}
 
-			const byte *vis = ent->s.sound || ent->s.event ? phs : pvs;
+		// the client can not accept more than this in a single frame
+		if (frame->num_entities == MAX_PACKET_ENTITIES)
+			break;
 
-			if (sent->num_clusters == -1) { // use top_node
-				if (!Cm_HeadnodeVisible(sent->top_node, vis))
-					continue;
-			} else { // or check individual leafs
-				int32_t i;
-				for (i = 0; i < sent->num_clusters; i++) {
-					const int32_t c = sent->clusters[i];
-					if (vis[c >> 3] & (1 << (c & 7)))
-						break;
-				}
-				if (i == sent->num_clusters)
-					continue; // not visible
-			}
-		}
+		// copy it to the client's span of the circular entity_state_t array
+		const uint32_t index = frame->entity_state + frame->num_entities;
+		entity_state_t *s = &svs.entity_states[index % svs.num_entity_states];
 
-		// copy it to the circular entity_state_t array
-		entity_state_t *s = &svs.entity_states[svs.next_entity_state % svs.num_entity_states];
-		if (ent->s.number != e) {
-			Com_Warn("Fixing entity number: %d -> %d\n", ent->s.number, e);
-			ent->s.number = e;
-		}
 		*s = ent->s;
 
 		// don't mark our own missiles as solid for prediction
 		if (ent->owner == client->entity)
 			s->solid = 0;
 
-		svs.next_entity_state++;
 		frame->num_entities++;
 	}
 }
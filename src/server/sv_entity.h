@@ -26,6 +26,8 @@
 
 #ifdef __SV_LOCAL_H__
 void Sv_WriteClientFrame(sv_client_t *client, mem_buf_t *msg);
+void Sv_PrepareClientFrames(void);
+void Sv_ReserveClientFrame(sv_client_t *client);
 void Sv_BuildClientFrame(sv_client_t *client);
 #endif /* __SV_LOCAL_H__ */
 
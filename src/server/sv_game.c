@@ -148,7 +148,6 @@ static void Sv_WriteAngles(const vec3_t angles) {
  * @brief Also checks areas so that doors block sight.
  */
 static _Bool Sv_InPVS(const vec3_t p1, const vec3_t p2) {
-	byte pvs[MAX_BSP_LEAFS >> 3];
 
 	const int32_t leaf1 = Cm_PointLeafnum(p1, 0);
 	const int32_t leaf2 = Cm_PointLeafnum(p2, 0);
@@ -162,19 +161,13 @@ static _Bool Sv_InPVS(const vec3_t p1, const vec3_t p2) {
 	const int32_t cluster1 = Cm_LeafCluster(leaf1);
 	const int32_t cluster2 = Cm_LeafCluster(leaf2);
 
-	Cm_ClusterPVS(cluster1, pvs);
-
-	if ((pvs[cluster2 >> 3] & (1 << (cluster2 & 7))) == 0)
-		return false;
-
-	return true;
+	return Cm_ClustersVisible(cluster1, cluster2);
 }
 
 /*
  * @brief Also checks areas so that doors block sound.
  */
 static _Bool Sv_InPHS(const vec3_t p1, const vec3_t p2) {
-	byte phs[MAX_BSP_LEAFS >> 3];
 
 	const int32_t leaf1 = Cm_PointLeafnum(p1, 0);
 
@@ -189,12 +182,7 @@ static _Bool Sv_InPHS(const vec3_t p1, const vec3_t p2) {
 	const int32_t cluster1 = Cm_LeafCluster(leaf1);
 	const int32_t cluster2 = Cm_LeafCluster(leaf2);
 
-	Cm_ClusterPHS(cluster1, phs);
-
-	if ((phs[cluster2 >> 3] & (1 << (cluster2 & 7))) == 0)
-		return false;
-
-	return true;
+	return Cm_ClustersHearable(cluster1, cluster2);
 }
 
 /*
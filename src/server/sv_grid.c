@@ -0,0 +1,246 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sv_grid.h"
+
+/*
+ * @brief The finest cells are never smaller than this, in world units.
+ */
+#define GRID_MIN_CELL_SIZE 128.0
+
+/*
+ * @brief The finest level is at most this many cells along either axis.
+ */
+#define GRID_MAX_CELLS 64
+
+#define GRID_MAX_LEVELS 16
+
+/*
+ * @brief Items are kept in intrusive lists per cell, linked by index, so that
+ * unlinking is constant time and queries touch only these contiguous arrays.
+ */
+typedef struct {
+	vec3_t mins, maxs;
+	int32_t cell; // -1 if not linked
+	int32_t prev, next;
+} sv_grid_item_t;
+
+typedef struct {
+	vec_t size; // the cell size
+	int32_t width, height; // in cells
+	int32_t first_cell; // offset into the cells array
+	int32_t num_items;
+} sv_grid_level_t;
+
+struct sv_grid_s {
+	vec3_t mins, maxs;
+
+	sv_grid_level_t levels[GRID_MAX_LEVELS];
+	int32_t num_levels;
+
+	int32_t *cells; // the first item in each cell, or -1
+	int32_t num_cells;
+
+	sv_grid_item_t *items;
+	int32_t max_items;
+};
+
+/*
+ * @brief Allocates a grid spanning the specified bounds, for up to max_items
+ * items. The cell size of the finest level adapts to the size of the bounds.
+ */
+sv_grid_t *Sv_CreateGrid(const vec3_t mins, const vec3_t maxs, const int32_t max_items, const mem_tag_t tag) {
+
+	sv_grid_t *grid = Mem_TagMalloc(sizeof(*grid), tag);
+
+	VectorCopy(mins, grid->mins);
+	VectorCopy(maxs, grid->maxs);
+
+	const vec_t width = MAX(maxs[0] - mins[0], 1.0);
+	const vec_t height = MAX(maxs[1] - mins[1], 1.0);
+
+	vec_t size = MAX(MAX(width, height) / GRID_MAX_CELLS, GRID_MIN_CELL_SIZE);
+
+	while (grid->num_levels < GRID_MAX_LEVELS) {
+		sv_grid_level_t *level = &grid->levels[grid->num_levels++];
+
+		level->size = size;
+		level->width = (int32_t) ceilf(width / size);
+		level->height = (int32_t) ceilf(height / size);
+		level->first_cell = grid->num_cells;
+
+		grid->num_cells += level->width * level->height;
+
+		if (level->width == 1 && level->height == 1) {
+			break;
+		}
+
+		size *= 2.0;
+	}
+
+	grid->cells = Mem_LinkMalloc(grid->num_cells * sizeof(int32_t), grid);
+	memset(grid->cells, 0xff, grid->num_cells * sizeof(int32_t));
+
+	grid->max_items = max_items;
+	grid->items = Mem_LinkMalloc(max_items * sizeof(sv_grid_item_t), grid);
+
+	for (int32_t i = 0; i < max_items; i++) {
+		grid->items[i].cell = -1;
+	}
+
+	return grid;
+}
+
+/*
+ * @brief Frees the specified grid.
+ */
+void Sv_FreeGrid(sv_grid_t *grid) {
+	Mem_Free(grid);
+}
+
+/*
+ * @return The cell coordinate of the given world coordinate along the given
+ * axis, clamped to the level.
+ */
+static int32_t Sv_GridCoord(const sv_grid_t *grid, const sv_grid_level_t *level, const int32_t axis,
+		const vec_t v) {
+
+	const int32_t max = (axis == 0 ? level->width : level->height) - 1;
+	const vec_t c = floorf((v - grid->mins[axis]) / level->size);
+
+	return c < 0.0 ? 0 : c > max ? max : (int32_t) c;
+}
+
+/*
+ * @brief Links the specified item into the grid with the given bounds. If the
+ * item is already linked, it is moved.
+ */
+void Sv_GridLink(sv_grid_t *grid, const int32_t item, const vec3_t mins, const vec3_t maxs) {
+
+	Sv_GridUnlink(grid, item);
+
+	sv_grid_item_t *it = &grid->items[item];
+
+	VectorCopy(mins, it->mins);
+	VectorCopy(maxs, it->maxs);
+
+	// find the finest level that will contain the item about its center
+	const vec_t extent = MAX(maxs[0] - mins[0], maxs[1] - mins[1]);
+
+	int32_t l = 0;
+	while (l < grid->num_levels - 1 && grid->levels[l].size < extent) {
+		l++;
+	}
+
+	sv_grid_level_t *level = &grid->levels[l];
+
+	const int32_t x = Sv_GridCoord(grid, level, 0, 0.5 * (mins[0] + maxs[0]));
+	const int32_t y = Sv_GridCoord(grid, level, 1, 0.5 * (mins[1] + maxs[1]));
+
+	it->cell = level->first_cell + y * level->width + x;
+
+	it->prev = -1;
+	it->next = grid->cells[it->cell];
+
+	if (it->next != -1) {
+		grid->items[it->next].prev = item;
+	}
+
+	grid->cells[it->cell] = item;
+	level->num_items++;
+}
+
+/*
+ * @brief Removes the specified item from the grid, if it is linked.
+ */
+void Sv_GridUnlink(sv_grid_t *grid, const int32_t item) {
+
+	sv_grid_item_t *it = &grid->items[item];
+
+	if (it->cell == -1) {
+		return;
+	}
+
+	if (it->prev != -1) {
+		grid->items[it->prev].next = it->next;
+	} else {
+		grid->cells[it->cell] = it->next;
+	}
+
+	if (it->next != -1) {
+		grid->items[it->next].prev = it->prev;
+	}
+
+	for (int32_t i = grid->num_levels - 1; i >= 0; i--) {
+		if (it->cell >= grid->levels[i].first_cell) {
+			grid->levels[i].num_items--;
+			break;
+		}
+	}
+
+	it->cell = -1;
+}
+
+/*
+ * @brief Populates an array of items with those which have bounding boxes
+ * that intersect the given box.
+ *
+ * @return The number of items found, which is at most len.
+ */
+size_t Sv_GridQuery(const sv_grid_t *grid, const vec3_t mins, const vec3_t maxs, int32_t *items,
+		const size_t len) {
+	size_t count = 0;
+
+	for (int32_t l = 0; l < grid->num_levels; l++) {
+		const sv_grid_level_t *level = &grid->levels[l];
+
+		if (level->num_items == 0) {
+			continue;
+		}
+
+		// items may overhang their cell by up to half of its size
+		const vec_t loose = 0.5 * level->size;
+
+		const int32_t x0 = Sv_GridCoord(grid, level, 0, mins[0] - loose);
+		const int32_t x1 = Sv_GridCoord(grid, level, 0, maxs[0] + loose);
+		const int32_t y0 = Sv_GridCoord(grid, level, 1, mins[1] - loose);
+		const int32_t y1 = Sv_GridCoord(grid, level, 1, maxs[1] + loose);
+
+		for (int32_t y = y0; y <= y1; y++) {
+			const int32_t *cell = grid->cells + level->first_cell + y * level->width;
+
+			for (int32_t x = x0; x <= x1; x++) {
+				for (int32_t i = cell[x]; i != -1; i = grid->items[i].next) {
+					const sv_grid_item_t *it = &grid->items[i];
+
+					if (BoxIntersect(it->mins, it->maxs, mins, maxs)) {
+						if (count == len) {
+							return count;
+						}
+						items[count++] = i;
+					}
+				}
+			}
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SV_GRID_H__
+#define __SV_GRID_H__
+
+#include "mem.h"
+#include "shared.h"
+
+/*
+ * @brief A hierarchical loose grid of axis-aligned bounding boxes, used to
+ * find the entities within an arbitrary box. Each level doubles the cell size
+ * of the one beneath it, and items are placed by their center into the finest
+ * level whose cells are at least as large as they are.
+ */
+typedef struct sv_grid_s sv_grid_t;
+
+sv_grid_t *Sv_CreateGrid(const vec3_t mins, const vec3_t maxs, const int32_t max_items, const mem_tag_t tag);
+void Sv_FreeGrid(sv_grid_t *grid);
+void Sv_GridLink(sv_grid_t *grid, const int32_t item, const vec3_t mins, const vec3_t maxs);
+void Sv_GridUnlink(sv_grid_t *grid, const int32_t item);
+size_t Sv_GridQuery(const sv_grid_t *grid, const vec3_t mins, const vec3_t maxs, int32_t *items,
+		const size_t len);
+
+#endif /* __SV_GRID_H__ */
@@ -0,0 +1,142 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sv_local.h"
+
+/*
+ * @brief Connected clients are hashed by their address and qport, so that
+ * incoming packets are dispatched without scanning every client slot. The
+ * exact table includes the source port. The port-agnostic table catches
+ * address translating routers which rewrite the client's port mid-game. Keys
+ * are copied into the tables, as clients behind the same router may share a
+ * port-agnostic key, and a client's keys change when it is re-hashed.
+ */
+typedef struct {
+	GHashTable *exact;
+	GHashTable *qport;
+} sv_hash_t;
+
+static sv_hash_t sv_hash;
+
+/*
+ * @return The exact hash key for the given address and qport.
+ */
+static int64_t Sv_HashKey(const net_addr_t *addr, const byte qport) {
+	return ((int64_t) addr->type << 56) | ((int64_t) qport << 48) | ((int64_t) addr->port << 32) | addr->addr;
+}
+
+/*
+ * @return The port-agnostic hash key for the given address and qport.
+ */
+static int64_t Sv_HashKey_QPort(const net_addr_t *addr, const byte qport) {
+	return ((int64_t) addr->type << 56) | ((int64_t) qport << 48) | addr->addr;
+}
+
+/*
+ * @brief Maps a copy of the given key to the specified client, replacing any
+ * client which shared it.
+ */
+static void Sv_HashInsert(GHashTable *table, const int64_t key, sv_client_t *cl) {
+
+	int64_t *k = g_new(int64_t, 1);
+	*k = key;
+
+	g_hash_table_replace(table, k, cl);
+}
+
+/*
+ * @brief Adds the specified client to the hash by its current address and
+ * qport. The client must not already be hashed.
+ */
+void Sv_HashClient(sv_client_t *cl) {
+
+	if (!sv_hash.exact) {
+		sv_hash.exact = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+		sv_hash.qport = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+	}
+
+	const net_chan_t *ch = &cl->net_chan;
+
+	cl->hash_keys[0] = Sv_HashKey(&ch->remote_address, ch->qport);
+	cl->hash_keys[1] = Sv_HashKey_QPort(&ch->remote_address, ch->qport);
+
+	Sv_HashInsert(sv_hash.exact, cl->hash_keys[0], cl);
+	Sv_HashInsert(sv_hash.qport, cl->hash_keys[1], cl);
+}
+
+/*
+ * @brief Removes the specified client from the hash, if it is hashed. This
+ * must be called before the client's address or qport change.
+ */
+void Sv_UnhashClient(sv_client_t *cl) {
+
+	if (!sv_hash.exact) {
+		return;
+	}
+
+	// clients behind the same router may collide, so remove only our entries
+	if (g_hash_table_lookup(sv_hash.exact, &cl->hash_keys[0]) == cl) {
+		g_hash_table_remove(sv_hash.exact, &cl->hash_keys[0]);
+	}
+
+	if (g_hash_table_lookup(sv_hash.qport, &cl->hash_keys[1]) == cl) {
+		g_hash_table_remove(sv_hash.qport, &cl->hash_keys[1]);
+	}
+}
+
+/*
+ * @brief Resolves the client for a packet from the given address and qport.
+ * If the client is found by address and qport alone, its port was rewritten by
+ * an address translating router, and the caller should update the client's
+ * port and re-hash it.
+ *
+ * @return The client, or NULL if the packet is not from a connected client.
+ */
+sv_client_t *Sv_HashedClient(const net_addr_t *addr, const byte qport) {
+
+	if (!sv_hash.exact) {
+		return NULL;
+	}
+
+	const int64_t key = Sv_HashKey(addr, qport);
+
+	sv_client_t *cl = g_hash_table_lookup(sv_hash.exact, &key);
+	if (cl) {
+		return cl;
+	}
+
+	const int64_t key_qport = Sv_HashKey_QPort(addr, qport);
+
+	return g_hash_table_lookup(sv_hash.qport, &key_qport);
+}
+
+/*
+ * @brief Clears the hash, as when the clients are freed.
+ */
+void Sv_ClearClientHash(void) {
+
+	if (sv_hash.exact) {
+		g_hash_table_destroy(sv_hash.exact);
+		g_hash_table_destroy(sv_hash.qport);
+	}
+
+	memset(&sv_hash, 0, sizeof(sv_hash));
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SV_HASH_H__
+#define __SV_HASH_H__
+
+#include "sv_types.h"
+
+#ifdef __SV_LOCAL_H__
+void Sv_HashClient(sv_client_t *cl);
+void Sv_UnhashClient(sv_client_t *cl);
+sv_client_t *Sv_HashedClient(const net_addr_t *addr, const byte qport);
+void Sv_ClearClientHash(void);
+#endif /* __SV_LOCAL_H__ */
+
+#endif /* __SV_HASH_H__ */
@@ -0,0 +1,393 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sv_local.h"
+
+/*
+ * @brief On dedicated servers, a thread drains the server socket so that a
+ * flood of connectionless packets can not delay the simulation. Queries for
+ * info, status and ping are answered by that thread from a snapshot, which the
+ * main thread refreshes periodically. Every other packet is passed to the main
+ * thread through a single producer, single consumer ring. Connectionless
+ * packets are rate limited per source address, whichever thread reads them.
+ */
+
+#define SV_INGRESS_PACKETS 256 // must be a power of 2
+
+#define SV_INGRESS_SOURCES 4096 // likewise
+
+/*
+ * @brief The interval at which the query snapshot is refreshed, in
+ * milliseconds.
+ */
+#define SV_INGRESS_SNAPSHOT_INTERVAL 500
+
+/*
+ * @brief The longest the ingress thread waits on the socket before checking
+ * whether it should exit, in microseconds.
+ */
+#define SV_INGRESS_WAIT 100000
+
+typedef struct {
+	net_addr_t from;
+	size_t size;
+	byte data[MAX_MSG_SIZE];
+} sv_ingress_packet_t;
+
+/*
+ * @brief Each source address earns sv_query_rate tokens per second, up to a
+ * burst of one second's worth. Tokens are counted in thousandths. Sources are
+ * direct-mapped by address, and evict one another on collision.
+ */
+typedef struct {
+	in_addr_t addr;
+	uint32_t time;
+	uint32_t tokens;
+} sv_ingress_source_t;
+
+typedef struct {
+	SDL_Thread *thread;
+	SDL_atomic_t running;
+	SDL_sem *sem; // posted as packets are queued, drained by Sv_WaitIngress
+
+	sv_ingress_packet_t *packets;
+	SDL_atomic_t head; // advanced by the ingress thread
+	SDL_atomic_t tail; // advanced by the main thread
+
+	SDL_SpinLock lock; // guards the snapshot
+	char status[MAX_MSG_SIZE - 16];
+	char info[MAX_MSG_SIZE - 16];
+	char hostname[MAX_STRING_CHARS];
+	_Bool single_player;
+	uint32_t snapshot_time;
+
+	sv_ingress_source_t sources[SV_INGRESS_SOURCES];
+} sv_ingress_t;
+
+static sv_ingress_t sv_ingress;
+
+/*
+ * @return True if a connectionless packet from the given address should be
+ * processed, false if the address has exceeded sv_query_rate.
+ */
+_Bool Sv_CheckQueryRate(const net_addr_t *addr) {
+
+	const int32_t rate = sv_query_rate->integer;
+
+	if (rate <= 0 || addr->type == NA_LOOP)
+		return true;
+
+	const uint32_t now = Sys_Milliseconds();
+	const uint32_t burst = rate * 1000;
+
+	sv_ingress_source_t *src = &sv_ingress.sources[((addr->addr * 2654435761u) >> 16) & (SV_INGRESS_SOURCES - 1)];
+
+	if (src->addr != addr->addr || src->time == 0) {
+		src->addr = addr->addr;
+		src->tokens = burst;
+	} else {
+		const uint32_t elapsed = MIN(now - src->time, 1000u);
+		src->tokens = MIN(src->tokens + elapsed * rate, burst);
+	}
+
+	src->time = now;
+
+	if (src->tokens < 1000) {
+		SDL_AtomicIncRef(&svs.ingress_limited);
+		return false;
+	}
+
+	src->tokens -= 1000;
+	return true;
+}
+
+/*
+ * @brief Answers the connectionless query in msg from the snapshot, if it is
+ * one which may be answered off of the main thread.
+ *
+ * @return True if the query was answered (or ignored), false if it must be
+ * passed to the main thread.
+ */
+static _Bool Sv_AnswerQuery(const net_addr_t *from, const mem_buf_t *msg) {
+	static char reply[MAX_MSG_SIZE];
+	char line[MAX_STRING_CHARS];
+
+	if (msg->size <= 4)
+		return false;
+
+	const size_t len = MIN(msg->size - 4, sizeof(line) - 1);
+
+	memcpy(line, msg->data + 4, len);
+	line[len] = '\0';
+
+	const size_t cmd_len = strcspn(line, " \r\n");
+	const char *arg = line + cmd_len;
+
+	line[cmd_len] = '\0';
+
+	if (!g_strcmp0(line, "ping")) {
+		Netchan_OutOfBandPrint(NS_UDP_SERVER, from, "ack");
+	} else if (!g_strcmp0(line, "status")) {
+
+		SDL_AtomicLock(&sv_ingress.lock);
+		g_strlcpy(reply, sv_ingress.status, sizeof(reply));
+		SDL_AtomicUnlock(&sv_ingress.lock);
+
+		Netchan_OutOfBandPrint(NS_UDP_SERVER, from, "print\n%s", reply);
+	} else if (!g_strcmp0(line, "info")) {
+
+		if (cmd_len < len) {
+			arg++;
+		}
+
+		const int32_t p = atoi(arg);
+
+		SDL_AtomicLock(&sv_ingress.lock);
+
+		const _Bool single_player = sv_ingress.single_player;
+
+		if (p != PROTOCOL_MAJOR && p != PROTOCOL_MAJOR_LEGACY) {
+			g_snprintf(reply, sizeof(reply), "%s: Wrong protocol: %d != %d", sv_ingress.hostname, p,
+					PROTOCOL_MAJOR);
+		} else {
+			g_strlcpy(reply, sv_ingress.info, sizeof(reply));
+		}
+
+		SDL_AtomicUnlock(&sv_ingress.lock);
+
+		if (!single_player) { // ignore in single player
+			Netchan_OutOfBandPrint(NS_UDP_SERVER, from, "info\n%s", reply);
+		}
+	} else {
+		return false;
+	}
+
+	SDL_AtomicIncRef(&svs.ingress_answered);
+	return true;
+}
+
+/*
+ * @brief Dispatches a packet read by the ingress thread, answering or
+ * discarding it, or queueing it for the main thread.
+ */
+static void Sv_IngressPacket(const net_addr_t *from, const mem_buf_t *msg) {
+
+	if (msg->size >= 4 && *(uint32_t *) msg->data == 0xffffffff) {
+
+		if (!Sv_CheckQueryRate(from))
+			return;
+
+		if (Sv_AnswerQuery(from, msg))
+			return;
+	}
+
+	const int32_t head = SDL_AtomicGet(&sv_ingress.head);
+
+	if (head - SDL_AtomicGet(&sv_ingress.tail) == SV_INGRESS_PACKETS) {
+		SDL_AtomicIncRef(&svs.ingress_overflowed);
+		return;
+	}
+
+	sv_ingress_packet_t *packet = &sv_ingress.packets[head & (SV_INGRESS_PACKETS - 1)];
+
+	packet->from = *from;
+	packet->size = msg->size;
+
+	memcpy(packet->data, msg->data, msg->size);
+
+	SDL_AtomicSet(&sv_ingress.head, head + 1);
+	SDL_SemPost(sv_ingress.sem);
+}
+
+/*
+ * @brief The ingress thread reads packets from the server socket until the
+ * server is shut down.
+ */
+static int32_t Sv_IngressThread(void *data) {
+	static byte buffer[MAX_MSG_SIZE];
+	net_addr_t from;
+	mem_buf_t msg;
+
+	Mem_InitBuffer(&msg, buffer, sizeof(buffer));
+
+	while (SDL_AtomicGet(&sv_ingress.running)) {
+
+		if (!Net_WaitUntil(g_get_monotonic_time() + SV_INGRESS_WAIT))
+			continue;
+
+		while (Net_ReceiveDatagram(NS_UDP_SERVER, &from, &msg)) {
+			Sv_IngressPacket(&from, &msg);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * @return True if the ingress thread is reading the server socket.
+ */
+_Bool Sv_IngressActive(void) {
+	return sv_ingress.thread != NULL;
+}
+
+/*
+ * @brief Reads the next packet queued by the ingress thread into msg.
+ *
+ * @return True if a packet was read, false if the queue is empty.
+ */
+_Bool Sv_ReadIngress(net_addr_t *from, mem_buf_t *msg) {
+
+	const int32_t tail = SDL_AtomicGet(&sv_ingress.tail);
+
+	if (tail == SDL_AtomicGet(&sv_ingress.head))
+		return false;
+
+	const sv_ingress_packet_t *packet = &sv_ingress.packets[tail & (SV_INGRESS_PACKETS - 1)];
+
+	*from = packet->from;
+
+	memcpy(msg->data, packet->data, packet->size);
+	msg->size = packet->size;
+	msg->read = 0;
+
+	SDL_AtomicSet(&sv_ingress.tail, tail + 1);
+	return true;
+}
+
+/*
+ * @brief Sleeps until the ingress thread queues a packet, or until the
+ * specified deadline, in microseconds of g_get_monotonic_time. The semaphore
+ * waits in whole milliseconds, so the final fraction of a millisecond is
+ * slept outright, and packets queued meanwhile are read at the deadline.
+ *
+ * @return True if packets are queued, false otherwise.
+ */
+_Bool Sv_WaitIngress(int64_t deadline) {
+
+	// discard the posts for packets already read, lest they wake us needlessly
+	while (SDL_SemTryWait(sv_ingress.sem) == 0) {
+	}
+
+	if (SDL_AtomicGet(&sv_ingress.head) != SDL_AtomicGet(&sv_ingress.tail))
+		return true;
+
+	const int64_t usec = deadline - g_get_monotonic_time();
+
+	if (usec <= 0)
+		return false;
+
+	if (usec < 1000) {
+		g_usleep(usec);
+		return SDL_AtomicGet(&sv_ingress.head) != SDL_AtomicGet(&sv_ingress.tail);
+	}
+
+	return SDL_SemWaitTimeout(sv_ingress.sem, usec / 1000) == 0;
+}
+
+/*
+ * @brief Refreshes the snapshot from which the ingress thread answers queries.
+ */
+static void Sv_UpdateIngress_(void) {
+
+	const char *status = Sv_StatusString();
+	const char *info = Sv_InfoString();
+
+	SDL_AtomicLock(&sv_ingress.lock);
+
+	g_strlcpy(sv_ingress.status, status, sizeof(sv_ingress.status));
+	g_strlcpy(sv_ingress.info, info, sizeof(sv_ingress.info));
+	g_strlcpy(sv_ingress.hostname, sv_hostname->string, sizeof(sv_ingress.hostname));
+
+	sv_ingress.single_player = sv_max_clients->integer == 1;
+
+	SDL_AtomicUnlock(&sv_ingress.lock);
+
+	sv_ingress.snapshot_time = quetoo.time;
+}
+
+/*
+ * @brief Refreshes the query snapshot, if the ingress thread is active and the
+ * snapshot is due.
+ */
+void Sv_UpdateIngress(void) {
+
+	if (!Sv_IngressActive())
+		return;
+
+	if (quetoo.time - sv_ingress.snapshot_time < SV_INGRESS_SNAPSHOT_INTERVAL)
+		return;
+
+	Sv_UpdateIngress_();
+}
+
+/*
+ * @brief Starts the ingress thread for dedicated servers, or refreshes its
+ * snapshot if it is already running, as when changing levels.
+ */
+void Sv_InitIngress(void) {
+
+	if (Sv_IngressActive()) {
+		Sv_UpdateIngress_();
+		return;
+	}
+
+	if (!dedicated->value || !sv_io_thread->integer)
+		return;
+
+	sv_ingress.packets = Mem_TagMalloc(SV_INGRESS_PACKETS * sizeof(sv_ingress_packet_t), MEM_TAG_SERVER);
+	sv_ingress.sem = SDL_CreateSemaphore(0);
+
+	SDL_AtomicSet(&sv_ingress.head, 0);
+	SDL_AtomicSet(&sv_ingress.tail, 0);
+
+	Sv_UpdateIngress_();
+
+	SDL_AtomicSet(&sv_ingress.running, 1);
+
+	sv_ingress.thread = SDL_CreateThread(Sv_IngressThread, __func__, NULL);
+
+	if (!sv_ingress.thread) {
+		Com_Warn("Failed to create ingress thread: %s\n", SDL_GetError());
+		Sv_ShutdownIngress();
+	}
+}
+
+/*
+ * @brief Stops the ingress thread, discarding any packets it has queued.
+ */
+void Sv_ShutdownIngress(void) {
+
+	SDL_AtomicSet(&sv_ingress.running, 0);
+
+	if (sv_ingress.thread) {
+		SDL_WaitThread(sv_ingress.thread, NULL);
+	}
+
+	if (sv_ingress.sem) {
+		SDL_DestroySemaphore(sv_ingress.sem);
+	}
+
+	if (sv_ingress.packets) {
+		Mem_Free(sv_ingress.packets);
+	}
+
+	memset(&sv_ingress, 0, sizeof(sv_ingress));
+}
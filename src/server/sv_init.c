@@ -169,16 +169,21 @@ static void Sv_ShutdownClients(void) {
 
 	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
 
-		if (cl->download.buffer) {
-			Fs_Free(cl->download.buffer);
-		}
+		Sv_CloseDownload(cl);
+
+		Netchan_Close(&cl->net_chan);
 	}
 
+	Sv_ClearClientHash();
+
 	Mem_Free(svs.clients);
 	svs.clients = NULL;
 
 	Mem_Free(svs.entity_states);
 	svs.entity_states = NULL;
+
+	Mem_Free(svs.entity_deltas);
+	svs.entity_deltas = NULL;
 }
 
 /*
@@ -203,6 +208,10 @@ static void Sv_InitEntities(void) {
 		svs.num_entity_states = sv_max_clients->integer * PACKET_BACKUP * MAX_PACKET_ENTITIES;
 		svs.entity_states = Mem_TagMalloc(sizeof(entity_state_t) * svs.num_entity_states, MEM_TAG_SERVER);
 
+		// and the shared entity delta cache
+		svs.entity_deltas = Mem_TagMalloc(sizeof(sv_entity_delta_t) * MAX_ENTITIES * SV_ENTITY_DELTA_SLOTS,
+				MEM_TAG_SERVER);
+
 		svs.frame_rate = sv_hz->integer;
 
 		svs.spawn_count = Random();
@@ -251,6 +260,8 @@ static void Sv_LoadMedia(const char *server, sv_state_t state) {
 	if (state == SV_ACTIVE_DEMO) { // loading a demo
 		sv.cm_models[0] = Cm_LoadBspModel(NULL, &bsp_size);
 
+		Sv_InitVis();
+
 		sv.demo_file = Fs_OpenRead(va("demos/%s.dem", sv.name));
 		svs.spawn_count = 0;
 
@@ -260,6 +271,8 @@ static void Sv_LoadMedia(const char *server, sv_state_t state) {
 
 		sv.cm_models[0] = Cm_LoadBspModel(sv.config_strings[CS_MODELS], &bsp_size);
 
+		Sv_InitVis();
+
 		const char *dir = Fs_RealDir(sv.config_strings[CS_MODELS]);
 		if (g_str_has_suffix(dir, ".pk3")) {
 			g_strlcpy(sv.config_strings[CS_ZIP], Basename(dir), MAX_STRING_CHARS);
@@ -352,9 +365,14 @@ void Sv_InitServer(const char *server, sv_state_t state) {
 	Sv_LoadMedia(server, state);
 	sv.state = state;
 
+	// pace the first frame from now, rather than from before the load
+	svs.frame_deadline = 0;
+
 	Com_Print("Server initialized\n");
 	Com_InitSubsystem(QUETOO_SERVER);
 
+	Sv_InitIngress();
+
 	svs.initialized = true;
 }
 
@@ -375,8 +393,14 @@ void Sv_ShutdownServer(const char *msg) {
 
 	Sv_ShutdownMasters();
 
+	Sv_ShutdownVis();
+
+	Sv_ShutdownWorld();
+
 	Sv_ClearState();
 
+	Sv_ShutdownIngress();
+
 	Net_Config(NS_UDP_SERVER, false);
 
 	Com_Print("Server down\n");
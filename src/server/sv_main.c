@@ -27,16 +27,21 @@ sv_server_t sv; // per-level server info
 
 sv_client_t *sv_client; // current client
 
+cvar_t *sv_debug_traces;
 cvar_t *sv_download_url;
 cvar_t *sv_enforce_time;
 cvar_t *sv_hostname;
 cvar_t *sv_hz;
+cvar_t *sv_io_thread;
 cvar_t *sv_max_clients;
 cvar_t *sv_no_areas;
 cvar_t *sv_public;
+cvar_t *sv_query_rate;
 cvar_t *sv_rcon_password; // password for remote server commands
+cvar_t *sv_threads;
 cvar_t *sv_timeout;
 cvar_t *sv_udp_download;
+cvar_t *sv_udp_download_rate;
 
 /*
  * @brief Called when the player is totally leaving the server, either willingly
@@ -47,11 +52,10 @@ void Sv_DropClient(sv_client_t *cl) {
 	g_entity_t *ent;
 
 	Mem_ClearBuffer(&cl->net_chan.message);
-	Mem_ClearBuffer(&cl->datagram.buffer);
 
-	if (cl->datagram.messages) {
-		g_list_free_full(cl->datagram.messages, Mem_Free);
-	}
+	Sv_ClearClientDatagram(cl);
+
+	Sv_UnhashClient(cl);
 
 	if (cl->state > SV_CLIENT_FREE) { // send the disconnect
 
@@ -63,9 +67,9 @@ void Sv_DropClient(sv_client_t *cl) {
 		Netchan_Transmit(&cl->net_chan, cl->net_chan.message.data, cl->net_chan.message.size);
 	}
 
-	if (cl->download.buffer) {
-		Fs_Free(cl->download.buffer);
-	}
+	Sv_CloseDownload(cl);
+
+	Netchan_Close(&cl->net_chan);
 
 	ent = cl->entity;
 
@@ -121,6 +125,24 @@ static void Sv_Ack_f(void) {
 	Com_Print("Ping acknowledge from %s\n", Net_NetaddrToString(&net_from));
 }
 
+/*
+ * @brief Returns a string fit for info replies to broadcast scans.
+ */
+const char *Sv_InfoString(void) {
+	static char info[MAX_MSG_SIZE - 16];
+	int32_t i, count = 0;
+
+	for (i = 0; i < sv_max_clients->integer; i++) {
+		if (svs.clients[i].state >= SV_CLIENT_CONNECTED)
+			count++;
+	}
+
+	g_snprintf(info, sizeof(info), "%-63s\\%-31s\\%-31s\\%d\\%d", sv_hostname->string,
+			sv.name, svs.game->GameName(), count, sv_max_clients->integer);
+
+	return info;
+}
+
 /*
  * @brief Responds with brief info for broadcast scans.
  */
@@ -131,19 +153,11 @@ static void Sv_Info_f(void) {
 		return; // ignore in single player
 
 	const int32_t p = atoi(Cmd_Argv(1));
-	if (p != PROTOCOL_MAJOR) {
+	if (p != PROTOCOL_MAJOR && p != PROTOCOL_MAJOR_LEGACY) {
 		g_snprintf(string, sizeof(string), "%s: Wrong protocol: %d != %d", sv_hostname->string, p,
 		PROTOCOL_MAJOR);
 	} else {
-		int32_t i, count = 0;
-
-		for (i = 0; i < sv_max_clients->integer; i++) {
-			if (svs.clients[i].state >= SV_CLIENT_CONNECTED)
-				count++;
-		}
-
-		g_snprintf(string, sizeof(string), "%-63s\\%-31s\\%-31s\\%d\\%d", sv_hostname->string,
-				sv.name, svs.game->GameName(), count, sv_max_clients->integer);
+		g_strlcpy(string, Sv_InfoString(), sizeof(string));
 	}
 
 	Netchan_OutOfBandPrint(NS_UDP_SERVER, &net_from, "info\n%s", string);
@@ -208,7 +222,7 @@ static void Sv_Connect_f(void) {
 	const int32_t version = strtol(Cmd_Argv(1), NULL, 0);
 
 	// resolve protocol
-	if (version != PROTOCOL_MAJOR) {
+	if (version != PROTOCOL_MAJOR && version != PROTOCOL_MAJOR_LEGACY) {
 		Netchan_OutOfBandPrint(NS_UDP_SERVER, addr, "print\nServer is version %d.\n",
 		PROTOCOL_MAJOR);
 		return;
@@ -218,6 +232,14 @@ static void Sv_Connect_f(void) {
 
 	const uint32_t challenge = strtoul(Cmd_Argv(3), NULL, 0);
 
+	// newer clients advertise support for compression and a reliable window
+	const int32_t caps = strtol(Cmd_Argv(5), NULL, 0);
+
+	// compression is of no use over the loopback
+	const _Bool compress = net_compress->integer && (caps & NET_CHAN_COMPRESS) && addr->type != NA_LOOP;
+	const _Bool seeded = compress && strtoul(Cmd_Argv(6), NULL, 0) == Netchan_SeedChecksum();
+	const _Bool window = !!(caps & NET_CHAN_WINDOW);
+
 	// copy user_info, leave room for ip stuffing
 	g_strlcpy(user_info, Cmd_Argv(4), sizeof(user_info) - 25);
 
@@ -317,14 +339,26 @@ static void Sv_Connect_f(void) {
 		return;
 	}
 
+	client->protocol = version;
+
 	// parse some info from the info strings
 	g_strlcpy(client->user_info, user_info, sizeof(client->user_info));
 	Sv_UserInfoChanged(client);
 
 	// send the connect packet to the client
-	Netchan_OutOfBandPrint(NS_UDP_SERVER, addr, "client_connect %s", sv_download_url->string);
+	Netchan_OutOfBandPrint(NS_UDP_SERVER, addr, "client_connect %s%s%s", sv_download_url->string,
+			compress ? " compress" : "", window ? " window" : "");
+
+	Sv_UnhashClient(client);
 
 	Netchan_Setup(NS_UDP_SERVER, &client->net_chan, addr, qport);
+	client->net_chan.compress = compress;
+	client->net_chan.seeded = seeded;
+	if (window) {
+		Netchan_OpenWindow(&client->net_chan);
+	}
+
+	Sv_HashClient(client);
 
 	Mem_InitBuffer(&client->datagram.buffer, client->datagram.data, sizeof(client->datagram.data));
 	client->datagram.buffer.allow_overflow = true;
@@ -518,53 +552,64 @@ static void Sv_CheckCommandTimes(void) {
 }
 
 /*
- * @brief
+ * @brief Processes the packet in net_message, received from net_from.
  */
-static void Sv_ReadPackets(void) {
+static void Sv_ReadPacket(void) {
 
-	while (Net_ReceiveDatagram(NS_UDP_SERVER, &net_from, &net_message)) {
+	// check for connectionless packet (0xffffffff) first
+	if (*(uint32_t *) net_message.data == 0xffffffff) {
+		Sv_ConnectionlessPacket();
+		return;
+	}
 
-		// check for connectionless packet (0xffffffff) first
-		if (*(uint32_t *) net_message.data == 0xffffffff) {
-			Sv_ConnectionlessPacket();
-			continue;
-		}
+	// read the qport out of the message so we can fix up
+	// stupid address translating routers
+	Net_BeginReading(&net_message);
 
-		// read the qport out of the message so we can fix up
-		// stupid address translating routers
-		Net_BeginReading(&net_message);
+	Net_ReadLong(&net_message); // sequence number
+	Net_ReadLong(&net_message); // sequence number
 
-		Net_ReadLong(&net_message); // sequence number
-		Net_ReadLong(&net_message); // sequence number
+	const byte qport = Net_ReadByte(&net_message) & 0xff;
 
-		const byte qport = Net_ReadByte(&net_message) & 0xff;
+	// check for packets from connected clients
+	sv_client_t *cl = Sv_HashedClient(&net_from, qport);
+	if (!cl)
+		return;
 
-		// check for packets from connected clients
-		sv_client_t * cl = svs.clients;
-		for (int32_t i = 0; i < sv_max_clients->integer; i++, cl++) {
+	if (cl->net_chan.remote_address.port != net_from.port) {
+		Sv_UnhashClient(cl);
+		cl->net_chan.remote_address.port = net_from.port;
+		Sv_HashClient(cl);
 
-			if (cl->state == SV_CLIENT_FREE)
-				continue;
+		Com_Warn("Fixed translated port for %s\n", Net_NetaddrToString(&net_from));
+	}
 
-			if (!Net_CompareClientNetaddr(&net_from, &cl->net_chan.remote_address))
-				continue;
+	// this is a valid, sequenced packet, so process it
+	if (Netchan_Process(&cl->net_chan, &net_message)) {
+		cl->last_message = quetoo.time; // nudge timeout
+		Sv_ParseClientMessage(cl);
+	}
+}
 
-			if (cl->net_chan.qport != qport)
-				continue;
+/*
+ * @brief Reads and processes pending packets, either as queued by the ingress
+ * thread or directly from the server socket.
+ */
+static void Sv_ReadPackets(void) {
 
-			if (cl->net_chan.remote_address.port != net_from.port) {
-				cl->net_chan.remote_address.port = net_from.port;
-				Com_Warn("Fixed translated port for %s\n", Net_NetaddrToString(&net_from));
-			}
+	if (Sv_IngressActive()) {
+		while (Sv_ReadIngress(&net_from, &net_message)) {
+			Sv_ReadPacket();
+		}
+	} else {
+		while (Net_ReceiveDatagram(NS_UDP_SERVER, &net_from, &net_message)) {
 
-			// this is a valid, sequenced packet, so process it
-			if (Netchan_Process(&cl->net_chan, &net_message)) {
-				cl->last_message = quetoo.time; // nudge timeout
-				Sv_ParseClientMessage(cl);
+			if (*(uint32_t *) net_message.data == 0xffffffff) {
+				if (!Sv_CheckQueryRate(&net_from))
+					continue;
 			}
 
-			// we've processed the packet for the correct client, so break
-			break;
+			Sv_ReadPacket();
 		}
 	}
 }
@@ -711,6 +756,45 @@ void Sv_UserInfoChanged(sv_client_t *cl) {
 	}
 }
 
+/*
+ * @brief Waits for the next frame deadline, reading packets from clients as
+ * soon as they arrive, so that late commands still make the frame. The
+ * lateness of each frame is recorded for sv_frame_stats.
+ */
+static void Sv_WaitFrame(void) {
+
+	const int64_t frame_usec = 1000000 / svs.frame_rate;
+
+	if (!svs.frame_deadline) {
+		svs.frame_deadline = g_get_monotonic_time() + frame_usec;
+	}
+
+	int64_t now;
+	while ((now = g_get_monotonic_time()) < svs.frame_deadline) {
+
+		const _Bool ready = Sv_IngressActive() ?
+				Sv_WaitIngress(svs.frame_deadline) : Net_WaitUntil(svs.frame_deadline);
+
+		if (ready) {
+			quetoo.time = Sys_Milliseconds();
+			Sv_ReadPackets();
+		}
+	}
+
+	quetoo.time = Sys_Milliseconds();
+
+	const int64_t late = now - svs.frame_deadline;
+
+	svs.frame_jitter[svs.frame_count++ % SV_FRAME_TIMING_SAMPLES] = (uint32_t) MIN(late, UINT32_MAX);
+
+	// schedule the next frame, without trying to catch up if we've fallen behind
+	svs.frame_deadline += frame_usec;
+
+	if (svs.frame_deadline <= now) {
+		svs.frame_deadline = now + frame_usec;
+	}
+}
+
 /*
  * @brief
  */
@@ -723,16 +807,28 @@ void Sv_Frame(const uint32_t msec) {
 	// read any pending packets from clients
 	Sv_ReadPackets();
 
+	// refresh the snapshot from which the ingress thread answers queries
+	Sv_UpdateIngress();
+
+	if (sv_debug_traces->modified) {
+		Cm_EnableTraceStats(sv_debug_traces->integer);
+		sv_debug_traces->modified = false;
+	}
+
 	// keep simulation time in sync with reality
 	if (!time_demo->value){
 
-		const uint32_t frame_millis = 1000 / svs.frame_rate;
+		if (dedicated->value) {
+			Sv_WaitFrame();
+		} else {
+			const uint32_t frame_millis = 1000 / svs.frame_rate;
 
-		svs.frame_delta += msec;
+			svs.frame_delta += msec;
 
-		 if (svs.frame_delta < frame_millis) {
-			Net_Sleep(frame_millis - svs.frame_delta);
-			return;
+			if (svs.frame_delta < frame_millis) {
+				Net_Sleep(frame_millis - svs.frame_delta);
+				return;
+			}
 		}
 	}
 
@@ -753,6 +849,9 @@ void Sv_Frame(const uint32_t msec) {
 	// send messages back to the clients that had packets read this frame
 	Sv_SendClientPackets();
 
+	// and release the frame's temporary allocations
+	Mem_ResetFrame(MEM_TAG_SERVER);
+
 	// send a heartbeat to the master if needed
 	Sv_HeartbeatMasters();
 
@@ -770,23 +869,35 @@ static void Sv_InitLocal(void) {
 
 	sv_rcon_password = Cvar_Get("rcon_password", "", 0, NULL);
 
+	sv_debug_traces = Cvar_Get("sv_debug_traces", "0", 0,
+			"Collect collision statistics, printed by sv_trace_stats\n");
+
 	sv_download_url = Cvar_Get("sv_download_url", "", CVAR_SERVER_INFO, NULL);
 	sv_enforce_time = Cvar_Get("sv_enforce_time", va("%d", CMD_MSEC_MAX_DRIFT_ERRORS), 0, NULL);
 
 	sv_hostname = Cvar_Get("sv_hostname", "Quetoo", CVAR_SERVER_INFO | CVAR_ARCHIVE, NULL);
 	sv_hz = Cvar_Get("sv_hz", va("%d", SV_HZ), CVAR_SERVER_INFO | CVAR_LATCH, NULL);
 
+	sv_io_thread = Cvar_Get("sv_io_thread", "1", CVAR_LATCH,
+			"Read packets and answer queries on a dedicated thread\n");
+
 	sv_no_areas = Cvar_Get("sv_no_areas", "0", CVAR_LATCH, "Disable server-side area management\n");
 
 	sv_public = Cvar_Get("sv_public", "0", 0, "Set to 1 to to advertise to the master server\n");
 
+	sv_query_rate = Cvar_Get("sv_query_rate", "10", 0,
+			"Connectionless packets per second accepted from each address\n");
+
 	if (dedicated->value)
 		sv_max_clients = Cvar_Get("sv_max_clients", "8", CVAR_SERVER_INFO | CVAR_LATCH, NULL);
 	else
 		sv_max_clients = Cvar_Get("sv_max_clients", "1", CVAR_SERVER_INFO | CVAR_LATCH, NULL);
 
+	sv_threads = Cvar_Get("sv_threads", "1", 0, "Build and encode client frames in parallel\n");
 	sv_timeout = Cvar_Get("sv_timeout", va("%d", SV_TIMEOUT), 0, NULL);
 	sv_udp_download = Cvar_Get("sv_udp_download", "1", CVAR_ARCHIVE, NULL);
+	sv_udp_download_rate = Cvar_Get("sv_udp_download_rate", "262144", CVAR_ARCHIVE,
+			"Bytes per second at which each client may stream UDP downloads\n");
 
 	// set this so clients and server browsers can see it
 	Cvar_Get("sv_protocol", va("%i", PROTOCOL_MAJOR), CVAR_SERVER_INFO | CVAR_NO_SET, NULL);
@@ -30,16 +30,21 @@ void Sv_Frame(const uint32_t msec);
 
 #ifdef __SV_LOCAL_H__
 // cvars
+extern cvar_t *sv_debug_traces;
 extern cvar_t *sv_download_url;
 extern cvar_t *sv_enforce_time;
 extern cvar_t *sv_hostname;
 extern cvar_t *sv_hz;
+extern cvar_t *sv_io_thread;
 extern cvar_t *sv_max_clients;
 extern cvar_t *sv_no_areas;
 extern cvar_t *sv_public;
+extern cvar_t *sv_query_rate;
 extern cvar_t *sv_rcon_password;
+extern cvar_t *sv_threads;
 extern cvar_t *sv_timeout;
 extern cvar_t *sv_udp_download;
+extern cvar_t *sv_udp_download_rate;
 
 // per-level and static server structures
 extern sv_server_t sv;
@@ -50,6 +55,7 @@ extern sv_client_t *sv_client;
 extern g_entity_t *sv_player;
 
 const char *Sv_StatusString(void);
+const char *Sv_InfoString(void);
 const char *Sv_NetaddrToString(const sv_client_t *cl);
 void Sv_KickClient(sv_client_t *cl, const char *msg);
 void Sv_DropClient(sv_client_t *cl);
@@ -115,6 +115,17 @@ void Sv_BroadcastCommand(const char *fmt, ...) {
 	Sv_Multicast(NULL, MULTICAST_ALL_R, NULL);
 }
 
+/*
+ * @brief Discards all pending datagram messages for the specified client. The
+ * message segmentation itself is reclaimed when the server frame is reset.
+ */
+void Sv_ClearClientDatagram(sv_client_t *cl) {
+
+	Mem_ClearBuffer(&cl->datagram.buffer);
+
+	cl->datagram.messages = cl->datagram.last_message = NULL;
+}
+
 /*
  * @brief Writes to the specified datagram, noting the offset of the message.
  */
@@ -124,23 +135,27 @@ static void Sv_ClientDatagramMessage(sv_client_t *cl, byte *data, size_t len) {
 		Com_Error(ERR_DROP, "Single datagram message exceeded MAX_MSG_LEN\n");
 	}
 
-	sv_client_message_t *msg = g_malloc0(sizeof(*msg));
+	sv_client_message_t *msg = Mem_FrameAlloc(sizeof(*msg), MEM_TAG_SERVER);
 
 	msg->offset = cl->datagram.buffer.size;
 	msg->len = len;
 
-	cl->datagram.messages = g_list_append(cl->datagram.messages, msg);
+	if (cl->datagram.last_message) {
+		cl->datagram.last_message->next = msg;
+	} else {
+		cl->datagram.messages = msg;
+	}
+
+	cl->datagram.last_message = msg;
 
 	Mem_WriteBuffer(&cl->datagram.buffer, data, len);
 
 	if (cl->datagram.buffer.overflowed) {
 		Com_Warn("Client datagram overflow for %s\n", cl->name);
 
-		msg->offset = 0;
 		cl->datagram.buffer.overflowed = false;
 
-		g_list_free_full(cl->datagram.messages, g_free);
-		cl->datagram.messages = NULL;
+		Sv_ClearClientDatagram(cl);
 	}
 }
 
@@ -174,7 +189,7 @@ void Sv_Unicast(const g_entity_t *ent, const _Bool reliable) {
  * then clears sv.multicast.
  */
 void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter) {
-	byte vis[MAX_BSP_LEAFS >> 3];
+	const byte *vis;
 	int32_t area;
 
 	origin = origin ?: vec3_origin;
@@ -186,8 +201,8 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 			reliable = true;
 			/* no break */
 		case MULTICAST_ALL:
-			memset(vis, 1, sizeof(vis));
-			area = 0;			
+			vis = NULL;
+			area = 0;
 			break;
 
 		case MULTICAST_PHS_R:
@@ -196,7 +211,7 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 		case MULTICAST_PHS: {
 			const int32_t leaf = Cm_PointLeafnum(origin, 0);
 			const int32_t cluster = Cm_LeafCluster(leaf);
-			Cm_ClusterPHS(cluster, vis);
+			vis = Sv_ClusterPHS(cluster);
 			area = Cm_LeafArea(leaf);
 		}
 
@@ -208,7 +223,7 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 		case MULTICAST_PVS: {
 			const int32_t leaf = Cm_PointLeafnum(origin, 0);
 			const int32_t cluster = Cm_LeafCluster(leaf);
-			Cm_ClusterPVS(cluster, vis);
+			vis = Sv_ClusterPVS(cluster);
 			area = Cm_LeafArea(leaf);
 		}
 			break;
@@ -246,7 +261,7 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 				continue;
 
 			const int32_t cluster = Cm_LeafCluster(leaf);
-			if (!(vis[cluster >> 3] & (1 << (cluster & 7))))
+			if (cluster == -1 || !(vis[cluster >> 3] & (1 << (cluster & 7))))
 				continue;
 		}
 
@@ -332,51 +347,59 @@ void Sv_PositionedSound(const vec3_t origin, const g_entity_t *entity, const uin
 }
 
 /*
- * @brief
+ * @brief ThreadRunFunc which builds the client's frame, and encodes it to the
+ * client's frame message. This touches only the client's own state and its
+ * reserved span of the entity_state_t ring, so it may run concurrently for all
+ * clients. The resulting message is identical either way.
  */
-static void Sv_SendClientDatagram(sv_client_t *cl) {
-	byte buffer[MAX_MSG_SIZE];
-	mem_buf_t buf;
+static void Sv_EncodeClientFrame(void *data) {
+	sv_client_t *cl = (sv_client_t *) data;
 
 	Sv_BuildClientFrame(cl);
 
-	Mem_InitBuffer(&buf, buffer, sizeof(buffer));
-	buf.allow_overflow = true;
+	Mem_InitBuffer(&cl->frame_message, cl->frame_message_data, sizeof(cl->frame_message_data));
+	cl->frame_message.allow_overflow = true;
+
+	// write all the relevant entity_state_t and the player_state_t
+	Sv_WriteClientFrame(cl, &cl->frame_message);
+}
+
+/*
+ * @brief Transmits the client's encoded frame, followed by its datagram.
+ */
+static void Sv_SendClientDatagram(sv_client_t *cl) {
+	mem_buf_t *buf = &cl->frame_message;
 
 	// accumulate the total size for rate throttling
 	size_t frame_size = 0;
 
-	// send over all the relevant entity_state_t and the player_state_t
-	Sv_WriteClientFrame(cl, &buf);
-
 	// the frame itself (player state and delta entities) must fit into a single message,
 	// since it is parsed as a single command by the client
-	if (buf.overflowed || buf.size > MAX_MSG_SIZE - 16) {
-		Com_Error(ERR_DROP, "Frame exceeds MAX_MSG_SIZE (%u)\n", (uint32_t) buf.size);
+	if (buf->overflowed || buf->size > MAX_MSG_SIZE - 16) {
+		Com_Error(ERR_DROP, "Frame exceeds MAX_MSG_SIZE (%u)\n", (uint32_t) buf->size);
 	}
 
 	// but we can packetize the remaining datagram messages, which are parsed individually
-	const GList *e = cl->datagram.messages;
-	while (e) {
-		const sv_client_message_t *msg = (sv_client_message_t *) e->data;
+	const sv_client_message_t *msg = cl->datagram.messages;
+	while (msg) {
 
 		// if we would overflow the packet, flush it first
-		if (buf.size + msg->len > (MAX_MSG_SIZE - 16)) {
-			Com_Debug("Fragmenting datagram @ %u bytes\n", (uint32_t) buf.size);
+		if (buf->size + msg->len > (MAX_MSG_SIZE - 16)) {
+			Com_Debug("Fragmenting datagram @ %u bytes\n", (uint32_t) buf->size);
 
-			Netchan_Transmit(&cl->net_chan, buf.data, buf.size);
-			frame_size += buf.size;
+			Netchan_Transmit(&cl->net_chan, buf->data, buf->size);
+			frame_size += buf->size;
 
-			Mem_ClearBuffer(&buf);
+			Mem_ClearBuffer(buf);
 		}
 
-		Mem_WriteBuffer(&buf, cl->datagram.buffer.data + msg->offset, msg->len);
-		e = e->next;
+		Mem_WriteBuffer(buf, cl->datagram.buffer.data + msg->offset, msg->len);
+		msg = msg->next;
 	}
 
 	// send the pending packet, which may include reliable messages
-	Netchan_Transmit(&cl->net_chan, buf.data, buf.size);
-	frame_size += buf.size;
+	Netchan_Transmit(&cl->net_chan, buf->data, buf->size);
+	frame_size += buf->size;
 
 	// record the total size for rate estimation
 	cl->frame_size[sv.frame_num % sv_hz->integer] = frame_size;
@@ -461,21 +484,78 @@ static size_t Sv_GetDemoMessage(byte *buffer) {
 	return size;
 }
 
+/*
+ * @brief Builds and encodes the frames for all active clients which are not
+ * rate-throttled. With sv_threads, the frames are encoded in parallel.
+ *
+ * Clients whose frames were encoded are flagged in the specified array.
+ */
+static void Sv_EncodeClientFrames(_Bool *encoded) {
+	thread_counter_t counter;
+	sv_client_t *cl;
+	int32_t i;
+
+	memset(encoded, 0, sizeof(_Bool) * MAX_CLIENTS);
+
+	if (sv.state == SV_ACTIVE_DEMO)
+		return;
+
+	memset(&counter, 0, sizeof(counter));
+
+	Sv_PrepareClientFrames();
+
+	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
+
+		if (cl->state != SV_CLIENT_ACTIVE)
+			continue;
+
+		// clients whose reliable message overflowed are dropped
+		if (cl->net_chan.message.overflowed)
+			continue;
+
+		if (Sv_RateDrop(cl)) // enforce rate throttle
+			continue;
+
+		// reserving entity states serially keeps the ring identical either way
+		Sv_ReserveClientFrame(cl);
+
+		if (sv_threads->integer) {
+			Thread_Submit(Sv_EncodeClientFrame, cl, &counter);
+		} else {
+			Sv_EncodeClientFrame(cl);
+		}
+
+		encoded[i] = true;
+	}
+
+	Thread_WaitAll(&counter);
+}
+
 /*
  * @brief Send the frame and all pending datagram messages since the last frame.
+ * Frames are built and encoded first, possibly in parallel, and then all
+ * packets are transmitted serially in client order.
  */
 void Sv_SendClientPackets(void) {
+	_Bool encoded[MAX_CLIENTS];
 	sv_client_t * cl;
 	int32_t i;
 
 	if (!svs.initialized)
 		return;
 
+	Sv_EncodeClientFrames(encoded);
+
+	// queue the outgoing datagrams so that they are sent together
+	Net_QueueDatagrams(NS_UDP_SERVER);
+
 	// send a message to each connected client
 	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
 
-		if (cl->state == SV_CLIENT_FREE) // don't bother
+		if (cl->state == SV_CLIENT_FREE) { // don't bother
+			Sv_ClearClientDatagram(cl);
 			continue;
+		}
 
 		// if the client's reliable message overflowed, we must drop them
 		if (cl->net_chan.message.overflowed) {
@@ -484,6 +564,9 @@ void Sv_SendClientPackets(void) {
 			continue;
 		}
 
+		// rate throttled clients, and those not yet in the game, send no frame
+		cl->frame_size[sv.frame_num % sv_hz->integer] = 0;
+
 		if (sv.state == SV_ACTIVE_DEMO) { // send the demo packet
 			byte buffer[MAX_MSG_SIZE];
 			size_t size;
@@ -493,25 +576,22 @@ void Sv_SendClientPackets(void) {
 			}
 		} else if (cl->state == SV_CLIENT_ACTIVE) { // send the game packet
 
-			if (Sv_RateDrop(cl)) { // enforce rate throttle
-				cl->frame_size[sv.frame_num % sv_hz->integer] = 0;
-			} else {
+			if (encoded[i]) {
 				Sv_SendClientDatagram(cl);
 			}
 
-			// clean up for the next frame
-			Mem_ClearBuffer(&cl->datagram.buffer);
-
-			if (cl->datagram.messages) {
-				g_list_free_full(cl->datagram.messages, g_free);
-			}
-
-			cl->datagram.messages = NULL;
-
 		} else { // just update reliable if needed
-			if (cl->net_chan.message.size || quetoo.time - cl->net_chan.last_sent > 1000)
+			if (Netchan_Pending(&cl->net_chan) || quetoo.time - cl->net_chan.last_sent > 1000)
 				Netchan_Transmit(&cl->net_chan, NULL, 0);
 		}
+
+		// stream any download, within its own rate limit
+		Sv_SendClientDownload(cl);
+
+		// clean up for the next frame, as the segmentation does not outlive it
+		Sv_ClearClientDatagram(cl);
 	}
+
+	Net_FlushDatagrams(NS_UDP_SERVER);
 }
 
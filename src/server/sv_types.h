@@ -22,6 +22,8 @@
 #ifndef __SV_TYPES_H__
 #define __SV_TYPES_H__
 
+#include <SDL2/SDL_atomic.h>
+
 #include "game/game.h"
 #include "matrix.h"
 
@@ -53,12 +55,31 @@ typedef struct {
 	int32_t num_clusters; // if -1, use top_node
 
 	int32_t areas[2];
-	struct sv_sector_s *sector;
+	_Bool linked; // in the world grid
 
 	matrix4x4_t matrix;
 	matrix4x4_t inverse_matrix;
 } sv_entity_t;
 
+/*
+ * @brief The entities potentially visible from a given cluster in the current
+ * frame, as bit vectors indexed by entity number. Entities with sounds or
+ * events are tested against the cluster's PHS, all others against its PVS.
+ */
+typedef struct {
+	byte pvs[MAX_ENTITIES >> 3];
+	byte phs[MAX_ENTITIES >> 3];
+} sv_vis_entities_t;
+
+/*
+ * @brief Hit and miss counters for the cluster visibility cache.
+ */
+typedef struct {
+	uint32_t pvs_hits, pvs_misses;
+	uint32_t phs_hits, phs_misses;
+	uint32_t entities_hits, entities_misses;
+} sv_vis_stats_t;
+
 /*
  * @brief Server states.
  */
@@ -96,6 +117,21 @@ typedef struct {
 	file_t *demo_file;
 } sv_server_t;
 
+/*
+ * @brief Entity deltas are encoded once per frame for each delta frame and
+ * protocol in use, and then copied into the message of every client which
+ * shares them. Each entity has a few slots, claimed by whichever client first
+ * needs a given delta. See Sv_WriteDeltaEntity.
+ */
+#define SV_ENTITY_DELTA_SLOTS 4
+
+typedef struct {
+	SDL_atomic_t key; // frame, delta age, protocol and readiness
+	entity_state_t from, to; // compared on every hit, as states may differ per client
+	uint16_t count; // length of the encoded delta in bits, 0 if unchanged
+	byte data[64];
+} sv_entity_delta_t;
+
 typedef struct {
 	int32_t area_bytes;
 	byte area_bits[MAX_BSP_AREAS >> 3]; // portal area visibility bits
@@ -154,30 +190,38 @@ typedef enum {
  * buffered datagram for a given frame. Datagrams are packetized along message
  * bounds and transmitted as fragments when necessary.
  */
-typedef struct {
+typedef struct sv_client_message_s {
 	size_t offset;
 	size_t len;
+	struct sv_client_message_s *next;
 } sv_client_message_t;
 
 /*
  * @brief A datagram structure that maintains individual message offsets so
- * that it may be safely fragmented for delivery.
+ * that it may be safely fragmented for delivery. The message segmentation is
+ * allocated from the server's frame arena, and is cleared every frame.
  */
 typedef struct {
 	mem_buf_t buffer; // the managed size buffer
 	byte data[MAX_DATAGRAM_SIZE]; // the raw message buffer
-	GList *messages; // message segmentation
+	sv_client_message_t *messages; // message segmentation
+	sv_client_message_t *last_message;
 } sv_client_datagram_t;
 
 /*
  * @brief Each client my download a single file at a time via the game's UDP
  * protocol. This only serves as a fallback for when HTTP downloading is not
- * configured or unavailable.
+ * configured or unavailable. The file is read in chunks as it is sent, so
+ * memory use does not depend on its size.
  */
 typedef struct {
-	byte *buffer;
+	file_t *file;
 	int32_t size;
-	int32_t count;
+	int32_t count; // bytes sent, or for streamed downloads, bytes acknowledged
+	_Bool stream; // chunks are sent unreliably, see DOWNLOAD_STREAM
+	uint64_t sent; // chunks of the window which have been sent
+	uint64_t acked; // and which the client holds, beyond count
+	uint32_t sent_time[DOWNLOAD_WINDOW]; // for retransmits
 } sv_client_download_t;
 
 /*
@@ -187,6 +231,8 @@ typedef struct {
 typedef struct {
 	sv_client_state_t state;
 
+	uint16_t protocol; // the protocol major the client connected with
+
 	char user_info[MAX_USER_INFO_STRING]; // name, skin, etc
 
 	int32_t last_frame; // for delta compression
@@ -197,7 +243,7 @@ typedef struct {
 
 	uint32_t frame_latency[SV_CLIENT_LATENCY_COUNT]; // used to calculate ping
 
-	uint32_t frame_size[SV_HZ_MAX]; // used to rate drop packets
+	uint32_t frame_size[SV_HZ_MAX]; // frame and download bytes, used to rate drop packets
 	uint32_t rate;
 	uint32_t surpress_count; // number of messages rate suppressed
 
@@ -212,10 +258,18 @@ typedef struct {
 
 	sv_frame_t frames[PACKET_BACKUP]; // updates can be delta'd from here
 
+	// the frame is built and encoded here, possibly in parallel with other
+	// clients, and is then packetized with the datagram and transmitted
+	mem_buf_t frame_message;
+	byte frame_message_data[MAX_MSG_SIZE];
+
 	sv_client_download_t download; // UDP file downloads
 
 	uint32_t last_message; // quetoo.time when packet was last received
 	net_chan_t net_chan;
+	net_dictionary_t dictionary; // compression dictionary, confirmed before baselines
+
+	int64_t hash_keys[2]; // exact and port-agnostic keys, see sv_hash.c
 } sv_client_t;
 
 /*
@@ -241,6 +295,11 @@ typedef struct {
  */
 #define MAX_CHALLENGES 1024
 
+/*
+ * @brief The number of recent frames for which timing is retained.
+ */
+#define SV_FRAME_TIMING_SAMPLES 1024
+
 /*
  * @brief The sv_static_t structure is persistent for the execution of the
  * game. It is only cleared when Sv_Init is called. It is not exposed to the
@@ -254,6 +313,10 @@ typedef struct {
 	uint16_t frame_rate; // configurable server frame rate (sv_hz)
 	uint32_t frame_delta;
 
+	int64_t frame_deadline; // when the next frame is due, for dedicated servers
+	uint32_t frame_jitter[SV_FRAME_TIMING_SAMPLES]; // microseconds late, for sv_frame_stats
+	uint32_t frame_count;
+
 	sv_client_t *clients; // server-side client structures
 
 	// the server maintains an array of entity states it uses to calculate
@@ -263,9 +326,15 @@ typedef struct {
 	// asked to support at any point in time during the current game
 
 	uint32_t num_entity_states; // sv_max_clients->integer * UPDATE_BACKUP * MAX_PACKET_ENTITIES
-	uint32_t next_entity_state; // next entity_state to use for newly spawned entities
+	uint32_t next_entity_state; // next span of entity_states to reserve for a client frame
 	entity_state_t *entity_states; // entity states array used for delta compression
 
+	// encoded entity deltas, MAX_ENTITIES * SV_ENTITY_DELTA_SLOTS
+	sv_entity_delta_t *entity_deltas;
+	SDL_atomic_t entity_delta_hits, entity_delta_misses; // for sv_frame_stats
+
+	SDL_atomic_t ingress_answered, ingress_limited, ingress_overflowed; // for sv_frame_stats
+
 	net_addr_t masters[MAX_MASTERS];
 	uint32_t next_heartbeat;
 
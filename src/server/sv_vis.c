@@ -0,0 +1,409 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_timer.h>
+
+#include "sv_local.h"
+
+#define ENTITY_VECTOR (MAX_ENTITIES >> 3)
+
+/*
+ * @brief Cached rows and entity tables are filled on demand, possibly by
+ * several client frame jobs at once. Each is claimed before it is written,
+ * and other threads wait for it to become ready.
+ */
+typedef enum {
+	SV_VIS_EMPTY,
+	SV_VIS_PENDING,
+	SV_VIS_READY
+} sv_vis_state_t;
+
+/*
+ * @brief The cluster visibility cache holds the entities visible from each
+ * cluster in the current frame, and decompressed PVS and PHS rows for maps too
+ * large for the collision model's visibility matrix. Clients and multicasts
+ * sharing a cluster reuse this work.
+ *
+ * It also maintains an inverted index of the entities linked into each
+ * cluster, so that the visible entities are gathered from the visible
+ * clusters rather than by testing every entity.
+ */
+typedef struct {
+	int32_t num_clusters;
+	size_t row_size;
+
+	byte *cluster_entities; // num_clusters entity vectors of ENTITY_VECTOR bytes
+	uint16_t *cluster_counts; // the number of entities linked into each cluster
+	byte *occupied; // a row of the clusters which have entities linked into them
+
+	byte linked[ENTITY_VECTOR]; // entities in the index
+	byte top_node_entities[ENTITY_VECTOR]; // entities spanning too many clusters
+
+	byte *pvs; // num_clusters rows of row_size bytes, or NULL
+	byte *phs;
+
+	SDL_atomic_t *pvs_state; // sv_vis_state_t for each row
+	SDL_atomic_t *phs_state;
+
+	sv_vis_entities_t *entities;
+	SDL_atomic_t *entities_state; // (frame_num << 2) | sv_vis_state_t
+
+	byte empty[MAX_BSP_LEAFS >> 3]; // for the invalid cluster
+
+	SDL_atomic_t pvs_hits, pvs_misses;
+	SDL_atomic_t phs_hits, phs_misses;
+	SDL_atomic_t entities_hits, entities_misses;
+} sv_vis_t;
+
+static sv_vis_t sv_vis;
+
+/*
+ * @brief Releases the visibility cache.
+ */
+void Sv_ShutdownVis(void) {
+
+	if (sv_vis.pvs) {
+		Mem_Free(sv_vis.pvs);
+		Mem_Free(sv_vis.phs);
+		Mem_Free(sv_vis.pvs_state);
+		Mem_Free(sv_vis.phs_state);
+	}
+
+	if (sv_vis.entities) {
+		Mem_Free(sv_vis.entities);
+		Mem_Free(sv_vis.entities_state);
+		Mem_Free(sv_vis.cluster_entities);
+		Mem_Free(sv_vis.cluster_counts);
+		Mem_Free(sv_vis.occupied);
+	}
+
+	memset(&sv_vis, 0, sizeof(sv_vis));
+}
+
+/*
+ * @brief Allocates the visibility cache for a newly loaded level. Rows are
+ * served from the collision model's matrix when it is available, and are
+ * otherwise decompressed as they are first requested.
+ */
+void Sv_InitVis(void) {
+
+	Sv_ShutdownVis();
+
+	sv_vis.num_clusters = Cm_NumClusters();
+	sv_vis.row_size = (sv_vis.num_clusters + 7) >> 3;
+
+	if (sv_vis.num_clusters) {
+
+		if (!Cm_ClusterPVSRow(0)) {
+			const size_t rows = sv_vis.num_clusters * sv_vis.row_size;
+
+			sv_vis.pvs = Mem_TagMalloc(rows, MEM_TAG_SERVER);
+			sv_vis.phs = Mem_TagMalloc(rows, MEM_TAG_SERVER);
+
+			sv_vis.pvs_state = Mem_TagMalloc(sizeof(SDL_atomic_t) * sv_vis.num_clusters, MEM_TAG_SERVER);
+			sv_vis.phs_state = Mem_TagMalloc(sizeof(SDL_atomic_t) * sv_vis.num_clusters, MEM_TAG_SERVER);
+		}
+
+		sv_vis.entities = Mem_TagMalloc(sizeof(sv_vis_entities_t) * sv_vis.num_clusters, MEM_TAG_SERVER);
+		sv_vis.entities_state = Mem_TagMalloc(sizeof(SDL_atomic_t) * sv_vis.num_clusters, MEM_TAG_SERVER);
+
+		sv_vis.cluster_entities = Mem_TagMalloc(ENTITY_VECTOR * sv_vis.num_clusters, MEM_TAG_SERVER);
+		sv_vis.cluster_counts = Mem_TagMalloc(sizeof(uint16_t) * sv_vis.num_clusters, MEM_TAG_SERVER);
+		sv_vis.occupied = Mem_TagMalloc(sv_vis.row_size, MEM_TAG_SERVER);
+	}
+
+	Com_Debug("%d clusters, %u bytes per row\n", sv_vis.num_clusters, (uint32_t) sv_vis.row_size);
+}
+
+/*
+ * @brief Adds the specified entity to the index of the clusters it occupies.
+ * This is called by Sv_LinkEntity once the entity's clusters are resolved.
+ */
+void Sv_LinkVis(const uint16_t e) {
+
+	if (!sv_vis.num_clusters) {
+		return;
+	}
+
+	const sv_entity_t *sent = &sv.entities[e];
+
+	const byte bit = 1 << (e & 7);
+
+	if (sent->num_clusters == -1) {
+		sv_vis.top_node_entities[e >> 3] |= bit;
+	} else {
+		for (int32_t i = 0; i < sent->num_clusters; i++) {
+			const int32_t c = sent->clusters[i];
+
+			sv_vis.cluster_entities[c * ENTITY_VECTOR + (e >> 3)] |= bit;
+
+			if (sv_vis.cluster_counts[c]++ == 0) {
+				sv_vis.occupied[c >> 3] |= 1 << (c & 7);
+			}
+		}
+	}
+
+	sv_vis.linked[e >> 3] |= bit;
+}
+
+/*
+ * @brief Removes the specified entity from the cluster index. This must be
+ * called before the entity's clusters are modified.
+ */
+void Sv_UnlinkVis(const uint16_t e) {
+
+	const byte bit = 1 << (e & 7);
+
+	if (!(sv_vis.linked[e >> 3] & bit)) {
+		return;
+	}
+
+	const sv_entity_t *sent = &sv.entities[e];
+
+	if (sent->num_clusters == -1) {
+		sv_vis.top_node_entities[e >> 3] &= ~bit;
+	} else {
+		for (int32_t i = 0; i < sent->num_clusters; i++) {
+			const int32_t c = sent->clusters[i];
+
+			sv_vis.cluster_entities[c * ENTITY_VECTOR + (e >> 3)] &= ~bit;
+
+			if (--sv_vis.cluster_counts[c] == 0) {
+				sv_vis.occupied[c >> 3] &= ~(1 << (c & 7));
+			}
+		}
+	}
+
+	sv_vis.linked[e >> 3] &= ~bit;
+}
+
+/*
+ * @brief Accumulates the entities linked into the occupied clusters of the
+ * given visibility row.
+ */
+static void Sv_GatherClusterEntities(const byte *vis, byte *ents) {
+
+	for (size_t i = 0; i < sv_vis.row_size; i++) {
+		byte clusters = vis[i] & sv_vis.occupied[i];
+
+		while (clusters) {
+			const int32_t c = (int32_t) (i << 3) + __builtin_ctz(clusters);
+			clusters &= clusters - 1;
+
+			Cm_VisOr(ents, sv_vis.cluster_entities + c * ENTITY_VECTOR, ENTITY_VECTOR);
+		}
+	}
+}
+
+/*
+ * @brief Attempts to claim the specified cache entry for writing. Entries in
+ * any state other than pending or ready (e.g. empty, or ready for a previous
+ * frame) are claimed.
+ *
+ * @return True if the entry was claimed, and must be written and marked ready
+ * by the caller. False once the entry is ready.
+ */
+static _Bool Sv_ClaimVis(SDL_atomic_t *state, const int32_t pending, const int32_t ready) {
+
+	while (true) {
+		const int32_t s = SDL_AtomicGet(state);
+
+		if (s == ready) {
+			return false;
+		}
+
+		if (s != pending && SDL_AtomicCAS(state, s, pending)) {
+			return true;
+		}
+
+		// another thread is writing this entry, and will be done shortly
+		SDL_Delay(0);
+	}
+}
+
+/*
+ * @brief Resolves the row for the specified cluster from the collision model,
+ * or from the cache, decompressing it on first use.
+ */
+static const byte *Sv_ClusterVis(const int32_t cluster, byte *rows, SDL_atomic_t *states,
+		const byte *(*Row)(const int32_t), size_t (*Decompress)(const int32_t, byte *),
+		SDL_atomic_t *hits, SDL_atomic_t *misses) {
+
+	if (cluster < 0 || cluster >= sv_vis.num_clusters) {
+		return sv_vis.empty;
+	}
+
+	if (!rows) {
+		SDL_AtomicIncRef(hits);
+		return Row(cluster);
+	}
+
+	byte *row = rows + cluster * sv_vis.row_size;
+
+	if (Sv_ClaimVis(&states[cluster], SV_VIS_PENDING, SV_VIS_READY)) {
+		byte vis[MAX_BSP_LEAFS >> 3];
+
+		Decompress(cluster, vis);
+		memcpy(row, vis, sv_vis.row_size);
+
+		SDL_AtomicSet(&states[cluster], SV_VIS_READY);
+		SDL_AtomicIncRef(misses);
+	} else {
+		SDL_AtomicIncRef(hits);
+	}
+
+	return row;
+}
+
+/*
+ * @return The decompressed PVS row for the specified cluster. Invalid clusters
+ * see nothing.
+ */
+const byte *Sv_ClusterPVS(const int32_t cluster) {
+	return Sv_ClusterVis(cluster, sv_vis.pvs, sv_vis.pvs_state, Cm_ClusterPVSRow, Cm_ClusterPVS,
+			&sv_vis.pvs_hits, &sv_vis.pvs_misses);
+}
+
+/*
+ * @return The decompressed PHS row for the specified cluster. Invalid clusters
+ * hear nothing.
+ */
+const byte *Sv_ClusterPHS(const int32_t cluster) {
+	return Sv_ClusterVis(cluster, sv_vis.phs, sv_vis.phs_state, Cm_ClusterPHSRow, Cm_ClusterPHS,
+			&sv_vis.phs_hits, &sv_vis.phs_misses);
+}
+
+/*
+ * @brief Populates the table of entities visible from the specified cluster,
+ * gathering candidates from the index for each visible or audible cluster.
+ */
+static void Sv_BuildClusterEntities(const int32_t cluster, sv_vis_entities_t *ents) {
+	byte pvs_ents[ENTITY_VECTOR], phs_ents[ENTITY_VECTOR], candidates[ENTITY_VECTOR];
+
+	const byte *pvs = Sv_ClusterPVS(cluster);
+	const byte *phs = Sv_ClusterPHS(cluster);
+
+	memset(pvs_ents, 0, sizeof(pvs_ents));
+	memset(phs_ents, 0, sizeof(phs_ents));
+
+	Sv_GatherClusterEntities(pvs, pvs_ents);
+	Sv_GatherClusterEntities(phs, phs_ents);
+
+	for (size_t i = 0; i < ENTITY_VECTOR; i++) {
+		candidates[i] = pvs_ents[i] | phs_ents[i] | sv_vis.top_node_entities[i];
+	}
+
+	memset(ents, 0, sizeof(*ents));
+
+	for (uint16_t e = 1; e < svs.game->num_entities; e++) {
+
+		// skip over empty bytes of the vector
+		if (!candidates[e >> 3]) {
+			e |= 7;
+			continue;
+		}
+
+		const byte bit = 1 << (e & 7);
+
+		if (!(candidates[e >> 3] & bit))
+			continue;
+
+		const g_entity_t *ent = ENTITY_FOR_NUM(e);
+
+		// ignore entities that are local to the server
+		if (ent->sv_flags & SVF_NO_CLIENT)
+			continue;
+
+		// ignore entities without visible presence unless they have an effect
+		if (!ent->s.event && !ent->s.effects && !ent->s.trail && !ent->s.model1 && !ent->s.sound)
+			continue;
+
+		const sv_entity_t *sent = &sv.entities[e];
+
+		if (ent->s.sound || ent->s.event) {
+			if (sent->num_clusters == -1 ? Cm_HeadnodeVisible(sent->top_node, phs) : (phs_ents[e >> 3] & bit)) {
+				ents->phs[e >> 3] |= bit;
+			}
+		} else {
+			if (sent->num_clusters == -1 ? Cm_HeadnodeVisible(sent->top_node, pvs) : (pvs_ents[e >> 3] & bit)) {
+				ents->pvs[e >> 3] |= bit;
+			}
+		}
+	}
+}
+
+/*
+ * @brief Resolves the entities visible from the specified cluster in the
+ * current frame, building the table for the first client that requests it.
+ * This must only be called once all entities have been linked for the frame.
+ *
+ * @return The entity table, or NULL for invalid clusters.
+ */
+const sv_vis_entities_t *Sv_ClusterEntities(const int32_t cluster) {
+
+	if (cluster < 0 || cluster >= sv_vis.num_clusters) {
+		return NULL;
+	}
+
+	sv_vis_entities_t *ents = &sv_vis.entities[cluster];
+
+	const int32_t frame = sv.frame_num << 2;
+
+	if (Sv_ClaimVis(&sv_vis.entities_state[cluster], frame | SV_VIS_PENDING,
+			frame | SV_VIS_READY)) {
+
+		Sv_BuildClusterEntities(cluster, ents);
+
+		SDL_AtomicSet(&sv_vis.entities_state[cluster], frame | SV_VIS_READY);
+		SDL_AtomicIncRef(&sv_vis.entities_misses);
+	} else {
+		SDL_AtomicIncRef(&sv_vis.entities_hits);
+	}
+
+	return ents;
+}
+
+/*
+ * @brief Copies the cache hit and miss counters to the specified structure.
+ */
+void Sv_VisStats(sv_vis_stats_t *stats) {
+
+	stats->pvs_hits = SDL_AtomicGet(&sv_vis.pvs_hits);
+	stats->pvs_misses = SDL_AtomicGet(&sv_vis.pvs_misses);
+	stats->phs_hits = SDL_AtomicGet(&sv_vis.phs_hits);
+	stats->phs_misses = SDL_AtomicGet(&sv_vis.phs_misses);
+	stats->entities_hits = SDL_AtomicGet(&sv_vis.entities_hits);
+	stats->entities_misses = SDL_AtomicGet(&sv_vis.entities_misses);
+}
+
+/*
+ * @brief Resets the cache hit and miss counters.
+ */
+void Sv_ClearVisStats(void) {
+
+	SDL_AtomicSet(&sv_vis.pvs_hits, 0);
+	SDL_AtomicSet(&sv_vis.pvs_misses, 0);
+	SDL_AtomicSet(&sv_vis.phs_hits, 0);
+	SDL_AtomicSet(&sv_vis.phs_misses, 0);
+	SDL_AtomicSet(&sv_vis.entities_hits, 0);
+	SDL_AtomicSet(&sv_vis.entities_misses, 0);
+}
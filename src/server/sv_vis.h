@@ -0,0 +1,39 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SV_VIS_H__
+#define __SV_VIS_H__
+
+#include "sv_types.h"
+
+#ifdef __SV_LOCAL_H__
+void Sv_InitVis(void);
+void Sv_ShutdownVis(void);
+void Sv_LinkVis(const uint16_t e);
+void Sv_UnlinkVis(const uint16_t e);
+const byte *Sv_ClusterPVS(const int32_t cluster);
+const byte *Sv_ClusterPHS(const int32_t cluster);
+const sv_vis_entities_t *Sv_ClusterEntities(const int32_t cluster);
+void Sv_VisStats(sv_vis_stats_t *stats);
+void Sv_ClearVisStats(void);
+#endif /* __SV_LOCAL_H__ */
+
+#endif /* __SV_VIS_H__ */
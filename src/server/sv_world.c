@@ -22,86 +22,37 @@
 #include "sv_local.h"
 
 /*
- * @brief The world is divided into evenly sized sectors to aid in entity
- * management. This works like a meta-BSP tree, providing fast searches via
- * recursion to find entities within an arbitrary box.
- */
-typedef struct sv_sector_s {
-	int32_t axis; // -1 = leaf
-	vec_t dist;
-	struct sv_sector_s *children[2];
-	GList *entities;
-} sv_sector_t;
-
-#define SECTOR_DEPTH	4
-#define SECTOR_NODES	32
-
-/*
- * @brief The world structure contains all sectors and also the current query
- * context issued to Sv_BoxEntities.
+ * @brief The world holds a grid of the solid entities, providing fast searches
+ * for entities within an arbitrary box.
  */
 typedef struct {
-	sv_sector_t sectors[SECTOR_NODES];
-	uint16_t num_sectors;
-
-	const vec_t *box_mins, *box_maxs;
-
-	g_entity_t **box_entities;
-	size_t num_box_entities, max_box_entities;
-
-	uint32_t box_type; // BOX_SOLID, BOX_TRIGGER, ..
+	sv_grid_t *grid;
 } sv_world_t;
 
 static sv_world_t sv_world;
 
 /*
- * @brief Builds a uniformly subdivided tree for the given world size.
+ * @brief Frees the entity grid.
  */
-static sv_sector_t *Sv_CreateSector(int32_t depth, vec3_t mins, vec3_t maxs) {
-	vec3_t size, mins1, maxs1, mins2, maxs2;
-
-	sv_sector_t *sector = &sv_world.sectors[sv_world.num_sectors];
-	sv_world.num_sectors++;
+void Sv_ShutdownWorld(void) {
 
-	if (depth == SECTOR_DEPTH) {
-		sector->axis = -1;
-		sector->children[0] = sector->children[1] = NULL;
-		return sector;
+	if (sv_world.grid) {
+		Sv_FreeGrid(sv_world.grid);
 	}
 
-	VectorSubtract(maxs, mins, size);
-	if (size[0] > size[1])
-		sector->axis = 0;
-	else
-		sector->axis = 1;
-
-	sector->dist = 0.5 * (maxs[sector->axis] + mins[sector->axis]);
-	VectorCopy(mins, mins1);
-	VectorCopy(mins, mins2);
-	VectorCopy(maxs, maxs1);
-	VectorCopy(maxs, maxs2);
-
-	maxs1[sector->axis] = mins2[sector->axis] = sector->dist;
-
-	sector->children[0] = Sv_CreateSector(depth + 1, mins2, maxs2);
-	sector->children[1] = Sv_CreateSector(depth + 1, mins1, maxs1);
-
-	return sector;
+	memset(&sv_world, 0, sizeof(sv_world));
 }
 
 /*
- * @brief Resolve our area nodes for a newly loaded level. This is called prior to
- * linking any entities.
+ * @brief Creates the entity grid for a newly loaded level. This is called prior
+ * to linking any entities.
  */
 void Sv_InitWorld(void) {
 
-	for (uint16_t i = 0; i < sv_world.num_sectors; i++) {
-		g_list_free(sv_world.sectors[i].entities);
-	}
-
-	memset(&sv_world, 0, sizeof(sv_world));
+	Sv_ShutdownWorld();
 
-	Sv_CreateSector(0, sv.cm_models[0]->mins, sv.cm_models[0]->maxs);
+	sv_world.grid = Sv_CreateGrid(sv.cm_models[0]->mins, sv.cm_models[0]->maxs, MAX_ENTITIES,
+			MEM_TAG_SERVER);
 }
 
 /*
@@ -110,11 +61,14 @@ void Sv_InitWorld(void) {
  */
 void Sv_UnlinkEntity(g_entity_t *ent) {
 
-	sv_entity_t *sent = &sv.entities[NUM_FOR_ENTITY(ent)];
+	const uint16_t e = NUM_FOR_ENTITY(ent);
+	sv_entity_t *sent = &sv.entities[e];
+
+	// remove it from the cluster index before its clusters are cleared
+	Sv_UnlinkVis(e);
 
-	if (sent->sector) {
-		sv_sector_t *sector = (sv_sector_t *) sent->sector;
-		sector->entities = g_list_remove(sector->entities, ent);
+	if (sent->linked) {
+		Sv_GridUnlink(sv_world.grid, e);
 
 		memset(sent, 0, sizeof(*sent));
 	}
@@ -133,7 +87,7 @@ void Sv_LinkEntity(g_entity_t *ent) {
 	if (ent == svs.game->entities) // never bother with the world
 		return;
 
-	// remove it from its current sector
+	// remove it from the grid
 	Sv_UnlinkEntity(ent);
 
 	if (!ent->in_use) // and if its free, we're done
@@ -233,27 +187,15 @@ void Sv_LinkEntity(g_entity_t *ent) {
 		}
 	}
 
+	// add it to the cluster index, regardless of whether it is solid
+	Sv_LinkVis(NUM_FOR_ENTITY(ent));
+
 	if (ent->solid == SOLID_NOT)
 		return;
 
-	// find the first sector that the ent's box crosses
-	sv_sector_t *sector = sv_world.sectors;
-	while (true) {
-
-		if (sector->axis == -1)
-			break;
-
-		if (ent->abs_mins[sector->axis] > sector->dist)
-			sector = sector->children[0];
-		else if (ent->abs_maxs[sector->axis] < sector->dist)
-			sector = sector->children[1];
-		else
-			break; // crosses the node
-	}
-
-	// add it to the sector
-	sent->sector = sector;
-	sector->entities = g_list_prepend(sector->entities, ent);
+	// add it to the grid
+	Sv_GridLink(sv_world.grid, NUM_FOR_ENTITY(ent), ent->abs_mins, ent->abs_maxs);
+	sent->linked = true;
 
 	// and update its clipping matrices
 	const vec_t *angles = ent->solid == SOLID_BSP ? ent->s.angles : vec3_origin;
@@ -263,20 +205,20 @@ void Sv_LinkEntity(g_entity_t *ent) {
 }
 
 /*
- * @return True if the entity matches the current world filter, false otherwise.
+ * @return True if the entity matches the specified box type, false otherwise.
  */
-static _Bool Sv_BoxEntities_Filter(const g_entity_t *ent) {
+static _Bool Sv_BoxEntities_Filter(const g_entity_t *ent, const uint32_t type) {
 
 	switch (ent->solid) {
 		case SOLID_TRIGGER:
-			if (sv_world.box_type & BOX_OCCUPY)
+			if (type & BOX_OCCUPY)
 				return true;
 			break;
 
 		case SOLID_DEAD:
 		case SOLID_BOX:
 		case SOLID_BSP:
-			if (sv_world.box_type & BOX_COLLIDE)
+			if (type & BOX_COLLIDE)
 				return true;
 			break;
 
@@ -287,43 +229,6 @@ static _Bool Sv_BoxEntities_Filter(const g_entity_t *ent) {
 	return false;
 }
 
-/*
- * @brief
- */
-static void Sv_BoxEntities_r(sv_sector_t *sector) {
-
-	GList *e = sector->entities;
-	while (e) {
-		g_entity_t *ent = (g_entity_t *) e->data;
-
-		if (Sv_BoxEntities_Filter(ent)) {
-
-			if (BoxIntersect(ent->abs_mins, ent->abs_maxs, sv_world.box_mins, sv_world.box_maxs)) {
-
-				sv_world.box_entities[sv_world.num_box_entities] = ent;
-				sv_world.num_box_entities++;
-
-				if (sv_world.num_box_entities == sv_world.max_box_entities) {
-					Com_Warn("sv_world.max_box_entities reached\n");
-					return;
-				}
-			}
-		}
-
-		e = e->next;
-	}
-
-	if (sector->axis == -1)
-		return; // terminal node
-
-	// recurse down both sides
-	if (sv_world.box_maxs[sector->axis] > sector->dist)
-		Sv_BoxEntities_r(sector->children[0]);
-
-	if (sv_world.box_mins[sector->axis] < sector->dist)
-		Sv_BoxEntities_r(sector->children[1]);
-}
-
 /*
  * @brief Populates an array of entities with those which have bounding boxes
  * that intersect the given area. It is possible for a non-axial BSP model to
@@ -333,17 +238,25 @@ static void Sv_BoxEntities_r(sv_sector_t *sector) {
  */
 size_t Sv_BoxEntities(const vec3_t mins, const vec3_t maxs, g_entity_t **list, const size_t len,
 		const uint32_t type) {
+	int32_t items[MAX_ENTITIES];
+	size_t count = 0;
 
-	sv_world.box_mins = mins;
-	sv_world.box_maxs = maxs;
-	sv_world.box_entities = list;
-	sv_world.num_box_entities = 0;
-	sv_world.max_box_entities = len;
-	sv_world.box_type = type;
+	const size_t num_items = Sv_GridQuery(sv_world.grid, mins, maxs, items, lengthof(items));
 
-	Sv_BoxEntities_r(sv_world.sectors);
+	for (size_t i = 0; i < num_items; i++) {
+		g_entity_t *ent = ENTITY_FOR_NUM(items[i]);
+
+		if (Sv_BoxEntities_Filter(ent, type)) {
+			list[count++] = ent;
+
+			if (count == len) {
+				Com_Warn("Box entities limit (%u) reached\n", (uint32_t) len);
+				break;
+			}
+		}
+	}
 
-	return sv_world.num_box_entities;
+	return count;
 }
 
 /*
@@ -26,6 +26,7 @@
 
 #ifdef __SV_LOCAL_H__
 void Sv_InitWorld(void);
+void Sv_ShutdownWorld(void);
 void Sv_LinkEntity(g_entity_t *ent);
 void Sv_UnlinkEntity(g_entity_t *ent);
 size_t Sv_BoxEntities(const vec3_t mins, const vec3_t maxs, g_entity_t **list, const size_t len,
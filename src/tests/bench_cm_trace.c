@@ -0,0 +1,202 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "collision/cmodel.h"
+#include "filesystem.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Compares the rate of rays traced individually by Cm_BoxTrace against those
+ * traced in batches by Cm_BoxTraces, through maps/torn.bsp, for points and
+ * for a player sized box. The rays are the same on every run, and a checksum
+ * of their results is reported, so that changes to the collision model can be
+ * shown to trace identically. Built with the tests, but run only by
+ * `make bench`.
+ */
+
+#define BENCH_RAYS 4096
+#define BENCH_BATCH 64
+#define BENCH_ITERATIONS 16
+
+static cm_bsp_model_t *world;
+
+static vec3_t starts[BENCH_RAYS], ends[BENCH_RAYS];
+static cm_trace_t traces[BENCH_RAYS], batched[BENCH_RAYS];
+
+/*
+ * @return A repeatable pseudo-random number between 0.0 and 1.0.
+ */
+static vec_t bench_Random(void) {
+	static uint32_t seed = 1;
+
+	seed = seed * 1664525 + 1013904223;
+	return (seed >> 8) / (vec_t) (1 << 24);
+}
+
+/*
+ * @brief Generates random rays within the world bounds, some of them long,
+ * and some short.
+ */
+static void bench_Rays(void) {
+
+	for (int32_t i = 0; i < BENCH_RAYS; i++) {
+		for (int32_t j = 0; j < 3; j++) {
+			starts[i][j] = world->mins[j] + bench_Random() * (world->maxs[j] - world->mins[j]);
+			ends[i][j] = world->mins[j] + bench_Random() * (world->maxs[j] - world->mins[j]);
+		}
+
+		if (i & 1) {
+			VectorLerp(starts[i], ends[i], 0.05, ends[i]);
+		}
+	}
+}
+
+/*
+ * @brief Accumulates the given bytes into an FNV-1a hash.
+ */
+static uint64_t bench_Hash(uint64_t hash, const void *data, size_t len) {
+
+	for (const byte *b = data; len; b++, len--) {
+		hash = (hash ^ *b) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+/*
+ * @return A checksum of the results of the individual traces.
+ */
+static uint64_t bench_Checksum(void) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (int32_t i = 0; i < BENCH_RAYS; i++) {
+		const cm_trace_t *tr = &traces[i];
+
+		hash = bench_Hash(hash, &tr->all_solid, sizeof(tr->all_solid));
+		hash = bench_Hash(hash, &tr->start_solid, sizeof(tr->start_solid));
+		hash = bench_Hash(hash, &tr->fraction, sizeof(tr->fraction));
+		hash = bench_Hash(hash, tr->end, sizeof(tr->end));
+		hash = bench_Hash(hash, tr->plane.normal, sizeof(tr->plane.normal));
+		hash = bench_Hash(hash, &tr->plane.dist, sizeof(tr->plane.dist));
+		hash = bench_Hash(hash, &tr->plane.num, sizeof(tr->plane.num));
+		hash = bench_Hash(hash, &tr->contents, sizeof(tr->contents));
+
+		if (tr->surface) {
+			hash = bench_Hash(hash, tr->surface->name, strlen(tr->surface->name));
+		}
+	}
+
+	return hash;
+}
+
+/*
+ * @brief Traces every ray individually, and then in batches, repeatedly,
+ * reporting the rate of each.
+ *
+ * @return True if the batched results match the individual ones.
+ */
+static _Bool bench_Cm_BoxTraces(const char *name, const vec3_t mins, const vec3_t maxs) {
+
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	for (int32_t n = 0; n < BENCH_ITERATIONS; n++) {
+		for (int32_t i = 0; i < BENCH_RAYS; i++) {
+			traces[i] = Cm_BoxTrace(starts[i], ends[i], mins, maxs, world->head_node, MASK_SOLID);
+		}
+	}
+
+	const double single = Test_Seconds(start);
+
+	start = SDL_GetPerformanceCounter();
+
+	for (int32_t n = 0; n < BENCH_ITERATIONS; n++) {
+		for (int32_t i = 0; i < BENCH_RAYS; i += BENCH_BATCH) {
+			Cm_BoxTraces(starts + i, ends + i, BENCH_BATCH, mins, maxs, world->head_node, MASK_SOLID,
+					batched + i);
+		}
+	}
+
+	const double batch = Test_Seconds(start);
+
+	int32_t hits = 0, mismatches = 0;
+
+	for (int32_t i = 0; i < BENCH_RAYS; i++) {
+		const cm_trace_t *a = &traces[i], *b = &batched[i];
+
+		if (memcmp(&a->fraction, &b->fraction, sizeof(a->fraction)) ||
+				memcmp(a->end, b->end, sizeof(a->end)) ||
+				memcmp(&a->plane, &b->plane, sizeof(a->plane)) ||
+				a->contents != b->contents || a->surface != b->surface) {
+			mismatches++;
+		}
+
+		if (a->fraction < 1.0) {
+			hits++;
+		}
+	}
+
+	const int32_t rays = BENCH_RAYS * BENCH_ITERATIONS;
+
+	printf("%s: %s: %d rays, %d hit: Cm_BoxTrace %.0f rays/s, Cm_BoxTraces %.0f rays/s\n", __func__,
+			name, rays, hits * BENCH_ITERATIONS, rays / single, rays / batch);
+
+	printf("%s: %s: checksum %016" PRIx64 "\n", __func__, name, bench_Checksum());
+
+	if (mismatches) {
+		printf("%s: %s: %d batched traces differ\n", __func__, name, mismatches);
+	}
+
+	return mismatches == 0;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+	const vec3_t mins = { -16.0, -16.0, -24.0 };
+	const vec3_t maxs = { 16.0, 16.0, 32.0 };
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	world = Cm_LoadBspModel("maps/torn.bsp", NULL);
+
+	bench_Rays();
+
+	_Bool passed = true;
+
+	passed &= bench_Cm_BoxTraces("point", vec3_origin, vec3_origin);
+	passed &= bench_Cm_BoxTraces("box", mins, maxs);
+
+	Cm_LoadBspModel(NULL, NULL);
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return !passed;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <physfs.h>
+
+#include "tests.h"
+#include "filesystem.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Compares the rate of typical asset probes, most of which miss, through the
+ * filesystem index against a walk of the search path by PhysFS. Built with
+ * the tests, but run only by `make bench`.
+ */
+
+#define BENCH_ITERATIONS 2000
+
+static const char *filenames[] = {
+	"quetoo.cfg",
+	"maps/torn.bsp",
+	"maps/torn.cfg",
+	"textures/common/caulk.tga",
+	"textures/common/caulk.png",
+	"textures/common/caulk.jpg",
+	"textures/common/caulk.pcx",
+	"textures/common/caulk.wal",
+	"textures/common/caulk_nm.tga",
+	"textures/common/caulk_s.tga",
+	"players/qforcer/jump1.ogg",
+	"players/qforcer/jump1.wav",
+	"sounds/does/not/exist.ogg",
+	NULL
+};
+
+/*
+ * @brief Probes every filename repeatedly with the given function, reporting
+ * the rate of lookups.
+ *
+ * @return The number of probes which hit.
+ */
+static uint32_t bench_Fs_Exists(const char *name, int (*exists)(const char *)) {
+	uint32_t lookups = 0, hits = 0;
+
+	const uint64_t start = SDL_GetPerformanceCounter();
+
+	for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+		for (const char **filename = filenames; *filename; filename++, lookups++) {
+			hits += exists(*filename) != 0;
+		}
+	}
+
+	const double seconds = Test_Seconds(start);
+
+	printf("%s: %s: %u lookups in %.3fs (%.0f lookups/s)\n", __func__, name, lookups, seconds,
+			lookups / seconds);
+
+	return hits;
+}
+
+/*
+ * @brief Adapts Fs_Exists to the signature of PHYSFS_exists.
+ */
+static int Fs_Exists_(const char *filename) {
+	return Fs_Exists(filename);
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	const uint32_t physfs = bench_Fs_Exists("PhysFS", PHYSFS_exists);
+	const uint32_t index = bench_Fs_Exists("index", Fs_Exists_);
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return physfs != index;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "tests.h"
+#include "mem.h"
+
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Measures the rate of concurrent allocation, linking and freeing of managed
+ * memory over a range of thread counts. Built with the tests, but run only by
+ * `make bench`.
+ */
+
+#define BENCH_THREADS 16
+#define BENCH_ITERATIONS 100000
+#define BENCH_ROOTS 64
+
+/*
+ * @brief Allocates, links and frees a mix of small and large blocks.
+ */
+static int32_t allocate(void *data __attribute__((unused))) {
+	void *roots[BENCH_ROOTS];
+
+	memset(roots, 0, sizeof(roots));
+
+	for (int32_t i = 0; i < BENCH_ITERATIONS; i++) {
+		void **root = &roots[i % BENCH_ROOTS];
+
+		if (*root) {
+			Mem_Free(*root);
+		}
+
+		*root = Mem_TagMalloc(1 + (i % 4096), (i & 1) ? MEM_TAG_GAME : MEM_TAG_CLIENT);
+
+		for (int32_t j = 0; j < 4; j++) {
+			void *child = Mem_LinkMalloc(16 << j, *root);
+			if (j & 1) {
+				Mem_Free(child);
+			}
+		}
+	}
+
+	for (int32_t i = 0; i < BENCH_ROOTS; i++) {
+		if (roots[i]) {
+			Mem_Free(roots[i]);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * @brief Runs the allocation loop on the given number of threads at once,
+ * reporting the rate at which blocks were allocated.
+ *
+ * @return True if every block was accounted for and freed, false otherwise.
+ */
+static _Bool bench_Mem_Concurrent(int32_t num_threads) {
+	SDL_Thread *threads[BENCH_THREADS];
+
+	Mem_Init();
+
+	const uint64_t start = SDL_GetPerformanceCounter();
+
+	for (int32_t i = 0; i < num_threads; i++) {
+		threads[i] = SDL_CreateThread(allocate, __func__, NULL);
+	}
+
+	for (int32_t i = 0; i < num_threads; i++) {
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	const double seconds = Test_Seconds(start);
+
+	mem_stats_t stats;
+	Mem_Stats(&stats);
+
+	const uint32_t allocations = stats.tags[MEM_TAG_GAME].allocations +
+			stats.tags[MEM_TAG_CLIENT].allocations + stats.tags[MEM_TAG_DEFAULT].allocations;
+
+	printf("%s: %u allocations on %d threads in %.3fs (%.0f allocs/s)\n", __func__, allocations,
+			num_threads, seconds, allocations / seconds);
+
+	const _Bool ok = Mem_Size() == 0 && allocations == (uint32_t) num_threads * BENCH_ITERATIONS * 5;
+
+	Mem_Shutdown();
+
+	return ok;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+	int32_t failed = 0;
+
+	Test_Init(argc, argv);
+
+	for (int32_t threads = 1; threads <= BENCH_THREADS; threads *= 2) {
+		failed += !bench_Mem_Concurrent(threads);
+	}
+
+	Test_Shutdown();
+	return failed;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "net/net_message.h"
+#include "net/net_types.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Compares the legacy and bit packed packet entity encodings over frames of
+ * moving entities, reporting the bytes per frame and the rate at which each
+ * encodes. Built with the tests, but run only by `make bench`.
+ */
+
+#define BENCH_ENTITIES 64
+#define BENCH_FRAMES 1000
+#define BENCH_ITERATIONS 10
+
+static entity_state_t frames[BENCH_FRAMES + 1][BENCH_ENTITIES];
+
+/*
+ * @brief Moves the entity as the game might, with the occasional teleport.
+ */
+static void move(entity_state_t *s) {
+
+	const int32_t r = rand() % 100;
+
+	if (r < 40) {
+		return; // idle
+	}
+
+	if (r < 98) {
+		for (int32_t i = 0; i < 3; i++) {
+			s->origin[i] += Randomc() * 12.0;
+		}
+		s->angles[YAW] = ClampAngle(s->angles[YAW] + Randomc() * 30.0);
+	} else {
+		for (int32_t i = 0; i < 3; i++) {
+			s->origin[i] = Randomc() * MAX_WORLD_COORD;
+		}
+		s->model1 = rand() & 0xff;
+	}
+}
+
+/*
+ * @brief Encodes the frame with the legacy protocol.
+ */
+static void encode_legacy(mem_buf_t *msg, const entity_state_t *from, const entity_state_t *to) {
+
+	for (int32_t i = 0; i < BENCH_ENTITIES; i++) {
+		Net_WriteDeltaEntity(msg, &from[i], &to[i], false);
+	}
+
+	Net_WriteShort(msg, 0);
+}
+
+/*
+ * @brief Encodes the frame with the bit packed protocol.
+ */
+static void encode_packed(mem_buf_t *msg, const entity_state_t *from, const entity_state_t *to) {
+	mem_bits_t bits;
+
+	Mem_BeginBits(&bits, msg);
+
+	uint16_t last = 0;
+	for (int32_t i = 0; i < BENCH_ENTITIES; i++) {
+		if (Net_WriteDeltaEntityBits(&bits, last, &from[i], &to[i], false)) {
+			last = to[i].number;
+		}
+	}
+
+	Net_WriteEntityNumberBits(&bits, last, 0);
+	Mem_EndWriteBits(&bits);
+}
+
+/*
+ * @brief Encodes the sequence of frames with the given encoder, reporting the
+ * bytes per frame and the rate of encoding.
+ *
+ * @return The total size of the encoded frames.
+ */
+static size_t bench_Net_WriteDeltaEntity(const char *name, void (*encode)(mem_buf_t *,
+		const entity_state_t *, const entity_state_t *)) {
+	byte buffer[MAX_MSG_SIZE];
+	mem_buf_t msg;
+	size_t bytes = 0;
+
+	Mem_InitBuffer(&msg, buffer, sizeof(buffer));
+
+	const uint64_t start = SDL_GetPerformanceCounter();
+
+	for (int32_t n = 0; n < BENCH_ITERATIONS; n++) {
+		for (int32_t f = 0; f < BENCH_FRAMES; f++) {
+			Mem_ClearBuffer(&msg);
+
+			encode(&msg, frames[f], frames[f + 1]);
+
+			bytes += msg.size;
+		}
+	}
+
+	const double seconds = Test_Seconds(start);
+	const int32_t count = BENCH_FRAMES * BENCH_ITERATIONS;
+
+	printf("%s: %s: %d entities, %d frames: %.1f bytes/frame, %.0f entities/s\n", __func__, name,
+			BENCH_ENTITIES, count, bytes / (double) count, BENCH_ENTITIES * count / seconds);
+
+	return bytes;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	// both encoders are given the same sequence of frames
+	for (int32_t i = 0; i < BENCH_ENTITIES; i++) {
+		frames[0][i].number = 1 + i * 3;
+		for (int32_t j = 0; j < 3; j++) {
+			frames[0][i].origin[j] = Randomc() * MAX_WORLD_COORD;
+		}
+	}
+
+	for (int32_t f = 1; f <= BENCH_FRAMES; f++) {
+		for (int32_t i = 0; i < BENCH_ENTITIES; i++) {
+			frames[f][i] = frames[f - 1][i];
+			move(&frames[f][i]);
+		}
+	}
+
+	const size_t legacy = bench_Net_WriteDeltaEntity("legacy", encode_legacy);
+	const size_t packed = bench_Net_WriteDeltaEntity("packed", encode_packed);
+
+	printf("packed is %.1f%% of legacy\n", 100.0 * packed / legacy);
+
+	Test_Shutdown();
+	return packed >= legacy;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "cmd.h"
+#include "cvar.h"
+#include "files.h"
+#include "filesystem.h"
+#include "replay.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Times the replay of a packet capture, reporting the rate of messages,
+ * packets and bytes, and the allocations made while replaying. Run with the
+ * path of a capture, relative to the search path, to benchmark a real
+ * session, e.g.:
+ *
+ *   bench_net_replay captures/ctf.cap
+ *
+ * Otherwise, a session is synthesized over the loopback and replayed. Built
+ * with the tests, but run only by `make bench`.
+ */
+
+#define BENCH_CAPTURE "captures/bench_net_replay.cap"
+#define BENCH_ITERATIONS 10
+
+cvar_t *dedicated;
+
+/*
+ * @brief Replays the capture repeatedly, reporting the rates of the replay.
+ *
+ * @return True if the capture was well formed and legible.
+ */
+static _Bool bench_Net_Replay(const char *filename, const byte *data, size_t len) {
+	replay_stats_t stats, total;
+	memset(&total, 0, sizeof(total));
+
+	double seconds = 0.0;
+
+	for (int32_t i = 0; i < BENCH_ITERATIONS; i++) {
+
+		const uint64_t start = SDL_GetPerformanceCounter();
+
+		if (!Replay(data, len, &stats)) {
+			printf("%s: %s: malformed capture\n", __func__, filename);
+			return false;
+		}
+
+		seconds += Test_Seconds(start);
+
+		Replay_Shutdown();
+
+		total.packets += stats.packets;
+		total.messages += stats.messages;
+		total.bytes += stats.bytes;
+	}
+
+	printf("%s: %s: %u packets (%u dropped, %u illegible, %u opaque), %u messages, %u bytes\n",
+			__func__, filename, stats.packets, stats.dropped, stats.illegible, stats.opaque,
+			stats.messages, (uint32_t) stats.bytes);
+
+	printf("%s: %s: %.0f messages/s, %.0f packets/s, %.1f MB/s, %u allocations per replay\n",
+			__func__, filename, total.messages / seconds, total.packets / seconds,
+			total.bytes / seconds / (1024.0 * 1024.0), stats.allocations);
+
+	return stats.illegible == 0;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+	void *data;
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	Fs_Init(false);
+
+	Cmd_Init();
+
+	Cvar_Init();
+
+	dedicated = Cvar_Get("dedicated", "0", CVAR_NO_SET, NULL);
+
+	Netchan_Init();
+
+	const char *filename = Com_Argc() > 1 ? Com_Argv(1) : BENCH_CAPTURE;
+	_Bool passed = false;
+
+	replay_stats_t live;
+	if (Com_Argc() < 2 && !Replay_Capture(filename, &live)) {
+		printf("Failed to capture %s\n", filename);
+	} else {
+		const int64_t len = Fs_Load(filename, &data);
+		if (len > 0) {
+			passed = bench_Net_Replay(filename, data, len);
+			Fs_Free(data);
+		} else {
+			printf("Failed to load %s\n", filename);
+		}
+	}
+
+	Netchan_Shutdown();
+
+	Cvar_Shutdown();
+
+	Cmd_Shutdown();
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return !passed;
+}
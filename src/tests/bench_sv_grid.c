@@ -0,0 +1,193 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "tests.h"
+#include "server/sv_grid.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Links, moves and queries a world of entities as a busy server would, and
+ * reports the rate of trace queries against the grid and against a brute
+ * force scan. Built with the tests, but run only by `make bench`.
+ */
+
+#define BENCH_ENTITIES 1024
+#define BENCH_FRAMES 100
+#define BENCH_QUERIES 64
+
+static sv_grid_t *grid;
+
+static vec3_t world_mins = { -4096.0, -4096.0, -1024.0 };
+static vec3_t world_maxs = { 4096.0, 4096.0, 1024.0 };
+
+static vec3_t mins[BENCH_ENTITIES], maxs[BENCH_ENTITIES];
+
+/*
+ * @brief Places the specified entity randomly within the world. Most entities
+ * are player sized, while some are large, like doors and triggers.
+ */
+static void place(const int32_t e) {
+	vec3_t origin, size;
+
+	for (int32_t i = 0; i < 3; i++) {
+		origin[i] = world_mins[i] + Randomf() * (world_maxs[i] - world_mins[i]);
+	}
+
+	if (e % 16 == 0) {
+		VectorSet(size, 64.0 + Randomf() * 768.0, 64.0 + Randomf() * 768.0, 128.0);
+	} else {
+		VectorSet(size, 32.0, 32.0, 56.0);
+	}
+
+	VectorMA(origin, -0.5, size, mins[e]);
+	VectorMA(origin, 0.5, size, maxs[e]);
+}
+
+/*
+ * @brief Moves the specified entity by a small amount, as in a server frame.
+ */
+static void move(const int32_t e) {
+	vec3_t delta;
+
+	VectorSet(delta, Randomc() * 32.0, Randomc() * 32.0, 0.0);
+
+	VectorAdd(mins[e], delta, mins[e]);
+	VectorAdd(maxs[e], delta, maxs[e]);
+}
+
+/*
+ * @brief Resolves the query box for a trace of the specified entity.
+ */
+static void trace_box(const int32_t e, vec3_t box_mins, vec3_t box_maxs) {
+
+	VectorCopy(mins[e], box_mins);
+	VectorCopy(maxs[e], box_maxs);
+
+	for (int32_t i = 0; i < 2; i++) {
+		box_mins[i] -= 64.0;
+		box_maxs[i] += 64.0;
+	}
+}
+
+/*
+ * @return The number of entities intersecting the given box, by brute force.
+ */
+static size_t brute_force(const vec3_t box_mins, const vec3_t box_maxs) {
+	size_t count = 0;
+
+	for (int32_t e = 0; e < BENCH_ENTITIES; e++) {
+		if (BoxIntersect(mins[e], maxs[e], box_mins, box_maxs)) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * @brief Moves and relinks every entity, and queries the grid around each of
+ * them, for a number of frames. The brute force scan is sampled over fewer
+ * frames, as it is far slower.
+ *
+ * @return True if the grid and brute force agreed on every sampled query.
+ */
+static _Bool bench_Sv_GridQuery(void) {
+	int32_t items[BENCH_ENTITIES];
+	uint32_t links = 0, queries = 0, brute_queries = 0;
+	_Bool ok = true;
+
+	for (int32_t e = 0; e < BENCH_ENTITIES; e++) {
+		place(e);
+		Sv_GridLink(grid, e, mins[e], maxs[e]);
+	}
+
+	double link_seconds = 0.0, query_seconds = 0.0, brute_seconds = 0.0;
+
+	for (int32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+
+		uint64_t start = SDL_GetPerformanceCounter();
+
+		for (int32_t e = 0; e < BENCH_ENTITIES; e++, links++) {
+			move(e);
+			Sv_GridLink(grid, e, mins[e], maxs[e]);
+		}
+
+		link_seconds += Test_Seconds(start);
+
+		start = SDL_GetPerformanceCounter();
+
+		for (int32_t e = 0; e < BENCH_ENTITIES; e++) {
+			vec3_t box_mins, box_maxs;
+			trace_box(e, box_mins, box_maxs);
+
+			for (int32_t q = 0; q < BENCH_QUERIES; q++, queries++) {
+				Sv_GridQuery(grid, box_mins, box_maxs, items, lengthof(items));
+			}
+		}
+
+		query_seconds += Test_Seconds(start);
+
+		if (frame % 10) {
+			continue;
+		}
+
+		start = SDL_GetPerformanceCounter();
+
+		for (int32_t e = 0; e < BENCH_ENTITIES; e++, brute_queries++) {
+			vec3_t box_mins, box_maxs;
+			trace_box(e, box_mins, box_maxs);
+
+			const size_t count = brute_force(box_mins, box_maxs);
+			ok &= count == Sv_GridQuery(grid, box_mins, box_maxs, items, lengthof(items));
+		}
+
+		brute_seconds += Test_Seconds(start);
+	}
+
+	printf("%s: %d entities, %d frames: %.0f links/s, grid %.0f queries/s, brute force %.0f queries/s\n",
+			__func__, BENCH_ENTITIES, BENCH_FRAMES, links / link_seconds, queries / query_seconds,
+			brute_queries / brute_seconds);
+
+	return ok;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	grid = Sv_CreateGrid(world_mins, world_maxs, BENCH_ENTITIES, MEM_TAG_DEFAULT);
+
+	const _Bool ok = bench_Sv_GridQuery();
+
+	Sv_FreeGrid(grid);
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return !ok;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "tests.h"
+#include "server/sv_local.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Compares the per-packet cost of resolving the client for an incoming packet
+ * by scanning every client slot, as Sv_ReadPackets once did, and through the
+ * client hash. Built with the tests, but run only by `make bench`.
+ */
+
+#define BENCH_CLIENTS 64
+#define BENCH_PACKETS 1000000
+
+static sv_client_t *clients;
+
+/*
+ * @return The client for the given address and qport, by scanning all slots.
+ */
+static sv_client_t *scan(const net_addr_t *addr, const byte qport) {
+
+	sv_client_t *cl = clients;
+	for (int32_t i = 0; i < BENCH_CLIENTS; i++, cl++) {
+
+		if (cl->state == SV_CLIENT_FREE)
+			continue;
+
+		if (cl->net_chan.remote_address.type != addr->type)
+			continue;
+
+		if (cl->net_chan.remote_address.addr != addr->addr)
+			continue;
+
+		if (cl->net_chan.qport != qport)
+			continue;
+
+		return cl;
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief Resolves packets from each client in turn with the given function,
+ * reporting the cost per packet.
+ *
+ * @return The number of packets resolved to their client.
+ */
+static uint32_t bench_Sv_HashedClient(const char *name, sv_client_t *(*resolve)(const net_addr_t *,
+		const byte)) {
+	uint32_t found = 0;
+
+	const uint64_t start = SDL_GetPerformanceCounter();
+
+	for (int32_t i = 0; i < BENCH_PACKETS; i++) {
+		sv_client_t *cl = &clients[i % BENCH_CLIENTS];
+		found += resolve(&cl->net_chan.remote_address, cl->net_chan.qport) == cl;
+	}
+
+	const double seconds = Test_Seconds(start);
+
+	printf("%s: %s: %d clients: %.1fns/packet\n", __func__, name, BENCH_CLIENTS,
+			seconds * 1e9 / BENCH_PACKETS);
+
+	return found;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	clients = Mem_Malloc(sizeof(sv_client_t) * BENCH_CLIENTS);
+
+	for (int32_t i = 0; i < BENCH_CLIENTS; i++) {
+		sv_client_t *cl = &clients[i];
+
+		cl->state = SV_CLIENT_ACTIVE;
+
+		cl->net_chan.remote_address.type = NA_DATAGRAM;
+		cl->net_chan.remote_address.addr = htonl(0x0a000000 + i / 4); // four clients per router
+		cl->net_chan.remote_address.port = htons(PORT_CLIENT + i);
+		cl->net_chan.qport = i & 0xff;
+
+		Sv_HashClient(cl);
+	}
+
+	const uint32_t scanned = bench_Sv_HashedClient("scan", scan);
+	const uint32_t hashed = bench_Sv_HashedClient("hash", Sv_HashedClient);
+
+	Sv_ClearClientHash();
+
+	Mem_Free(clients);
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return scanned != BENCH_PACKETS || hashed != BENCH_PACKETS;
+}
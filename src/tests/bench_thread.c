@@ -0,0 +1,114 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "tests.h"
+#include "thread.h"
+
+#include <SDL2/SDL_timer.h>
+
+/*
+ * Measures the rate at which the job system runs small jobs submitted from
+ * the main thread, and from within the workers, over a range of pool sizes.
+ * Built with the tests, but run only by `make bench`.
+ */
+
+#define BENCH_JOBS (MAX_THREAD_JOBS * 16)
+#define BENCH_FAN_OUT 64
+
+static SDL_atomic_t job_count;
+
+/*
+ * @brief Counts the number of jobs that have run.
+ */
+static void increment(void *data __attribute__((unused))) {
+	SDL_AtomicIncRef(&job_count);
+}
+
+/*
+ * @brief Submits a nested group of jobs and waits on them from within a worker.
+ */
+static void fan_out(void *data __attribute__((unused))) {
+	thread_counter_t counter;
+
+	memset(&counter, 0, sizeof(counter));
+
+	for (int32_t i = 0; i < BENCH_FAN_OUT; i++) {
+		Thread_Submit(increment, NULL, &counter);
+	}
+
+	Thread_WaitAll(&counter);
+}
+
+/*
+ * @brief Runs the given job count times and waits for them all, reporting
+ * the rate at which jobs completed.
+ *
+ * @return True if every job ran, false otherwise.
+ */
+static _Bool bench_Thread_Submit(const char *name, ThreadRunFunc run, int32_t count, int32_t jobs) {
+	thread_counter_t counter;
+
+	memset(&counter, 0, sizeof(counter));
+
+	SDL_AtomicSet(&job_count, 0);
+
+	const uint64_t start = SDL_GetPerformanceCounter();
+
+	for (int32_t i = 0; i < count; i++) {
+		Thread_Submit_(name, run, NULL, &counter);
+	}
+
+	Thread_WaitAll(&counter);
+
+	const double seconds = Test_Seconds(start);
+
+	printf("%s: %d jobs on %d threads in %.3fs (%.0f jobs/s)\n", name, jobs, Thread_Count(), seconds,
+			jobs / seconds);
+
+	return SDL_AtomicGet(&job_count) == jobs;
+}
+
+/*
+ * @brief Benchmark entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+	int32_t failed = 0;
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	for (uint16_t threads = 1; threads <= 16; threads *= 2) {
+
+		Thread_Init(threads);
+
+		failed += !bench_Thread_Submit("increment", increment, BENCH_JOBS, BENCH_JOBS);
+		failed += !bench_Thread_Submit("fan_out", fan_out, BENCH_JOBS / BENCH_FAN_OUT, BENCH_JOBS);
+
+		Thread_Shutdown();
+	}
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return failed;
+}
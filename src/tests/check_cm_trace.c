@@ -0,0 +1,167 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+
+#include "tests.h"
+#include "collision/cmodel.h"
+#include "filesystem.h"
+
+#define TRACE_RAYS 4096
+#define TRACE_BATCH 64
+
+static cm_bsp_model_t *world;
+
+static vec3_t starts[TRACE_RAYS], ends[TRACE_RAYS];
+static cm_trace_t traces[TRACE_RAYS], batched[TRACE_RAYS];
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	world = Cm_LoadBspModel("maps/torn.bsp", NULL);
+
+	// random rays within the world bounds, some of them long, and some short
+	for (int32_t i = 0; i < TRACE_RAYS; i++) {
+		for (int32_t j = 0; j < 3; j++) {
+			starts[i][j] = world->mins[j] + Randomf() * (world->maxs[j] - world->mins[j]);
+			ends[i][j] = world->mins[j] + Randomf() * (world->maxs[j] - world->mins[j]);
+		}
+
+		if (i & 1) {
+			VectorLerp(starts[i], ends[i], 0.05, ends[i]);
+		}
+	}
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+	Cm_LoadBspModel(NULL, NULL);
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+}
+
+/*
+ * @brief Traces every ray individually, and then in batches, asserting that
+ * the results are identical.
+ */
+static void check_Cm_BoxTraces_(const char *name, const vec3_t mins, const vec3_t maxs) {
+
+	for (int32_t i = 0; i < TRACE_RAYS; i++) {
+		traces[i] = Cm_BoxTrace(starts[i], ends[i], mins, maxs, world->head_node, MASK_SOLID);
+	}
+
+	for (int32_t i = 0; i < TRACE_RAYS; i += TRACE_BATCH) {
+		Cm_BoxTraces(starts + i, ends + i, TRACE_BATCH, mins, maxs, world->head_node, MASK_SOLID,
+				batched + i);
+	}
+
+	int32_t hits = 0;
+
+	for (int32_t i = 0; i < TRACE_RAYS; i++) {
+		const cm_trace_t *a = &traces[i], *b = &batched[i];
+
+		ck_assert_msg(memcmp(&a->fraction, &b->fraction, sizeof(a->fraction)) == 0,
+				"%s: fraction %d differs: %f != %f", name, i, a->fraction, b->fraction);
+		ck_assert_msg(memcmp(a->end, b->end, sizeof(a->end)) == 0, "%s: end %d differs", name, i);
+		ck_assert_msg(memcmp(&a->plane, &b->plane, sizeof(a->plane)) == 0, "%s: plane %d differs", name, i);
+
+		ck_assert(a->all_solid == b->all_solid);
+		ck_assert(a->start_solid == b->start_solid);
+		ck_assert(a->surface == b->surface);
+		ck_assert_int_eq(a->contents, b->contents);
+
+		if (a->fraction < 1.0) {
+			hits++;
+		}
+	}
+
+	ck_assert_msg(hits > 0, "%s: no rays hit", name);
+}
+
+START_TEST(check_Cm_BoxTraces)
+	{
+		const vec3_t mins = { -16.0, -16.0, -24.0 };
+		const vec3_t maxs = { 16.0, 16.0, 32.0 };
+
+		check_Cm_BoxTraces_("point", vec3_origin, vec3_origin);
+		check_Cm_BoxTraces_("box", mins, maxs);
+
+	}END_TEST
+
+START_TEST(check_Cm_LoadWorld)
+	{
+		const vec3_t mins = { -16.0, -16.0, -24.0 };
+		const vec3_t maxs = { 16.0, 16.0, 32.0 };
+
+		// a second, independent copy of the current world
+		cm_world_t *world2 = Cm_LoadWorld("maps/torn.bsp", NULL);
+
+		ck_assert(world2 != Cm_World());
+		ck_assert_int_eq(Cm_NumModels_(world2), Cm_NumModels());
+		ck_assert_int_eq(Cm_NumClusters_(world2), Cm_NumClusters());
+
+		for (int32_t i = 0; i < TRACE_RAYS; i++) {
+			const cm_trace_t a = Cm_BoxTrace(starts[i], ends[i], mins, maxs, world->head_node, MASK_SOLID);
+			const cm_trace_t b = Cm_BoxTrace_(world2, starts[i], ends[i], mins, maxs,
+					Cm_WorldModel(world2, 0)->head_node, MASK_SOLID);
+
+			ck_assert(memcmp(&a.fraction, &b.fraction, sizeof(a.fraction)) == 0);
+			ck_assert(memcmp(a.end, b.end, sizeof(a.end)) == 0);
+			ck_assert_int_eq(a.contents, b.contents);
+
+			ck_assert_int_eq(Cm_PointContents(starts[i], 0), Cm_PointContents_(world2, starts[i], 0));
+		}
+
+		Cm_FreeWorld(world2);
+
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_cm_trace");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Cm_BoxTraces);
+	tcase_add_test(tcase, check_Cm_LoadWorld);
+
+	Suite *suite = suite_create("check_cm_trace");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
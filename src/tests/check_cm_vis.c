@@ -0,0 +1,169 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "collision/cmodel.h"
+#include "filesystem.h"
+
+#define VIS_QUERIES 0x4000
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	Cm_LoadBspModel("maps/torn.bsp", NULL);
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+	Cm_LoadBspModel(NULL, NULL);
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+}
+
+START_TEST(check_Cm_ClusterPVSRow)
+	{
+		byte pvs[MAX_BSP_LEAFS >> 3], phs[MAX_BSP_LEAFS >> 3];
+
+		const int32_t num_clusters = Cm_NumClusters();
+		ck_assert(num_clusters > 0);
+
+		for (int32_t i = -1; i < num_clusters; i++) {
+			const size_t len = Cm_ClusterPVS(i, pvs);
+			Cm_ClusterPHS(i, phs);
+
+			const byte *pvs_row = Cm_ClusterPVSRow(i);
+			const byte *phs_row = Cm_ClusterPHSRow(i);
+
+			ck_assert(pvs_row && phs_row);
+
+			ck_assert_int_eq(memcmp(pvs, pvs_row, len), 0);
+			ck_assert_int_eq(memcmp(phs, phs_row, len), 0);
+
+			for (int32_t j = 0; j < num_clusters; j++) {
+				const _Bool visible = pvs[j >> 3] & (1 << (j & 7));
+				const _Bool hearable = phs[j >> 3] & (1 << (j & 7));
+
+				ck_assert(Cm_ClustersVisible(i, j) == visible);
+				ck_assert(Cm_ClustersHearable(i, j) == hearable);
+			}
+		}
+
+	}END_TEST
+
+START_TEST(check_Cm_VisOr)
+	{
+		byte a[67], b[67], or[67], and[67];
+
+		for (size_t i = 0; i < sizeof(a); i++) {
+			a[i] = rand() & 0xff;
+			b[i] = rand() & 0xff;
+		}
+
+		// unaligned, with a tail
+		memcpy(or, a, sizeof(a));
+		Cm_VisOr(or + 1, b + 1, sizeof(a) - 1);
+
+		memcpy(and, a, sizeof(a));
+		Cm_VisAnd(and + 1, b + 1, sizeof(a) - 1);
+
+		ck_assert_int_eq(or[0], a[0]);
+		ck_assert_int_eq(and[0], a[0]);
+
+		for (size_t i = 1; i < sizeof(a); i++) {
+			ck_assert_int_eq(or[i], a[i] | b[i]);
+			ck_assert_int_eq(and[i], a[i] & b[i]);
+		}
+
+		memset(a, 0, sizeof(a));
+		memset(b, 0, sizeof(b));
+
+		ck_assert(!Cm_VisIntersects(a, b, sizeof(a)));
+
+		a[66] = b[66] = 0x10;
+		ck_assert(Cm_VisIntersects(a, b, sizeof(a)));
+		ck_assert(!Cm_VisIntersects(a, b, sizeof(a) - 1));
+
+	}END_TEST
+
+START_TEST(check_Cm_ClustersVisible)
+	{
+		static int32_t clusters[VIS_QUERIES][2];
+		byte pvs[MAX_BSP_LEAFS >> 3];
+
+		const int32_t num_clusters = Cm_NumClusters();
+
+		for (int32_t i = 0; i < VIS_QUERIES; i++) {
+			clusters[i][0] = rand() % num_clusters;
+			clusters[i][1] = rand() % num_clusters;
+		}
+
+		int32_t visible = 0;
+
+		for (int32_t i = 0; i < VIS_QUERIES; i++) {
+			const int32_t c = clusters[i][1];
+
+			Cm_ClusterPVS(clusters[i][0], pvs);
+
+			const _Bool expected = (pvs[c >> 3] & (1 << (c & 7))) != 0;
+
+			ck_assert_msg(Cm_ClustersVisible(clusters[i][0], c) == expected, "Clusters %d and %d differ",
+					clusters[i][0], c);
+
+			visible += expected;
+		}
+
+		ck_assert_int_gt(visible, 0);
+
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_cm_vis");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Cm_ClusterPVSRow);
+	tcase_add_test(tcase, check_Cm_VisOr);
+	tcase_add_test(tcase, check_Cm_ClustersVisible);
+
+	Suite *suite = suite_create("check_cm_vis");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
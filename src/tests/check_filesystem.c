@@ -19,8 +19,11 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include <physfs.h>
+
 #include "tests.h"
 #include "filesystem.h"
+#include "thread.h"
 
 /*
  * @brief Setup fixture.
@@ -87,6 +90,123 @@ START_TEST(check_Fs_LoadFile)
 
 	}END_TEST
 
+START_TEST(check_Fs_Map)
+	{
+		const char *filenames[] = { "quetoo.cfg", "maps/torn.bsp", NULL };
+
+		const char **filename = filenames;
+		while (*filename) {
+			void *buffer;
+			const void *map;
+
+			const int64_t len = Fs_Load(*filename, &buffer);
+			ck_assert_msg(len > 0, "Failed to load %s", *filename);
+
+			ck_assert_msg(Fs_Map(*filename, &map) == len, "Failed to map %s", *filename);
+			ck_assert_msg(memcmp(map, buffer, len) == 0, "Mapped %s differs", *filename);
+
+			Fs_Unmap(map);
+			Fs_Free(buffer);
+
+			filename++;
+		}
+
+		const void *map;
+		ck_assert(Fs_Map("does/not/exist", &map) == -1);
+		ck_assert(map == NULL);
+
+	}END_TEST
+
+START_TEST(check_Fs_Exists)
+	{
+		// typical asset probes, most of which miss
+		const char *filenames[] = {
+			"quetoo.cfg",
+			"maps/torn.bsp",
+			"maps/torn.cfg",
+			"textures/common/caulk.tga",
+			"textures/common/caulk.png",
+			"textures/common/caulk.jpg",
+			"textures/common/caulk.pcx",
+			"textures/common/caulk.wal",
+			"textures/common/caulk_nm.tga",
+			"textures/common/caulk_s.tga",
+			"players/qforcer/jump1.ogg",
+			"players/qforcer/jump1.wav",
+			"sounds/does/not/exist.ogg",
+			NULL
+		};
+
+		for (const char **filename = filenames; *filename; filename++) {
+			ck_assert_msg(Fs_Exists(*filename) == (_Bool) PHYSFS_exists(*filename),
+					"Index disagrees with PhysFS for %s", *filename);
+			ck_assert_msg(!g_strcmp0(Fs_RealDir(*filename), PHYSFS_getRealDir(*filename)),
+					"Index resolves %s to the wrong search path", *filename);
+		}
+
+	}END_TEST
+
+START_TEST(check_Fs_Invalidate)
+	{
+		const char *filename = "check_Fs_Invalidate/dir/file.txt";
+
+		// probe first, so that misses are cached for the file and its directories
+		Fs_Exists("check_Fs_Invalidate");
+		Fs_Exists("check_Fs_Invalidate/dir");
+		Fs_Exists(filename);
+
+		file_t *f = Fs_OpenWrite(filename);
+
+		ck_assert_msg(f != NULL, "Failed to open %s", filename);
+		ck_assert_msg(Fs_Close(f), "Failed to close %s", filename);
+
+		ck_assert(Fs_Exists("check_Fs_Invalidate"));
+		ck_assert(Fs_Exists("check_Fs_Invalidate/dir"));
+		ck_assert(Fs_Exists(filename));
+
+	}END_TEST
+
+/*
+ * @brief Fs_LoadAsyncFunc for check_Fs_LoadAsync.
+ */
+static void check_Fs_LoadAsync_(const char *filename, void *buffer, int64_t len, void *data) {
+	int32_t *loaded = (int32_t *) data;
+
+	void *expected;
+	ck_assert_msg(Fs_Load(filename, &expected) == len, "Length mismatch for %s", filename);
+
+	if (len > 0) {
+		ck_assert_msg(memcmp(buffer, expected, len) == 0, "Contents mismatch for %s", filename);
+	}
+
+	Fs_Free(expected);
+	Fs_Free(buffer);
+
+	(*loaded)++;
+}
+
+START_TEST(check_Fs_LoadAsync)
+	{
+		const char *filenames[] = { "quetoo.cfg", "maps/torn.bsp", "does/not/exist", NULL };
+		int32_t loaded = 0, count = 0;
+
+		Thread_Init(2);
+
+		for (int32_t i = 0; i < 16; i++) {
+			for (const char **filename = filenames; *filename; filename++, count++) {
+				Fs_LoadAsync(*filename, i, check_Fs_LoadAsync_, &loaded);
+			}
+		}
+
+		Fs_WaitAsync();
+
+		ck_assert_int_eq(loaded, count);
+		ck_assert_int_eq(Fs_PollAsync(), 0);
+
+		Thread_Shutdown();
+
+	}END_TEST
+
 /*
  * @brief Test entry point.
  */
@@ -99,7 +219,11 @@ int32_t main(int32_t argc, char **argv) {
 
 	tcase_add_test(tcase, check_Fs_OpenRead);
 	tcase_add_test(tcase, check_Fs_OpenWrite);
+	tcase_add_test(tcase, check_Fs_Exists);
+	tcase_add_test(tcase, check_Fs_Invalidate);
 	tcase_add_test(tcase, check_Fs_LoadFile);
+	tcase_add_test(tcase, check_Fs_Map);
+	tcase_add_test(tcase, check_Fs_LoadAsync);
 
 	Suite *suite = suite_create("check_filesystem");
 	suite_add_tcase(suite, tcase);
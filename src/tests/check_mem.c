@@ -22,6 +22,12 @@
 #include "tests.h"
 #include "mem.h"
 
+#include <SDL2/SDL_thread.h>
+
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_ITERATIONS 100000
+#define CONCURRENT_ROOTS 64
+
 /*
  * @brief Setup fixture.
  */
@@ -61,6 +67,26 @@ START_TEST(check_Mem_LinkMalloc)
 
 	}END_TEST
 
+START_TEST(check_Mem_Alignment)
+	{
+		// managed memory must be as aligned as malloc's, for SSE and long double
+		for (size_t size = 1; size <= 8192; size += 7) {
+			void *block = Mem_TagMalloc(size, MEM_TAG_GAME);
+			void *child = Mem_LinkMalloc(size, block);
+			void *frame = Mem_FrameAlloc(size, MEM_TAG_SERVER);
+
+			ck_assert_msg(((uintptr_t) block & 15) == 0, "Block of %u bytes misaligned", (uint32_t) size);
+			ck_assert_msg(((uintptr_t) child & 15) == 0, "Child of %u bytes misaligned", (uint32_t) size);
+			ck_assert_msg(((uintptr_t) frame & 15) == 0, "Frame of %u bytes misaligned", (uint32_t) size);
+		}
+
+		Mem_FreeTag(MEM_TAG_GAME);
+		Mem_ResetFrame(MEM_TAG_SERVER);
+
+		ck_assert(Mem_Size() == 0);
+
+	}END_TEST
+
 START_TEST(check_Mem_CopyString)
 	{
 		char *test = Mem_CopyString("test");
@@ -72,6 +98,118 @@ START_TEST(check_Mem_CopyString)
 		ck_assert(Mem_Size() == 0);
 	}END_TEST
 
+START_TEST(check_Mem_FreeTag)
+	{
+		byte *game = Mem_TagMalloc(1, MEM_TAG_GAME);
+		Mem_LinkMalloc(1, game);
+
+		Mem_TagMalloc(1, MEM_TAG_SERVER);
+
+		ck_assert(Mem_Size() == 3);
+
+		Mem_FreeTag(MEM_TAG_GAME);
+
+		ck_assert(Mem_Size() == 1);
+
+		mem_stats_t stats;
+		Mem_Stats(&stats);
+
+		ck_assert(stats.tags[MEM_TAG_GAME].count == 0);
+		ck_assert(stats.tags[MEM_TAG_SERVER].count == 1);
+		ck_assert(stats.tags[MEM_TAG_DEFAULT].allocations == 1);
+
+		Mem_FreeTag(MEM_TAG_ALL);
+
+		ck_assert(Mem_Size() == 0);
+
+	}END_TEST
+
+START_TEST(check_Mem_FrameAlloc)
+	{
+		byte *first = Mem_FrameAlloc(64, MEM_TAG_SERVER);
+
+		ck_assert(first != NULL);
+		ck_assert(Mem_Size() == 0);
+
+		int32_t i;
+		for (i = 0; i < 4096; i++) {
+			byte *b = Mem_FrameAlloc(64, MEM_TAG_SERVER);
+			ck_assert(b[0] == 0 && b[63] == 0);
+			memset(b, 0xff, 64);
+		}
+
+		Mem_ResetFrame(MEM_TAG_SERVER);
+
+		// the arena has been coalesced, and should now hand out the same memory
+		byte *second = Mem_FrameAlloc(64, MEM_TAG_SERVER);
+		ck_assert(second[0] == 0);
+
+		Mem_ResetFrame(MEM_TAG_SERVER);
+
+		ck_assert(Mem_FrameAlloc(64, MEM_TAG_SERVER) == second);
+
+	}END_TEST
+
+/*
+ * @brief Allocates, links and frees a mix of small and large blocks.
+ */
+static int32_t allocate(void *data __attribute__((unused))) {
+	void *roots[CONCURRENT_ROOTS];
+	int32_t i, j;
+
+	memset(roots, 0, sizeof(roots));
+
+	for (i = 0; i < CONCURRENT_ITERATIONS; i++) {
+		void **root = &roots[i % CONCURRENT_ROOTS];
+
+		if (*root) {
+			Mem_Free(*root);
+		}
+
+		*root = Mem_TagMalloc(1 + (i % 4096), (i & 1) ? MEM_TAG_GAME : MEM_TAG_CLIENT);
+
+		for (j = 0; j < 4; j++) {
+			void *child = Mem_LinkMalloc(16 << j, *root);
+			if (j & 1) {
+				Mem_Free(child);
+			}
+		}
+	}
+
+	for (i = 0; i < CONCURRENT_ROOTS; i++) {
+		if (roots[i]) {
+			Mem_Free(roots[i]);
+		}
+	}
+
+	return 0;
+}
+
+START_TEST(check_Mem_Concurrent)
+	{
+		SDL_Thread *threads[CONCURRENT_THREADS];
+		int32_t i;
+
+		for (i = 0; i < CONCURRENT_THREADS; i++) {
+			threads[i] = SDL_CreateThread(allocate, __func__, NULL);
+		}
+
+		for (i = 0; i < CONCURRENT_THREADS; i++) {
+			SDL_WaitThread(threads[i], NULL);
+		}
+
+		ck_assert(Mem_Size() == 0);
+
+		mem_stats_t stats;
+		Mem_Stats(&stats);
+
+		const uint32_t allocations = stats.tags[MEM_TAG_GAME].allocations +
+				stats.tags[MEM_TAG_CLIENT].allocations + stats.tags[MEM_TAG_DEFAULT].allocations;
+
+		ck_assert(allocations == CONCURRENT_THREADS * CONCURRENT_ITERATIONS * 5);
+
+	}END_TEST
+
 /*
  * @brief Test entry point.
  */
@@ -83,7 +221,11 @@ int32_t main(int32_t argc, char **argv) {
 	tcase_add_checked_fixture(tcase, setup, teardown);
 
 	tcase_add_test(tcase, check_Mem_LinkMalloc);
+	tcase_add_test(tcase, check_Mem_Alignment);
 	tcase_add_test(tcase, check_Mem_CopyString);
+	tcase_add_test(tcase, check_Mem_FreeTag);
+	tcase_add_test(tcase, check_Mem_FrameAlloc);
+	tcase_add_test(tcase, check_Mem_Concurrent);
 
 	Suite *suite = suite_create("check_mem");
 	suite_add_tcase(suite, tcase);
@@ -0,0 +1,407 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "cmd.h"
+#include "cvar.h"
+#include "net/net_chan.h"
+
+/*
+ * Exercises the reliable window over a loopback pair, with datagrams dropped,
+ * held back and reordered between the channels. Reliable messages carry their
+ * index and a pattern, so that the receiver can verify that each arrives
+ * intact, once and in order. Unreliable messages carry the frame number.
+ */
+
+#define CHAN_FRAMES 400
+#define CHAN_FRAME_MSEC 25
+#define CHAN_DRAIN_FRAMES 200
+#define CHAN_HOLD 8
+
+#define CHAN_RELIABLE 1
+#define CHAN_UNRELIABLE 2
+
+cvar_t *dedicated;
+
+typedef struct {
+	size_t size;
+	byte data[MAX_MSG_SIZE];
+} chan_datagram_t;
+
+/*
+ * @brief Each end of the pair, and the datagrams in flight toward it.
+ */
+typedef struct {
+	net_src_t source;
+	net_chan_t chan;
+
+	uint32_t sent; // reliable messages written
+	uint32_t received; // reliable messages delivered
+	int32_t frame; // the most recent unreliable message delivered
+
+	chan_datagram_t held[CHAN_HOLD];
+	uint32_t num_held;
+
+	uint32_t dropped; // datagrams discarded by the network
+	uint32_t stale; // datagrams refused by the netchan
+} chan_end_t;
+
+static chan_end_t client, server;
+
+/*
+ * @brief Decides the fate of each datagram as it leaves the sender.
+ */
+typedef enum {
+	CHAN_DELIVER,
+	CHAN_DROP,
+	CHAN_HOLD_BACK
+} chan_fate_t;
+
+typedef chan_fate_t (*chan_network_t)(const chan_end_t *to, int32_t frame);
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_Init();
+
+	Cmd_Init();
+
+	Cvar_Init();
+
+	dedicated = Cvar_Get("dedicated", "0", CVAR_NO_SET, NULL);
+
+	Netchan_Init();
+
+	net_addr_t addr = { .type = NA_LOOP, .addr = net_lo };
+
+	memset(&client, 0, sizeof(client));
+	memset(&server, 0, sizeof(server));
+
+	client.source = NS_UDP_CLIENT;
+	server.source = NS_UDP_SERVER;
+
+	client.frame = server.frame = -1;
+
+	Netchan_Setup(NS_UDP_CLIENT, &client.chan, &addr, 1);
+	Netchan_Setup(NS_UDP_SERVER, &server.chan, &addr, 1);
+
+	Netchan_OpenWindow(&client.chan);
+	Netchan_OpenWindow(&server.chan);
+
+	srand(1);
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+	Netchan_Close(&client.chan);
+	Netchan_Close(&server.chan);
+
+	Netchan_Shutdown();
+
+	Cvar_Shutdown();
+
+	Cmd_Shutdown();
+
+	Mem_Shutdown();
+}
+
+/*
+ * @brief Writes the next reliable message, spanning up to three fragments.
+ */
+static void Chan_WriteReliable(chan_end_t *from) {
+
+	const uint32_t index = from->sent++;
+	const uint16_t size = 1 + (index * 577) % (NET_FRAGMENT_SIZE * 3 - 8);
+
+	Net_WriteByte(&from->chan.message, CHAN_RELIABLE);
+	Net_WriteLong(&from->chan.message, index);
+	Net_WriteShort(&from->chan.message, size);
+
+	for (uint16_t i = 0; i < size; i++) {
+		Net_WriteByte(&from->chan.message, (index + i) & 0xff);
+	}
+}
+
+/*
+ * @brief Verifies the messages delivered to the given end.
+ */
+static void Chan_Read(chan_end_t *to, mem_buf_t *msg) {
+
+	while (msg->read < msg->size) {
+		const int32_t cmd = Net_ReadByte(msg);
+
+		if (cmd == CHAN_RELIABLE) {
+			const uint32_t index = Net_ReadLong(msg);
+			const uint16_t size = Net_ReadShort(msg);
+
+			ck_assert_int_eq(index, to->received);
+			ck_assert(msg->read + size <= msg->size);
+
+			for (uint16_t i = 0; i < size; i++) {
+				ck_assert_int_eq(Net_ReadByte(msg), (index + i) & 0xff);
+			}
+
+			to->received++;
+		} else {
+			ck_assert_int_eq(cmd, CHAN_UNRELIABLE);
+
+			const int32_t frame = Net_ReadLong(msg);
+			ck_assert_int_gt(frame, to->frame);
+
+			to->frame = frame;
+		}
+	}
+}
+
+/*
+ * @brief Processes a datagram as the receiving end would.
+ */
+static void Chan_Deliver(chan_end_t *to, const chan_datagram_t *datagram) {
+
+	memcpy(net_message.data, datagram->data, datagram->size);
+	net_message.size = datagram->size;
+
+	if (Netchan_Process(&to->chan, &net_message))
+		Chan_Read(to, &net_message);
+	else
+		to->stale++;
+}
+
+/*
+ * @brief Delivers the datagrams held back for the given end, newest first.
+ */
+static void Chan_Release(chan_end_t *to) {
+
+	while (to->num_held) {
+		Chan_Deliver(to, &to->held[--to->num_held]);
+	}
+}
+
+/*
+ * @brief Transmits from one end of the pair to the other, passing the
+ * datagram through the network.
+ */
+static void Chan_Transmit(chan_end_t *from, chan_end_t *to, chan_network_t network, int32_t frame) {
+	byte buffer[8];
+	mem_buf_t buf;
+
+	Mem_InitBuffer(&buf, buffer, sizeof(buffer));
+
+	Net_WriteByte(&buf, CHAN_UNRELIABLE);
+	Net_WriteLong(&buf, frame);
+
+	Netchan_Transmit(&from->chan, buf.data, buf.size);
+
+	chan_datagram_t datagram;
+	mem_buf_t recv;
+
+	Mem_InitBuffer(&recv, datagram.data, sizeof(datagram.data));
+
+	ck_assert(Net_ReceiveDatagram(to->source, &net_from, &recv));
+	datagram.size = recv.size;
+
+	switch (network ? network(to, frame) : CHAN_DELIVER) {
+		case CHAN_DELIVER:
+			Chan_Deliver(to, &datagram);
+			break;
+		case CHAN_DROP:
+			to->dropped++;
+			break;
+		case CHAN_HOLD_BACK:
+			to->held[to->num_held++] = datagram;
+			if (to->num_held == CHAN_HOLD)
+				Chan_Release(to);
+			break;
+	}
+}
+
+/*
+ * @brief Runs the given number of frames, in which each end may write a
+ * reliable message, and then transmits to the other.
+ */
+static void Chan_Run(int32_t frames, _Bool write, chan_network_t network) {
+	static int32_t frame;
+
+	for (int32_t i = 0; i < frames; i++, frame++) {
+
+		quetoo.time += CHAN_FRAME_MSEC;
+
+		if (write) {
+			if (frame % 2 == 0)
+				Chan_WriteReliable(&server);
+			if (frame % 5 == 0)
+				Chan_WriteReliable(&client);
+		}
+
+		Chan_Transmit(&server, &client, network, frame);
+		Chan_Transmit(&client, &server, network, frame);
+	}
+
+	Chan_Release(&client);
+	Chan_Release(&server);
+}
+
+/*
+ * @brief Asserts that every reliable message was delivered, and that both
+ * windows are empty.
+ */
+static void Chan_Verify(void) {
+
+	Chan_Run(CHAN_DRAIN_FRAMES, false, NULL);
+
+	ck_assert_int_gt(server.sent, 0);
+	ck_assert_int_gt(client.sent, 0);
+
+	ck_assert_int_eq(client.received, server.sent);
+	ck_assert_int_eq(server.received, client.sent);
+
+	ck_assert_int_eq(server.chan.fragment_acknowledged, server.chan.fragment_outgoing);
+	ck_assert_int_eq(client.chan.fragment_acknowledged, client.chan.fragment_outgoing);
+
+	ck_assert(!Netchan_Pending(&server.chan));
+	ck_assert(!Netchan_Pending(&client.chan));
+}
+
+/*
+ * @brief Drops roughly a quarter of datagrams in both directions.
+ */
+static chan_fate_t Chan_Lossy(const chan_end_t *to, int32_t frame) {
+	return rand() % 4 == 0 ? CHAN_DROP : CHAN_DELIVER;
+}
+
+/*
+ * @brief Holds back roughly half of all datagrams, releasing them newest
+ * first once several have accumulated.
+ */
+static chan_fate_t Chan_Reordering(const chan_end_t *to, int32_t frame) {
+	return rand() % 2 == 0 ? CHAN_HOLD_BACK : CHAN_DELIVER;
+}
+
+/*
+ * @brief Drops and reorders datagrams at once.
+ */
+static chan_fate_t Chan_Hostile(const chan_end_t *to, int32_t frame) {
+
+	switch (rand() % 5) {
+		case 0:
+			return CHAN_DROP;
+		case 1:
+		case 2:
+			return CHAN_HOLD_BACK;
+		default:
+			return CHAN_DELIVER;
+	}
+}
+
+/*
+ * @brief Drops every datagram toward the client for a period well beyond the
+ * maximum retransmit time.
+ */
+static chan_fate_t Chan_Outage(const chan_end_t *to, int32_t frame) {
+	return to == &client ? CHAN_DROP : CHAN_DELIVER;
+}
+
+START_TEST(check_Netchan_Perfect)
+	{
+		Chan_Run(CHAN_FRAMES, true, NULL);
+
+		ck_assert_int_eq(client.received, server.sent);
+		ck_assert_int_eq(server.received, client.sent);
+
+		Chan_Verify();
+	}END_TEST
+
+START_TEST(check_Netchan_Loss)
+	{
+		Chan_Run(CHAN_FRAMES, true, Chan_Lossy);
+
+		ck_assert_int_gt(client.dropped, 0);
+		ck_assert_int_gt(server.dropped, 0);
+
+		Chan_Verify();
+	}END_TEST
+
+START_TEST(check_Netchan_Reorder)
+	{
+		Chan_Run(CHAN_FRAMES, true, Chan_Reordering);
+
+		ck_assert_int_gt(client.stale, 0);
+		ck_assert_int_gt(server.stale, 0);
+
+		Chan_Verify();
+	}END_TEST
+
+START_TEST(check_Netchan_LossAndReorder)
+	{
+		Chan_Run(CHAN_FRAMES, true, Chan_Hostile);
+
+		ck_assert_int_gt(client.dropped, 0);
+		ck_assert_int_gt(client.stale, 0);
+
+		Chan_Verify();
+	}END_TEST
+
+START_TEST(check_Netchan_Retransmit)
+	{
+		Chan_Run(10, true, NULL);
+
+		const uint32_t received = client.received;
+
+		// with the client deaf, the server must retain what it has sent
+		Chan_Run(4, true, Chan_Outage);
+		Chan_Run(4000 / CHAN_FRAME_MSEC, false, Chan_Outage);
+
+		ck_assert_int_eq(client.received, received);
+		ck_assert(server.chan.fragment_acknowledged != server.chan.fragment_outgoing);
+
+		// and resend it on its own timer once the client can hear again
+		Chan_Verify();
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_net_chan");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Netchan_Perfect);
+	tcase_add_test(tcase, check_Netchan_Loss);
+	tcase_add_test(tcase, check_Netchan_Reorder);
+	tcase_add_test(tcase, check_Netchan_LossAndReorder);
+	tcase_add_test(tcase, check_Netchan_Retransmit);
+
+	Suite *suite = suite_create("check_net_chan");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
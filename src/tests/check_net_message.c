@@ -0,0 +1,237 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "net/net_message.h"
+#include "net/net_types.h"
+
+#define MESSAGE_ENTITIES 64
+#define MESSAGE_FRAMES 1000
+
+static mem_buf_t msg;
+static byte buffer[MAX_MSG_SIZE];
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+	Mem_InitBuffer(&msg, buffer, sizeof(buffer));
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+}
+
+START_TEST(check_Mem_ReadBits)
+	{
+		mem_bits_t bits;
+
+		Net_WriteByte(&msg, 0xaa);
+
+		Mem_BeginBits(&bits, &msg);
+		for (uint32_t i = 1; i <= 32; i++) {
+			Mem_WriteBits(&bits, 0xdeadbeef, i);
+		}
+		Mem_EndWriteBits(&bits);
+
+		Net_WriteByte(&msg, 0x55);
+
+		// 528 bits pack into 66 bytes, bracketed by the aligned bytes
+		ck_assert_int_eq(msg.size, 1 + 66 + 1);
+
+		Net_BeginReading(&msg);
+		ck_assert_int_eq(Net_ReadByte(&msg), 0xaa);
+
+		Mem_BeginBits(&bits, &msg);
+		for (uint32_t i = 1; i <= 32; i++) {
+			const uint32_t mask = i < 32 ? (1u << i) - 1 : UINT32_MAX;
+			ck_assert_uint_eq(Mem_ReadBits(&bits, i), 0xdeadbeef & mask);
+		}
+		Mem_EndReadBits(&bits);
+
+		ck_assert_int_eq(Net_ReadByte(&msg), 0x55);
+		ck_assert_int_eq(msg.read, msg.size);
+
+	}END_TEST
+
+/*
+ * @brief Moves the entity as the game might, with the occasional teleport.
+ */
+static void move(entity_state_t *s) {
+
+	const int32_t r = rand() % 100;
+
+	if (r < 40) {
+		return; // idle
+	}
+
+	if (r < 98) {
+		for (int32_t i = 0; i < 3; i++) {
+			s->origin[i] += Randomc() * 12.0;
+		}
+		s->angles[YAW] = ClampAngle(s->angles[YAW] + Randomc() * 30.0);
+	} else {
+		for (int32_t i = 0; i < 3; i++) {
+			s->origin[i] = Randomc() * MAX_WORLD_COORD;
+		}
+		s->model1 = rand() & 0xff;
+	}
+
+	if (r & 1) {
+		s->event = rand() & 0xff;
+	}
+}
+
+START_TEST(check_Net_ReadDeltaEntityBits)
+	{
+		entity_state_t server[MESSAGE_ENTITIES], client[MESSAGE_ENTITIES];
+		size_t legacy = 0, packed = 0;
+
+		memset(server, 0, sizeof(server));
+
+		for (int32_t i = 0; i < MESSAGE_ENTITIES; i++) {
+			server[i].number = 1 + i * 3;
+			for (int32_t j = 0; j < 3; j++) {
+				server[i].origin[j] = Randomc() * MAX_WORLD_COORD;
+			}
+		}
+
+		memcpy(client, server, sizeof(client));
+
+		for (int32_t f = 0; f < MESSAGE_FRAMES; f++) {
+			entity_state_t from[MESSAGE_ENTITIES];
+			memcpy(from, server, sizeof(from));
+
+			for (int32_t i = 0; i < MESSAGE_ENTITIES; i++) {
+				move(&server[i]);
+			}
+
+			// the legacy encoding, for comparison
+			Mem_ClearBuffer(&msg);
+			for (int32_t i = 0; i < MESSAGE_ENTITIES; i++) {
+				Net_WriteDeltaEntity(&msg, &from[i], &server[i], false);
+			}
+			Net_WriteShort(&msg, 0);
+			legacy += msg.size;
+
+			// and the bit packed encoding
+			Mem_ClearBuffer(&msg);
+
+			mem_bits_t bits;
+			Mem_BeginBits(&bits, &msg);
+
+			uint16_t last = 0;
+			for (int32_t i = 0; i < MESSAGE_ENTITIES; i++) {
+				if (Net_WriteDeltaEntityBits(&bits, last, &from[i], &server[i], false)) {
+					last = server[i].number;
+				}
+			}
+			Net_WriteEntityNumberBits(&bits, last, 0);
+			Mem_EndWriteBits(&bits);
+
+			packed += msg.size;
+
+			// read it back against the client's copy of the delta base
+			Net_BeginReading(&msg);
+			Mem_BeginBits(&bits, &msg);
+
+			uint16_t number = 0;
+			while ((number = Net_ReadEntityNumberBits(&bits, number))) {
+				const int32_t i = (number - 1) / 3;
+				ck_assert_int_eq(server[i].number, number);
+
+				const uint16_t flags = Net_ReadEntityFlagsBits(&bits);
+				ck_assert(!(flags & U_REMOVE));
+
+				const entity_state_t base = client[i];
+				Net_ReadDeltaEntityBits(&bits, &base, &client[i], number, flags);
+			}
+			Mem_EndReadBits(&bits);
+
+			ck_assert_int_eq(msg.read, msg.size);
+
+			for (int32_t i = 0; i < MESSAGE_ENTITIES; i++) {
+				for (int32_t j = 0; j < 3; j++) {
+					const vec_t error = fabsf(client[i].origin[j] - server[i].origin[j]);
+					ck_assert(error <= 1.0 / NET_POSITION_SCALE);
+					ck_assert_int_eq(PackAngle(client[i].angles[j]), PackAngle(server[i].angles[j]));
+				}
+				ck_assert_int_eq(client[i].model1, server[i].model1);
+			}
+		}
+
+		ck_assert(packed < legacy);
+
+	}END_TEST
+
+START_TEST(check_Net_ReadEntityNumberBits)
+	{
+		const uint16_t numbers[] = { 1, 2, 3, 5, 20, 21, 300, 1023, 0 };
+		mem_bits_t bits;
+
+		Mem_BeginBits(&bits, &msg);
+
+		uint16_t last = 0;
+		for (size_t i = 0; i < lengthof(numbers); i++) {
+			Net_WriteEntityNumberBits(&bits, last, numbers[i]);
+			last = numbers[i];
+		}
+		Mem_EndWriteBits(&bits);
+
+		Net_BeginReading(&msg);
+		Mem_BeginBits(&bits, &msg);
+
+		last = 0;
+		for (size_t i = 0; i < lengthof(numbers); i++) {
+			last = Net_ReadEntityNumberBits(&bits, last);
+			ck_assert_int_eq(last, numbers[i]);
+		}
+		Mem_EndReadBits(&bits);
+
+		ck_assert_int_eq(msg.read, msg.size);
+
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_net_message");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Mem_ReadBits);
+	tcase_add_test(tcase, check_Net_ReadEntityNumberBits);
+	tcase_add_test(tcase, check_Net_ReadDeltaEntityBits);
+
+	Suite *suite = suite_create("check_net_message");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
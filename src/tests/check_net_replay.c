@@ -0,0 +1,139 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "cmd.h"
+#include "cvar.h"
+#include "files.h"
+#include "filesystem.h"
+#include "replay.h"
+
+/*
+ * Verifies packet captures, as written by `net_capture`, by replaying them.
+ * Run with the path of a capture, relative to the search path, to verify a
+ * real session, e.g.:
+ *
+ *   check_net_replay captures/ctf.cap
+ *
+ * Otherwise, a session is synthesized over the loopback and replayed.
+ */
+
+#define REPLAY_CAPTURE "captures/check_net_replay.cap"
+
+cvar_t *dedicated;
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_Init();
+
+	Fs_Init(false);
+
+	Cmd_Init();
+
+	Cvar_Init();
+
+	dedicated = Cvar_Get("dedicated", "0", CVAR_NO_SET, NULL);
+
+	Netchan_Init();
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+	Replay_Shutdown();
+
+	Netchan_Shutdown();
+
+	Cvar_Shutdown();
+
+	Cmd_Shutdown();
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+}
+
+START_TEST(check_Net_Replay)
+	{
+		void *data;
+
+		const char *filename = Com_Argc() > 1 ? Com_Argv(1) : REPLAY_CAPTURE;
+		uint32_t sent = 0;
+
+		if (Com_Argc() < 2) {
+			replay_stats_t live;
+			sent = Replay_Capture(filename, &live);
+
+			ck_assert_msg(sent > 0, "Failed to capture %s", filename);
+			ck_assert_int_eq(live.dropped, 0);
+			ck_assert_int_eq(live.illegible, 0);
+			ck_assert_int_eq(live.messages, sent);
+		}
+
+		const int64_t len = Fs_Load(filename, &data);
+		ck_assert_msg(len > 0, "Failed to load %s", filename);
+
+		replay_stats_t stats;
+		ck_assert_msg(Replay(data, len, &stats), "Malformed capture %s", filename);
+
+		Fs_Free(data);
+
+		ck_assert_int_gt(stats.channels, 0);
+		ck_assert_int_gt(stats.messages, 0);
+		ck_assert_int_eq(stats.illegible, 0);
+
+		// only each channel and its reliable window are allocated
+		ck_assert_int_le(stats.allocations, stats.channels * 2);
+
+		if (sent) {
+			ck_assert_int_eq(stats.messages, sent);
+			ck_assert_int_eq(stats.dropped, 0);
+		}
+
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_net_replay");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_set_timeout(tcase, 60);
+
+	tcase_add_test(tcase, check_Net_Replay);
+
+	Suite *suite = suite_create("check_net_replay");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "server/sv_local.h"
+
+#define DELTA_ENTITIES 64
+#define DELTA_CLIENTS 4
+#define DELTA_FRAMES 100
+
+sv_static_t svs;
+sv_server_t sv;
+
+static entity_state_t baselines[DELTA_ENTITIES];
+static entity_state_t states[DELTA_ENTITIES];
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+	Mem_Init();
+
+	memset(&svs, 0, sizeof(svs));
+	memset(&sv, 0, sizeof(sv));
+
+	svs.entity_deltas = Mem_Malloc(sizeof(sv_entity_delta_t) * MAX_ENTITIES * SV_ENTITY_DELTA_SLOTS);
+
+	memset(baselines, 0, sizeof(baselines));
+
+	for (int32_t i = 0; i < DELTA_ENTITIES; i++) {
+		baselines[i].number = 1 + i * 3;
+		baselines[i].model1 = 1 + (i & 7);
+	}
+
+	memcpy(states, baselines, sizeof(states));
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+	Mem_Free(svs.entity_deltas);
+
+	Mem_Shutdown();
+}
+
+/*
+ * @brief Moves some of the entities, as the game might in a frame.
+ */
+static void move(void) {
+
+	for (int32_t i = 0; i < DELTA_ENTITIES; i++) {
+		entity_state_t *s = &states[i];
+
+		if (rand() % 100 < 40) {
+			continue;
+		}
+
+		for (int32_t j = 0; j < 3; j++) {
+			s->origin[j] += Randomc() * 12.0;
+		}
+		s->angles[YAW] = ClampAngle(s->angles[YAW] + Randomc() * 30.0);
+
+		if (rand() & 1) {
+			s->event = rand() & 0xff;
+		}
+	}
+}
+
+/*
+ * @brief Writes the entity deltas as Sv_WriteEntities would, through the delta
+ * cache or directly.
+ */
+static void write_entities(mem_buf_t *msg, const _Bool packed, const _Bool cached, const uint32_t age,
+		const entity_state_t *from, const entity_state_t *to) {
+	mem_bits_t bits;
+	uint16_t last = 0;
+
+	if (packed) {
+		Mem_BeginBits(&bits, msg);
+	}
+
+	for (int32_t i = 0; i < DELTA_ENTITIES; i++) {
+		_Bool written;
+
+		if (cached) {
+			written = Sv_WriteDeltaEntity(msg, packed ? &bits : NULL, last, age, &from[i], &to[i]);
+		} else if (packed) {
+			written = Net_WriteDeltaEntityBits(&bits, last, &from[i], &to[i], age == 0);
+		} else {
+			Net_WriteDeltaEntity(msg, &from[i], &to[i], age == 0);
+			written = true;
+		}
+
+		if (written) {
+			last = to[i].number;
+		}
+	}
+
+	if (packed) {
+		Net_WriteEntityNumberBits(&bits, last, 0);
+		Mem_EndWriteBits(&bits);
+	} else {
+		Net_WriteShort(msg, 0);
+	}
+}
+
+/*
+ * @brief Encodes every frame for several clients, one of which sees a tailored
+ * state, and compares each message with the uncached encoding.
+ */
+static void check_Sv_WriteDeltaEntity_(const _Bool packed) {
+	static byte cached_buffer[MAX_MSG_SIZE], uncached_buffer[MAX_MSG_SIZE];
+	mem_buf_t cached, uncached;
+
+	Mem_InitBuffer(&cached, cached_buffer, sizeof(cached_buffer));
+	Mem_InitBuffer(&uncached, uncached_buffer, sizeof(uncached_buffer));
+
+	for (int32_t f = 1; f <= DELTA_FRAMES; f++) {
+		entity_state_t from[DELTA_ENTITIES];
+
+		memcpy(from, states, sizeof(from));
+		move();
+
+		sv.frame_num = f;
+
+		for (int32_t c = 0; c < DELTA_CLIENTS; c++) {
+			entity_state_t to[DELTA_ENTITIES];
+
+			memcpy(to, states, sizeof(to));
+
+			if (c == DELTA_CLIENTS - 1) {
+				to[f % DELTA_ENTITIES].solid ^= 1;
+			}
+
+			// the delta from the previous frame, and from the baselines
+			for (uint32_t age = 0; age < 2; age++) {
+				const entity_state_t *base = age ? from : baselines;
+
+				Mem_ClearBuffer(&cached);
+				Mem_ClearBuffer(&uncached);
+
+				write_entities(&cached, packed, true, age, base, to);
+				write_entities(&uncached, packed, false, age, base, to);
+
+				ck_assert_int_eq(cached.size, uncached.size);
+				ck_assert_msg(memcmp(cached.data, uncached.data, cached.size) == 0,
+						"Frame %d, client %d, age %u differs from the uncached encoding", f, c, age);
+			}
+		}
+	}
+
+	ck_assert(SDL_AtomicGet(&svs.entity_delta_hits) > 0);
+	ck_assert(SDL_AtomicGet(&svs.entity_delta_misses) > 0);
+}
+
+START_TEST(check_Sv_WriteDeltaEntity)
+	{
+		check_Sv_WriteDeltaEntity_(false);
+	}END_TEST
+
+START_TEST(check_Sv_WriteDeltaEntityBits)
+	{
+		check_Sv_WriteDeltaEntity_(true);
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_Sv_WriteDeltaEntity");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Sv_WriteDeltaEntity);
+	tcase_add_test(tcase, check_Sv_WriteDeltaEntityBits);
+
+	Suite *suite = suite_create("check_sv_delta");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+
+	return failed;
+}
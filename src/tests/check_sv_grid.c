@@ -0,0 +1,176 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "server/sv_grid.h"
+
+#define GRID_ENTITIES 1024
+
+static sv_grid_t *grid;
+
+static vec3_t world_mins = { -4096.0, -4096.0, -1024.0 };
+static vec3_t world_maxs = { 4096.0, 4096.0, 1024.0 };
+
+static vec3_t mins[GRID_ENTITIES], maxs[GRID_ENTITIES];
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+	Mem_Init();
+
+	grid = Sv_CreateGrid(world_mins, world_maxs, GRID_ENTITIES, MEM_TAG_DEFAULT);
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+	Sv_FreeGrid(grid);
+
+	Mem_Shutdown();
+}
+
+/*
+ * @brief Places the specified entity randomly within the world. Most entities
+ * are player sized, while some are large, like doors and triggers.
+ */
+static void place(const int32_t e) {
+	vec3_t origin, size;
+
+	for (int32_t i = 0; i < 3; i++) {
+		origin[i] = world_mins[i] + Randomf() * (world_maxs[i] - world_mins[i]);
+	}
+
+	if (e % 16 == 0) {
+		VectorSet(size, 64.0 + Randomf() * 768.0, 64.0 + Randomf() * 768.0, 128.0);
+	} else {
+		VectorSet(size, 32.0, 32.0, 56.0);
+	}
+
+	VectorMA(origin, -0.5, size, mins[e]);
+	VectorMA(origin, 0.5, size, maxs[e]);
+}
+
+/*
+ * @brief Moves the specified entity by a small amount, as in a server frame.
+ */
+static void move(const int32_t e) {
+	vec3_t delta;
+
+	VectorSet(delta, Randomc() * 32.0, Randomc() * 32.0, 0.0);
+
+	VectorAdd(mins[e], delta, mins[e]);
+	VectorAdd(maxs[e], delta, maxs[e]);
+}
+
+/*
+ * @brief Resolves the query box for a trace of the specified entity.
+ */
+static void trace_box(const int32_t e, vec3_t box_mins, vec3_t box_maxs) {
+
+	VectorCopy(mins[e], box_mins);
+	VectorCopy(maxs[e], box_maxs);
+
+	for (int32_t i = 0; i < 2; i++) {
+		box_mins[i] -= 64.0;
+		box_maxs[i] += 64.0;
+	}
+}
+
+/*
+ * @return The number of entities intersecting the given box, by brute force.
+ */
+static size_t brute_force(const vec3_t box_mins, const vec3_t box_maxs) {
+	size_t count = 0;
+
+	for (int32_t e = 0; e < GRID_ENTITIES; e++) {
+		if (BoxIntersect(mins[e], maxs[e], box_mins, box_maxs)) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+START_TEST(check_Sv_GridQuery)
+	{
+		int32_t items[GRID_ENTITIES];
+
+		for (int32_t e = 0; e < GRID_ENTITIES; e++) {
+			place(e);
+			Sv_GridLink(grid, e, mins[e], maxs[e]);
+		}
+
+		for (int32_t frame = 0; frame < 10; frame++) {
+
+			for (int32_t e = 0; e < GRID_ENTITIES; e++) {
+				move(e);
+				Sv_GridLink(grid, e, mins[e], maxs[e]);
+			}
+
+			for (int32_t e = 0; e < GRID_ENTITIES; e++) {
+				vec3_t box_mins, box_maxs;
+				trace_box(e, box_mins, box_maxs);
+
+				const size_t count = Sv_GridQuery(grid, box_mins, box_maxs, items, lengthof(items));
+				ck_assert_int_eq(count, brute_force(box_mins, box_maxs));
+			}
+		}
+
+		for (int32_t e = 0; e < GRID_ENTITIES; e += 2) {
+			Sv_GridUnlink(grid, e);
+		}
+
+		// entities may have wandered outside of the world bounds
+		vec3_t box_mins, box_maxs;
+		VectorScale(world_mins, 2.0, box_mins);
+		VectorScale(world_maxs, 2.0, box_maxs);
+
+		const size_t count = Sv_GridQuery(grid, box_mins, box_maxs, items, lengthof(items));
+		ck_assert_int_eq(count, GRID_ENTITIES / 2);
+
+		for (size_t i = 0; i < count; i++) {
+			ck_assert_msg(items[i] & 1, "Unlinked entity %d returned", items[i]);
+		}
+
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_sv_grid");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Sv_GridQuery);
+
+	Suite *suite = suite_create("check_sv_grid");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "server/sv_local.h"
+
+#define HASH_CLIENTS 64
+
+static sv_client_t *clients;
+
+/*
+ * @brief Setup fixture.
+ */
+void setup(void) {
+	Mem_Init();
+
+	clients = Mem_Malloc(sizeof(sv_client_t) * HASH_CLIENTS);
+
+	for (int32_t i = 0; i < HASH_CLIENTS; i++) {
+		sv_client_t *cl = &clients[i];
+
+		cl->state = SV_CLIENT_ACTIVE;
+
+		cl->net_chan.remote_address.type = NA_DATAGRAM;
+		cl->net_chan.remote_address.addr = htonl(0x0a000000 + i / 4); // four clients per router
+		cl->net_chan.remote_address.port = htons(PORT_CLIENT + i);
+		cl->net_chan.qport = i & 0xff;
+
+		Sv_HashClient(cl);
+	}
+}
+
+/*
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+	Sv_ClearClientHash();
+
+	Mem_Free(clients);
+
+	Mem_Shutdown();
+}
+
+/*
+ * @return The client for the given address and qport, by scanning all slots
+ * as Sv_ReadPackets did previously.
+ */
+static sv_client_t *scan(const net_addr_t *addr, const byte qport) {
+
+	sv_client_t *cl = clients;
+	for (int32_t i = 0; i < HASH_CLIENTS; i++, cl++) {
+
+		if (cl->state == SV_CLIENT_FREE)
+			continue;
+
+		if (cl->net_chan.remote_address.type != addr->type)
+			continue;
+
+		if (cl->net_chan.remote_address.addr != addr->addr)
+			continue;
+
+		if (cl->net_chan.qport != qport)
+			continue;
+
+		return cl;
+	}
+
+	return NULL;
+}
+
+START_TEST(check_Sv_HashedClient)
+	{
+		for (int32_t i = 0; i < HASH_CLIENTS; i++) {
+			const net_chan_t *ch = &clients[i].net_chan;
+			ck_assert(Sv_HashedClient(&ch->remote_address, ch->qport) == &clients[i]);
+			ck_assert(scan(&ch->remote_address, ch->qport) == &clients[i]);
+		}
+
+		// an unknown qport from a known address
+		ck_assert(Sv_HashedClient(&clients[0].net_chan.remote_address, 0xff) == NULL);
+
+		// a router rewrites the port of a connected client
+		net_addr_t addr = clients[5].net_chan.remote_address;
+		addr.port = htons(40000);
+
+		sv_client_t *cl = Sv_HashedClient(&addr, clients[5].net_chan.qport);
+		ck_assert(cl == &clients[5]);
+
+		Sv_UnhashClient(cl);
+		cl->net_chan.remote_address.port = addr.port;
+		Sv_HashClient(cl);
+
+		ck_assert(Sv_HashedClient(&addr, cl->net_chan.qport) == cl);
+
+		// a dropped client is no longer resolved
+		Sv_UnhashClient(&clients[7]);
+		ck_assert(Sv_HashedClient(&clients[7].net_chan.remote_address, clients[7].net_chan.qport) == NULL);
+
+	}END_TEST
+
+START_TEST(check_Sv_HashedClient_Collision)
+	{
+		sv_client_t *a = &clients[8], *b = &clients[9];
+
+		// two clients behind the same router happen to share a qport
+		Sv_UnhashClient(b);
+		b->net_chan.qport = a->net_chan.qport;
+		Sv_HashClient(b);
+
+		ck_assert(Sv_HashedClient(&a->net_chan.remote_address, a->net_chan.qport) == a);
+		ck_assert(Sv_HashedClient(&b->net_chan.remote_address, b->net_chan.qport) == b);
+
+		// the first client's slot is reused by a client elsewhere
+		Sv_UnhashClient(a);
+		a->net_chan.remote_address.addr = htonl(0x0b000000);
+		Sv_HashClient(a);
+
+		ck_assert(Sv_HashedClient(&a->net_chan.remote_address, a->net_chan.qport) == a);
+		ck_assert(Sv_HashedClient(&b->net_chan.remote_address, b->net_chan.qport) == b);
+
+		// the second client's port is rewritten, and it is found by qport
+		net_addr_t addr = b->net_chan.remote_address;
+		addr.port = htons(40000);
+
+		ck_assert(Sv_HashedClient(&addr, b->net_chan.qport) == b);
+
+		// and once dropped, it is no longer resolved by either table
+		Sv_UnhashClient(b);
+
+		ck_assert(Sv_HashedClient(&b->net_chan.remote_address, b->net_chan.qport) == NULL);
+		ck_assert(Sv_HashedClient(&addr, b->net_chan.qport) == NULL);
+		ck_assert(Sv_HashedClient(&a->net_chan.remote_address, a->net_chan.qport) == a);
+
+	}END_TEST
+
+/*
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_sv_hash");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Sv_HashedClient);
+	tcase_add_test(tcase, check_Sv_HashedClient_Collision);
+
+	Suite *suite = suite_create("check_sv_hash");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
@@ -22,12 +22,19 @@
 #include "tests.h"
 #include "thread.h"
 
+#include <SDL2/SDL_timer.h>
+
 typedef struct {
 	_Bool ready;
 } critical_section_t;
 
 static critical_section_t cs;
 
+#define STRESS_JOBS (MAX_THREAD_JOBS * 16)
+#define STRESS_THREADS 8
+
+static SDL_atomic_t job_count;
+
 /*
  * @brief Setup fixture.
  */
@@ -38,6 +45,8 @@ void setup(void) {
 	Thread_Init(2);
 
 	memset(&cs, 0, sizeof(cs));
+
+	SDL_AtomicSet(&job_count, 0);
 }
 
 /*
@@ -81,6 +90,82 @@ START_TEST(check_Thread_Wait)
 
 	}END_TEST
 
+/*
+ * @brief Verifies that the producer has completed before the continuation runs.
+ */
+static void continuation(void *data __attribute__((unused))) {
+
+	ck_assert(cs.ready);
+
+	cs.ready = false;
+}
+
+START_TEST(check_Thread_CreateAfter)
+	{
+		int32_t i;
+
+		for (i = 0; i < 1000; i++) {
+			cs.ready = false;
+
+			thread_t *p = Thread_Create(produce, NULL);
+			thread_t *c = Thread_CreateAfter(continuation, NULL, p);
+
+			Thread_Wait(c);
+			Thread_Wait(p);
+
+			ck_assert(!cs.ready);
+		}
+
+	}END_TEST
+
+/*
+ * @brief Counts the number of jobs that have run.
+ */
+static void increment(void *data __attribute__((unused))) {
+	SDL_AtomicIncRef(&job_count);
+}
+
+/*
+ * @brief Submits a nested group of jobs and waits on them from within a worker.
+ */
+static void fan_out(void *data __attribute__((unused))) {
+	thread_counter_t counter;
+	int32_t i;
+
+	memset(&counter, 0, sizeof(counter));
+
+	for (i = 0; i < 64; i++) {
+		Thread_Submit(increment, NULL, &counter);
+	}
+
+	Thread_WaitAll(&counter);
+}
+
+START_TEST(check_Thread_WaitAll)
+	{
+		thread_counter_t counter;
+		int32_t i;
+
+		Thread_Shutdown();
+		Thread_Init(STRESS_THREADS);
+
+		memset(&counter, 0, sizeof(counter));
+
+		for (i = 0; i < STRESS_JOBS; i++) {
+			Thread_Submit(increment, NULL, &counter);
+		}
+
+		for (i = 0; i < 256; i++) {
+			Thread_Submit(fan_out, NULL, &counter);
+		}
+
+		Thread_WaitAll(&counter);
+
+		ck_assert_int_eq(SDL_AtomicGet(&job_count), STRESS_JOBS + 256 * 64);
+		ck_assert_int_eq(SDL_AtomicGet(&counter.count), 0);
+
+	}END_TEST
+
 /*
  * @brief Test entry point.
  */
@@ -92,6 +177,8 @@ int32_t main(int32_t argc, char **argv) {
 	tcase_add_checked_fixture(tcase, setup, teardown);
 
 	tcase_add_test(tcase, check_Thread_Wait);
+	tcase_add_test(tcase, check_Thread_CreateAfter);
+	tcase_add_test(tcase, check_Thread_WaitAll);
 
 	Suite *suite = suite_create("check_threads");
 	suite_add_tcase(suite, tcase);
@@ -0,0 +1,589 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "replay.h"
+#include "cmd.h"
+
+#define REPLAY_ENTITIES 64
+#define REPLAY_FRAMES 1000
+#define REPLAY_HZ 40
+
+/*
+ * @brief The replay maintains a channel for each remote address of each
+ * source, along with just enough state to walk its messages.
+ */
+typedef struct {
+	net_src_t source;
+	net_addr_t addr;
+	net_chan_t chan;
+
+	uint16_t protocol; // from the server data, for packet entities
+	player_state_t ps;
+	entity_state_t entities[MAX_ENTITIES];
+
+	char config_strings[MAX_CONFIG_STRINGS][MAX_STRING_CHARS];
+	net_dictionary_t dictionary;
+} replay_chan_t;
+
+static replay_chan_t *replay_chans[MAX_CLIENTS * 2];
+static byte replay_buffer[MAX_MSG_SIZE];
+
+/*
+ * @return The replay channel for the given source and address, allocating it
+ * if create is true.
+ */
+static replay_chan_t *Replay_Chan(net_src_t source, const net_addr_t *addr, _Bool create) {
+
+	for (size_t i = 0; i < lengthof(replay_chans); i++) {
+		replay_chan_t *rc = replay_chans[i];
+
+		if (rc == NULL) {
+			if (!create)
+				return NULL;
+
+			rc = replay_chans[i] = Mem_Malloc(sizeof(replay_chan_t));
+
+			rc->source = source;
+			rc->addr = *addr;
+			return rc;
+		}
+
+		if (rc->source == source && rc->addr.type == addr->type && Net_CompareNetaddr(&rc->addr, addr))
+			return rc;
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief Connectionless packets are ignored, except for the server's connect
+ * response, which establishes a channel with the capabilities it names. Both
+ * the client's receipt and the server's transmission of it are honored.
+ */
+static void Replay_ConnectionlessPacket(net_src_t source, const net_addr_t *addr, mem_buf_t *msg,
+		replay_stats_t *stats) {
+
+	Net_BeginReading(msg);
+	Net_ReadLong(msg); // skip the -1
+
+	Cmd_TokenizeString(Net_ReadStringLine(msg));
+
+	if (g_strcmp0(Cmd_Argv(0), "client_connect"))
+		return;
+
+	replay_chan_t *rc = Replay_Chan(source, addr, true);
+	if (rc == NULL) {
+		Com_Warn("Too many channels, ignoring %s\n", Net_NetaddrToString(addr));
+		return;
+	}
+
+	net_addr_t remote = *addr;
+	Netchan_Setup(source, &rc->chan, &remote, 0);
+
+	stats->channels++;
+
+	for (int32_t i = 1; i < Cmd_Argc(); i++) {
+		if (!g_strcmp0(Cmd_Argv(i), "compress")) {
+			rc->chan.compress = true;
+		} else if (!g_strcmp0(Cmd_Argv(i), "window")) {
+			Netchan_OpenWindow(&rc->chan);
+		}
+	}
+}
+
+/*
+ * @brief Net_PacketEntityFunc for the replay. The delta base of each entity is
+ * simply its last state, which is sufficient to consume the message.
+ */
+static void Replay_ParseEntity(mem_buf_t *msg, mem_bits_t *packed, uint16_t number, uint16_t flags,
+		void *data) {
+
+	replay_chan_t *rc = (replay_chan_t *) data;
+
+	if (flags & U_REMOVE)
+		return;
+
+	const entity_state_t from = rc->entities[number];
+
+	if (packed)
+		Net_ReadDeltaEntityBits(packed, &from, &rc->entities[number], number, flags);
+	else
+		Net_ReadDeltaEntity(msg, &from, &rc->entities[number], number, flags);
+}
+
+/*
+ * @brief Walks a message from the server with the readers which
+ * Cl_ParseServerMessage uses.
+ *
+ * @return False if the message is illegible.
+ */
+static _Bool Replay_ParseServerMessage(replay_chan_t *rc, mem_buf_t *msg, replay_stats_t *stats) {
+	static const player_state_t null_state;
+	static const entity_state_t null_entity;
+
+	while (true) {
+		const int32_t cmd = Net_ReadByte(msg);
+
+		if (cmd == -1)
+			return true;
+
+		_Bool legible = true;
+
+		switch (cmd) {
+
+			case SV_CMD_BASELINE: {
+				const uint16_t number = Net_ReadShort(msg);
+				const uint16_t bits = Net_ReadShort(msg);
+
+				if (number >= MAX_ENTITIES)
+					return false;
+
+				Net_ReadDeltaEntity(msg, &null_entity, &rc->entities[number], number, bits);
+			}
+				break;
+
+			case SV_CMD_CBUF_TEXT: {
+				const char *text = Net_ReadString(msg);
+
+				// the client primes its dictionary before requesting baselines
+				if (rc->chan.compress && g_str_has_prefix(text, "baselines ") &&
+						g_str_has_suffix(text, " 0\n")) {
+					Netchan_BuildDictionary(&rc->dictionary, rc->config_strings, MAX_CONFIG_STRINGS);
+					rc->chan.dictionary = &rc->dictionary;
+				}
+			}
+				break;
+
+			case SV_CMD_CONFIG_STRING: {
+				const uint16_t i = Net_ReadShort(msg);
+
+				if (i >= MAX_CONFIG_STRINGS)
+					return false;
+
+				g_strlcpy(rc->config_strings[i], Net_ReadString(msg), MAX_STRING_CHARS);
+			}
+				break;
+
+			case SV_CMD_DISCONNECT:
+			case SV_CMD_RECONNECT:
+				break;
+
+			case SV_CMD_DOWNLOAD: {
+				net_download_t download;
+				legible = Net_ReadDownload(msg, &download);
+			}
+				break;
+
+			case SV_CMD_FRAME: {
+				net_frame_t frame;
+
+				if (!Net_ReadFrame(msg, &frame))
+					return false;
+
+				const player_state_t from = frame.delta_frame_num <= 0 ? null_state : rc->ps;
+				Net_ReadDeltaPlayerState(msg, &from, &rc->ps);
+
+				legible = Net_ReadPacketEntities(msg, rc->protocol == PROTOCOL_MAJOR,
+						Replay_ParseEntity, rc);
+			}
+				break;
+
+			case SV_CMD_PRINT:
+				Net_ReadByte(msg);
+				Net_ReadString(msg);
+				break;
+
+			case SV_CMD_SERVER_DATA: {
+				net_server_data_t data;
+				legible = Net_ReadServerData(msg, &data);
+
+				rc->protocol = data.major;
+
+				memset(rc->config_strings, 0, sizeof(rc->config_strings));
+				rc->chan.dictionary = NULL;
+			}
+				break;
+
+			case SV_CMD_SOUND: {
+				net_sound_t sound;
+				legible = Net_ReadSound(msg, &sound);
+			}
+				break;
+
+			default:
+				if (cmd < SV_CMD_CGAME)
+					return false;
+
+				stats->opaque++;
+				return true;
+		}
+
+		if (!legible || msg->read > msg->size)
+			return false;
+
+		stats->messages++;
+	}
+}
+
+/*
+ * @brief Walks a message from a client with the readers which
+ * Sv_ParseClientMessage uses.
+ *
+ * @return False if the message is illegible.
+ */
+static _Bool Replay_ParseClientMessage(replay_chan_t *rc, mem_buf_t *msg, replay_stats_t *stats) {
+
+	while (true) {
+		const int32_t cmd = Net_ReadByte(msg);
+
+		if (cmd == -1)
+			return true;
+
+		switch (cmd) {
+
+			case CL_CMD_MOVE: {
+				net_move_t move;
+
+				if (!Net_ReadMove(msg, &move))
+					return false;
+			}
+				break;
+
+			case CL_CMD_STRING:
+			case CL_CMD_USER_INFO:
+				Net_ReadString(msg);
+				break;
+
+			default:
+				if (cmd < CL_CMD_CGAME)
+					return false;
+
+				stats->opaque++;
+				return true;
+		}
+
+		if (msg->read > msg->size)
+			return false;
+
+		stats->messages++;
+	}
+}
+
+/*
+ * @return True if msg is a connectionless packet.
+ */
+static _Bool Replay_Connectionless(const mem_buf_t *msg) {
+	return msg->size >= sizeof(int32_t) && *(int32_t *) msg->data == -1;
+}
+
+/*
+ * @brief Processes a datagram received on the given channel, and walks it.
+ */
+static void Replay_Packet(replay_chan_t *rc, mem_buf_t *msg, replay_stats_t *stats) {
+
+	stats->packets++;
+	stats->bytes += msg->size;
+
+	if (rc == NULL || msg->size < sizeof(int32_t) || !Netchan_Process(&rc->chan, msg)) {
+		stats->dropped++;
+		return;
+	}
+
+	_Bool legible;
+	if (rc->source == NS_UDP_CLIENT)
+		legible = Replay_ParseServerMessage(rc, msg, stats);
+	else
+		legible = Replay_ParseClientMessage(rc, msg, stats);
+
+	if (!legible)
+		stats->illegible++;
+}
+
+/*
+ * @brief Replays the given packet capture, accumulating stats.
+ *
+ * @return True if the capture was well formed, false otherwise.
+ */
+_Bool Replay(const byte *data, size_t len, replay_stats_t *stats) {
+	mem_stats_t mem_before, mem_after;
+	net_capture_header_t header;
+	mem_buf_t msg;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (len < sizeof(header))
+		return false;
+
+	memcpy(&header, data, sizeof(header));
+
+	if (header.magic != NET_CAPTURE_MAGIC || header.version != NET_CAPTURE_VERSION)
+		return false;
+
+	Mem_Stats(&mem_before);
+	const uint32_t time = quetoo.time;
+
+	size_t pos = sizeof(header);
+	while (pos + sizeof(net_capture_record_t) <= len) {
+		net_capture_record_t record;
+
+		memcpy(&record, data + pos, sizeof(record));
+		pos += sizeof(record);
+
+		if (record.size > len - pos || record.size > sizeof(replay_buffer))
+			return false;
+
+		Mem_InitBuffer(&msg, replay_buffer, sizeof(replay_buffer));
+		memcpy(replay_buffer, data + pos, record.size);
+		msg.size = record.size;
+
+		pos += record.size;
+
+		const net_addr_t addr = {
+			.type = record.type,
+			.addr = record.addr,
+			.port = record.port
+		};
+
+		if (Replay_Connectionless(&msg)) {
+			Replay_ConnectionlessPacket(record.source, &addr, &msg, stats);
+			continue;
+		}
+
+		if (record.direction != NET_CAPTURE_RECV)
+			continue;
+
+		quetoo.time = time + record.time / 1000;
+
+		Replay_Packet(Replay_Chan(record.source, &addr, false), &msg, stats);
+	}
+
+	Mem_Stats(&mem_after);
+
+	for (mem_tag_t t = 0; t < MEM_TAG_TOTAL; t++) {
+		stats->allocations += mem_after.tags[t].allocations - mem_before.tags[t].allocations;
+	}
+
+	return pos == len;
+}
+
+/*
+ * @brief Moves the entity as the game might.
+ */
+static void Replay_Move(entity_state_t *s) {
+
+	if (rand() % 100 < 40)
+		return;
+
+	for (int32_t i = 0; i < 3; i++) {
+		s->origin[i] += Randomc() * 12.0;
+	}
+	s->angles[YAW] = ClampAngle(s->angles[YAW] + Randomc() * 30.0);
+}
+
+/*
+ * @brief Delivers all pending datagrams for the given channel, walking them
+ * as the replay would.
+ */
+static void Replay_Receive(replay_chan_t *rc, replay_stats_t *stats) {
+
+	while (Net_ReceiveDatagram(rc->source, &net_from, &net_message)) {
+
+		if (Replay_Connectionless(&net_message))
+			continue;
+
+		Replay_Packet(rc, &net_message, stats);
+	}
+}
+
+/*
+ * @brief Synthesizes a session over the loopback, writing it to a capture.
+ * The session is walked as it is sent, accumulating stats.
+ *
+ * @return The number of messages sent by the client and server, or 0 if the
+ * capture could not be written.
+ */
+uint32_t Replay_Capture(const char *filename, replay_stats_t *stats) {
+	static replay_chan_t client, server;
+	static entity_state_t entities[REPLAY_ENTITIES];
+	static const player_state_t null_state;
+	static const pm_cmd_t null_cmd;
+
+	byte buffer[MAX_MSG_SIZE];
+	mem_buf_t buf;
+
+	memset(stats, 0, sizeof(*stats));
+
+	uint32_t sent = 0;
+
+	if (!Net_StartCapture(filename))
+		return 0;
+
+	net_addr_t addr = { .type = NA_LOOP, .addr = net_lo };
+
+	Netchan_OutOfBandPrint(NS_UDP_SERVER, &addr, "client_connect %s%s%s", "", " compress", " window");
+	if (!Net_ReceiveDatagram(NS_UDP_CLIENT, &net_from, &net_message)) {
+		Net_StopCapture();
+		return 0;
+	}
+
+	memset(&client, 0, sizeof(client));
+	memset(&server, 0, sizeof(server));
+
+	client.source = NS_UDP_CLIENT;
+	server.source = NS_UDP_SERVER;
+
+	Netchan_Setup(NS_UDP_CLIENT, &client.chan, &addr, 1);
+	Netchan_Setup(NS_UDP_SERVER, &server.chan, &addr, 1);
+
+	client.chan.compress = server.chan.compress = true;
+	Netchan_OpenWindow(&client.chan);
+	Netchan_OpenWindow(&server.chan);
+
+	Net_WriteByte(&server.chan.message, SV_CMD_SERVER_DATA);
+	Net_WriteShort(&server.chan.message, PROTOCOL_MAJOR);
+	Net_WriteShort(&server.chan.message, 0);
+	Net_WriteLong(&server.chan.message, 1);
+	Net_WriteLong(&server.chan.message, REPLAY_HZ);
+	Net_WriteByte(&server.chan.message, 0);
+	Net_WriteString(&server.chan.message, "default");
+	Net_WriteShort(&server.chan.message, 0);
+	Net_WriteString(&server.chan.message, "check_net_replay");
+	sent++;
+
+	for (int32_t i = 0; i < REPLAY_ENTITIES; i++) {
+		entities[i].number = 1 + i * 3;
+		for (int32_t j = 0; j < 3; j++) {
+			entities[i].origin[j] = Randomc() * MAX_WORLD_COORD;
+		}
+	}
+
+	player_state_t ps, last_ps;
+	memset(&ps, 0, sizeof(ps));
+	memset(&last_ps, 0, sizeof(last_ps));
+
+	pm_cmd_t cmds[3];
+	memset(cmds, 0, sizeof(cmds));
+
+	for (int32_t f = 1; f <= REPLAY_FRAMES; f++) {
+		entity_state_t from[REPLAY_ENTITIES];
+
+		quetoo.time += 1000 / REPLAY_HZ;
+
+		// the occasional reliable print from the server, and string from the client
+		if (f % 10 == 0) {
+			Net_WriteByte(&server.chan.message, SV_CMD_PRINT);
+			Net_WriteByte(&server.chan.message, PRINT_HIGH);
+			Net_WriteString(&server.chan.message,
+					va("Frame %d: the quick brown fox jumps over the lazy dog\n", f));
+			sent++;
+		}
+
+		if (f % 50 == 0) {
+			Net_WriteByte(&client.chan.message, CL_CMD_STRING);
+			Net_WriteString(&client.chan.message, va("say frame %d", f));
+			sent++;
+		}
+
+		// the server's sound and frame
+		memcpy(from, entities, sizeof(from));
+		for (int32_t i = 0; i < REPLAY_ENTITIES; i++) {
+			Replay_Move(&entities[i]);
+		}
+
+		ps.pm_state.origin[0] += 10.0;
+		ps.pm_state.view_angles[YAW] = PackAngle(f * 10.0);
+
+		Mem_InitBuffer(&buf, buffer, sizeof(buffer));
+
+		Net_WriteByte(&buf, SV_CMD_SOUND);
+		Net_WriteByte(&buf, S_ATTEN | S_ENTITY);
+		Net_WriteByte(&buf, f & 0xff);
+		Net_WriteByte(&buf, ATTEN_NORM);
+		Net_WriteShort(&buf, entities[f % REPLAY_ENTITIES].number);
+
+		Net_WriteByte(&buf, SV_CMD_FRAME);
+		Net_WriteLong(&buf, f);
+		Net_WriteLong(&buf, f - 1);
+		Net_WriteByte(&buf, 0);
+		Net_WriteByte(&buf, 0);
+
+		Net_WriteDeltaPlayerState(&buf, f == 1 ? &null_state : &last_ps, &ps);
+		last_ps = ps;
+
+		mem_bits_t bits;
+		Mem_BeginBits(&bits, &buf);
+
+		uint16_t last = 0;
+		for (int32_t i = 0; i < REPLAY_ENTITIES; i++) {
+			if (Net_WriteDeltaEntityBits(&bits, last, &from[i], &entities[i], f == 1)) {
+				last = entities[i].number;
+			}
+		}
+		Net_WriteEntityNumberBits(&bits, last, 0);
+		Mem_EndWriteBits(&bits);
+
+		sent += 2;
+
+		Netchan_Transmit(&server.chan, buf.data, buf.size);
+		Replay_Receive(&client, stats);
+
+		// and the client's reply
+		cmds[0] = cmds[1];
+		cmds[1] = cmds[2];
+		cmds[2].msec = 1000 / REPLAY_HZ;
+		cmds[2].angles[YAW] = PackAngle(f * 10.0);
+		cmds[2].forward = 100;
+
+		Mem_InitBuffer(&buf, buffer, sizeof(buffer));
+
+		Net_WriteByte(&buf, CL_CMD_MOVE);
+		Net_WriteLong(&buf, f);
+		Net_WriteDeltaMoveCmd(&buf, &null_cmd, &cmds[0]);
+		Net_WriteDeltaMoveCmd(&buf, &cmds[0], &cmds[1]);
+		Net_WriteDeltaMoveCmd(&buf, &cmds[1], &cmds[2]);
+		sent++;
+
+		Netchan_Transmit(&client.chan, buf.data, buf.size);
+		Replay_Receive(&server, stats);
+	}
+
+	Net_StopCapture();
+
+	Netchan_Close(&client.chan);
+	Netchan_Close(&server.chan);
+
+	return sent;
+}
+
+/*
+ * @brief Closes and frees all replay channels, so that the next replay
+ * begins afresh.
+ */
+void Replay_Shutdown(void) {
+
+	for (size_t i = 0; i < lengthof(replay_chans); i++) {
+		if (replay_chans[i]) {
+			Netchan_Close(&replay_chans[i]->chan);
+			Mem_Free(replay_chans[i]);
+			replay_chans[i] = NULL;
+		}
+	}
+}
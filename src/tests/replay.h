@@ -0,0 +1,52 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "net/net_chan.h"
+
+/*
+ * Replays packet captures, as written by `net_capture`, through the netchan
+ * and a walk of the core protocol, using the same readers as the client and
+ * server. Shared by check_net_replay, which verifies a session, and
+ * bench_net_replay, which times it.
+ *
+ * Commands which belong to the game modules are opaque to the replay, and end
+ * the walk of the packet in which they appear.
+ */
+
+typedef struct {
+	uint32_t packets; // datagrams received
+	uint32_t dropped; // datagrams discarded by the netchan
+	uint32_t illegible; // datagrams which could not be walked
+	uint32_t opaque; // datagrams whose walk ended at a game module command
+	uint32_t messages; // commands walked
+	uint32_t channels; // channels established by connect responses
+	uint32_t allocations; // managed allocations made while replaying
+	size_t bytes; // datagram bytes received
+} replay_stats_t;
+
+_Bool Replay(const byte *data, size_t len, replay_stats_t *stats);
+uint32_t Replay_Capture(const char *filename, replay_stats_t *stats);
+void Replay_Shutdown(void);
+
+#endif /* __REPLAY_H__ */
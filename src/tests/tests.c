@@ -21,6 +21,8 @@
 
 #include "tests.h"
 
+#include <SDL2/SDL_timer.h>
+
 quetoo_t quetoo;
 
 /**
@@ -53,3 +55,11 @@ void Test_Init(int32_t argc, char **argv) {
 void Test_Shutdown(void) {
 
 }
+
+/*
+ * @return The seconds elapsed since start, a value of SDL_GetPerformanceCounter.
+ * Used by the benchmarks, which report rates rather than assert them.
+ */
+double Test_Seconds(uint64_t start) {
+	return (SDL_GetPerformanceCounter() - start) / (double) SDL_GetPerformanceFrequency();
+}
@@ -30,4 +30,6 @@ int Test_Run(Suite *suite);
 void Test_Init(int32_t argc, char **argv);
 void Test_Shutdown(void);
 
+double Test_Seconds(uint64_t start);
+
 #endif /* __TESTS_H__ */
@@ -21,155 +21,503 @@
 
 #include "thread.h"
 
+/*
+ * @brief Each worker owns a deque of jobs. The owner pushes and pops at the
+ * tail, while idle workers (and waiting callers) steal from the head.
+ */
+typedef struct {
+	SDL_Thread *thread;
+	SDL_SpinLock lock;
+
+	thread_t *jobs[MAX_THREAD_DEQUE];
+	uint32_t head, tail;
+} thread_worker_t;
+
 typedef struct thread_pool_s {
 	SDL_mutex *mutex;
+	SDL_cond *work_cond; // signaled when jobs are queued
+	SDL_cond *done_cond; // broadcast when jobs complete
 
-	thread_t *threads;
+	SDL_atomic_t queued; // jobs sitting in worker deques
+	SDL_atomic_t sleeping; // workers blocked on work_cond
+	SDL_atomic_t waiting; // callers blocked on done_cond
+	SDL_atomic_t next_worker; // round-robin for submissions from non-workers
+	SDL_atomic_t shutdown;
+
+	thread_t *jobs;
+	thread_t *free_jobs;
+	SDL_SpinLock free_lock;
+
+	thread_worker_t *workers;
 	uint16_t num_threads;
 } thread_pool_t;
 
 static thread_pool_t thread_pool;
 
+/*
+ * @brief Thread-local storage identifying the worker (if any) of the calling
+ * thread. This survives pool restarts, as SDL provides no means to free it.
+ */
+static SDL_TLSID thread_worker;
+
 cvar_t *threads;
 
+typedef _Bool (*ThreadDoneFunc)(void *data);
+
+/*
+ * @brief Allocates a job from the free list, returning NULL if none remain.
+ */
+static thread_t *Thread_Alloc(void) {
+
+	SDL_AtomicLock(&thread_pool.free_lock);
+
+	thread_t *t = thread_pool.free_jobs;
+	if (t) {
+		thread_pool.free_jobs = t->next;
+	}
+
+	SDL_AtomicUnlock(&thread_pool.free_lock);
+
+	return t;
+}
+
+/*
+ * @brief Returns the specified job to the free list.
+ */
+static void Thread_Free(thread_t *t) {
+
+	SDL_AtomicSet(&t->status, THREAD_IDLE);
+
+	SDL_AtomicLock(&thread_pool.free_lock);
+
+	t->next = thread_pool.free_jobs;
+	thread_pool.free_jobs = t;
+
+	SDL_AtomicUnlock(&thread_pool.free_lock);
+}
+
+/*
+ * @brief Wakes a sleeping worker and any blocked waiters after a job is queued,
+ * so that they may run or steal it.
+ */
+static void Thread_Signal(void) {
+
+	const _Bool sleeping = SDL_AtomicGet(&thread_pool.sleeping) > 0;
+	const _Bool waiting = SDL_AtomicGet(&thread_pool.waiting) > 0;
+
+	if (sleeping || waiting) {
+		SDL_mutexP(thread_pool.mutex);
+
+		if (sleeping) {
+			SDL_CondSignal(thread_pool.work_cond);
+		}
+
+		if (waiting) {
+			SDL_CondBroadcast(thread_pool.done_cond);
+		}
+
+		SDL_mutexV(thread_pool.mutex);
+	}
+}
+
+/*
+ * @brief Wakes any blocked waiters after a job completes.
+ */
+static void Thread_Notify(void) {
+
+	if (SDL_AtomicGet(&thread_pool.waiting) > 0) {
+		SDL_mutexP(thread_pool.mutex);
+		SDL_CondBroadcast(thread_pool.done_cond);
+		SDL_mutexV(thread_pool.mutex);
+	}
+}
+
+/*
+ * @brief Pushes the job onto the calling worker's deque. Submissions from
+ * threads outside of the pool are distributed round-robin.
+ *
+ * @return True if the job was queued, false if the deque was full.
+ */
+static _Bool Thread_Push(thread_t *t) {
+
+	thread_worker_t *w = SDL_TLSGet(thread_worker);
+	if (w == NULL) {
+		const uint32_t i = (uint32_t) SDL_AtomicAdd(&thread_pool.next_worker, 1);
+		w = &thread_pool.workers[i % thread_pool.num_threads];
+	}
+
+	SDL_AtomicLock(&w->lock);
+
+	if (w->tail - w->head == MAX_THREAD_DEQUE) {
+		SDL_AtomicUnlock(&w->lock);
+		return false;
+	}
+
+	w->jobs[w->tail & (MAX_THREAD_DEQUE - 1)] = t;
+	w->tail++;
+
+	SDL_AtomicUnlock(&w->lock);
+
+	SDL_AtomicIncRef(&thread_pool.queued);
+
+	Thread_Signal();
+	return true;
+}
+
 /*
- * @brief Wrap the user's function in our own for introspection.
+ * @brief Pops the most recently queued job from the worker's own deque.
+ */
+static thread_t *Thread_Pop(thread_worker_t *w) {
+	thread_t *t = NULL;
+
+	SDL_AtomicLock(&w->lock);
+
+	if (w->tail != w->head) {
+		w->tail--;
+		t = w->jobs[w->tail & (MAX_THREAD_DEQUE - 1)];
+	}
+
+	SDL_AtomicUnlock(&w->lock);
+
+	if (t) {
+		SDL_AtomicAdd(&thread_pool.queued, -1);
+	}
+
+	return t;
+}
+
+/*
+ * @brief Steals the oldest queued job from another worker's deque.
+ */
+static thread_t *Thread_Steal(const thread_worker_t *self) {
+	uint16_t i;
+
+	const uint32_t start = self ? (uint32_t) (self - thread_pool.workers) + 1 :
+			(uint32_t) SDL_AtomicGet(&thread_pool.next_worker);
+
+	for (i = 0; i < thread_pool.num_threads; i++) {
+		thread_worker_t *w = &thread_pool.workers[(start + i) % thread_pool.num_threads];
+
+		if (w == self || w->tail == w->head) {
+			continue;
+		}
+
+		thread_t *t = NULL;
+
+		SDL_AtomicLock(&w->lock);
+
+		if (w->tail != w->head) {
+			t = w->jobs[w->head & (MAX_THREAD_DEQUE - 1)];
+			w->head++;
+		}
+
+		SDL_AtomicUnlock(&w->lock);
+
+		if (t) {
+			SDL_AtomicAdd(&thread_pool.queued, -1);
+			return t;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief Returns the next job the calling thread should run, or NULL.
+ */
+static thread_t *Thread_Next(void) {
+
+	if (SDL_AtomicGet(&thread_pool.queued) == 0) {
+		return NULL;
+	}
+
+	thread_worker_t *w = SDL_TLSGet(thread_worker);
+
+	thread_t *t = w ? Thread_Pop(w) : NULL;
+	if (t == NULL) {
+		t = Thread_Steal(w);
+	}
+
+	return t;
+}
+
+static void Thread_Execute(thread_t *t);
+
+/*
+ * @brief Releases one of the job's pending references, queueing it once all of
+ * its dependencies have completed. If the job can not be queued, it is run
+ * immediately on the calling thread.
+ */
+static void Thread_Release(thread_t *t) {
+
+	if (SDL_AtomicDecRef(&t->pending)) {
+		if (!Thread_Push(t)) {
+			Thread_Execute(t);
+		}
+	}
+}
+
+/*
+ * @brief Runs the specified job, releasing its continuations and counter.
+ */
+static void Thread_Execute(thread_t *t) {
+
+	t->Run(t->data);
+
+	// the job may be released as soon as it is marked complete
+	thread_counter_t *counter = t->counter;
+	const _Bool detached = t->detached;
+
+	SDL_AtomicLock(&t->lock);
+
+	thread_t *c = t->continuations;
+	t->continuations = NULL;
+
+	SDL_AtomicSet(&t->status, THREAD_WAIT);
+
+	SDL_AtomicUnlock(&t->lock);
+
+	if (detached) {
+		Thread_Free(t);
+	}
+
+	while (c) {
+		thread_t *next = c->next;
+		Thread_Release(c);
+		c = next;
+	}
+
+	if (counter) {
+		SDL_AtomicAdd(&counter->count, -1);
+	}
+
+	Thread_Notify();
+}
+
+/*
+ * @brief Blocks the calling thread until the given condition is met. Rather
+ * than idling, the caller runs queued jobs while it waits.
+ */
+static void Thread_Join(ThreadDoneFunc done, void *data) {
+
+	while (!done(data)) {
+
+		thread_t *t = Thread_Next();
+		if (t) {
+			Thread_Execute(t);
+			continue;
+		}
+
+		SDL_mutexP(thread_pool.mutex);
+		SDL_AtomicIncRef(&thread_pool.waiting);
+
+		if (!done(data) && SDL_AtomicGet(&thread_pool.queued) == 0) {
+			SDL_CondWait(thread_pool.done_cond, thread_pool.mutex);
+		}
+
+		SDL_AtomicAdd(&thread_pool.waiting, -1);
+		SDL_mutexV(thread_pool.mutex);
+	}
+}
+
+/*
+ * @return True if the specified job is no longer running.
+ */
+static _Bool Thread_Done(void *data) {
+	return SDL_AtomicGet(&((thread_t *) data)->status) != THREAD_RUNNING;
+}
+
+/*
+ * @return True if all jobs submitted against the specified counter are done.
+ */
+static _Bool Thread_CounterDone(void *data) {
+	return SDL_AtomicGet(&((thread_counter_t *) data)->count) <= 0;
+}
+
+/*
+ * @brief Worker entry point: run our own jobs, steal others', or sleep.
  */
 static int32_t Thread_Run(void *data) {
-	thread_t *t = (thread_t *) data;
 
-	while (thread_pool.mutex) {
+	SDL_TLSSet(thread_worker, data, NULL);
 
-		SDL_mutexP(t->mutex);
+	while (true) {
 
-		if (t->status == THREAD_RUNNING) {
-			t->Run(t->data);
+		thread_t *t = Thread_Next();
+		if (t) {
+			Thread_Execute(t);
+			continue;
+		}
 
-			t->Run = NULL;
-			t->data = NULL;
+		SDL_mutexP(thread_pool.mutex);
 
-			t->status = THREAD_WAIT;
-		} else {
-			SDL_CondWait(t->cond, t->mutex);
+		if (SDL_AtomicGet(&thread_pool.shutdown)) {
+			SDL_mutexV(thread_pool.mutex);
+			break;
 		}
 
-		SDL_mutexV(t->mutex);
+		SDL_AtomicIncRef(&thread_pool.sleeping);
+
+		if (SDL_AtomicGet(&thread_pool.queued) == 0) {
+			SDL_CondWait(thread_pool.work_cond, thread_pool.mutex);
+		}
+
+		SDL_AtomicAdd(&thread_pool.sleeping, -1);
+
+		SDL_mutexV(thread_pool.mutex);
 	}
 
 	return 0;
 }
 
 /*
- * @brief Initializes the threads backing the thread pool.
+ * @brief Initializes the job pool and the workers backing it.
  */
 static void Thread_Init_(uint16_t num_threads) {
 
 	thread_pool.num_threads = MIN(num_threads, MAX_THREADS);
 
 	if (thread_pool.num_threads) {
-		thread_pool.threads = Mem_Malloc(sizeof(thread_t) * thread_pool.num_threads);
+		uint16_t i;
 
-		thread_t *t = thread_pool.threads;
-		uint16_t i = 0;
+		thread_pool.jobs = Mem_Malloc(sizeof(thread_t) * MAX_THREAD_JOBS);
 
-		for (i = 0; i < thread_pool.num_threads; i++, t++) {
-			t->cond = SDL_CreateCond();
-			t->mutex = SDL_CreateMutex();
-			t->thread = SDL_CreateThread(Thread_Run, __func__, t);
+		for (i = 0; i < MAX_THREAD_JOBS; i++) {
+			Thread_Free(&thread_pool.jobs[i]);
+		}
+
+		thread_pool.workers = Mem_Malloc(sizeof(thread_worker_t) * thread_pool.num_threads);
+
+		thread_worker_t *w = thread_pool.workers;
+		for (i = 0; i < thread_pool.num_threads; i++, w++) {
+			w->thread = SDL_CreateThread(Thread_Run, __func__, w);
 		}
 	}
 }
 
 /**
- * Thread_Shutdown_
+ * @brief Stops the workers, allowing them to drain their deques, and frees the
+ * job pool.
  */
 static void Thread_Shutdown_(void) {
 
 	if (thread_pool.num_threads) {
-		thread_t *t = thread_pool.threads;
-		uint16_t i = 0;
 
-		for (i = 0; i < thread_pool.num_threads; i++, t++) {
-			Thread_Wait(t);
-			SDL_CondSignal(t->cond);
-			SDL_WaitThread(t->thread, NULL);
-			SDL_DestroyCond(t->cond);
-			SDL_DestroyMutex(t->mutex);
+		SDL_mutexP(thread_pool.mutex);
+		SDL_AtomicSet(&thread_pool.shutdown, 1);
+		SDL_CondBroadcast(thread_pool.work_cond);
+		SDL_mutexV(thread_pool.mutex);
+
+		thread_worker_t *w = thread_pool.workers;
+		uint16_t i;
+
+		for (i = 0; i < thread_pool.num_threads; i++, w++) {
+			SDL_WaitThread(w->thread, NULL);
 		}
 
-		Mem_Free(thread_pool.threads);
+		Mem_Free(thread_pool.workers);
+		Mem_Free(thread_pool.jobs);
 	}
 }
 
 /*
- * @brief Creates a new thread to run the specified function. Callers must use
- * Thread_Wait on the returned handle to release the thread when finished.
+ * @brief Allocates and dispatches a job, optionally as the continuation of
+ * another. If no job can be allocated, the function is run immediately.
  */
-thread_t *Thread_Create_(const char *name, ThreadRunFunc run, void *data) {
+static thread_t *Thread_Enqueue(const char *name, ThreadRunFunc run, void *data,
+		thread_t *dependency, thread_counter_t *counter, _Bool detached) {
 
-	thread_t *t = thread_pool.threads;
-	uint16_t i = 0;
+	thread_t *t = thread_pool.num_threads ? Thread_Alloc() : NULL;
 
-	// if threads are available, find an idle one and dispatch it
-	if (thread_pool.num_threads) {
-		SDL_mutexP(thread_pool.mutex);
-
-		for (i = 0; i < thread_pool.num_threads; i++, t++) {
-
-			// if the thread appears idle, lock it and check again
-			if (t->status == THREAD_IDLE) {
+	if (t == NULL) {
+		if (dependency) {
+			Thread_Join(Thread_Done, dependency);
+		}
+		run(data);
+		return NULL;
+	}
 
-				SDL_mutexP(t->mutex);
+	g_strlcpy(t->name, name, sizeof(t->name));
 
-				// if the thread is idle, dispatch it
-				if (t->status == THREAD_IDLE) {
-					g_strlcpy(t->name, name, sizeof(t->name));
+	t->Run = run;
+	t->data = data;
+	t->continuations = NULL;
+	t->next = NULL;
+	t->counter = counter;
+	t->detached = detached;
 
-					t->Run = run;
-					t->data = data;
+	SDL_AtomicSet(&t->status, THREAD_RUNNING);
+	SDL_AtomicSet(&t->pending, 1);
 
-					t->status = THREAD_RUNNING;
+	if (counter) {
+		SDL_AtomicIncRef(&counter->count);
+	}
 
-					SDL_mutexV(t->mutex);
-					SDL_CondSignal(t->cond);
+	if (dependency) {
+		SDL_AtomicLock(&dependency->lock);
 
-					break;
-				}
+		if (SDL_AtomicGet(&dependency->status) == THREAD_RUNNING) {
+			SDL_AtomicIncRef(&t->pending);
 
-				SDL_mutexV(t->mutex);
-			}
+			t->next = dependency->continuations;
+			dependency->continuations = t;
 		}
 
-		SDL_mutexV(thread_pool.mutex);
+		SDL_AtomicUnlock(&dependency->lock);
 	}
 
-	// if we failed to allocate a thread, run the function in this thread
-	if (i == thread_pool.num_threads) {
-#if 0
-		if (thread_pool.num_threads) {
-			printf("No threads available for %s\n", name);
-		}
-#endif
-		t = NULL;
-		run(data);
-	}
+	Thread_Release(t);
 
 	return t;
 }
 
 /*
- * @brief Wait for the specified thread to complete.
+ * @brief Creates a new job to run the specified function. Callers must use
+ * Thread_Wait on the returned handle to release the job when finished.
+ */
+thread_t *Thread_Create_(const char *name, ThreadRunFunc run, void *data) {
+	return Thread_Enqueue(name, run, data, NULL, NULL, false);
+}
+
+/*
+ * @brief Creates a new job which will run only after the specified dependency
+ * has completed. The dependency must not be released with Thread_Wait until
+ * this call returns. Callers must use Thread_Wait on the returned handle.
+ */
+thread_t *Thread_CreateAfter_(const char *name, ThreadRunFunc run, void *data, thread_t *dependency) {
+	return Thread_Enqueue(name, run, data, dependency, NULL, false);
+}
+
+/*
+ * @brief Submits a job which is released automatically when it completes. Use
+ * Thread_WaitAll on the counter to wait for a group of submitted jobs.
+ */
+void Thread_Submit_(const char *name, ThreadRunFunc run, void *data, thread_counter_t *counter) {
+	Thread_Enqueue(name, run, data, NULL, counter, true);
+}
+
+/*
+ * @brief Wait for the specified job to complete, and release it.
  */
 void Thread_Wait(thread_t *t) {
 
-	if (!t || t->status == THREAD_IDLE)
+	if (!t || SDL_AtomicGet(&t->status) == THREAD_IDLE)
 		return;
 
-	while (t->status != THREAD_WAIT) {
-		usleep(0);
-	}
+	Thread_Join(Thread_Done, t);
+
+	Thread_Free(t);
+}
+
+/*
+ * @brief Wait for all jobs submitted against the specified counter to complete.
+ */
+void Thread_WaitAll(thread_counter_t *counter) {
 
-	t->status = THREAD_IDLE;
+	if (!counter)
+		return;
+
+	Thread_Join(Thread_CounterDone, counter);
 }
 
 /*
@@ -186,7 +534,13 @@ void Thread_Init(uint16_t num_threads) {
 
 	memset(&thread_pool, 0, sizeof(thread_pool));
 
+	if (thread_worker == 0) {
+		thread_worker = SDL_TLSCreate();
+	}
+
 	thread_pool.mutex = SDL_CreateMutex();
+	thread_pool.work_cond = SDL_CreateCond();
+	thread_pool.done_cond = SDL_CreateCond();
 
 	Thread_Init_(num_threads);
 }
@@ -197,11 +551,12 @@ void Thread_Init(uint16_t num_threads) {
 void Thread_Shutdown(void) {
 
 	if (thread_pool.mutex) {
+		Thread_Shutdown_();
+
+		SDL_DestroyCond(thread_pool.work_cond);
+		SDL_DestroyCond(thread_pool.done_cond);
 		SDL_DestroyMutex(thread_pool.mutex);
-		thread_pool.mutex = NULL;
 	}
 
-	Thread_Shutdown_();
-
 	memset(&thread_pool, 0, sizeof(thread_pool));
 }
@@ -22,12 +22,24 @@
 #ifndef __THREAD_H__
 #define __THREAD_H__
 
+#include <SDL2/SDL_atomic.h>
 #include <SDL2/SDL_thread.h>
 
 #include "mem.h"
 
 #define MAX_THREADS 128
 
+/*
+ * @brief The maximum number of jobs which may be outstanding at any one time.
+ * When the job pool is exhausted, jobs are simply run on the calling thread.
+ */
+#define MAX_THREAD_JOBS 4096
+
+/*
+ * @brief The capacity of each worker's job deque (must be a power of 2).
+ */
+#define MAX_THREAD_DEQUE 1024
+
 typedef enum {
 	THREAD_IDLE,
 	THREAD_RUNNING,
@@ -36,19 +48,43 @@ typedef enum {
 
 typedef void (*ThreadRunFunc)(void *data);
 
-typedef struct {
-	SDL_Thread *thread;
-	SDL_cond *cond;
-	SDL_mutex *mutex;
+/*
+ * @brief Jobs are dispatched to the worker pool and may be waited upon through
+ * their handle. A job may also be scheduled as the continuation of another, in
+ * which case it is not queued until its dependency completes.
+ */
+typedef struct thread_s {
 	char name[64];
-	thread_status_t status;
+	SDL_atomic_t status;
 	ThreadRunFunc Run;
 	void *data;
+
+	SDL_atomic_t pending; // unfinished dependencies, plus one for submission
+	SDL_SpinLock lock; // guards continuations
+
+	struct thread_s *continuations; // jobs to release when this one completes
+	struct thread_s *next; // sibling continuation, or next free job
+
+	struct thread_counter_s *counter; // optional counter to decrement on completion
+	_Bool detached; // released automatically on completion
 } thread_t;
 
+/*
+ * @brief Counters provide a join point for groups of jobs submitted without
+ * handles. A zeroed counter is ready for use.
+ */
+typedef struct thread_counter_s {
+	SDL_atomic_t count;
+} thread_counter_t;
+
 thread_t *Thread_Create_(const char *name, ThreadRunFunc run, void *data);
 #define Thread_Create(f, d) Thread_Create_(#f, f, d)
+thread_t *Thread_CreateAfter_(const char *name, ThreadRunFunc run, void *data, thread_t *dependency);
+#define Thread_CreateAfter(f, d, t) Thread_CreateAfter_(#f, f, d, t)
+void Thread_Submit_(const char *name, ThreadRunFunc run, void *data, thread_counter_t *counter);
+#define Thread_Submit(f, d, c) Thread_Submit_(#f, f, d, c)
 void Thread_Wait(thread_t *t);
+void Thread_WaitAll(thread_counter_t *counter);
 uint16_t Thread_Count(void);
 void Thread_Init(uint16_t num_threads);
 void Thread_Shutdown(void);
@@ -496,6 +496,50 @@ static void GatherSampleSunlight(const vec3_t pos, const vec3_t normal, vec_t *s
 	VectorMA(direction, light * scale, delta, direction);
 }
 
+/*
+ * @brief A light source which may reach a sample position, pending an
+ * occlusion test.
+ */
+typedef struct {
+	const light_t *light;
+	vec3_t delta; // normalized direction from the sample to the light
+	vec_t intensity; // light received, if unoccluded
+} sample_light_t;
+
+/*
+ * @brief Traces from each of the pending light sources to the sample position
+ * in a single batch, accumulating light and directional information from
+ * those which are not occluded.
+ */
+static void GatherSampleLights(const sample_light_t *pending, size_t count, const vec3_t pos,
+		const vec3_t normal, vec_t *sample, vec_t *direction, vec_t scale) {
+	vec3_t starts[LIGHT_TRACES], ends[LIGHT_TRACES];
+	cm_trace_t traces[LIGHT_TRACES];
+
+	for (size_t i = 0; i < count; i++) {
+		VectorCopy(pending[i].light->origin, starts[i]);
+		VectorCopy(pos, ends[i]);
+	}
+
+	Light_Traces(traces, (const vec3_t *) starts, (const vec3_t *) ends, count, CONTENTS_SOLID);
+
+	for (size_t i = 0; i < count; i++) {
+		const light_t *l = pending[i].light;
+		const vec_t light = pending[i].intensity;
+		vec3_t delta;
+
+		if (traces[i].fraction < 1.0)
+			continue; // occluded
+
+		// add some light to it
+		VectorMA(sample, light * scale, l->color, sample);
+
+		// and add some direction
+		VectorMix(normal, pending[i].delta, 2.0 * light / l->intensity, delta);
+		VectorMA(direction, light * scale, delta, direction);
+	}
+}
+
 /*
  * @brief Iterate over all light sources for the sample position's PVS, accumulating
  * light and directional information to the specified pointers.
@@ -503,11 +547,13 @@ static void GatherSampleSunlight(const vec3_t pos, const vec3_t normal, vec_t *s
 static void GatherSampleLight(vec3_t pos, vec3_t normal, byte *pvs, vec_t *sample,
 		vec_t *direction, vec_t scale) {
 
+	sample_light_t pending[LIGHT_TRACES];
+	size_t num_pending = 0;
+
 	light_t *l;
 	vec3_t delta;
 	vec_t dot, dot2;
 	vec_t dist;
-	cm_trace_t trace;
 	int32_t i;
 
 	// iterate over lights, which are in buckets by cluster
@@ -553,20 +599,20 @@ static void GatherSampleLight(vec3_t pos, vec3_t normal, byte *pvs, vec_t *sampl
 			if (light <= 0.0) // no light
 				continue;
 
-			Light_Trace(&trace, l->origin, pos, CONTENTS_SOLID);
-
-			if (trace.fraction < 1.0)
-				continue; // occluded
-
-			// add some light to it
-			VectorMA(sample, light * scale, l->color, sample);
+			// defer the occlusion test, so that it may be batched
+			pending[num_pending].light = l;
+			pending[num_pending].intensity = light;
+			VectorCopy(delta, pending[num_pending].delta);
 
-			// and add some direction
-			VectorMix(normal, delta, 2.0 * light / l->intensity, delta);
-			VectorMA(direction, light * scale, delta, direction);
+			if (++num_pending == LIGHT_TRACES) {
+				GatherSampleLights(pending, num_pending, pos, normal, sample, direction, scale);
+				num_pending = 0;
+			}
 		}
 	}
 
+	GatherSampleLights(pending, num_pending, pos, normal, sample, direction, scale);
+
 	GatherSampleSunlight(pos, normal, sample, direction, scale);
 }
 
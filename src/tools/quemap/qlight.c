@@ -107,6 +107,31 @@ void Light_Trace(cm_trace_t *trace, const vec3_t start, const vec3_t end, int32_
 	}
 }
 
+/*
+ * @brief Traces up to LIGHT_TRACES rays, yielding the same results as calling
+ * Light_Trace for each.
+ */
+void Light_Traces(cm_trace_t *traces, const vec3_t *starts, const vec3_t *ends, size_t count,
+		int32_t mask) {
+	cm_trace_t trs[LIGHT_TRACES];
+
+	if (count > LIGHT_TRACES)
+		Com_Error(ERR_FATAL, "Too many traces: %zu\n", count);
+
+	Cm_BoxTraces(starts, ends, count, vec3_origin, vec3_origin, cmodels[0]->head_node, mask, traces);
+
+	// and any BSP submodels, too
+	for (int32_t i = 1; i < num_cmodels; i++) {
+		Cm_BoxTraces(starts, ends, count, vec3_origin, vec3_origin, cmodels[i]->head_node, mask, trs);
+
+		for (size_t j = 0; j < count; j++) {
+			if (trs[j].fraction < traces[j].fraction) {
+				traces[j] = trs[j];
+			}
+		}
+	}
+}
+
 /*
  * @brief
  */
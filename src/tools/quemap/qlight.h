@@ -76,4 +76,9 @@ _Bool Light_PointPVS(const vec3_t org, byte *pvs);
 int32_t Light_PointLeafnum(const vec3_t point);
 void Light_Trace(cm_trace_t *trace, const vec3_t start, const vec3_t end, int32_t mask);
 
+#define LIGHT_TRACES 64 // the most rays which may be traced by Light_Traces
+
+void Light_Traces(cm_trace_t *traces, const vec3_t *starts, const vec3_t *ends, size_t count,
+		int32_t mask);
+
 #endif /* __QLIGHT_H__ */
@@ -134,7 +134,7 @@ void ThreadUnlock(void) {
  * @brief
  */
 static void RunThreads(void) {
-	thread_t *t[MAX_THREADS];
+	thread_counter_t counter;
 	int32_t i;
 
 	if (Thread_Count() == 0) {
@@ -144,11 +144,13 @@ static void RunThreads(void) {
 
 	lock = SDL_CreateMutex();
 
-	for (i = 0; i < Thread_Count(); i++)
-		t[i] = Thread_Create(ThreadWork, NULL);
+	memset(&counter, 0, sizeof(counter));
 
 	for (i = 0; i < Thread_Count(); i++)
-		Thread_Wait(t[i]);
+		Thread_Submit(ThreadWork, NULL, &counter);
+
+	// the main thread lends a hand while it waits
+	Thread_WaitAll(&counter);
 
 	SDL_DestroyMutex(lock);
 	lock = NULL;